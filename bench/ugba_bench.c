@@ -0,0 +1,674 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+// Benchmark of the SDL2 port of the library. It runs a set of synthetic
+// workloads in headless mode, so it doesn't need a display or an audio device,
+// and it prints the results in JSON format.
+//
+// Usage: ugba_bench [--frames N] [--output file.json] [workload ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ugba/ugba.h>
+
+#define BENCH_DEFAULT_FRAMES    600
+#define BENCH_WARMUP_FRAMES     10
+
+#define BENCH_VISIBLE_LINES     160
+
+typedef struct {
+    const char *name;
+    void (*setup)(void);
+    void (*frame)(int frame); // Called right after the VBL interrupt
+} bench_workload;
+
+// Helpers
+// =======
+
+static uint32_t bench_random_state = 0x12345678;
+
+static uint32_t bench_random(void)
+{
+    // Xorshift32
+    uint32_t x = bench_random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    bench_random_state = x;
+    return x;
+}
+
+static void bench_fill_random(void *dst, size_t size)
+{
+    uint8_t *p = dst;
+
+    for (size_t i = 0; i < size; i++)
+        p[i] = bench_random();
+}
+
+// Fill a regular map with random tiles, flips and palettes
+static void bench_fill_map_regular(uintptr_t addr, size_t entries,
+                                   uint16_t num_tiles)
+{
+    uint16_t *map = (uint16_t *)addr;
+
+    for (size_t i = 0; i < entries; i++)
+    {
+        uint32_t r = bench_random();
+        map[i] = MAP_REGULAR_TILE(r % num_tiles) | ((r >> 16) & 0xFC00);
+    }
+}
+
+// Fill a bitmap framebuffer with a gradient, which is similar to real images
+static void bench_fill_bitmap(uint16_t *fb, int w, int h)
+{
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+            fb[y * w + x] = RGB15(x & 31, y & 31, (x + y) & 31);
+    }
+}
+
+// Sine table with 256 entries per turn and 8 fractional bits
+static int32_t bench_sin(int angle)
+{
+    static int16_t table[256];
+    static int initialized = 0;
+
+    if (!initialized)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            // Parabolic approximation, it only needs to look smooth
+            int32_t x = (i & 127) - 64;
+            int32_t v = 256 - ((x * x) >> 4);
+            table[i] = (i < 128) ? v : -v;
+        }
+        initialized = 1;
+    }
+
+    return table[angle & 255];
+}
+
+static void bench_reset(void)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        DMA_Stop(i);
+        TM_TimerStop(i);
+    }
+
+    SWI_RegisterRamReset(SWI_RAM_RESET_PALETTE | SWI_RAM_RESET_VRAM |
+                         SWI_RAM_RESET_OAM | SWI_RAM_RESET_IO_SOUND |
+                         SWI_RAM_RESET_IO_OTHER);
+
+    for (int i = 0; i < MEM_OAM_NUMBER_ENTRIES; i++)
+        MEM_OAM_ENTRIES[i].attr0 = ATTR0_DISABLE;
+
+    IRQ_Init();
+    IRQ_Enable(IRQ_VBLANK);
+
+    bench_fill_random(MEM_PALETTE, MEM_PALETTE_SIZE);
+}
+
+// Common setups
+// =============
+
+// Four regular backgrounds. BG0 and BG1 use 16 colors, BG2 and BG3 use 256.
+static void bench_setup_regular_bgs(void)
+{
+    bench_fill_random(MEM_VRAM_BG, 2 * MEM_BG_TILES_BLOCK_SIZE);
+
+    BG_RegularInit(0, BG_REGULAR_512x512, BG_16_COLORS,
+                   MEM_BG_TILES_BLOCK_ADDR(0), MEM_BG_MAP_BLOCK_ADDR(16));
+    bench_fill_map_regular(MEM_BG_MAP_BLOCK_ADDR(16), 64 * 64, 1024);
+
+    BG_RegularInit(1, BG_REGULAR_512x256, BG_16_COLORS,
+                   MEM_BG_TILES_BLOCK_ADDR(0), MEM_BG_MAP_BLOCK_ADDR(20));
+    bench_fill_map_regular(MEM_BG_MAP_BLOCK_ADDR(20), 64 * 32, 1024);
+
+    BG_RegularInit(2, BG_REGULAR_256x512, BG_256_COLORS,
+                   MEM_BG_TILES_BLOCK_ADDR(0), MEM_BG_MAP_BLOCK_ADDR(22));
+    bench_fill_map_regular(MEM_BG_MAP_BLOCK_ADDR(22), 32 * 64, 512);
+
+    BG_RegularInit(3, BG_REGULAR_256x256, BG_256_COLORS,
+                   MEM_BG_TILES_BLOCK_ADDR(0), MEM_BG_MAP_BLOCK_ADDR(24));
+    bench_fill_map_regular(MEM_BG_MAP_BLOCK_ADDR(24), 32 * 32, 512);
+}
+
+static void bench_scroll_regular_bgs(int frame)
+{
+    BG_RegularScrollSet(0, frame, frame >> 1);
+    BG_RegularScrollSet(1, -frame, frame);
+    BG_RegularScrollSet(2, frame >> 1, -frame);
+    BG_RegularScrollSet(3, -(frame >> 2), frame >> 2);
+}
+
+static void bench_affine_bg_set(int index, int frame, int speed)
+{
+    bg_affine_src src = {
+        .bgx = (128 << 8) + (frame << 8),
+        .bgy = (128 << 8),
+        .scrx = 120,
+        .scry = 80,
+        .scalex = (1 << 8) + (bench_sin(frame) >> 2),
+        .scaley = (1 << 8) + (bench_sin(frame) >> 2),
+        .angle = (uint32_t)(frame * speed) << 8,
+    };
+    bg_affine_dst dst;
+
+    SWI_BgAffineSet(&src, &dst, 1);
+    BG_AffineTransformSet(index, &dst);
+}
+
+static void bench_setup_sprite_tiles(void)
+{
+    bench_fill_random(MEM_VRAM_OBJ, MEM_VRAM_OBJ_SIZE);
+}
+
+// 128 affine sprites of 32x32 pixels drawn in a 64x64 area, sharing the 32
+// affine matrices.
+static void bench_setup_affine_sprites(void)
+{
+    bench_setup_sprite_tiles();
+
+    for (int i = 0; i < MEM_OAM_NUMBER_ENTRIES; i++)
+    {
+        int x = (i * 37) % (240 + 64) - 64;
+        int y = (i * 23) % (160 + 64) - 64;
+        oam_color_mode colors = (i & 1) ? OBJ_256_COLORS : OBJ_16_COLORS;
+
+        OBJ_AffineInit(i, x, y, OBJ_SIZE_32x32, i & 31, colors, i & 15,
+                       (i & 15) * 32, 1);
+        OBJ_PrioritySet(i, i & 3);
+    }
+}
+
+static void bench_update_affine_sprites(int frame)
+{
+    obj_affine_src src[MEM_OAM_NUMBER_MATRICES];
+
+    for (int i = 0; i < MEM_OAM_NUMBER_MATRICES; i++)
+    {
+        src[i].sx = (1 << 8) + (bench_sin(frame + i * 8) >> 2);
+        src[i].sy = (1 << 8) + (bench_sin(frame + i * 8) >> 2);
+        src[i].angle = (uint16_t)((frame + i) * 256);
+    }
+
+    SWI_ObjAffineSet_OAM(src, MEM_OAM_MATRICES, MEM_OAM_NUMBER_MATRICES);
+
+    for (int i = 0; i < MEM_OAM_NUMBER_ENTRIES; i++)
+    {
+        int x = ((i * 37) + frame) % (240 + 64) - 64;
+        int y = ((i * 23) + (frame >> 1)) % (160 + 64) - 64;
+        OBJ_PositionSet(i, x, y);
+    }
+}
+
+// Video modes
+// ===========
+
+static void bench_mode0_setup(void)
+{
+    bench_setup_regular_bgs();
+
+    REG_DISPCNT = DISPCNT_BG_MODE(0) |
+                  DISPCNT_BG0_ENABLE | DISPCNT_BG1_ENABLE |
+                  DISPCNT_BG2_ENABLE | DISPCNT_BG3_ENABLE;
+}
+
+static void bench_mode0_frame(int frame)
+{
+    bench_scroll_regular_bgs(frame);
+}
+
+static void bench_mode1_setup(void)
+{
+    bench_setup_regular_bgs();
+
+    BG_AffineInit(2, BG_AFFINE_512x512, MEM_BG_TILES_BLOCK_ADDR(0),
+                  MEM_BG_MAP_BLOCK_ADDR(26), 1);
+    bench_fill_random((void *)MEM_BG_MAP_BLOCK_ADDR(26), 64 * 64);
+
+    REG_DISPCNT = DISPCNT_BG_MODE(1) |
+                  DISPCNT_BG0_ENABLE | DISPCNT_BG1_ENABLE | DISPCNT_BG2_ENABLE;
+}
+
+static void bench_mode1_frame(int frame)
+{
+    bench_scroll_regular_bgs(frame);
+    bench_affine_bg_set(2, frame, 1);
+}
+
+static void bench_mode2_setup(void)
+{
+    bench_fill_random(MEM_VRAM_BG, MEM_BG_TILES_BLOCK_SIZE);
+
+    BG_AffineInit(2, BG_AFFINE_1024x1024, MEM_BG_TILES_BLOCK_ADDR(0),
+                  MEM_BG_MAP_BLOCK_ADDR(16), 1);
+    bench_fill_random((void *)MEM_BG_MAP_BLOCK_ADDR(16), 128 * 128);
+
+    BG_AffineInit(3, BG_AFFINE_256x256, MEM_BG_TILES_BLOCK_ADDR(0),
+                  MEM_BG_MAP_BLOCK_ADDR(24), 0);
+    bench_fill_random((void *)MEM_BG_MAP_BLOCK_ADDR(24), 32 * 32);
+
+    REG_DISPCNT = DISPCNT_BG_MODE(2) | DISPCNT_BG2_ENABLE | DISPCNT_BG3_ENABLE;
+}
+
+static void bench_mode2_frame(int frame)
+{
+    bench_affine_bg_set(2, frame, 1);
+    bench_affine_bg_set(3, frame, -2);
+}
+
+static void bench_mode3_setup(void)
+{
+    bench_fill_bitmap(BG_Mode3FramebufferGet(), GBA_SCREEN_W, GBA_SCREEN_H);
+
+    REG_DISPCNT = DISPCNT_BG_MODE(3) | DISPCNT_BG2_ENABLE;
+}
+
+static void bench_mode3_frame(int frame)
+{
+    // Modify one line per frame, like a game that draws to the framebuffer
+    uint16_t *fb = BG_Mode3FramebufferGet();
+    int y = frame % GBA_SCREEN_H;
+
+    for (int x = 0; x < GBA_SCREEN_W; x++)
+        fb[y * GBA_SCREEN_W + x] = bench_random();
+}
+
+static void bench_mode4_setup(void)
+{
+    bench_fill_random(MEM_VRAM_MODE4_FRAME0, GBA_SCREEN_W * GBA_SCREEN_H);
+    bench_fill_random(MEM_VRAM_MODE4_FRAME1, GBA_SCREEN_W * GBA_SCREEN_H);
+
+    REG_DISPCNT = DISPCNT_BG_MODE(4) | DISPCNT_BG2_ENABLE;
+}
+
+static void bench_mode45_frame(UNUSED int frame)
+{
+    BG_FramebufferSwap();
+}
+
+static void bench_mode5_setup(void)
+{
+    bench_fill_bitmap(MEM_VRAM_MODE5_FRAME0, 160, 128);
+    bench_fill_bitmap(MEM_VRAM_MODE5_FRAME1, 160, 128);
+
+    REG_DISPCNT = DISPCNT_BG_MODE(5) | DISPCNT_BG2_ENABLE;
+}
+
+// Sprites
+// =======
+
+static void bench_sprites_setup(void)
+{
+    bench_mode0_setup();
+    bench_setup_affine_sprites();
+
+    REG_DISPCNT |= DISPCNT_OBJ_ENABLE | DISPCNT_OBJ_1D_MAPPING;
+}
+
+static void bench_sprites_frame(int frame)
+{
+    bench_scroll_regular_bgs(frame);
+    bench_update_affine_sprites(frame);
+}
+
+// Windows and blending
+// ====================
+
+// Every frame uses a different combination of windows (none, window 0,
+// window 1, object window) and special effects (none, alpha blending,
+// brightness increase, brightness decrease).
+
+static void bench_windows_setup(void)
+{
+    bench_setup_regular_bgs();
+    bench_setup_sprite_tiles();
+
+    // Sprites used as object window, and sprites with alpha blending
+    for (int i = 0; i < 32; i++)
+    {
+        int x = (i * 29) % 240;
+        int y = (i * 17) % 160;
+
+        OBJ_RegularInit(i, x, y, OBJ_SIZE_64x64, OBJ_16_COLORS, i & 15, 0);
+
+        if (i < 16)
+            OBJ_ModeSet(i, OBJ_MODE_WINDOW);
+        else
+            OBJ_ModeSet(i, OBJ_MODE_TRANSPARENT);
+    }
+
+    WIN_Win0LayersSet(WININ0_BG0_ENABLE | WININ0_BG2_ENABLE |
+                      WININ0_OBJ_ENABLE | WININ0_EFFECT_ENABLE);
+    WIN_Win1LayersSet(WININ1_BG1_ENABLE | WININ1_BG3_ENABLE |
+                      WININ1_EFFECT_ENABLE);
+    WIN_WinOutLayersSet(WINOUT_BG0_ENABLE | WINOUT_BG1_ENABLE |
+                        WINOUT_BG2_ENABLE | WINOUT_BG3_ENABLE |
+                        WINOUT_OBJ_ENABLE);
+    WIN_WinObjLayersSet(WINOBJ_BG1_ENABLE | WINOBJ_BG2_ENABLE |
+                        WINOBJ_EFFECT_ENABLE);
+
+    DISP_BlendAlphaSet(10, 6);
+    DISP_BlendYSet(8);
+}
+
+static void bench_windows_frame(int frame)
+{
+    const uint16_t effects[4] = {
+        BLDCNT_DISABLE, BLDCNT_ALPHA_BLENDING,
+        BLDCNT_BRIGTHNESS_INCRESE, BLDCNT_BRIGTHNESS_DECREASE
+    };
+
+    int windows = frame & 7;
+    int effect = (frame >> 3) & 3;
+
+    REG_DISPCNT = DISPCNT_BG_MODE(0) |
+                  DISPCNT_BG0_ENABLE | DISPCNT_BG1_ENABLE |
+                  DISPCNT_BG2_ENABLE | DISPCNT_BG3_ENABLE |
+                  DISPCNT_OBJ_ENABLE | DISPCNT_OBJ_1D_MAPPING;
+
+    DISP_WindowsEnable(windows & 1, windows & 2, windows & 4);
+
+    int x = frame % 120;
+    WIN_Win0SizeSet(x, x + 100, 20, 120);
+    WIN_Win1SizeSet(200 - x, 239, 60, 150);
+
+    DISP_BlendSetup(BLDCNT_1ST_BG0 | BLDCNT_1ST_BG1 | BLDCNT_1ST_OBJ,
+                    BLDCNT_2ND_BG2 | BLDCNT_2ND_BG3 | BLDCNT_2ND_BD,
+                    effects[effect]);
+
+    bench_scroll_regular_bgs(frame);
+}
+
+// Mosaic
+// ======
+
+static void bench_mosaic_setup(void)
+{
+    bench_mode1_setup();
+    bench_setup_affine_sprites();
+
+    for (int i = 0; i < MEM_OAM_NUMBER_ENTRIES; i++)
+        OBJ_MosaicSet(i, 1);
+
+    for (int i = 0; i < 3; i++)
+        BG_MosaicEnable(i, 1);
+
+    REG_DISPCNT |= DISPCNT_OBJ_ENABLE | DISPCNT_OBJ_1D_MAPPING;
+}
+
+static void bench_mosaic_frame(int frame)
+{
+    int size = (frame >> 2) & 15;
+
+    DISP_MosaicSet(size, 15 - size, 15 - size, size);
+
+    bench_mode1_frame(frame);
+    bench_update_affine_sprites(frame);
+}
+
+// HBL DMA
+// =======
+
+// Two HBL DMA channels modify the scroll of two backgrounds in every scanline
+
+static uint16_t bench_hbl_hofs[GBA_SCREEN_H + 1];
+static uint32_t bench_hbl_ofs[GBA_SCREEN_H + 1];
+
+static void bench_hbl_dma_setup(void)
+{
+    bench_mode0_setup();
+}
+
+static void bench_hbl_dma_frame(int frame)
+{
+    for (int y = 0; y < GBA_SCREEN_H + 1; y++)
+    {
+        int hofs = bench_sin(frame + y * 2) >> 4;
+        int vofs = bench_sin(frame * 2 + y) >> 5;
+
+        bench_hbl_hofs[y] = hofs;
+        bench_hbl_ofs[y] = (uint16_t)-hofs | ((uint32_t)(uint16_t)vofs << 16);
+    }
+
+    uint16_t flags = DMACNT_DST_FIXED | DMACNT_SRC_INCREMENT |
+                     DMACNT_REPEAT_ON | DMACNT_START_HBLANK;
+
+    DMA_Stop(0);
+    DMA_Transfer(0, &bench_hbl_hofs[1], (void *)&REG_BG0HOFS, 2,
+                 flags | DMACNT_TRANSFER_16_BITS);
+
+    DMA_Stop(3);
+    DMA_Transfer(3, &bench_hbl_ofs[1], (void *)&REG_BG1HOFS, 4,
+                 flags | DMACNT_TRANSFER_32_BITS);
+
+    // The first line isn't affected by HBL DMA
+    REG_BG0HOFS = bench_hbl_hofs[0];
+    REG_BG1HOFS = bench_hbl_ofs[0] & 0xFFFF;
+    REG_BG1VOFS = bench_hbl_ofs[0] >> 16;
+}
+
+// Sound
+// =====
+
+// The four PSG channels and both DMA channels play at the same time, while the
+// screen only displays one background.
+
+#define BENCH_SOUND_BUFFER_SIZE 1024
+
+static ALIGNED(4) int8_t bench_sound_buffer_a[BENCH_SOUND_BUFFER_SIZE];
+static ALIGNED(4) int8_t bench_sound_buffer_b[BENCH_SOUND_BUFFER_SIZE];
+
+static void bench_sound_setup(void)
+{
+    bench_setup_regular_bgs();
+
+    REG_DISPCNT = DISPCNT_BG_MODE(0) | DISPCNT_BG0_ENABLE;
+
+    for (int i = 0; i < BENCH_SOUND_BUFFER_SIZE; i++)
+    {
+        bench_sound_buffer_a[i] = bench_sin(i) >> 2;
+        bench_sound_buffer_b[i] = bench_random();
+    }
+
+    SOUND_MasterEnable(1);
+
+    // PSG channels
+
+    SOUND_PSG_MasterVolume(100);
+    SOUND_PSG_Volume(7, 7);
+    SOUND_PSG_Pan(1, 1, 1, 1, 1, 1, 1, 1);
+
+    REG_SOUND1CNT_L = SOUND1CNT_L_SWEEP_TIME_SET(3) |
+                      SOUND1CNT_L_SWEEP_DIR_INC | SOUND1CNT_L_SWEEP_SHIFT_SET(2);
+    REG_SOUND1CNT_H = SOUND1CNT_H_WAVE_DUTY_50 |
+                      SOUND1CNT_H_ENV_VOLUME_SET(15);
+    REG_SOUND1CNT_X = SOUND1CNT_X_FREQUENCY_SET(1546) | SOUND1CNT_X_RESTART;
+
+    REG_SOUND2CNT_L = SOUND2CNT_L_WAVE_DUTY_25 |
+                      SOUND2CNT_L_ENV_VOLUME_SET(12) |
+                      SOUND2CNT_L_ENV_STEP_TIME_SET(7) |
+                      SOUND2CNT_L_ENV_DIR_DEC;
+    REG_SOUND2CNT_H = SOUND2CNT_H_FREQUENCY_SET(1750) | SOUND2CNT_H_RESTART;
+
+    for (int i = 0; i < 8; i++)
+        REG_WAVE_RAM[i] = bench_random();
+    REG_SOUND3CNT_L = SOUND3CNT_L_SIZE_32 | SOUND3CNT_L_BANK_SET(0) |
+                      SOUND3CNT_L_ENABLE;
+    REG_SOUND3CNT_H = SOUND3CNT_H_VOLUME_100;
+    REG_SOUND3CNT_X = SOUND3CNT_X_SAMPLE_RATE_SET(1800) |
+                      SOUND3CNT_X_RESTART;
+
+    REG_SOUND4CNT_L = SOUND4CNT_L_ENV_VOLUME_SET(10);
+    REG_SOUND4CNT_H = SOUND4CNT_H_DIV_RATIO_SET(3) |
+                      SOUND4CNT_H_WIDTH_15_BITS |
+                      SOUND4CNT_H_FREQUENCY_SET(2) | SOUND4CNT_H_RESTART;
+
+    // DMA channels at 32768 Hz
+
+    SOUND_DMA_Volume(100, 100);
+    SOUND_DMA_Pan(1, 0, 0, 1);
+    SOUND_DMA_TimerSetup(0, 1);
+
+    TM_TimerStart(0, (UINT16_MAX + 1) - 512, 1, 0);
+    TM_TimerStart(1, (UINT16_MAX + 1) - 512, 1, 0);
+
+    SOUND_DMA_Setup_AB(bench_sound_buffer_a, bench_sound_buffer_b);
+}
+
+static void bench_sound_frame(int frame)
+{
+    // 32768 Hz / 60 FPS is lower than the size of the buffers
+    SOUND_DMA_Retrigger_AB();
+
+    bench_scroll_regular_bgs(frame);
+}
+
+// Benchmark runner
+// ================
+
+static const bench_workload bench_workloads[] = {
+    { "mode0", bench_mode0_setup, bench_mode0_frame },
+    { "mode1", bench_mode1_setup, bench_mode1_frame },
+    { "mode2", bench_mode2_setup, bench_mode2_frame },
+    { "mode3", bench_mode3_setup, bench_mode3_frame },
+    { "mode4", bench_mode4_setup, bench_mode45_frame },
+    { "mode5", bench_mode5_setup, bench_mode45_frame },
+    { "affine_sprites", bench_sprites_setup, bench_sprites_frame },
+    { "windows_blend", bench_windows_setup, bench_windows_frame },
+    { "mosaic", bench_mosaic_setup, bench_mosaic_frame },
+    { "hbl_dma", bench_hbl_dma_setup, bench_hbl_dma_frame },
+    { "sound", bench_sound_setup, bench_sound_frame },
+};
+
+#define BENCH_NUM_WORKLOADS \
+        (sizeof(bench_workloads) / sizeof(bench_workloads[0]))
+
+static double bench_time(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+// Returns the number of seconds needed to run the specified number of frames
+static double bench_run(const bench_workload *w, int frames)
+{
+    bench_random_state = 0x12345678;
+
+    bench_reset();
+    w->setup();
+
+    for (int i = 0; i < BENCH_WARMUP_FRAMES; i++)
+    {
+        w->frame(i);
+        SWI_VBlankIntrWait();
+    }
+
+    double start = bench_time();
+
+    for (int i = 0; i < frames; i++)
+    {
+        w->frame(BENCH_WARMUP_FRAMES + i);
+        SWI_VBlankIntrWait();
+    }
+
+    return bench_time() - start;
+}
+
+static int bench_selected(const char *name, int argc, char *argv[])
+{
+    if (argc == 0)
+        return 1;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], name) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    UGBA_InitHeadless(&argc, &argv);
+
+    // Draw all frames as fast as possible
+    UGBA_FastForwardSet(1, 1);
+
+    int frames = BENCH_DEFAULT_FRAMES;
+    const char *output = NULL;
+
+    int arg = 1;
+    while (arg < argc)
+    {
+        if ((strcmp(argv[arg], "--frames") == 0) && (arg + 1 < argc))
+            frames = atoi(argv[arg + 1]);
+        else if ((strcmp(argv[arg], "--output") == 0) && (arg + 1 < argc))
+            output = argv[arg + 1];
+        else
+            break;
+
+        arg += 2;
+    }
+
+    if (frames <= 0)
+    {
+        fprintf(stderr, "Invalid number of frames\n");
+        return 1;
+    }
+
+    FILE *f = stdout;
+    if (output != NULL)
+    {
+        f = fopen(output, "w");
+        if (f == NULL)
+        {
+            fprintf(stderr, "Can't open %s\n", output);
+            return 1;
+        }
+    }
+
+    fprintf(f, "{\"frames\":%d,\"workloads\":[", frames);
+
+    int first = 1;
+
+    for (size_t i = 0; i < BENCH_NUM_WORKLOADS; i++)
+    {
+        const bench_workload *w = &bench_workloads[i];
+
+        if (!bench_selected(w->name, argc - arg, &argv[arg]))
+            continue;
+
+        double seconds = bench_run(w, frames);
+
+        double fps = frames / seconds;
+        double ns_per_line = (seconds * 1000000000.0)
+                           / ((double)frames * BENCH_VISIBLE_LINES);
+
+        fprintf(f, "%s\n{\"name\":\"%s\",\"seconds\":%.3f,\"fps\":%.1f,"
+                "\"ns_per_scanline\":%.1f}", first ? "" : ",", w->name,
+                seconds, fps, ns_per_line);
+        fflush(f);
+
+        first = 0;
+    }
+
+    fprintf(f, "\n]}\n");
+
+    if (f != stdout)
+        fclose(f);
+
+    return 0;
+}
@@ -36,6 +36,76 @@ EXPORT_API void UGBA_Init(int *argc, char **argv[]);
 // be called at the start of main(). Not implemented in GBA as it isn't usedul
 // there.
 EXPORT_API void UGBA_InitHeadless(int *argc, char **argv[]);
+
+// Run the simulation as fast as possible instead of at 60 FPS. Only one of every
+// draw_interval frames is drawn and shown. If it is 0, frames are only drawn if
+// a Lua script needs them. Frames that aren't drawn skip all the GUI code. This
+// can also be enabled with the environment variable UGBA_FAST_FORWARD or the
+// command line argument "--fast-forward", which take draw_interval as value.
+EXPORT_API void UGBA_FastForwardSet(int enable, int draw_interval);
+
+// Emulation contexts. A context holds the state of one emulated GBA: memory,
+// registers, interrupt handlers, DMA, timers, sound and video. Each thread has a
+// current context, and all threads start with the default context, which is
+// the one connected to the GUI and the audio device. Additional contexts are
+// headless and run as fast as possible, so that several games can be run at the
+// same time in different threads. Note that only the state of the library is
+// part of the context: the code that runs in several contexts at the same time
+// can't share global variables.
+typedef struct ugba_context ugba_context;
+
+// Create a new context with all the hardware reset. UGBA_Init() must have been
+// called before using it. If UGBA_Init() or UGBA_InitHeadless() are called
+// while it is the current context, they don't do anything. Returns NULL on
+// error.
+EXPORT_API ugba_context *UGBA_ContextCreate(void);
+// Destroy a context. It can't be the current context of any thread.
+EXPORT_API void UGBA_ContextDestroy(ugba_context *ctx);
+// Set the current context of the calling thread. If ctx is NULL, the default
+// context is used.
+EXPORT_API void UGBA_ContextSetCurrent(ugba_context *ctx);
+EXPORT_API ugba_context *UGBA_ContextGetCurrent(void);
+
+// Save states. They hold the state of the emulated hardware of the current
+// context: memory, I/O registers, DMA, timers, sound and video. The state of
+// the code of the game (its variables, stack and interrupt handlers) isn't part
+// of it, so the game is responsible for restoring it. They must be used between
+// frames, or when the game is paused by a Lua script. They use a compact binary
+// format that can only be loaded by builds of the library for the same
+// platform. DMA channels that read from or write to memory of the program
+// outside of the emulated memory (like arrays in the game binary) are saved as
+// pointers, which are only valid in the process that has created the state (or
+// in its scenario children). If they are loaded by any other process, those
+// channels are disabled, and the game has to set them up again. All functions
+// that return int return 0 on success.
+EXPORT_API int UGBA_StateSave(const char *path);
+EXPORT_API int UGBA_StateLoad(const char *path);
+// Returns a buffer with the state and its size, or NULL on error. The buffer
+// must be freed with UGBA_StateFree().
+EXPORT_API void *UGBA_StateSaveToMemory(size_t *size);
+EXPORT_API int UGBA_StateLoadFromMemory(const void *state, size_t size);
+EXPORT_API void UGBA_StateFree(void *state);
+
+// Scenario fan-out. It forks the process "num" times from the point where it is
+// called, which should be right after the start of the VBL period. Each child
+// continues running the game with a copy of all the memory of the program
+// (including the variables of the game), shared with the parent until it is
+// modified. Up to "max_parallel" children run at the same time (one per CPU
+// core if it is 0). In each child it returns the index of the child, from 0 to
+// num - 1. Children must end by calling UGBA_ScenarioReport(). In the parent it
+// returns UGBA_SCENARIO_PARENT after all children have ended, or
+// UGBA_SCENARIO_ERROR if the children couldn't be created. It is only available
+// in headless mode, in systems that support fork(). Video and WAV recordings
+// are finished before forking.
+#define UGBA_SCENARIO_PARENT    (-1)
+#define UGBA_SCENARIO_ERROR     (-2)
+EXPORT_API int UGBA_ScenarioFork(int num, int max_parallel);
+// Send the result of a child to the parent and end the child process.
+EXPORT_API void UGBA_ScenarioReport(const void *data, size_t size);
+// Get the result reported by a child. It returns NULL if the child ended
+// without reporting anything. The result is valid until the next call to
+// UGBA_ScenarioFork().
+EXPORT_API const void *UGBA_ScenarioGetResult(int index, size_t *size);
 #endif
 
 // This function tries to detect specific flashcarts with special needs and
@@ -15,6 +15,9 @@
 // Default values
 global_config GlobalConfig = {
     .screen_size = 3,
+    .render_threads = 1,
+    .profiler = 0,
+    .png_compression = 6,
 
     .volume = 100,
     .channel_flags = 0x3F,
@@ -24,6 +27,15 @@ global_config GlobalConfig = {
 #define CFG_SCREEN_SIZE "screen_size"
 // unsigned integer ( "1" - "5" )
 
+#define CFG_RENDER_THREADS "render_threads"
+// unsigned integer ( "0" = one per CPU core )
+
+#define CFG_PROFILER "profiler"
+// "true" - "false"
+
+#define CFG_PNG_COMPRESSION "png_compression"
+// unsigned integer ( "0" - "9" )
+
 #define CFG_SND_CHN_ENABLE "channels_enabled"
 // "#3F" 3F = flags
 
@@ -43,6 +55,9 @@ void Config_Save(void)
 
     fprintf(f, "[General]\n");
     fprintf(f, CFG_SCREEN_SIZE "=%d\n", GlobalConfig.screen_size);
+    fprintf(f, CFG_RENDER_THREADS "=%d\n", GlobalConfig.render_threads);
+    fprintf(f, CFG_PROFILER "=%s\n", GlobalConfig.profiler ? "true" : "false");
+    fprintf(f, CFG_PNG_COMPRESSION "=%d\n", GlobalConfig.png_compression);
     fprintf(f, "\n");
 
     fprintf(f, "[Sound]\n");
@@ -146,6 +161,36 @@ void Config_Load(void)
             GlobalConfig.screen_size = 2;
     }
 
+    tmp = strstr(ini, CFG_RENDER_THREADS);
+    if (tmp)
+    {
+        tmp += strlen(CFG_RENDER_THREADS) + 1;
+        GlobalConfig.render_threads = atoi(tmp);
+        if (GlobalConfig.render_threads < 0)
+            GlobalConfig.render_threads = 1;
+    }
+
+    tmp = strstr(ini, CFG_PROFILER);
+    if (tmp)
+    {
+        tmp += strlen(CFG_PROFILER) + 1;
+        if (strncmp(tmp, "true", strlen("true")) == 0)
+            GlobalConfig.profiler = 1;
+        else
+            GlobalConfig.profiler = 0;
+    }
+
+    tmp = strstr(ini, CFG_PNG_COMPRESSION);
+    if (tmp)
+    {
+        tmp += strlen(CFG_PNG_COMPRESSION) + 1;
+        GlobalConfig.png_compression = atoi(tmp);
+        if (GlobalConfig.png_compression > 9)
+            GlobalConfig.png_compression = 9;
+        else if (GlobalConfig.png_compression < 0)
+            GlobalConfig.png_compression = 0;
+    }
+
     // Sound options
 
     tmp = strstr(ini, CFG_SND_CHN_ENABLE);
@@ -11,6 +11,9 @@ typedef struct
     // ---------------
 
     int screen_size;
+    int render_threads; // Threads used to draw the screen (0 = one per core)
+    int profiler; // Show the time spent in each subsystem in the window caption
+    int png_compression; // zlib compression level of PNG files (0 - 9)
 
     // Sound
     //-----
@@ -1,24 +1,77 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 //
-// Copyright (c) 2020-2021 Antonio Niño Díaz
+// Copyright (c) 2020-2021, 2026 Antonio Niño Díaz
 
 #include <SDL2/SDL.h>
 
 #include <ugba/ugba.h>
 
+#include "context.h"
 #include "interrupts.h"
 #include "dma.h"
 #include "sound.h"
+#include "timer.h"
 #include "video.h"
 
 #include "../debug_utils.h"
 #include "../input_utils.h"
 #include "../lua_handler.h"
+#include "../profiler.h"
+#include "../video_capture.h"
 
 #include "../gui/win_main.h"
 #include "../gui/window_handler.h"
 
-static int current_vcount = 0;
+#define current_vcount  (GBA_Context()->vcount)
+#define frame_draw      (GBA_Context()->frame_draw)
+
+// Fast-forward mode
+// =================
+//
+// When fast-forward mode is enabled the simulation runs as fast as possible.
+// Only one of every draw_interval frames is drawn and shown in the GUI. If
+// draw_interval is 0, frames are only drawn when they are requested by a Lua
+// script. Frames are always drawn while a video is being recorded. Frames that
+// aren't drawn skip all the GUI code.
+
+static int fast_forward_enabled = 0;
+static int fast_forward_interval = 1;
+static int fast_forward_count = 0;
+
+void UGBA_FastForwardSet(int enable, int draw_interval)
+{
+    if (draw_interval < 0)
+        draw_interval = 0;
+
+    fast_forward_enabled = enable;
+    fast_forward_interval = draw_interval;
+    fast_forward_count = 0;
+}
+
+static int fast_forward_frame_needed(void)
+{
+    if (fast_forward_enabled == 0)
+        return 1;
+
+#ifdef LUA_INTERPRETER_ENABLED
+    if (Script_FrameRequested())
+        return 1;
+#endif
+
+    // Every frame of a video capture has to be drawn
+    if (VID_FileIsOpen())
+        return 1;
+
+    if (fast_forward_interval == 0)
+        return 0;
+
+    fast_forward_count++;
+    if (fast_forward_count < fast_forward_interval)
+        return 0;
+
+    fast_forward_count = 0;
+    return 1;
+}
 
 static void Input_Handle_Interrupt(void)
 {
@@ -60,10 +113,17 @@ static void handle_hbl(void)
     check_trigger_vcount();
 
     // Then, draw
-    GBA_DrawScanline(current_vcount);
+    if (frame_draw)
+    {
+        uint64_t start = Profiler_Start();
+        GBA_DrawScanline(current_vcount);
+        Profiler_End(PROF_VIDEO, start);
+    }
 
     // Handle DMA if active
+    uint64_t start = Profiler_Start();
     GBA_DMAHandleHBL();
+    Profiler_End(PROF_DMA, start);
 
     // Finally, HBL interrupt
     if (REG_DISPSTAT & DISPSTAT_HBLANK_IRQ_ENABLE)
@@ -84,26 +144,62 @@ static void handle_hbl_during_vbl(void)
 
 static void handle_vbl(void)
 {
+    // Only the default context is connected to the GUI, the input devices and
+    // the script handler. Other contexts run as fast as possible.
+    int is_default = GBA_ContextIsDefault();
+
+    // Make sure that the frame is complete before doing anything else
+    uint64_t start = Profiler_Start();
+    GBA_DrawFrameFinish();
+
+    // Capture the frame before the sound of this frame is generated so that
+    // the audio position saved with it is the start of the frame.
+    if (is_default && VID_FileIsOpen())
+        VID_FileStream();
+
+    Profiler_End(PROF_VIDEO, start);
+
     // Handle DMA if active
+    start = Profiler_Start();
     GBA_DMAHandleVBL();
+    Profiler_End(PROF_DMA, start);
 
     // Handle sound before calling the VBL interrupt handler
+    start = Profiler_Start();
     Sound_Handle_VBL();
+    Profiler_End(PROF_SOUND, start);
 
     // Handle VBL interrupt
     if (REG_DISPSTAT & DISPSTAT_VBLANK_IRQ_ENABLE)
         IRQ_Internal_CallHandler(IRQ_VBLANK);
 
+    if (!is_default)
+    {
+        Input_Handle_Interrupt();
+        return;
+    }
+
     // Handle GUI
     // ----------
 
-    // Handle events for all windows
+    start = Profiler_Start();
+
+    // Handle events for all windows. This is needed even if the frame isn't
+    // drawn, or the input wouldn't be updated and the window couldn't be closed
+    // in fast-forward mode.
     WH_HandleEvents();
 
-    Win_MainLoopHandle();
+    Win_MainCheckExit();
+
+    if (frame_draw)
+    {
+        Win_MainLoopHandle();
+
+        // Render main window every frame
+        Win_MainRender();
+    }
 
-    // Render main window every frame
-    Win_MainRender();
+    Profiler_End(PROF_GUI, start);
 
     // Update input state. Do this before invoking the script handler, as the
     // script can overwrite the input.
@@ -119,7 +215,13 @@ static void handle_vbl(void)
     Input_Handle_Interrupt();
 
     // Synchronise video
-    if (Input_Speedup_Enabled())
+    start = Profiler_Start();
+
+    if (fast_forward_enabled)
+    {
+        // Don't wait at all
+    }
+    else if (Input_Speedup_Enabled())
     {
         SDL_Delay(0);
     }
@@ -140,10 +242,17 @@ static void handle_vbl(void)
         else
             waitforticks += FLOAT_MS_PER_FRAME;
     }
+
+    Profiler_End(PROF_IDLE, start);
+
+    Profiler_FrameEnd();
 }
 
 static void do_scanline_draw(void)
 {
+    if ((current_vcount == 0) && GBA_ContextIsDefault())
+        frame_draw = fast_forward_frame_needed();
+
     if (current_vcount < 160)
     {
         handle_hbl();
@@ -165,6 +274,8 @@ static void do_scanline_draw(void)
         handle_hbl_during_vbl();
     }
 
+    GBA_TimerHandleScanline();
+
     current_vcount++;
 
     if (current_vcount == 228)
@@ -175,7 +286,11 @@ static void do_scanline_draw(void)
 
 void SWI_Halt(void)
 {
+    Profiler_End(PROF_GAME, GBA_Context()->game_start);
+
     do_scanline_draw();
+
+    GBA_Context()->game_start = Profiler_Start();
 }
 
 void SWI_IntrWait(uint32_t discard_old_flags, uint16_t wait_flags)
@@ -8,6 +8,7 @@
 #include <ugba/ugba.h>
 
 #include "sound.h"
+#include "tile_cache.h"
 
 #include "../debug_utils.h"
 
@@ -33,6 +34,7 @@ void SWI_RegisterRamReset(uint32_t flags)
     if (flags & SWI_RAM_RESET_VRAM)
     {
         memset(MEM_VRAM, 0, MEM_VRAM_SIZE);
+        GBA_TileCacheInvalidate(MEM_VRAM, MEM_VRAM_SIZE);
     }
     if (flags & SWI_RAM_RESET_OAM)
     {
@@ -159,6 +161,8 @@ void SWI_CpuSet(const void *src, void *dst, uint32_t len_mode)
     int count = len_mode & 0x001FFFFF;
     uint32_t mode = len_mode & ~0x001FFFFF;
 
+    GBA_TileCacheInvalidate(dst, count * ((mode & SWI_MODE_32BIT) ? 4 : 2));
+
     if (mode & SWI_MODE_32BIT)
     {
         uint32_t *src_ = (uint32_t *)((uintptr_t)src & ~3);
@@ -207,6 +211,8 @@ void SWI_CpuFastSet(const void *src, void *dst, uint32_t len_mode)
     uint32_t *src_ = (uint32_t *)((uintptr_t)src & ~3);
     uint32_t *dst_ = (uint32_t *)((uintptr_t)dst & ~3);
 
+    GBA_TileCacheInvalidate(dst_, count * 4);
+
     if (mode & SWI_MODE_FILL)
     {
         uint32_t fill = *src_;
@@ -326,6 +332,8 @@ void SWI_BitUnPack(const void *source, void *dest, const bit_unpack_info *info)
             dstdata = 0;
         }
     }
+
+    GBA_TileCacheInvalidate(dest, (uintptr_t)dst - (uintptr_t)dest);
 }
 
 // The only difference between LZ77UnCompReadNormalWrite8bit() and
@@ -402,6 +410,7 @@ static void SWI_UncompressLZ77(const void *source, void *dest)
 
     // Copy to destination
     memcpy(dst, buffer, size);
+    GBA_TileCacheInvalidate(dst, size);
 
     free(buffer);
 }
@@ -516,6 +525,8 @@ void SWI_HuffUnComp(const void *source, void *dest)
         if (total >= size)
             break;
     }
+
+    GBA_TileCacheInvalidate(dest, size);
 }
 
 static void GBA_SWI_RLUnComp(const void *source, void *dest)
@@ -564,6 +575,8 @@ static void GBA_SWI_RLUnComp(const void *source, void *dest)
             }
         }
     }
+    // The last run may end after the size specified in the header
+    GBA_TileCacheInvalidate(dest, (uintptr_t)dst - (uintptr_t)dest);
 }
 
 void SWI_RLUnCompWram(const void *source, void *dest)
@@ -608,6 +621,8 @@ static void GBA_Diff8bitUnFilter(const void *source, void *dest)
 
     int32_t size = (header >> 8) & 0x00FFFFFF;
 
+    GBA_TileCacheInvalidate(dest, size);
+
     uint8_t value = 0;
 
     while (size > 0)
@@ -663,6 +678,8 @@ void SWI_Diff16bitUnFilter(const void *source, void *dest)
 
     int32_t size = (header >> 8) & 0x00FFFFFF;
 
+    GBA_TileCacheInvalidate(dest, size);
+
     uint16_t value = 0;
 
     while (size > 0)
@@ -0,0 +1,455 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <stdint.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "color_convert.h"
+
+// Unlike the row kernels of the compositor, these kernels aren't selected when
+// building the code. The x86 kernels are built with target attributes, and the
+// one to use is selected at runtime depending on the features of the CPU. On
+// Arm, NEON is only used if the compiler targets it.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+# define COLOR_X86
+# include <immintrin.h>
+# if defined(_MSC_VER) && !defined(__clang__)
+#  define TARGET_SSE2
+#  define TARGET_AVX2
+# else
+#  define TARGET_SSE2       __attribute__((target("sse2")))
+#  define TARGET_AVX2       __attribute__((target("avx2")))
+# endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define COLOR_NEON
+# include <arm_neon.h>
+#endif
+
+typedef void (*color_convert_fn)(uint8_t *dst, const uint16_t *src, int count);
+
+// Plain C
+// =======
+
+static void convert_rgba8888_c(uint8_t *dst, const uint16_t *src, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t data = *src++;
+        *dst++ = GBA_ColorExpand5(data & 0x1F);
+        *dst++ = GBA_ColorExpand5((data >> 5) & 0x1F);
+        *dst++ = GBA_ColorExpand5((data >> 10) & 0x1F);
+        *dst++ = 0xFF;
+    }
+}
+
+static void convert_bgra8888_c(uint8_t *dst, const uint16_t *src, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t data = *src++;
+        *dst++ = GBA_ColorExpand5((data >> 10) & 0x1F);
+        *dst++ = GBA_ColorExpand5((data >> 5) & 0x1F);
+        *dst++ = GBA_ColorExpand5(data & 0x1F);
+        *dst++ = 0xFF;
+    }
+}
+
+static void convert_rgb888_c(uint8_t *dst, const uint16_t *src, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t data = *src++;
+        *dst++ = GBA_ColorExpand5(data & 0x1F);
+        *dst++ = GBA_ColorExpand5((data >> 5) & 0x1F);
+        *dst++ = GBA_ColorExpand5((data >> 10) & 0x1F);
+    }
+}
+
+// Lookup tables
+// =============
+//
+// They are only filled if no SIMD kernel can be used. Each entry holds the
+// bytes of a pixel in the order they are stored in memory, so the RGB888 table
+// is the RGBA8888 table without the last byte.
+
+static uint8_t color_lut_rgba[32768][4];
+static uint8_t color_lut_bgra[32768][4];
+
+static void color_lut_init(void)
+{
+    for (uint32_t i = 0; i < 32768; i++)
+    {
+        uint16_t color = i;
+        convert_rgba8888_c(color_lut_rgba[i], &color, 1);
+        convert_bgra8888_c(color_lut_bgra[i], &color, 1);
+    }
+}
+
+static void convert_rgba8888_lut(uint8_t *dst, const uint16_t *src, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(dst, color_lut_rgba[src[i] & 0x7FFF], 4);
+        dst += 4;
+    }
+}
+
+static void convert_bgra8888_lut(uint8_t *dst, const uint16_t *src, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(dst, color_lut_bgra[src[i] & 0x7FFF], 4);
+        dst += 4;
+    }
+}
+
+static void convert_rgb888_lut(uint8_t *dst, const uint16_t *src, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(dst, color_lut_rgba[src[i] & 0x7FFF], 3);
+        dst += 3;
+    }
+}
+
+#if defined(COLOR_X86)
+
+// SSE2
+// ====
+//
+// Each 16-bit lane holds one pixel. The components are expanded in place, and
+// then they are combined into 16-bit pairs of bytes that are interleaved to
+// form 32-bit pixels.
+
+TARGET_SSE2
+static inline __m128i sse2_expand5(__m128i c)
+{
+    return _mm_or_si128(_mm_slli_epi16(c, 3), _mm_srli_epi16(c, 2));
+}
+
+// Returns the bytes of the first and second components of 8 pixels in the low
+// and high halves of each lane, and the third component and alpha in "p23".
+TARGET_SSE2
+static inline __m128i sse2_pairs(__m128i col, int bgr, __m128i *p23)
+{
+    __m128i m31 = _mm_set1_epi16(0x1F);
+
+    __m128i r = sse2_expand5(_mm_and_si128(col, m31));
+    __m128i g = sse2_expand5(_mm_and_si128(_mm_srli_epi16(col, 5), m31));
+    __m128i b = sse2_expand5(_mm_and_si128(_mm_srli_epi16(col, 10), m31));
+
+    __m128i first = bgr ? b : r;
+    __m128i third = bgr ? r : b;
+
+    *p23 = _mm_or_si128(third, _mm_set1_epi16((short)0xFF00));
+    return _mm_or_si128(first, _mm_slli_epi16(g, 8));
+}
+
+// Remove the alpha byte of 4 RGBA pixels. The 12 bytes left are packed at the
+// bottom of the vector.
+TARGET_SSE2
+static inline __m128i sse2_pack_rgb(__m128i v)
+{
+    // Join the two pixels of each 64-bit half into 6 bytes
+    __m128i even = _mm_and_si128(v, _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF));
+    __m128i odd = _mm_and_si128(v, _mm_set_epi32(0xFFFFFF, 0, 0xFFFFFF, 0));
+    __m128i v48 = _mm_or_si128(even, _mm_srli_epi64(odd, 8));
+
+    // Move the 6 bytes of the upper half right after the ones of the lower half
+    return _mm_or_si128(_mm_move_epi64(v48),
+                        _mm_slli_si128(_mm_srli_si128(v48, 8), 6));
+}
+
+TARGET_SSE2
+static inline void sse2_store_rgb(uint8_t *dst, __m128i v)
+{
+    _mm_storel_epi64((__m128i *)dst, v);
+
+    uint32_t last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+    memcpy(dst + 8, &last, sizeof(last));
+}
+
+TARGET_SSE2
+static void convert_32_sse2(uint8_t *dst, const uint16_t *src, int count,
+                            int bgr)
+{
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i p23;
+        __m128i p01 = sse2_pairs(_mm_loadu_si128((const __m128i *)&src[i]),
+                                 bgr, &p23);
+
+        _mm_storeu_si128((__m128i *)&dst[i * 4],
+                         _mm_unpacklo_epi16(p01, p23));
+        _mm_storeu_si128((__m128i *)&dst[i * 4 + 16],
+                         _mm_unpackhi_epi16(p01, p23));
+    }
+
+    if (bgr)
+        convert_bgra8888_c(&dst[i * 4], &src[i], count - i);
+    else
+        convert_rgba8888_c(&dst[i * 4], &src[i], count - i);
+}
+
+TARGET_SSE2
+static void convert_rgba8888_sse2(uint8_t *dst, const uint16_t *src, int count)
+{
+    convert_32_sse2(dst, src, count, 0);
+}
+
+TARGET_SSE2
+static void convert_bgra8888_sse2(uint8_t *dst, const uint16_t *src, int count)
+{
+    convert_32_sse2(dst, src, count, 1);
+}
+
+TARGET_SSE2
+static void convert_rgb888_sse2(uint8_t *dst, const uint16_t *src, int count)
+{
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i p23;
+        __m128i p01 = sse2_pairs(_mm_loadu_si128((const __m128i *)&src[i]),
+                                 0, &p23);
+
+        sse2_store_rgb(&dst[i * 3],
+                       sse2_pack_rgb(_mm_unpacklo_epi16(p01, p23)));
+        sse2_store_rgb(&dst[i * 3 + 12],
+                       sse2_pack_rgb(_mm_unpackhi_epi16(p01, p23)));
+    }
+
+    convert_rgb888_c(&dst[i * 3], &src[i], count - i);
+}
+
+// AVX2
+// ====
+//
+// The same as the SSE2 kernels, but with 16 pixels at a time. The unpack
+// instructions work inside each 128-bit half, so the results need to be
+// reordered before storing them.
+
+TARGET_AVX2
+static inline __m256i avx2_expand5(__m256i c)
+{
+    return _mm256_or_si256(_mm256_slli_epi16(c, 3), _mm256_srli_epi16(c, 2));
+}
+
+TARGET_AVX2
+static inline __m256i avx2_pairs(__m256i col, int bgr, __m256i *p23)
+{
+    __m256i m31 = _mm256_set1_epi16(0x1F);
+
+    __m256i r = avx2_expand5(_mm256_and_si256(col, m31));
+    __m256i g = avx2_expand5(_mm256_and_si256(_mm256_srli_epi16(col, 5), m31));
+    __m256i b = avx2_expand5(_mm256_and_si256(_mm256_srli_epi16(col, 10), m31));
+
+    __m256i first = bgr ? b : r;
+    __m256i third = bgr ? r : b;
+
+    *p23 = _mm256_or_si256(third, _mm256_set1_epi16((short)0xFF00));
+    return _mm256_or_si256(first, _mm256_slli_epi16(g, 8));
+}
+
+TARGET_AVX2
+static void convert_32_avx2(uint8_t *dst, const uint16_t *src, int count,
+                            int bgr)
+{
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i p23;
+        __m256i p01 = avx2_pairs(_mm256_loadu_si256((const __m256i *)&src[i]),
+                                 bgr, &p23);
+
+        // Pixels 0-3 and 8-11, and pixels 4-7 and 12-15
+        __m256i lo = _mm256_unpacklo_epi16(p01, p23);
+        __m256i hi = _mm256_unpackhi_epi16(p01, p23);
+
+        _mm256_storeu_si256((__m256i *)&dst[i * 4],
+                            _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)&dst[i * 4 + 32],
+                            _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    if (bgr)
+        convert_bgra8888_c(&dst[i * 4], &src[i], count - i);
+    else
+        convert_rgba8888_c(&dst[i * 4], &src[i], count - i);
+}
+
+TARGET_AVX2
+static void convert_rgba8888_avx2(uint8_t *dst, const uint16_t *src, int count)
+{
+    convert_32_avx2(dst, src, count, 0);
+}
+
+TARGET_AVX2
+static void convert_bgra8888_avx2(uint8_t *dst, const uint16_t *src, int count)
+{
+    convert_32_avx2(dst, src, count, 1);
+}
+
+TARGET_AVX2
+static void convert_rgb888_avx2(uint8_t *dst, const uint16_t *src, int count)
+{
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i p23;
+        __m256i p01 = avx2_pairs(_mm256_loadu_si256((const __m256i *)&src[i]),
+                                 0, &p23);
+
+        __m256i lo = _mm256_unpacklo_epi16(p01, p23);
+        __m256i hi = _mm256_unpackhi_epi16(p01, p23);
+
+        uint8_t *d = &dst[i * 3];
+
+        sse2_store_rgb(d, sse2_pack_rgb(_mm256_castsi256_si128(lo)));
+        sse2_store_rgb(d + 12, sse2_pack_rgb(_mm256_castsi256_si128(hi)));
+        sse2_store_rgb(d + 24,
+                       sse2_pack_rgb(_mm256_extracti128_si256(lo, 1)));
+        sse2_store_rgb(d + 36,
+                       sse2_pack_rgb(_mm256_extracti128_si256(hi, 1)));
+    }
+
+    convert_rgb888_c(&dst[i * 3], &src[i], count - i);
+}
+
+#endif // COLOR_X86
+
+#if defined(COLOR_NEON)
+
+// NEON
+// ====
+//
+// The interleaving stores of NEON write the components of 8 pixels at once.
+
+static inline uint8x8_t neon_component(uint16x8_t col, int shift)
+{
+    uint16x8_t c = vandq_u16(vshlq_u16(col, vdupq_n_s16(-shift)),
+                             vdupq_n_u16(0x1F));
+    return vmovn_u16(vorrq_u16(vshlq_n_u16(c, 3), vshrq_n_u16(c, 2)));
+}
+
+static void convert_rgba8888_neon(uint8_t *dst, const uint16_t *src, int count)
+{
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t col = vld1q_u16(&src[i]);
+
+        uint8x8x4_t px;
+        px.val[0] = neon_component(col, 0);
+        px.val[1] = neon_component(col, 5);
+        px.val[2] = neon_component(col, 10);
+        px.val[3] = vdup_n_u8(0xFF);
+        vst4_u8(&dst[i * 4], px);
+    }
+
+    convert_rgba8888_c(&dst[i * 4], &src[i], count - i);
+}
+
+static void convert_bgra8888_neon(uint8_t *dst, const uint16_t *src, int count)
+{
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t col = vld1q_u16(&src[i]);
+
+        uint8x8x4_t px;
+        px.val[0] = neon_component(col, 10);
+        px.val[1] = neon_component(col, 5);
+        px.val[2] = neon_component(col, 0);
+        px.val[3] = vdup_n_u8(0xFF);
+        vst4_u8(&dst[i * 4], px);
+    }
+
+    convert_bgra8888_c(&dst[i * 4], &src[i], count - i);
+}
+
+static void convert_rgb888_neon(uint8_t *dst, const uint16_t *src, int count)
+{
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t col = vld1q_u16(&src[i]);
+
+        uint8x8x3_t px;
+        px.val[0] = neon_component(col, 0);
+        px.val[1] = neon_component(col, 5);
+        px.val[2] = neon_component(col, 10);
+        vst3_u8(&dst[i * 3], px);
+    }
+
+    convert_rgb888_c(&dst[i * 3], &src[i], count - i);
+}
+
+#endif // COLOR_NEON
+
+// Dispatch
+// ========
+
+static color_convert_fn convert_rgba8888 = convert_rgba8888_c;
+static color_convert_fn convert_bgra8888 = convert_bgra8888_c;
+static color_convert_fn convert_rgb888 = convert_rgb888_c;
+
+void GBA_ColorConvertInit(void)
+{
+#if defined(COLOR_X86)
+    if (SDL_HasAVX2())
+    {
+        convert_rgba8888 = convert_rgba8888_avx2;
+        convert_bgra8888 = convert_bgra8888_avx2;
+        convert_rgb888 = convert_rgb888_avx2;
+        return;
+    }
+
+    if (SDL_HasSSE2())
+    {
+        convert_rgba8888 = convert_rgba8888_sse2;
+        convert_bgra8888 = convert_bgra8888_sse2;
+        convert_rgb888 = convert_rgb888_sse2;
+        return;
+    }
+#elif defined(COLOR_NEON)
+    convert_rgba8888 = convert_rgba8888_neon;
+    convert_bgra8888 = convert_bgra8888_neon;
+    convert_rgb888 = convert_rgb888_neon;
+    return;
+#endif
+
+    color_lut_init();
+
+    convert_rgba8888 = convert_rgba8888_lut;
+    convert_bgra8888 = convert_bgra8888_lut;
+    convert_rgb888 = convert_rgb888_lut;
+}
+
+void GBA_ColorConvertToRGBA8888(void *dst, const uint16_t *src, int count)
+{
+    convert_rgba8888(dst, src, count);
+}
+
+void GBA_ColorConvertToBGRA8888(void *dst, const uint16_t *src, int count)
+{
+    convert_bgra8888(dst, src, count);
+}
+
+void GBA_ColorConvertToRGB888(void *dst, const uint16_t *src, int count)
+{
+    convert_rgb888(dst, src, count);
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_CORE_COLOR_CONVERT_H__
+#define SDL2_CORE_COLOR_CONVERT_H__
+
+#include <stdint.h>
+
+// Conversion of BGR555 colors to the formats used by SDL and libpng. The 5-bit
+// components are expanded to 8 bits as (c << 3) | (c >> 2), so that 31 becomes
+// 255. Bit 15 of the source colors is ignored.
+//
+// The buffer conversion functions use SSE2, AVX2 or NEON if the CPU supports
+// them, and a lookup table otherwise. The results are the same in all cases.
+
+// Select the best implementation for the CPU. Until this is called, the
+// conversion functions use plain C code.
+void GBA_ColorConvertInit(void);
+
+// Bytes R, G, B, A in memory. Alpha is set to 255.
+void GBA_ColorConvertToRGBA8888(void *dst, const uint16_t *src, int count);
+
+// Bytes B, G, R, A in memory (SDL_PIXELFORMAT_BGRA32). Alpha is set to 255.
+void GBA_ColorConvertToBGRA8888(void *dst, const uint16_t *src, int count);
+
+// Bytes R, G, B in memory
+void GBA_ColorConvertToRGB888(void *dst, const uint16_t *src, int count);
+
+// Expand a 5-bit color component to 8 bits
+static inline uint32_t GBA_ColorExpand5(uint32_t c)
+{
+    return (c << 3) | (c >> 2);
+}
+
+// Convert a single color. The result has R in bits 0-7, G in bits 8-15 and B in
+// bits 16-23. Bits 24-31 are 0.
+static inline uint32_t GBA_ColorToRGB32(uint16_t color)
+{
+    uint32_t r = GBA_ColorExpand5(color & 0x1F);
+    uint32_t g = GBA_ColorExpand5((color >> 5) & 0x1F);
+    uint32_t b = GBA_ColorExpand5((color >> 10) & 0x1F);
+
+    return (b << 16) | (g << 8) | r;
+}
+
+#endif // SDL2_CORE_COLOR_CONVERT_H__
@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <ugba/ugba.h>
+
+#include "context.h"
+#include "dma.h"
+#include "sound.h"
+#include "tile_cache.h"
+#include "timer.h"
+#include "video.h"
+
+#include "../debug_utils.h"
+
+// Memory of the default context
+
+static uint8_t internal_bios[MEM_BIOS_SIZE] ALIGNED(MEM_BIOS_SIZE);
+static uint8_t internal_ewram[MEM_EWRAM_SIZE] ALIGNED(MEM_EWRAM_SIZE);
+static uint8_t internal_iwram[MEM_IWRAM_SIZE] ALIGNED(MEM_IWRAM_SIZE);
+static uint8_t internal_io[MEM_IO_SIZE] ALIGNED(MEM_IO_SIZE);
+static uint8_t internal_palette[MEM_PALETTE_SIZE] ALIGNED(MEM_PALETTE_SIZE);
+static uint8_t internal_vram[MEM_VRAM_SIZE] ALIGNED(MEM_VRAM_SIZE + 32 * 1024);
+static uint8_t internal_oam[MEM_OAM_SIZE] ALIGNED(MEM_OAM_SIZE);
+static uint8_t internal_rom[MEM_ROM_SIZE] ALIGNED(MEM_ROM_SIZE);
+static uint8_t internal_sram[MEM_SRAM_SIZE] ALIGNED(MEM_SRAM_SIZE);
+
+ugba_context ugba_context_default = {
+    .bios = internal_bios,
+    .ewram = internal_ewram,
+    .iwram = internal_iwram,
+    .io = internal_io,
+    .palette = internal_palette,
+    .vram = internal_vram,
+    .oam = internal_oam,
+    .rom = internal_rom,
+    .sram = internal_sram,
+
+    .frame_draw = 1,
+
+    .dma = &gba_dma_state_default,
+    .timer = &gba_timer_state_default,
+    .sound = &gba_sound_state_default,
+    .video = &gba_video_state_default,
+    .tile_cache = &gba_tile_cache_state_default,
+};
+
+THREAD_LOCAL ugba_context *ugba_context_current = &ugba_context_default;
+
+// Memory regions of new contexts are allocated with the same alignment as the
+// ones of the default context.
+static const struct {
+    size_t offset;
+    size_t size;
+    size_t alignment;
+    uint32_t address; // Address in the memory map of the real hardware
+} context_mem_regions[CONTEXT_MEM_REGIONS] = {
+    { offsetof(ugba_context, bios), MEM_BIOS_SIZE, MEM_BIOS_SIZE,
+      0x00000000 },
+    { offsetof(ugba_context, ewram), MEM_EWRAM_SIZE, MEM_EWRAM_SIZE,
+      0x02000000 },
+    { offsetof(ugba_context, iwram), MEM_IWRAM_SIZE, MEM_IWRAM_SIZE,
+      0x03000000 },
+    { offsetof(ugba_context, io), MEM_IO_SIZE, MEM_IO_SIZE,
+      0x04000000 },
+    { offsetof(ugba_context, palette), MEM_PALETTE_SIZE, MEM_PALETTE_SIZE,
+      0x05000000 },
+    { offsetof(ugba_context, vram), MEM_VRAM_SIZE, MEM_VRAM_SIZE + 32 * 1024,
+      0x06000000 },
+    { offsetof(ugba_context, oam), MEM_OAM_SIZE, MEM_OAM_SIZE,
+      0x07000000 },
+    { offsetof(ugba_context, rom), MEM_ROM_SIZE, MEM_ROM_SIZE,
+      0x08000000 },
+    { offsetof(ugba_context, sram), MEM_SRAM_SIZE, MEM_SRAM_SIZE,
+      0x0E000000 },
+};
+
+static uint8_t *context_mem_region(ugba_context *ctx, int index)
+{
+    return *(uint8_t **)((uint8_t *)ctx + context_mem_regions[index].offset);
+}
+
+uint64_t GBA_ContextPtrToAddress(uintptr_t ptr)
+{
+    ugba_context *ctx = GBA_Context();
+
+    for (int i = 0; i < CONTEXT_MEM_REGIONS; i++)
+    {
+        uintptr_t base = (uintptr_t)context_mem_region(ctx, i);
+
+        if ((ptr >= base) && ((ptr - base) < context_mem_regions[i].size))
+            return context_mem_regions[i].address + (ptr - base);
+    }
+
+    return (uint64_t)ptr | CONTEXT_ADDRESS_HOST;
+}
+
+uintptr_t GBA_ContextAddressToPtr(uint64_t address)
+{
+    if (address & CONTEXT_ADDRESS_HOST)
+        return (uintptr_t)(address & ~CONTEXT_ADDRESS_HOST);
+
+    ugba_context *ctx = GBA_Context();
+
+    for (int i = 0; i < CONTEXT_MEM_REGIONS; i++)
+    {
+        uint64_t base = context_mem_regions[i].address;
+
+        if ((address >= base) && ((address - base) < context_mem_regions[i].size))
+            return (uintptr_t)context_mem_region(ctx, i) + (address - base);
+    }
+
+    // This can only happen with corrupted data
+    return 0;
+}
+
+void *GBA_ContextMemRange(uint32_t address, size_t size)
+{
+    ugba_context *ctx = GBA_Context();
+
+    for (int i = 0; i < CONTEXT_MEM_REGIONS; i++)
+    {
+        uint32_t base = context_mem_regions[i].address;
+        size_t region_size = context_mem_regions[i].size;
+
+        if ((address < base) || ((address - base) >= region_size))
+            continue;
+
+        if (size > (region_size - (address - base)))
+            return NULL;
+
+        return context_mem_region(ctx, i) + (address - base);
+    }
+
+    return NULL;
+}
+
+static void context_free(ugba_context *ctx)
+{
+    for (int i = 0; i < CONTEXT_MEM_REGIONS; i++)
+        free(ctx->mem_allocations[i]);
+
+    GBA_DMAStateDestroy(ctx->dma);
+    GBA_TimerStateDestroy(ctx->timer);
+    GBA_SoundStateDestroy(ctx->sound);
+    GBA_VideoStateDestroy(ctx->video);
+    GBA_TileCacheStateDestroy(ctx->tile_cache);
+
+    free(ctx);
+}
+
+ugba_context *UGBA_ContextCreate(void)
+{
+    ugba_context *ctx = calloc(1, sizeof(ugba_context));
+    if (ctx == NULL)
+        goto error;
+
+    // The allocations are zeroed, so the pages of the big regions that are
+    // never used (like most of ROM) aren't actually backed by memory.
+    for (int i = 0; i < CONTEXT_MEM_REGIONS; i++)
+    {
+        size_t alignment = context_mem_regions[i].alignment;
+
+        uint8_t *mem = calloc(1, context_mem_regions[i].size + alignment - 1);
+        if (mem == NULL)
+            goto error;
+
+        ctx->mem_allocations[i] = mem;
+
+        uintptr_t addr = ((uintptr_t)mem + alignment - 1) & ~(alignment - 1);
+
+        *(uint8_t **)((uint8_t *)ctx + context_mem_regions[i].offset) =
+                (uint8_t *)addr;
+    }
+
+    ctx->dma = GBA_DMAStateCreate();
+    ctx->timer = GBA_TimerStateCreate();
+    ctx->sound = GBA_SoundStateCreate();
+    ctx->video = GBA_VideoStateCreate();
+    ctx->tile_cache = GBA_TileCacheStateCreate();
+
+    if ((ctx->dma == NULL) || (ctx->timer == NULL) || (ctx->sound == NULL) ||
+        (ctx->video == NULL) || (ctx->tile_cache == NULL))
+    {
+        goto error;
+    }
+
+    ctx->frame_draw = 1;
+
+    // Reset the hardware the same way as UGBA_Init()
+
+    ugba_context *old = ugba_context_current;
+    ugba_context_current = ctx;
+
+    Sound_Initialize();
+    IRQ_Init();
+
+    REG_KEYINPUT = 0x03FF; // All keys released
+    REG_WAITCNT = WAITCNT_DEFAULT_STARTUP;
+
+    ugba_context_current = old;
+
+    return ctx;
+
+error:
+    Debug_Log("%s: Not enough memory", __func__);
+    if (ctx != NULL)
+        context_free(ctx);
+    return NULL;
+}
+
+void UGBA_ContextDestroy(ugba_context *ctx)
+{
+    if ((ctx == NULL) || (ctx == &ugba_context_default))
+        return;
+
+    if (ctx == ugba_context_current)
+        ugba_context_current = &ugba_context_default;
+
+    context_free(ctx);
+}
+
+void UGBA_ContextSetCurrent(ugba_context *ctx)
+{
+    if (ctx == NULL)
+        ctx = &ugba_context_default;
+
+    ugba_context_current = ctx;
+}
+
+ugba_context *UGBA_ContextGetCurrent(void)
+{
+    return ugba_context_current;
+}
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_CORE_CONTEXT_H__
+#define SDL2_CORE_CONTEXT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ugba/ugba.h>
+
+// Emulation contexts
+// ==================
+//
+// All the state of the emulated hardware lives in a context. Each thread has a
+// current context, which is the one used by the UGBA_Mem*() and UGBA_Reg*()
+// accessors and by all the code in the core directory. All threads start with
+// the default context, which is the one used by UGBA_Init().
+//
+// The default context is the only one connected to the GUI, the audio device,
+// the Lua interpreter and the video worker threads. Other contexts are always
+// headless: they draw their frames in the thread that runs them, their sound is
+// mixed but not played, and they run as fast as possible.
+
+#if defined(_MSC_VER)
+# define THREAD_LOCAL __declspec(thread)
+#else
+# define THREAD_LOCAL _Thread_local
+#endif
+
+#define CONTEXT_MEM_REGIONS     9
+
+// The format of the state of these modules is private to each module
+typedef struct gba_dma_state gba_dma_state;
+typedef struct gba_timer_state gba_timer_state;
+typedef struct gba_sound_state gba_sound_state;
+typedef struct gba_video_state gba_video_state;
+typedef struct gba_tile_cache_state gba_tile_cache_state;
+
+struct ugba_context {
+    // Memory regions
+    uint8_t *bios;
+    uint8_t *ewram;
+    uint8_t *iwram;
+    uint8_t *io;
+    uint8_t *palette;
+    uint8_t *vram;
+    uint8_t *oam;
+    uint8_t *rom;
+    uint8_t *sram;
+
+    // DMA source and destination address registers
+    uintptr_t dma_sad[4];
+    uintptr_t dma_dad[4];
+
+    irq_vector irq_vector_table[IRQ_NUMBER];
+
+    int vcount; // Scanline being simulated
+    int frame_draw; // Set to 0 if this frame is skipped
+
+    // Start of the code of the game that runs between calls to SWI_Halt()
+    uint64_t game_start;
+
+    gba_dma_state *dma;
+    gba_timer_state *timer;
+    gba_sound_state *sound;
+    gba_video_state *video;
+    gba_tile_cache_state *tile_cache;
+
+    // Allocations of the memory regions (NULL in the default context)
+    void *mem_allocations[CONTEXT_MEM_REGIONS];
+};
+
+extern ugba_context ugba_context_default;
+extern THREAD_LOCAL ugba_context *ugba_context_current;
+
+static inline ugba_context *GBA_Context(void)
+{
+    return ugba_context_current;
+}
+
+static inline int GBA_ContextIsDefault(void)
+{
+    return ugba_context_current == &ugba_context_default;
+}
+
+// Translate a pointer to the memory of the current context to the address that
+// it would have in the real hardware, so that it is still valid in other
+// contexts or in other runs of the program. Pointers to any other memory are
+// kept as they are, with CONTEXT_ADDRESS_HOST set. They are only valid in the
+// program that has created them.
+#define CONTEXT_ADDRESS_HOST    (1ULL << 63)
+
+uint64_t GBA_ContextPtrToAddress(uintptr_t ptr);
+uintptr_t GBA_ContextAddressToPtr(uint64_t address);
+
+// Get a pointer to "size" bytes of the memory of the current context that start
+// at the provided address of the real hardware. It returns NULL if the range
+// isn't completely inside one memory region.
+void *GBA_ContextMemRange(uint32_t address, size_t size);
+
+#endif // SDL2_CORE_CONTEXT_H__
@@ -3,11 +3,16 @@
 // Copyright (c) 2011-2015, 2019-2021 Antonio Niño Díaz
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <ugba/ugba.h>
 
+#include "context.h"
+#include "dma.h"
 #include "interrupts.h"
+#include "state.h"
+#include "tile_cache.h"
 
 #include "../debug_utils.h"
 
@@ -26,10 +31,184 @@ typedef struct {
     uint32_t start_mode;
 } dma_channel;
 
-static dma_channel DMA[4];
+struct gba_dma_state {
+    dma_channel channel[4];
+};
+
+gba_dma_state gba_dma_state_default;
+
+#define DMA (GBA_Context()->dma->channel)
+
+gba_dma_state *GBA_DMAStateCreate(void)
+{
+    return calloc(1, sizeof(gba_dma_state));
+}
+
+void GBA_DMAStateDestroy(gba_dma_state *state)
+{
+    free(state);
+}
+
+// The addresses are saved with GBA_ContextPtrToAddress() so that they are
+// valid in other contexts.
+typedef struct {
+    uint64_t sad[4];
+    uint64_t dad[4];
+
+    struct {
+        uint64_t srcaddr, dstaddr;
+        uint64_t num_chunks;
+        int32_t enabled, copywords;
+        int32_t srcadd, dstadd;
+        int32_t repeat;
+        uint32_t start_mode;
+    } channel[4];
+} dma_saved_state;
+
+void GBA_DMAStateSave(gba_state *s)
+{
+    dma_saved_state saved;
+    memset(&saved, 0, sizeof(saved));
+
+    for (int i = 0; i < 4; i++)
+    {
+        saved.sad[i] = GBA_ContextPtrToAddress(GBA_Context()->dma_sad[i]);
+        saved.dad[i] = GBA_ContextPtrToAddress(GBA_Context()->dma_dad[i]);
+
+        dma_channel *dma = &DMA[i];
+
+        saved.channel[i].srcaddr = GBA_ContextPtrToAddress(dma->srcaddr);
+        saved.channel[i].dstaddr = GBA_ContextPtrToAddress(dma->dstaddr);
+        saved.channel[i].num_chunks = dma->num_chunks;
+        saved.channel[i].enabled = dma->enabled;
+        saved.channel[i].copywords = dma->copywords;
+        saved.channel[i].srcadd = dma->srcadd;
+        saved.channel[i].dstadd = dma->dstadd;
+        saved.channel[i].repeat = dma->repeat;
+        saved.channel[i].start_mode = dma->start_mode;
+    }
+
+    GBA_StateWrite(s, GBA_STATE_TAG('D', 'M', 'A', ' '), &saved, sizeof(saved));
+}
+
+static void GBA_DMAStop(int channel);
+
+// Addresses of the GBA memory map that aren't inside any memory region can only
+// come from corrupted data.
+static int dma_saved_address_is_valid(uint64_t address)
+{
+    if (address & CONTEXT_ADDRESS_HOST)
+        return 1;
+
+    return GBA_ContextAddressToPtr(address) != 0;
+}
+
+static int dma_saved_channel_is_valid(const dma_saved_state *saved, int i)
+{
+    if (!dma_saved_address_is_valid(saved->sad[i]) ||
+        !dma_saved_address_is_valid(saved->dad[i]) ||
+        !dma_saved_address_is_valid(saved->channel[i].srcaddr) ||
+        !dma_saved_address_is_valid(saved->channel[i].dstaddr))
+    {
+        return 0;
+    }
+
+    if ((saved->channel[i].enabled & ~1) || (saved->channel[i].copywords & ~1))
+        return 0;
+
+    // The biggest transfer is the one of DMA 3 when the size is 0
+    if (saved->channel[i].num_chunks > 0x10000)
+        return 0;
+
+    int32_t step = saved->channel[i].copywords ? 4 : 2;
+    int32_t srcadd = saved->channel[i].srcadd;
+    int32_t dstadd = saved->channel[i].dstadd;
+
+    if (((srcadd != step) && (srcadd != -step) && (srcadd != 0)) ||
+        ((dstadd != step) && (dstadd != -step) && (dstadd != 0)))
+    {
+        return 0;
+    }
+
+    if (saved->channel[i].start_mode & ~(3 << 12))
+        return 0;
+
+    return 1;
+}
+
+void GBA_DMAStateLoad(gba_state *s)
+{
+    dma_saved_state saved;
+
+    if (GBA_StateReadCopy(s, GBA_STATE_TAG('D', 'M', 'A', ' '),
+                          &saved, sizeof(saved)) != 0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (!dma_saved_channel_is_valid(&saved, i))
+        {
+            Debug_Log("%s: DMA %d: Invalid state", __func__, i);
+            s->error = 1;
+            return;
+        }
+    }
+
+    if (s->validate)
+        return;
+
+    for (int i = 0; i < 4; i++)
+    {
+        // Pointers to the memory of the program are only valid in the process
+        // that has created the state. The game needs to set up the channel
+        // again after loading the state.
+        int stop = 0;
+
+        if (!s->host_valid)
+        {
+            if ((saved.sad[i] | saved.dad[i]) & CONTEXT_ADDRESS_HOST)
+            {
+                Debug_Log("%s: DMA %d: Address of another process", __func__, i);
+                saved.sad[i] = 0;
+                saved.dad[i] = 0;
+            }
+
+            if ((saved.channel[i].srcaddr | saved.channel[i].dstaddr) &
+                CONTEXT_ADDRESS_HOST)
+            {
+                Debug_Log("%s: DMA %d: Channel disabled", __func__, i);
+                saved.channel[i].srcaddr = 0;
+                saved.channel[i].dstaddr = 0;
+                stop = 1;
+            }
+        }
+
+        GBA_Context()->dma_sad[i] = GBA_ContextAddressToPtr(saved.sad[i]);
+        GBA_Context()->dma_dad[i] = GBA_ContextAddressToPtr(saved.dad[i]);
+
+        dma_channel *dma = &DMA[i];
+
+        dma->srcaddr = GBA_ContextAddressToPtr(saved.channel[i].srcaddr);
+        dma->dstaddr = GBA_ContextAddressToPtr(saved.channel[i].dstaddr);
+        dma->num_chunks = saved.channel[i].num_chunks;
+        dma->enabled = saved.channel[i].enabled;
+        dma->copywords = saved.channel[i].copywords;
+        dma->srcadd = saved.channel[i].srcadd;
+        dma->dstadd = saved.channel[i].dstadd;
+        dma->repeat = saved.channel[i].repeat;
+        dma->start_mode = saved.channel[i].start_mode;
+
+        if (stop)
+            GBA_DMAStop(i);
+    }
+}
 
 static void GBA_DMACopyNow(dma_channel *dma)
 {
+    uintptr_t dst_start = dma->dstaddr;
+
     if (dma->copywords)
     {
         for (size_t i = 0; i < dma->num_chunks; i++)
@@ -56,6 +235,22 @@ static void GBA_DMACopyNow(dma_channel *dma)
             dma->dstaddr += dma->dstadd;
         }
     }
+
+    if (dma->num_chunks == 0)
+        return;
+
+    // The destination address may increment, decrement or stay fixed
+    uintptr_t first = dst_start;
+    uintptr_t last = dma->dstaddr - dma->dstadd;
+    if (last < first)
+    {
+        uintptr_t tmp = first;
+        first = last;
+        last = tmp;
+    }
+
+    GBA_TileCacheInvalidate((void *)first,
+                            last - first + (dma->copywords ? 4 : 2));
 }
 
 static int UGBA_DMA_SoundGetChannelFifoA(void)
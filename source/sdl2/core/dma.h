@@ -5,6 +5,19 @@
 #ifndef SDL2_CORE_DMA_H__
 #define SDL2_CORE_DMA_H__
 
+#include <stdint.h>
+
+#include "context.h"
+#include "state.h"
+
+extern gba_dma_state gba_dma_state_default;
+
+gba_dma_state *GBA_DMAStateCreate(void);
+void GBA_DMAStateDestroy(gba_dma_state *state);
+
+void GBA_DMAStateSave(gba_state *s);
+void GBA_DMAStateLoad(gba_state *s);
+
 void GBA_DMAUpdateRegister(uint32_t offset);
 void GBA_DMAHandleHBL(void);
 void GBA_DMAHandleVBL(void);
@@ -1,17 +1,21 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 //
-// Copyright (c) 2020 Antonio Niño Díaz
+// Copyright (c) 2020, 2026 Antonio Niño Díaz
 
 #include <stddef.h>
 
 #include <ugba/ugba.h>
 
-static irq_vector IRQ_VectorTable[IRQ_NUMBER];
+#include "context.h"
+
+#include "../profiler.h"
 
 void IRQ_Init(void)
 {
+    irq_vector *table = GBA_Context()->irq_vector_table;
+
     for (int i = 0; i < IRQ_NUMBER; i ++)
-        IRQ_VectorTable[i] = NULL;
+        table[i] = NULL;
 
     REG_IE = 0;
 
@@ -25,7 +29,7 @@ void IRQ_Init(void)
 void IRQ_SetHandler(irq_index index, irq_vector function)
 {
     if (index < IRQ_NUMBER)
-        IRQ_VectorTable[index] = function;
+        GBA_Context()->irq_vector_table[index] = function;
 }
 
 void IRQ_Enable(irq_index index)
@@ -98,9 +102,13 @@ void IRQ_Internal_CallHandler(irq_index index)
 
     BIOS_INTR_FLAGS |= (1 << index);
 
-    irq_vector vector = IRQ_VectorTable[index];
+    irq_vector vector = GBA_Context()->irq_vector_table[index];
     if (vector)
+    {
+        uint64_t start = Profiler_Start();
         vector();
+        Profiler_End(PROF_IRQ, start);
+    }
 
     REG_IME = old_ime;
 }
@@ -6,70 +6,65 @@
 
 #include <ugba/ugba.h>
 
+#include "context.h"
 #include "dma.h"
 #include "interrupts.h"
 #include "timer.h"
 #include "video.h"
 
-uint8_t internal_bios[MEM_BIOS_SIZE] ALIGNED(MEM_BIOS_SIZE);
-uint8_t internal_ewram[MEM_EWRAM_SIZE] ALIGNED(MEM_EWRAM_SIZE);
-uint8_t internal_iwram[MEM_IWRAM_SIZE] ALIGNED(MEM_IWRAM_SIZE);
-uint8_t internal_io[MEM_IO_SIZE] ALIGNED(MEM_IO_SIZE);
-uint8_t internal_palette[MEM_PALETTE_SIZE] ALIGNED(MEM_PALETTE_SIZE);
-uint8_t internal_vram[MEM_VRAM_SIZE] ALIGNED(MEM_VRAM_SIZE + 32 * 1024);
-uint8_t internal_oam[MEM_OAM_SIZE] ALIGNED(MEM_OAM_SIZE);
-uint8_t internal_rom[MEM_ROM_SIZE] ALIGNED(MEM_ROM_SIZE);
-uint8_t internal_sram[MEM_SRAM_SIZE] ALIGNED(MEM_SRAM_SIZE);
-
 uintptr_t UGBA_MemBIOS(void)
 {
-    return (uintptr_t)(&internal_bios[0]);
+    return (uintptr_t)GBA_Context()->bios;
 }
 
 uintptr_t UGBA_MemEWRAM(void)
 {
-    return (uintptr_t)(&internal_ewram[0]);
+    return (uintptr_t)GBA_Context()->ewram;
 }
 
 uintptr_t UGBA_MemIWRAM(void)
 {
-    return (uintptr_t)(&internal_iwram[0]);
+    return (uintptr_t)GBA_Context()->iwram;
 }
 
 uintptr_t UGBA_MemIO(void)
 {
-    return (uintptr_t)(&internal_io[0]);
+    return (uintptr_t)GBA_Context()->io;
 }
 
 uintptr_t UGBA_MemPalette(void)
 {
-    return (uintptr_t)(&internal_palette[0]);
+    return (uintptr_t)GBA_Context()->palette;
 }
 
 uintptr_t UGBA_MemVRAM(void)
 {
-    return (uintptr_t)(&internal_vram[0]);
+    return (uintptr_t)GBA_Context()->vram;
 }
 
 uintptr_t UGBA_MemOAM(void)
 {
-    return (uintptr_t)(&internal_oam[0]);
+    return (uintptr_t)GBA_Context()->oam;
 }
 
 uintptr_t UGBA_MemROM(void)
 {
-    return (uintptr_t)(&internal_rom[0]);
+    return (uintptr_t)GBA_Context()->rom;
 }
 
 uintptr_t UGBA_MemSRAM(void)
 {
-    return (uintptr_t)(&internal_sram[0]);
+    return (uintptr_t)GBA_Context()->sram;
 }
 
 void UGBA_RegisterUpdatedOffset(uint32_t offset)
 {
     switch (offset)
     {
+        case OFFSET_TM0CNT_L:
+        case OFFSET_TM1CNT_L:
+        case OFFSET_TM2CNT_L:
+        case OFFSET_TM3CNT_L:
         case OFFSET_TM0CNT_H:
         case OFFSET_TM1CNT_H:
         case OFFSET_TM2CNT_H:
@@ -105,45 +100,42 @@ void UGBA_RegisterUpdatedOffset(uint32_t offset)
     }
 }
 
-static uintptr_t DMASAD[4];
-static uintptr_t DMADAD[4];
-
 uintptr_t *UGBA_RegDMA0SAD(void)
 {
-    return &(DMASAD[0]);
+    return &(GBA_Context()->dma_sad[0]);
 }
 
 uintptr_t *UGBA_RegDMA0DAD(void)
 {
-    return &(DMADAD[0]);
+    return &(GBA_Context()->dma_dad[0]);
 }
 
 uintptr_t *UGBA_RegDMA1SAD(void)
 {
-    return &(DMASAD[1]);
+    return &(GBA_Context()->dma_sad[1]);
 }
 
 uintptr_t *UGBA_RegDMA1DAD(void)
 {
-    return &(DMADAD[1]);
+    return &(GBA_Context()->dma_dad[1]);
 }
 
 uintptr_t *UGBA_RegDMA2SAD(void)
 {
-    return &(DMASAD[2]);
+    return &(GBA_Context()->dma_sad[2]);
 }
 
 uintptr_t *UGBA_RegDMA2DAD(void)
 {
-    return &(DMADAD[2]);
+    return &(GBA_Context()->dma_dad[2]);
 }
 
 uintptr_t *UGBA_RegDMA3SAD(void)
 {
-    return &(DMASAD[3]);
+    return &(GBA_Context()->dma_sad[3]);
 }
 
 uintptr_t *UGBA_RegDMA3DAD(void)
 {
-    return &(DMADAD[3]);
+    return &(GBA_Context()->dma_dad[3]);
 }
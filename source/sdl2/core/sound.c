@@ -2,91 +2,27 @@
 //
 // Copyright (c) 2020-2021 Antonio Niño Díaz
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <ugba/ugba.h>
 
+#include "context.h"
 #include "dma.h"
+#include "sound.h"
+#include "state.h"
+#include "timer.h"
 
 #include "../config.h"
 #include "../debug_utils.h"
 #include "../sound_utils.h"
 #include "../wav_utils.h"
 
-// Banked wave RAM
-// ===============
+// Sound state
+// ===========
 
 #define WAV_BUFFER_SIZE     ((32 * 4) / (8 * sizeof(uint16_t)))
 
-static uint16_t channel_3_wave_ram[2 * WAV_BUFFER_SIZE];
-
-volatile uint16_t *UGBA_MemWaveRam(void)
-{
-    if ((REG_SOUNDCNT_X & SOUNDCNT_X_MASTER_ENABLE) == 0)
-        return &(channel_3_wave_ram[WAV_BUFFER_SIZE]);
-
-    // Return the buffer that isn't selected for playback.
-    if (SOUND3CNT_L_BANK_GET(REG_SOUND3CNT_L) == 0)
-        return &(channel_3_wave_ram[WAV_BUFFER_SIZE]);
-    else
-        return &(channel_3_wave_ram[0]);
-}
-
-// This is only used by the debugger window
-volatile uint16_t *UGBA_MemWaveRamTwoBanks(void)
-{
-    return &(channel_3_wave_ram[0]);
-}
-
-static int GetWaveRamSample(int index)
-{
-    uint16_t val = channel_3_wave_ram[index >> 2];
-
-    switch (index & 3)
-    {
-        case 0:
-            return (val >> 4) & 0xF;
-        case 1:
-            return (val >> 0) & 0xF;
-        case 2:
-            return (val >> 12) & 0xF;
-        case 3:
-            return (val >> 8) & 0xF;
-        default:
-            return 0;
-    }
-}
-
-// PSG channels
-// ============
-
-static const int8_t GBA_SquareWave[4][32] = {
-    {
-        -128, -128,  127,  127, -128, -128, -128, -128,
-        -128, -128, -128, -128, -128, -128, -128, -128,
-        -128, -128,  127,  127, -128, -128, -128, -128,
-        -128, -128, -128, -128, -128, -128, -128, -128,
-    },
-    {
-         127,  127,  127,  127, -128, -128, -128, -128,
-        -128, -128, -128, -128, -128, -128, -128, -128,
-         127,  127,  127,  127, -128, -128, -128, -128,
-        -128, -128, -128, -128, -128, -128, -128, -128,
-    },
-    {
-         127,  127,  127,  127,  127,  127,  127,  127,
-        -128, -128, -128, -128, -128, -128, -128, -128,
-         127,  127,  127,  127,  127,  127,  127,  127,
-        -128, -128, -128, -128, -128, -128, -128, -128,
-    },
-    {
-        -128, -128, -128, -128,  127,  127,  127,  127,
-         127,  127,  127,  127,  127,  127,  127,  127,
-        -128, -128, -128, -128,  127,  127,  127,  127,
-         127,  127,  127,  127,  127,  127,  127,  127,
-    }
-};
-
 typedef struct
 {
     struct // Tone & Sweep
@@ -198,7 +134,221 @@ typedef struct
     int clocks_current_sample; // Elapsed clocks of current PSG sample
 } sound_psg_info_t;
 
-static sound_psg_info_t sound_psg;
+typedef struct {
+    int8_t buffer[GBA_SAMPLES_PER_FRAME];
+    int write_ptr;
+
+    int clocks_current_sample; // Clocks left to read a sample from the FIFO
+    int8_t current_sample;
+    int clocks_current_buffer_index; // Clocks left to write to the buffer
+
+    uint32_t sample_data; // Last 4 samples read from buffer
+    int sample_count; // Count of samples read from sample_data so far
+} sound_dma_info_t;
+
+#define MIXED_BUFFER_SIZE       (32 * 1024)
+
+typedef struct {
+    int16_t buffer[MIXED_BUFFER_SIZE];
+    int16_t unscaled[MIXED_BUFFER_SIZE]; // Before applying the volume
+    int write_ptr;
+} mixed_sound_info_t;
+
+struct gba_sound_state {
+    uint16_t channel_3_wave_ram[2 * WAV_BUFFER_SIZE]; // Banked wave RAM
+    sound_psg_info_t psg;
+    sound_dma_info_t dma[2];
+    mixed_sound_info_t mixed;
+};
+
+gba_sound_state gba_sound_state_default;
+
+#define channel_3_wave_ram  (GBA_Context()->sound->channel_3_wave_ram)
+#define sound_psg           (GBA_Context()->sound->psg)
+#define sound_dma           (GBA_Context()->sound->dma)
+#define mixed               (GBA_Context()->sound->mixed)
+
+gba_sound_state *GBA_SoundStateCreate(void)
+{
+    return calloc(1, sizeof(gba_sound_state));
+}
+
+void GBA_SoundStateDestroy(gba_sound_state *state)
+{
+    free(state);
+}
+
+// The mixed buffer isn't saved, it only holds samples that are waiting to be
+// sent to the audio device.
+
+void GBA_SoundStateSave(gba_state *s)
+{
+    GBA_StateWrite(s, GBA_STATE_TAG('W', 'A', 'V', 'E'),
+                   channel_3_wave_ram, sizeof(channel_3_wave_ram));
+    GBA_StateWrite(s, GBA_STATE_TAG('P', 'S', 'G', ' '),
+                   &sound_psg, sizeof(sound_psg));
+    GBA_StateWrite(s, GBA_STATE_TAG('S', 'D', 'M', 'A'),
+                   sound_dma, sizeof(sound_dma));
+}
+
+// Only the values used as array indices, shifts or divisors, or as limits of
+// loops, are checked.
+
+static int sound_psg_state_is_valid(const sound_psg_info_t *psg)
+{
+    if ((psg->ch1.duty_cycle & ~3) || (psg->ch2.duty_cycle & ~3))
+        return 0;
+
+    if ((psg->ch1.sample_pointer & ~31) || (psg->ch2.sample_pointer & ~31) ||
+        (psg->ch3.sample_pointer & ~63) || (psg->ch3.bank_selected & ~1))
+        return 0;
+
+    if (psg->ch1.sweep_shift & ~7)
+        return 0;
+
+    if ((psg->ch1.frequency & ~2047) || (psg->ch1.frequency_steps & ~2047) ||
+        (psg->ch2.frequency & ~2047) || (psg->ch2.frequency_steps & ~2047) ||
+        (psg->ch3.frequency & ~2047) || (psg->ch3.frequency_steps & ~2047))
+        return 0;
+
+    if ((psg->ch1.volume & ~15) || (psg->ch2.volume & ~15) ||
+        (psg->ch3.volume & ~15) || (psg->ch4.volume & ~15))
+        return 0;
+
+    if ((psg->clocks_current_step < 0) ||
+        (psg->clocks_current_step >= GBA_CLOCKS_PER_SECOND / 256))
+        return 0;
+
+    if ((psg->clocks_current_sample < 0) ||
+        (psg->clocks_current_sample >= GBA_CLOCKS_PER_SAMPLE_60_FPS))
+        return 0;
+
+    return 1;
+}
+
+static int sound_dma_state_is_valid(const sound_dma_info_t *dma)
+{
+    if ((dma->sample_count < 0) || (dma->sample_count > 4))
+        return 0;
+
+    if (dma->clocks_current_sample < 0)
+        return 0;
+
+    if ((dma->clocks_current_buffer_index < 0) ||
+        (dma->clocks_current_buffer_index >= GBA_CLOCKS_PER_SAMPLE_60_FPS))
+        return 0;
+
+    return 1;
+}
+
+void GBA_SoundStateLoad(gba_state *s)
+{
+    sound_psg_info_t psg;
+    sound_dma_info_t dma[2];
+
+    GBA_StateRead(s, GBA_STATE_TAG('W', 'A', 'V', 'E'),
+                  channel_3_wave_ram, sizeof(channel_3_wave_ram));
+
+    if (GBA_StateReadCopy(s, GBA_STATE_TAG('P', 'S', 'G', ' '),
+                          &psg, sizeof(psg)) == 0)
+    {
+        if (!sound_psg_state_is_valid(&psg))
+        {
+            Debug_Log("%s: Invalid PSG state", __func__);
+            s->error = 1;
+        }
+        else if (!s->validate)
+        {
+            sound_psg = psg;
+        }
+    }
+
+    if (GBA_StateReadCopy(s, GBA_STATE_TAG('S', 'D', 'M', 'A'),
+                          dma, sizeof(dma)) == 0)
+    {
+        if (!sound_dma_state_is_valid(&dma[0]) ||
+            !sound_dma_state_is_valid(&dma[1]))
+        {
+            Debug_Log("%s: Invalid DMA state", __func__);
+            s->error = 1;
+        }
+        else if (!s->validate)
+        {
+            memcpy(sound_dma, dma, sizeof(dma));
+        }
+    }
+}
+
+// Banked wave RAM
+// ===============
+
+volatile uint16_t *UGBA_MemWaveRam(void)
+{
+    if ((REG_SOUNDCNT_X & SOUNDCNT_X_MASTER_ENABLE) == 0)
+        return &(channel_3_wave_ram[WAV_BUFFER_SIZE]);
+
+    // Return the buffer that isn't selected for playback.
+    if (SOUND3CNT_L_BANK_GET(REG_SOUND3CNT_L) == 0)
+        return &(channel_3_wave_ram[WAV_BUFFER_SIZE]);
+    else
+        return &(channel_3_wave_ram[0]);
+}
+
+// This is only used by the debugger window
+volatile uint16_t *UGBA_MemWaveRamTwoBanks(void)
+{
+    return &(channel_3_wave_ram[0]);
+}
+
+static int GetWaveRamSample(int index)
+{
+    uint16_t val = channel_3_wave_ram[index >> 2];
+
+    switch (index & 3)
+    {
+        case 0:
+            return (val >> 4) & 0xF;
+        case 1:
+            return (val >> 0) & 0xF;
+        case 2:
+            return (val >> 12) & 0xF;
+        case 3:
+            return (val >> 8) & 0xF;
+        default:
+            return 0;
+    }
+}
+
+// PSG channels
+// ============
+
+static const int8_t GBA_SquareWave[4][32] = {
+    {
+        -128, -128,  127,  127, -128, -128, -128, -128,
+        -128, -128, -128, -128, -128, -128, -128, -128,
+        -128, -128,  127,  127, -128, -128, -128, -128,
+        -128, -128, -128, -128, -128, -128, -128, -128,
+    },
+    {
+         127,  127,  127,  127, -128, -128, -128, -128,
+        -128, -128, -128, -128, -128, -128, -128, -128,
+         127,  127,  127,  127, -128, -128, -128, -128,
+        -128, -128, -128, -128, -128, -128, -128, -128,
+    },
+    {
+         127,  127,  127,  127,  127,  127,  127,  127,
+        -128, -128, -128, -128, -128, -128, -128, -128,
+         127,  127,  127,  127,  127,  127,  127,  127,
+        -128, -128, -128, -128, -128, -128, -128, -128,
+    },
+    {
+        -128, -128, -128, -128,  127,  127,  127,  127,
+         127,  127,  127,  127,  127,  127,  127,  127,
+        -128, -128, -128, -128,  127,  127,  127,  127,
+         127,  127,  127,  127,  127,  127,  127,  127,
+    }
+};
+
 
 static void UGBA_RefreshPSGState(void)
 {
@@ -491,484 +641,504 @@ static void UGBA_RefreshPSGState(void)
     }
 }
 
-static void Sound_FillBuffers_VBL_PSG(void)
+// Envelope, sweep and sound length of channels 1, 2, 3 and 4. This is called
+// 256 times per second.
+static void Sound_PSG_HandleStep(void)
 {
-    uint16_t soundcnt_l = REG_SOUNDCNT_L;
-    uint16_t soundcnt_h = REG_SOUNDCNT_H;
-
-    uint32_t clocks_left = GBA_CLOCKS_PER_FRAME;
+    // Channel 1
 
-    // 256 steps per second
-    const int clocks_per_step = GBA_CLOCKS_PER_SECOND / 256;
+    if (sound_psg.ch1.running)
+    {
+        // Sound length
 
-    // The frequency goes through a full cycle 131072 times per second. This is
-    // the same as saying 2097152 times per second for channel 3, or 2097152
-    // times per second if you imagine the waves of channels 1 and 2 to be
-    // formed of 16 samples.
-    const int clocks_per_frequency = GBA_CLOCKS_PER_SECOND / (131072 * 16);
+        if (sound_psg.ch1.steps_total > 0)
+        {
+            if (sound_psg.ch1.steps_total > sound_psg.ch1.steps_elapsed)
+            {
+                sound_psg.ch1.steps_elapsed++;
+            }
+            else
+            {
+                sound_psg.ch1.running = 0;
+                sound_psg.ch1.env_active = 0;
 
-    const int clocks_per_frequency_ch4 = GBA_CLOCKS_PER_SECOND / (1024 * 1024);
+                // Flag it as disabled
+                REG_SOUNDCNT_X &= ~SOUNDCNT_X_PSG_1_IS_ON;
+            }
+        }
 
-    const int clocks_per_sample = GBA_CLOCKS_PER_SAMPLE_60_FPS;
+        // Sweep
 
-    // Get master volume
+        if (sound_psg.ch1.sweep_steps)
+        {
+            sound_psg.ch1.sweep_elapsed_steps++;
 
-    int psg_vol = soundcnt_h & SOUNDCNT_H_PSG_VOLUME_MASK;
+            if (sound_psg.ch1.sweep_elapsed_steps >= sound_psg.ch1.sweep_steps)
+            {
+                sound_psg.ch1.sweep_elapsed_steps = 0;
 
-    if (psg_vol == SOUNDCNT_H_PSG_VOLUME_100)
-        psg_vol = 4;
-    else if (psg_vol == SOUNDCNT_H_PSG_VOLUME_50)
-        psg_vol = 2;
-    else if (psg_vol == SOUNDCNT_H_PSG_VOLUME_25)
-        psg_vol = 1;
-    else
-        psg_vol = 0;
+                int value = sound_psg.ch1.frequency;
+                value >>= sound_psg.ch1.sweep_shift;
 
-    // A value of 0 doesn't mean off, it means 1/8th of the max
-    int psg_vol_left =
-            (1 + SOUNDCNT_L_PSG_VOL_LEFT_GET(soundcnt_l)) * psg_vol;
-    int psg_vol_right =
-            (1 + SOUNDCNT_L_PSG_VOL_RIGHT_GET(soundcnt_l)) * psg_vol;
-
-    // Get individual left and right volumes (master volume is included here)
-
-    int ch1_vol_left = 0;
-    int ch1_vol_right = 0;
-    int ch2_vol_left = 0;
-    int ch2_vol_right = 0;
-    int ch3_vol_left = 0;
-    int ch3_vol_right = 0;
-    int ch4_vol_left = 0;
-    int ch4_vol_right = 0;
-
-    if (soundcnt_l & SOUNDCNT_L_PSG_1_ENABLE_LEFT)
-        ch1_vol_left = sound_psg.ch1.volume * psg_vol_left;
-    if (soundcnt_l & SOUNDCNT_L_PSG_1_ENABLE_RIGHT)
-        ch1_vol_right = sound_psg.ch1.volume * psg_vol_right;
-
-    if (soundcnt_l & SOUNDCNT_L_PSG_2_ENABLE_LEFT)
-        ch2_vol_left = sound_psg.ch2.volume * psg_vol_left;
-    if (soundcnt_l & SOUNDCNT_L_PSG_2_ENABLE_RIGHT)
-        ch2_vol_right = sound_psg.ch2.volume * psg_vol_right;
-
-    if (soundcnt_l & SOUNDCNT_L_PSG_3_ENABLE_LEFT)
-        ch3_vol_left = sound_psg.ch3.volume * psg_vol_left;
-    if (soundcnt_l & SOUNDCNT_L_PSG_3_ENABLE_RIGHT)
-        ch3_vol_right = sound_psg.ch3.volume * psg_vol_right;
-
-    if (soundcnt_l & SOUNDCNT_L_PSG_4_ENABLE_LEFT)
-        ch4_vol_left = sound_psg.ch4.volume * psg_vol_left;
-    if (soundcnt_l & SOUNDCNT_L_PSG_4_ENABLE_RIGHT)
-        ch4_vol_right = sound_psg.ch4.volume * psg_vol_right;
-
-    // Always reset pointer to the start of the buffer, as all the data is
-    // always sent to SDL.
-    sound_psg.write_ptr = 0;
-
-    while (clocks_left > 0)
-    {
-        // Handle envelope, sweep and sound length of channels 1, 2, 3 and 4
-        // -----------------------------------------------------------------
-
-        sound_psg.clocks_current_step++;
-        if (sound_psg.clocks_current_step == clocks_per_step)
-        {
-            sound_psg.clocks_current_step = 0;
-
-            // Channel 1
-
-            if (sound_psg.ch1.running)
-            {
-                // Sound length
-
-                if (sound_psg.ch1.steps_total > 0)
+                if (sound_psg.ch1.sweep_decrease)
+                {
+                    sound_psg.ch1.frequency -= value;
+                    // No need to check for underflows. "value" is, at most,
+                    // the same value as the frequency, so the result can only
+                    // be 0 or greater than 0.
+                }
+                else
                 {
-                    if (sound_psg.ch1.steps_total > sound_psg.ch1.steps_elapsed)
+                    if (sound_psg.ch1.frequency + value <= 2047)
                     {
-                        sound_psg.ch1.steps_elapsed++;
+                        sound_psg.ch1.frequency += value;
                     }
                     else
                     {
                         sound_psg.ch1.running = 0;
-                        sound_psg.ch1.env_active = 0;
 
                         // Flag it as disabled
                         REG_SOUNDCNT_X &= ~SOUNDCNT_X_PSG_1_IS_ON;
                     }
                 }
+            }
+        }
 
-                // Sweep
-
-                if (sound_psg.ch1.sweep_steps)
-                {
-                    sound_psg.ch1.sweep_elapsed_steps++;
+        // Envelope
 
-                    if (sound_psg.ch1.sweep_elapsed_steps >=
-                            sound_psg.ch1.sweep_steps)
-                    {
-                        sound_psg.ch1.sweep_elapsed_steps = 0;
-
-                        int value = sound_psg.ch1.frequency;
-                        value >>= sound_psg.ch1.sweep_shift;
-
-                        if (sound_psg.ch1.sweep_decrease)
-                        {
-                            sound_psg.ch1.frequency -= value;
-                            // No need to check for underflows. "value" is, at
-                            // most, the same value as the frequency, so the
-                            // result can only be 0 or greater than 0.
-                        }
-                        else
-                        {
-                            if (sound_psg.ch1.frequency + value <= 2047)
-                            {
-                                sound_psg.ch1.frequency += value;
-                            }
-                            else
-                            {
-                                sound_psg.ch1.running = 0;
-
-                                // Flag it as disabled
-                                REG_SOUNDCNT_X &= ~SOUNDCNT_X_PSG_1_IS_ON;
-                            }
-                        }
-                    }
-                }
+        if (sound_psg.ch1.env_active)
+        {
+            sound_psg.ch1.env_steps_left--;
+            if (sound_psg.ch1.env_steps_left == 0)
+            {
+                sound_psg.ch1.env_steps_left = sound_psg.ch1.env_steps_to_change;
 
-                // Envelope
+                sound_psg.ch1.volume += sound_psg.ch1.env_increment;
 
-                if (sound_psg.ch1.env_active)
+                if (sound_psg.ch1.volume < 0)
                 {
-                    sound_psg.ch1.env_steps_left--;
-                    if (sound_psg.ch1.env_steps_left == 0)
-                    {
-                        sound_psg.ch1.env_steps_left =
-                            sound_psg.ch1.env_steps_to_change;
-
-                        sound_psg.ch1.volume += sound_psg.ch1.env_increment;
-
-                        if (sound_psg.ch1.volume < 0)
-                        {
-                            sound_psg.ch1.volume = 0;
-                            sound_psg.ch1.env_active = 0;
-                        }
-                        else if (sound_psg.ch1.volume > 7)
-                        {
-                            sound_psg.ch1.volume = 7;
-                            sound_psg.ch1.env_active = 0;
-                        }
-                    }
-
-                    if (soundcnt_l & SOUNDCNT_L_PSG_1_ENABLE_LEFT)
-                        ch1_vol_left = sound_psg.ch1.volume * psg_vol_left;
-                    if (soundcnt_l & SOUNDCNT_L_PSG_1_ENABLE_RIGHT)
-                        ch1_vol_right = sound_psg.ch1.volume * psg_vol_right;
+                    sound_psg.ch1.volume = 0;
+                    sound_psg.ch1.env_active = 0;
+                }
+                else if (sound_psg.ch1.volume > 7)
+                {
+                    sound_psg.ch1.volume = 7;
+                    sound_psg.ch1.env_active = 0;
                 }
             }
+        }
+    }
 
-            // Channel 2
+    // Channel 2
 
-            if (sound_psg.ch2.running)
+    if (sound_psg.ch2.running)
+    {
+        // Sound length
+
+        if (sound_psg.ch2.steps_total > 0)
+        {
+            if (sound_psg.ch2.steps_total > sound_psg.ch2.steps_elapsed)
+            {
+                sound_psg.ch2.steps_elapsed++;
+            }
+            else
             {
-                // Sound length
+                sound_psg.ch2.running = 0;
+                sound_psg.ch2.env_active = 0;
 
-                if (sound_psg.ch2.steps_total > 0)
-                {
-                    if (sound_psg.ch2.steps_total > sound_psg.ch2.steps_elapsed)
-                    {
-                        sound_psg.ch2.steps_elapsed++;
-                    }
-                    else
-                    {
-                        sound_psg.ch2.running = 0;
-                        sound_psg.ch2.env_active = 0;
+                // Flag it as disabled
+                REG_SOUNDCNT_X &= ~SOUNDCNT_X_PSG_2_IS_ON;
+            }
+        }
 
-                        // Flag it as disabled
-                        REG_SOUNDCNT_X &= ~SOUNDCNT_X_PSG_2_IS_ON;
-                    }
-                }
+        // Envelope
 
-                // Envelope
+        if (sound_psg.ch2.env_active)
+        {
+            sound_psg.ch2.env_steps_left--;
+            if (sound_psg.ch2.env_steps_left == 0)
+            {
+                sound_psg.ch2.env_steps_left = sound_psg.ch2.env_steps_to_change;
 
-                if (sound_psg.ch2.env_active)
-                {
-                    sound_psg.ch2.env_steps_left--;
-                    if (sound_psg.ch2.env_steps_left == 0)
-                    {
-                        sound_psg.ch2.env_steps_left =
-                            sound_psg.ch2.env_steps_to_change;
-
-                        sound_psg.ch2.volume += sound_psg.ch2.env_increment;
-
-                        if (sound_psg.ch2.volume < 0)
-                        {
-                            sound_psg.ch2.volume = 0;
-                            sound_psg.ch2.env_active = 0;
-                        }
-                        else if (sound_psg.ch2.volume > 7)
-                        {
-                            sound_psg.ch2.volume = 7;
-                            sound_psg.ch2.env_active = 0;
-                        }
-                    }
+                sound_psg.ch2.volume += sound_psg.ch2.env_increment;
 
-                    if (soundcnt_l & SOUNDCNT_L_PSG_2_ENABLE_LEFT)
-                        ch2_vol_left = sound_psg.ch2.volume * psg_vol_left;
-                    if (soundcnt_l & SOUNDCNT_L_PSG_2_ENABLE_RIGHT)
-                        ch2_vol_right = sound_psg.ch2.volume * psg_vol_right;
+                if (sound_psg.ch2.volume < 0)
+                {
+                    sound_psg.ch2.volume = 0;
+                    sound_psg.ch2.env_active = 0;
+                }
+                else if (sound_psg.ch2.volume > 7)
+                {
+                    sound_psg.ch2.volume = 7;
+                    sound_psg.ch2.env_active = 0;
                 }
             }
+        }
+    }
+
+    // Channel 3
 
-            // Channel 3
+    if (sound_psg.ch3.running)
+    {
+        // Sound length
 
-            if (sound_psg.ch3.running)
+        if (sound_psg.ch3.steps_total > 0)
+        {
+            if (sound_psg.ch3.steps_total > sound_psg.ch3.steps_elapsed)
             {
-                // Sound length
-
-                if (sound_psg.ch3.steps_total > 0)
-                {
-                    if (sound_psg.ch3.steps_total > sound_psg.ch3.steps_elapsed)
-                    {
-                        sound_psg.ch3.steps_elapsed++;
-                    }
-                    else
-                    {
-                        sound_psg.ch3.running = 0;
+                sound_psg.ch3.steps_elapsed++;
+            }
+            else
+            {
+                sound_psg.ch3.running = 0;
 
-                        // Flag it as disabled
-                        REG_SOUNDCNT_X &= ~SOUNDCNT_X_PSG_3_IS_ON;
-                    }
-                }
+                // Flag it as disabled
+                REG_SOUNDCNT_X &= ~SOUNDCNT_X_PSG_3_IS_ON;
             }
+        }
+    }
 
-            // Channel 4
+    // Channel 4
 
-            if (sound_psg.ch4.running)
+    if (sound_psg.ch4.running)
+    {
+        // Sound length
+
+        if (sound_psg.ch4.steps_total > 0)
+        {
+            if (sound_psg.ch4.steps_total > sound_psg.ch4.steps_elapsed)
+            {
+                sound_psg.ch4.steps_elapsed++;
+            }
+            else
             {
-                // Sound length
+                sound_psg.ch4.running = 0;
+                sound_psg.ch4.env_active = 0;
 
-                if (sound_psg.ch4.steps_total > 0)
-                {
-                    if (sound_psg.ch4.steps_total > sound_psg.ch4.steps_elapsed)
-                    {
-                        sound_psg.ch4.steps_elapsed++;
-                    }
-                    else
-                    {
-                        sound_psg.ch4.running = 0;
-                        sound_psg.ch4.env_active = 0;
+                // Flag it as disabled
+                REG_SOUNDCNT_X &= ~SOUNDCNT_X_PSG_4_IS_ON;
+            }
+        }
 
-                        // Flag it as disabled
-                        REG_SOUNDCNT_X &= ~SOUNDCNT_X_PSG_4_IS_ON;
-                    }
-                }
+        // Envelope
+
+        if (sound_psg.ch4.env_active)
+        {
+            sound_psg.ch4.env_steps_left--;
+            if (sound_psg.ch4.env_steps_left == 0)
+            {
+                sound_psg.ch4.env_steps_left = sound_psg.ch4.env_steps_to_change;
 
-                // Envelope
+                sound_psg.ch4.volume += sound_psg.ch4.env_increment;
 
-                if (sound_psg.ch4.env_active)
+                if (sound_psg.ch4.volume < 0)
                 {
-                    sound_psg.ch4.env_steps_left--;
-                    if (sound_psg.ch4.env_steps_left == 0)
-                    {
-                        sound_psg.ch4.env_steps_left =
-                            sound_psg.ch4.env_steps_to_change;
-
-                        sound_psg.ch4.volume += sound_psg.ch4.env_increment;
-
-                        if (sound_psg.ch4.volume < 0)
-                        {
-                            sound_psg.ch4.volume = 0;
-                            sound_psg.ch4.env_active = 0;
-                        }
-                        else if (sound_psg.ch4.volume > 7)
-                        {
-                            sound_psg.ch4.volume = 7;
-                            sound_psg.ch4.env_active = 0;
-                        }
-                    }
-
-                    if (soundcnt_l & SOUNDCNT_L_PSG_4_ENABLE_LEFT)
-                        ch4_vol_left = sound_psg.ch4.volume * psg_vol_left;
-                    if (soundcnt_l & SOUNDCNT_L_PSG_4_ENABLE_RIGHT)
-                        ch4_vol_right = sound_psg.ch4.volume * psg_vol_right;
+                    sound_psg.ch4.volume = 0;
+                    sound_psg.ch4.env_active = 0;
+                }
+                else if (sound_psg.ch4.volume > 7)
+                {
+                    sound_psg.ch4.volume = 7;
+                    sound_psg.ch4.env_active = 0;
                 }
             }
         }
+    }
+}
 
-        // Handle waveform changes of channels 1, 2 and 3
-        // ----------------------------------------------
-
-        sound_psg.clocks_current_frequency++;
-        if (sound_psg.clocks_current_frequency == clocks_per_frequency)
-        {
-            sound_psg.clocks_current_frequency = 0;
+// Advance the frequency counter of channels 1, 2 or 3 by the specified number
+// of ticks. The counter goes from the value of the frequency to 2048, and the
+// waveform advances every time it reaches 2048. Returns the number of times
+// that the waveform has advanced.
+static uint32_t Sound_PSG_FrequencyTicks(int *frequency_steps, int frequency,
+                                         uint32_t ticks)
+{
+    uint32_t ticks_to_change = 2048 - *frequency_steps;
 
-            // Channel 1
+    if (ticks < ticks_to_change)
+    {
+        *frequency_steps += ticks;
+        return 0;
+    }
 
-            if (sound_psg.ch1.running)
-            {
-                sound_psg.ch1.frequency_steps++;
+    uint32_t period = 2048 - frequency;
 
-                if (sound_psg.ch1.frequency_steps >= 2048)
-                {
-                    sound_psg.ch1.frequency_steps = sound_psg.ch1.frequency;
+    ticks -= ticks_to_change;
+    *frequency_steps = frequency + (ticks % period);
 
-                    int duty = sound_psg.ch1.duty_cycle;
-                    int pointer = sound_psg.ch1.sample_pointer;
+    return 1 + (ticks / period);
+}
 
-                    sound_psg.ch1.current_value = GBA_SquareWave[duty][pointer];
+// Step the LFSR of channel 4 the specified number of times
+static void Sound_PSG_NoiseSteps(uint32_t steps)
+{
+    int xor_value = (sound_psg.ch4.counter_width == 7) ? 0x60 : 0x6000;
 
-                    sound_psg.ch1.sample_pointer++;
-                    sound_psg.ch1.sample_pointer &= 31;
-                }
-            }
+    if ((sound_psg.ch4.counter_width != 7) &&
+        (sound_psg.ch4.counter_width != 15))
+        return;
 
-            // Channel 2
+    int lfsr = sound_psg.ch4.lfsr_state;
+    int bit = 0;
 
-            if (sound_psg.ch2.running)
-            {
-                sound_psg.ch2.frequency_steps++;
+    for (uint32_t i = 0; i < steps; i++)
+    {
+        bit = lfsr & 1;
+        lfsr >>= 1;
+        if (bit)
+            lfsr ^= xor_value;
+    }
 
-                if (sound_psg.ch2.frequency_steps >= 2048)
-                {
-                    sound_psg.ch2.frequency_steps = sound_psg.ch2.frequency;
+    sound_psg.ch4.lfsr_state = lfsr;
+    sound_psg.ch4.current_value = bit ? 127 : -128;
+}
 
-                    int duty = sound_psg.ch2.duty_cycle;
-                    int pointer = sound_psg.ch2.sample_pointer;
+// Advance the waveforms of all channels by the specified number of clocks
+static void Sound_PSG_AdvanceWaveforms(uint32_t clocks)
+{
+    // The frequency goes through a full cycle 131072 times per second. This is
+    // the same as saying 2097152 times per second for channel 3, or 2097152
+    // times per second if you imagine the waves of channels 1 and 2 to be
+    // formed of 16 samples.
+    const uint32_t clocks_per_frequency = GBA_CLOCKS_PER_SECOND / (131072 * 16);
 
-                    sound_psg.ch2.current_value = GBA_SquareWave[duty][pointer];
+    const uint32_t clocks_per_frequency_ch4 =
+                                    GBA_CLOCKS_PER_SECOND / (1024 * 1024);
 
-                    sound_psg.ch2.sample_pointer++;
-                    sound_psg.ch2.sample_pointer &= 31;
-                }
-            }
+    // Channels 1, 2 and 3
 
-            // Channel 3
+    uint32_t clocks_frequency = sound_psg.clocks_current_frequency + clocks;
+    uint32_t ticks = clocks_frequency / clocks_per_frequency;
+    sound_psg.clocks_current_frequency = clocks_frequency % clocks_per_frequency;
 
-            if (sound_psg.ch3.running)
+    if (ticks > 0)
+    {
+        if (sound_psg.ch1.running)
+        {
+            uint32_t changes =
+                    Sound_PSG_FrequencyTicks(&sound_psg.ch1.frequency_steps,
+                                             sound_psg.ch1.frequency, ticks);
+            if (changes > 0)
             {
-                sound_psg.ch3.frequency_steps++;
+                int duty = sound_psg.ch1.duty_cycle;
+                int pointer = sound_psg.ch1.sample_pointer;
 
-                if (sound_psg.ch3.frequency_steps >= 2048)
-                {
-                    sound_psg.ch3.frequency_steps = sound_psg.ch3.frequency;
+                // Only the last value is needed
+                sound_psg.ch1.current_value =
+                        GBA_SquareWave[duty][(pointer + changes - 1) & 31];
 
-                    int pointer = sound_psg.ch3.sample_pointer;
-                    int sample = (GetWaveRamSample(pointer) - 7) << 5;
+                sound_psg.ch1.sample_pointer = (pointer + changes) & 31;
+            }
+        }
 
-                    sound_psg.ch3.current_value = sample;
+        if (sound_psg.ch2.running)
+        {
+            uint32_t changes =
+                    Sound_PSG_FrequencyTicks(&sound_psg.ch2.frequency_steps,
+                                             sound_psg.ch2.frequency, ticks);
+            if (changes > 0)
+            {
+                int duty = sound_psg.ch2.duty_cycle;
+                int pointer = sound_psg.ch2.sample_pointer;
 
-                    if (sound_psg.ch3.bank_size == 64)
-                    {
-                        sound_psg.ch3.sample_pointer++;
-                        sound_psg.ch3.sample_pointer &= 63;
-                    }
-                    else // if (sound_psg.ch3.bank_size == 32)
-                    {
-                        sound_psg.ch3.sample_pointer++;
-                        sound_psg.ch3.sample_pointer &= 31;
+                sound_psg.ch2.current_value =
+                        GBA_SquareWave[duty][(pointer + changes - 1) & 31];
 
-                        sound_psg.ch3.sample_pointer |=
-                            sound_psg.ch3.bank_selected << 5;
-                    }
-                }
+                sound_psg.ch2.sample_pointer = (pointer + changes) & 31;
             }
         }
 
-        // Handle waveform changes of channel 4
-        // ------------------------------------
-
-        sound_psg.clocks_current_frequency_ch4++;
-        if (sound_psg.clocks_current_frequency_ch4 == clocks_per_frequency_ch4)
+        if (sound_psg.ch3.running)
         {
-            sound_psg.clocks_current_frequency_ch4 = 0;
-
-            if (sound_psg.ch4.running)
+            uint32_t changes =
+                    Sound_PSG_FrequencyTicks(&sound_psg.ch3.frequency_steps,
+                                             sound_psg.ch3.frequency, ticks);
+            if (changes > 0)
             {
-                sound_psg.ch4.frequency_steps++;
+                int pointer = sound_psg.ch3.sample_pointer;
+                int last;
 
-                if (sound_psg.ch4.frequency_steps >= sound_psg.ch4.frequency)
+                if (sound_psg.ch3.bank_size == 64)
+                {
+                    last = (pointer + changes - 1) & 63;
+                    sound_psg.ch3.sample_pointer = (pointer + changes) & 63;
+                }
+                else // if (sound_psg.ch3.bank_size == 32)
                 {
-                    sound_psg.ch4.frequency_steps = 0;
+                    int bank = sound_psg.ch3.bank_selected << 5;
 
-                    if (sound_psg.ch4.counter_width == 7)
-                    {
-                        if (sound_psg.ch4.lfsr_state & 1)
-                        {
-                            sound_psg.ch4.lfsr_state >>= 1;
-                            sound_psg.ch4.lfsr_state ^= 0x60;
-                            sound_psg.ch4.current_value = 127;
-                        }
-                        else
-                        {
-                            sound_psg.ch4.lfsr_state >>= 1;
-                            sound_psg.ch4.current_value = -128;
-                        }
-                    }
-                    else if (sound_psg.ch4.counter_width == 15)
-                    {
-                        if (sound_psg.ch4.lfsr_state & 1)
-                        {
-                            sound_psg.ch4.lfsr_state >>= 1;
-                            sound_psg.ch4.lfsr_state ^= 0x6000;
-                            sound_psg.ch4.current_value = 127;
-                        }
-                        else
-                        {
-                            sound_psg.ch4.lfsr_state >>= 1;
-                            sound_psg.ch4.current_value = -128;
-                        }
-                    }
+                    // The first sample is read before the bank is applied
+                    if (changes == 1)
+                        last = pointer;
+                    else
+                        last = ((pointer + changes - 1) & 31) | bank;
+
+                    sound_psg.ch3.sample_pointer =
+                                        ((pointer + changes) & 31) | bank;
                 }
+
+                sound_psg.ch3.current_value = (GetWaveRamSample(last) - 7) << 5;
             }
         }
+    }
+
+    // Channel 4
+
+    uint32_t clocks_frequency_ch4 = sound_psg.clocks_current_frequency_ch4
+                                  + clocks;
+    uint32_t ticks_ch4 = clocks_frequency_ch4 / clocks_per_frequency_ch4;
+    sound_psg.clocks_current_frequency_ch4 =
+                            clocks_frequency_ch4 % clocks_per_frequency_ch4;
+
+    if ((ticks_ch4 > 0) && sound_psg.ch4.running)
+    {
+        // With a frequency of 0 the LFSR is updated in every tick
+        uint32_t period = sound_psg.ch4.frequency;
+        if (period == 0)
+            period = 1;
+
+        uint32_t ticks_to_change = period - sound_psg.ch4.frequency_steps;
+
+        if (ticks_ch4 < ticks_to_change)
+        {
+            sound_psg.ch4.frequency_steps += ticks_ch4;
+        }
+        else
+        {
+            ticks_ch4 -= ticks_to_change;
+            sound_psg.ch4.frequency_steps = ticks_ch4 % period;
+
+            Sound_PSG_NoiseSteps(1 + (ticks_ch4 / period));
+        }
+    }
+}
+
+static void Sound_FillBuffers_VBL_PSG(void)
+{
+    uint16_t soundcnt_l = REG_SOUNDCNT_L;
+    uint16_t soundcnt_h = REG_SOUNDCNT_H;
+
+    uint32_t clocks_left = GBA_CLOCKS_PER_FRAME;
+
+    // 256 steps per second
+    const int clocks_per_step = GBA_CLOCKS_PER_SECOND / 256;
+
+    const int clocks_per_sample = GBA_CLOCKS_PER_SAMPLE_60_FPS;
+
+    // Get master volume
+
+    int psg_vol = soundcnt_h & SOUNDCNT_H_PSG_VOLUME_MASK;
+
+    if (psg_vol == SOUNDCNT_H_PSG_VOLUME_100)
+        psg_vol = 4;
+    else if (psg_vol == SOUNDCNT_H_PSG_VOLUME_50)
+        psg_vol = 2;
+    else if (psg_vol == SOUNDCNT_H_PSG_VOLUME_25)
+        psg_vol = 1;
+    else
+        psg_vol = 0;
+
+    // A value of 0 doesn't mean off, it means 1/8th of the max
+    int psg_vol_left =
+            (1 + SOUNDCNT_L_PSG_VOL_LEFT_GET(soundcnt_l)) * psg_vol;
+    int psg_vol_right =
+            (1 + SOUNDCNT_L_PSG_VOL_RIGHT_GET(soundcnt_l)) * psg_vol;
+
+    // Always reset pointer to the start of the buffer, as all the data is
+    // always sent to SDL.
+    sound_psg.write_ptr = 0;
+
+    // Instead of simulating every clock, jump from one event to the next one.
+    // Events that happen in the same clock are handled in this order: steps of
+    // envelope, sweep and sound length, waveform changes, and output samples.
+    while (clocks_left > 0)
+    {
+        uint32_t clocks = clocks_left;
+
+        uint32_t clocks_to_step = clocks_per_step - sound_psg.clocks_current_step;
+        if (clocks > clocks_to_step)
+            clocks = clocks_to_step;
+
+        uint32_t clocks_to_sample =
+                    clocks_per_sample - sound_psg.clocks_current_sample;
+        if (clocks > clocks_to_sample)
+            clocks = clocks_to_sample;
+
+        // Advance the waveforms up to the last clock, which may have events
+        Sound_PSG_AdvanceWaveforms(clocks - 1);
+
+        clocks_left -= clocks;
+
+        sound_psg.clocks_current_step += clocks;
+        if (sound_psg.clocks_current_step == clocks_per_step)
+        {
+            sound_psg.clocks_current_step = 0;
+
+            Sound_PSG_HandleStep();
+        }
+
+        Sound_PSG_AdvanceWaveforms(1);
 
         // Generate sample combining the 4 channels
         // ----------------------------------------
 
+        sound_psg.clocks_current_sample += clocks;
+        if (sound_psg.clocks_current_sample != clocks_per_sample)
+            continue;
+
+        sound_psg.clocks_current_sample = 0;
+
         // GBATEK: Each of the four PSGs can span one QUARTER of the output
         // range (+/-80h).
 
-        sound_psg.clocks_current_sample++;
-        if (sound_psg.clocks_current_sample == clocks_per_sample)
+        int sound_left = 0;
+        int sound_right = 0;
+
+        if ((sound_psg.ch1.running) && (GlobalConfig.channel_flags & (1 << 0)))
         {
-            sound_psg.clocks_current_sample = 0;
+            int value = sound_psg.ch1.current_value * sound_psg.ch1.volume;
 
-            int sound_left = 0;
-            int sound_right = 0;
+            if (soundcnt_l & SOUNDCNT_L_PSG_1_ENABLE_LEFT)
+                sound_left += value * psg_vol_left;
+            if (soundcnt_l & SOUNDCNT_L_PSG_1_ENABLE_RIGHT)
+                sound_right += value * psg_vol_right;
+        }
 
-            if ((sound_psg.ch1.running) && (GlobalConfig.channel_flags & (1 << 0)))
-            {
-                sound_left += sound_psg.ch1.current_value * ch1_vol_left;
-                sound_right += sound_psg.ch1.current_value * ch1_vol_right;
-            }
+        if ((sound_psg.ch2.running) && (GlobalConfig.channel_flags & (1 << 1)))
+        {
+            int value = sound_psg.ch2.current_value * sound_psg.ch2.volume;
 
-            if ((sound_psg.ch2.running) && (GlobalConfig.channel_flags & (1 << 1)))
-            {
-                sound_left += sound_psg.ch2.current_value * ch2_vol_left;
-                sound_right += sound_psg.ch2.current_value * ch2_vol_right;
-            }
+            if (soundcnt_l & SOUNDCNT_L_PSG_2_ENABLE_LEFT)
+                sound_left += value * psg_vol_left;
+            if (soundcnt_l & SOUNDCNT_L_PSG_2_ENABLE_RIGHT)
+                sound_right += value * psg_vol_right;
+        }
 
-            if ((sound_psg.ch3.running) && (GlobalConfig.channel_flags & (1 << 2)))
-            {
-                sound_left += sound_psg.ch3.current_value * ch3_vol_left;
-                sound_right += sound_psg.ch3.current_value * ch3_vol_right;
-            }
+        if ((sound_psg.ch3.running) && (GlobalConfig.channel_flags & (1 << 2)))
+        {
+            int value = sound_psg.ch3.current_value * sound_psg.ch3.volume;
 
-            if ((sound_psg.ch4.running) && (GlobalConfig.channel_flags & (1 << 3)))
-            {
-                sound_left += sound_psg.ch4.current_value * ch4_vol_left;
-                sound_right += sound_psg.ch4.current_value * ch4_vol_right;
-            }
+            if (soundcnt_l & SOUNDCNT_L_PSG_3_ENABLE_LEFT)
+                sound_left += value * psg_vol_left;
+            if (soundcnt_l & SOUNDCNT_L_PSG_3_ENABLE_RIGHT)
+                sound_right += value * psg_vol_right;
+        }
 
-            sound_left >>= 10;
-            sound_right >>= 10;
+        if ((sound_psg.ch4.running) && (GlobalConfig.channel_flags & (1 << 3)))
+        {
+            int value = sound_psg.ch4.current_value * sound_psg.ch4.volume;
 
-            sound_psg.buffer[sound_psg.write_ptr++] = sound_left;
-            sound_psg.buffer[sound_psg.write_ptr++] = sound_right;
+            if (soundcnt_l & SOUNDCNT_L_PSG_4_ENABLE_LEFT)
+                sound_left += value * psg_vol_left;
+            if (soundcnt_l & SOUNDCNT_L_PSG_4_ENABLE_RIGHT)
+                sound_right += value * psg_vol_right;
         }
 
-        clocks_left--;
+        sound_left >>= 10;
+        sound_right >>= 10;
+
+        sound_psg.buffer[sound_psg.write_ptr++] = sound_left;
+        sound_psg.buffer[sound_psg.write_ptr++] = sound_right;
     }
 
     // Hack: Fill buffer with the last value if there are empty samples.
@@ -985,19 +1155,6 @@ static void Sound_FillBuffers_VBL_PSG(void)
 // DMA channels
 // ============
 
-typedef struct {
-    int8_t buffer[GBA_SAMPLES_PER_FRAME];
-    int write_ptr;
-
-    int clocks_current_sample; // Elapsed clocks of current DMA sample
-    int8_t current_sample;
-    int clocks_current_buffer_index; // Elapsed clocks in sound buffer
-
-    uint32_t sample_data; // Last 4 samples read from buffer
-    int sample_count; // Count of samples read from sample_data so far
-} sound_dma_info_t;
-
-static sound_dma_info_t sound_dma[2];
 
 // Calculate clocks per period for either timer 0 or 1
 static uint32_t UGBA_TimerClocksPerPeriod(int timer)
@@ -1006,12 +1163,12 @@ static uint32_t UGBA_TimerClocksPerPeriod(int timer)
 
     if (timer)
     {
-        reload_value = REG_TM1CNT_L;
+        reload_value = GBA_TimerGetReloadValue(1);
         flags = REG_TM1CNT_H;
     }
     else
     {
-        reload_value = REG_TM0CNT_L;
+        reload_value = GBA_TimerGetReloadValue(0);
         flags = REG_TM0CNT_H;
     }
 
@@ -1029,6 +1186,38 @@ static uint32_t UGBA_TimerClocksPerPeriod(int timer)
     return clocks_per_period;
 }
 
+// Read the specified number of samples from the FIFO of a DMA channel. Only the
+// last one is kept, but all of them are removed from the FIFO.
+static void Sound_DMA_ReadSamples(int dma_channel, uint32_t count)
+{
+    sound_dma_info_t *dma = &sound_dma[dma_channel];
+
+    while (count > 0)
+    {
+        if (dma->sample_count == 0)
+        {
+            if (dma_channel == 0)
+                dma->sample_data = UGBA_DMA_SoundGetDataFifoA();
+            else
+                dma->sample_data = UGBA_DMA_SoundGetDataFifoB();
+
+            dma->sample_count = 4;
+        }
+
+        uint32_t skip = count;
+        if (skip > (uint32_t)dma->sample_count)
+            skip = dma->sample_count;
+
+        dma->sample_data >>= 8 * (skip - 1);
+
+        dma->current_sample = dma->sample_data & 0xFF;
+        dma->sample_data >>= 8;
+        dma->sample_count -= skip;
+
+        count -= skip;
+    }
+}
+
 // DMA A: dma_channel = 0 | DMA B: dma_channel = 1
 static void Sound_FillBuffers_VBL_DMA(int dma_channel)
 {
@@ -1060,37 +1249,47 @@ static void Sound_FillBuffers_VBL_DMA(int dma_channel)
     // always sent to SDL.
     dma->write_ptr = 0;
 
-    for (uint32_t i = 0; i < GBA_CLOCKS_PER_FRAME; i++)
+    uint32_t clocks_left = GBA_CLOCKS_PER_FRAME;
+
+    // Jump from one output sample to the next one. The timer may overflow any
+    // number of times in between, and a new sample is read from the FIFO every
+    // time it does. If both things happen in the same clock, the FIFO is read
+    // first.
+    while (clocks_left > 0)
     {
-        if (dma->clocks_current_sample == 0)
-        {
-            dma->clocks_current_sample = clocks_per_period;
+        uint32_t clocks = dma->clocks_current_buffer_index + 1;
+        if (clocks > clocks_left)
+            clocks = clocks_left;
 
-            if (dma->sample_count == 0)
-            {
-                if (dma_channel == 0)
-                    dma->sample_data = UGBA_DMA_SoundGetDataFifoA();
-                else
-                    dma->sample_data = UGBA_DMA_SoundGetDataFifoB();
+        uint32_t clocks_to_read = dma->clocks_current_sample;
 
-                dma->sample_count = 4;
-            }
+        if (clocks_to_read < clocks)
+        {
+            uint32_t elapsed = clocks - 1 - clocks_to_read;
+            uint32_t reads = 1 + (elapsed / clocks_per_period);
+
+            Sound_DMA_ReadSamples(dma_channel, reads);
 
-            dma->current_sample = dma->sample_data & 0xFF;
-            dma->sample_data >>= 8;
-            dma->sample_count--;
+            dma->clocks_current_sample = clocks_per_period - 1
+                                       - (elapsed % clocks_per_period);
+        }
+        else
+        {
+            dma->clocks_current_sample -= clocks;
         }
 
-        dma->clocks_current_sample--;
+        clocks_left -= clocks;
 
-        if (dma->clocks_current_buffer_index == 0)
+        if (clocks == (uint32_t)dma->clocks_current_buffer_index + 1)
         {
-            dma->clocks_current_buffer_index = GBA_CLOCKS_PER_SAMPLE_60_FPS;
-
             dma->buffer[dma->write_ptr++] = dma->current_sample;
-        }
 
-        dma->clocks_current_buffer_index--;
+            dma->clocks_current_buffer_index = GBA_CLOCKS_PER_SAMPLE_60_FPS - 1;
+        }
+        else
+        {
+            dma->clocks_current_buffer_index -= clocks;
+        }
     }
 
     // Hack: Fill buffer with the last value if there are empty samples.
@@ -1104,14 +1303,6 @@ static void Sound_FillBuffers_VBL_DMA(int dma_channel)
 // Sound mixer
 // ===========
 
-#define MIXED_BUFFER_SIZE       (32 * 1024)
-
-typedef struct {
-    int16_t buffer[MIXED_BUFFER_SIZE];
-    int write_ptr;
-} mixed_sound_info_t;
-
-static mixed_sound_info_t mixed;
 
 static void Sound_Mix_Buffers_VBL(void)
 {
@@ -1188,8 +1379,10 @@ static void Sound_Mix_Buffers_VBL(void)
         sample_left = (sample_left - 0x200) << 6;
         sample_right = (sample_right - 0x200) << 6;
 
+        mixed.unscaled[mixed.write_ptr] = sample_left;
         mixed.buffer[mixed.write_ptr++] =
                 (sample_left * GlobalConfig.volume) / 100;
+        mixed.unscaled[mixed.write_ptr] = sample_right;
         mixed.buffer[mixed.write_ptr++] =
                 (sample_right * GlobalConfig.volume) / 100;
     }
@@ -1206,6 +1399,8 @@ static void Sound_MixBuffers_Empty(void)
 
     uint32_t num_samples = GBA_CLOCKS_PER_FRAME / GBA_CLOCKS_PER_SAMPLE_60_FPS;
 
+    memset(mixed.unscaled, 0, (num_samples + 1) * 2 * sizeof(int16_t));
+
     for (uint32_t i = 0; i < num_samples + 1; i++)
     {
         mixed.buffer[mixed.write_ptr++] = 0;
@@ -1219,6 +1414,10 @@ static void Sound_SendToStream(void)
     int samples = mixed.write_ptr;
     int size;
 
+    // Only the default context is connected to the audio device
+    if (!GBA_ContextIsDefault())
+        return;
+
     if (WAV_FileIsOpen())
     {
         size = samples * sizeof(int16_t);
@@ -1258,6 +1457,12 @@ void Sound_Handle_VBL(void)
     Sound_SendToStream();
 }
 
+const int16_t *Sound_GetFrameSamples(int *samples)
+{
+    *samples = mixed.write_ptr;
+    return mixed.unscaled;
+}
+
 int Sound_PSG_GetChannelVolume(int channel)
 {
     switch (channel)
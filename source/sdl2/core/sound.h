@@ -5,10 +5,28 @@
 #ifndef SDL2_SOUND_H__
 #define SDL2_SOUND_H__
 
+#include <stdint.h>
+
+#include "context.h"
+#include "state.h"
+
+extern gba_sound_state gba_sound_state_default;
+
+gba_sound_state *GBA_SoundStateCreate(void);
+void GBA_SoundStateDestroy(gba_sound_state *state);
+
+void GBA_SoundStateSave(gba_state *s);
+void GBA_SoundStateLoad(gba_state *s);
+
 void Sound_Handle_VBL(void);
 void Sound_Initialize(void);
 
 int Sound_PSG_GetChannelVolume(int channel);
+
+// Samples generated during the last frame, before the volume of the
+// configuration is applied to them. The left and right channels are
+// interleaved.
+const int16_t *Sound_GetFrameSamples(int *samples);
 volatile uint16_t *UGBA_MemWaveRamTwoBanks(void);
 
 #endif // SDL2_SOUND_H__
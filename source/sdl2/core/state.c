@@ -0,0 +1,436 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef _WIN32
+// The library is built as C11 without extensions, getpid() needs this
+# define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+# include <process.h>
+#else
+# include <unistd.h>
+#endif
+
+#include <ugba/ugba.h>
+
+#include "context.h"
+#include "dma.h"
+#include "sound.h"
+#include "state.h"
+#include "tile_cache.h"
+#include "timer.h"
+#include "video.h"
+
+#include "../debug_utils.h"
+#include "../file_utils.h"
+#include "../lz_utils.h"
+
+// Format of a save state:
+//
+//     char     magic[8];   // "UGBASTAT"
+//     uint32_t version;    // STATE_VERSION (little endian)
+//     uint32_t size;       // Size of the uncompressed data (little endian)
+//     uint8_t  data[];     // Sections compressed with LZ_Compress()
+//
+// The sections are saved in the native byte order and with the native layout of
+// some structures, so save states can only be loaded by builds of the library
+// for the same platform. The version needs to be increased whenever a section
+// is changed.
+//
+// The first section is the ID of the process that has created the state. Some
+// sections can have pointers to the memory of the program (see
+// GBA_ContextPtrToAddress()), and they are only valid if the state is loaded by
+// the same process (or by a child created with fork()).
+
+#define STATE_MAGIC         "UGBASTAT"
+#define STATE_MAGIC_SIZE    8
+#define STATE_VERSION       2
+#define STATE_HEADER_SIZE   (STATE_MAGIC_SIZE + 4 + 4)
+
+// Initial size of the buffer of the uncompressed data. The memory regions are
+// most of it.
+#define STATE_INITIAL_CAPACITY  (512 * 1024)
+
+// Limit used to reject corrupted headers before allocating any memory
+#define STATE_MAX_SIZE          (16 * 1024 * 1024)
+
+// The BIOS and the ROM can't be modified, so they aren't saved.
+static const struct {
+    uint32_t tag;
+    size_t offset;
+    size_t size;
+} state_mem_regions[] = {
+    { GBA_STATE_TAG('E', 'W', 'R', 'M'), offsetof(ugba_context, ewram),
+      MEM_EWRAM_SIZE },
+    { GBA_STATE_TAG('I', 'W', 'R', 'M'), offsetof(ugba_context, iwram),
+      MEM_IWRAM_SIZE },
+    { GBA_STATE_TAG('I', 'O', ' ', ' '), offsetof(ugba_context, io),
+      MEM_IO_SIZE },
+    { GBA_STATE_TAG('P', 'A', 'L', ' '), offsetof(ugba_context, palette),
+      MEM_PALETTE_SIZE },
+    { GBA_STATE_TAG('V', 'R', 'A', 'M'), offsetof(ugba_context, vram),
+      MEM_VRAM_SIZE },
+    { GBA_STATE_TAG('O', 'A', 'M', ' '), offsetof(ugba_context, oam),
+      MEM_OAM_SIZE },
+    { GBA_STATE_TAG('S', 'R', 'A', 'M'), offsetof(ugba_context, sram),
+      MEM_SRAM_SIZE },
+};
+
+#define STATE_MEM_REGIONS \
+    (sizeof(state_mem_regions) / sizeof(state_mem_regions[0]))
+
+static uint64_t state_session;
+
+static uint64_t state_process_id(void)
+{
+#ifdef _WIN32
+    return (uint64_t)_getpid();
+#else
+    return (uint64_t)getpid();
+#endif
+}
+
+void GBA_StateInit(void)
+{
+    // The address of the variable changes between runs if the address space
+    // is randomized, and the time changes between runs if it isn't. The ID of
+    // the process is different for programs that run at the same time.
+    // Children created with fork() keep the session ID of their parent, which
+    // is what is needed, as they have the same pointers.
+    state_session = ((uint64_t)time(NULL) << 24) ^ (uint64_t)clock() ^
+                    (uint64_t)(uintptr_t)&state_session ^
+                    (state_process_id() << 40);
+}
+
+static uint8_t *state_mem_region(size_t index)
+{
+    ugba_context *ctx = GBA_Context();
+    return *(uint8_t **)((uint8_t *)ctx + state_mem_regions[index].offset);
+}
+
+static void state_write32(uint8_t *dst, uint32_t value)
+{
+    dst[0] = value & 0xFF;
+    dst[1] = (value >> 8) & 0xFF;
+    dst[2] = (value >> 16) & 0xFF;
+    dst[3] = value >> 24;
+}
+
+static uint32_t state_read32(const uint8_t *src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) |
+           ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+void GBA_StateWrite(gba_state *s, uint32_t tag, const void *data, size_t size)
+{
+    if (s->error)
+        return;
+
+    size_t needed = s->size + 8 + size;
+
+    if (needed > s->capacity)
+    {
+        size_t capacity = s->capacity ? s->capacity : STATE_INITIAL_CAPACITY;
+        while (capacity < needed)
+            capacity *= 2;
+
+        uint8_t *new_data = realloc(s->data, capacity);
+        if (new_data == NULL)
+        {
+            Debug_Log("%s: Not enough memory", __func__);
+            s->error = 1;
+            return;
+        }
+
+        s->data = new_data;
+        s->capacity = capacity;
+    }
+
+    state_write32(&s->data[s->size], tag);
+    state_write32(&s->data[s->size + 4], size);
+    memcpy(&s->data[s->size + 8], data, size);
+
+    s->size = needed;
+}
+
+static int state_read(gba_state *s, uint32_t tag, void *data, size_t size,
+                      int always_copy)
+{
+    if (s->error)
+        return -1;
+
+    if ((s->size - s->offset) < (8 + size))
+    {
+        Debug_Log("%s: Unexpected end of data", __func__);
+        s->error = 1;
+        return -1;
+    }
+
+    const uint8_t *section = &s->data[s->offset];
+
+    if ((state_read32(section) != tag) || (state_read32(section + 4) != size))
+    {
+        Debug_Log("%s: Invalid section at offset %zu", __func__, s->offset);
+        s->error = 1;
+        return -1;
+    }
+
+    s->offset += 8 + size;
+
+    if (s->validate && !always_copy)
+        return -1;
+
+    memcpy(data, section + 8, size);
+
+    return 0;
+}
+
+int GBA_StateRead(gba_state *s, uint32_t tag, void *data, size_t size)
+{
+    return state_read(s, tag, data, size, 0);
+}
+
+int GBA_StateReadCopy(gba_state *s, uint32_t tag, void *data, size_t size)
+{
+    return state_read(s, tag, data, size, 1);
+}
+
+// Both functions need to handle the sections in the same order
+
+static void state_save_sections(gba_state *s)
+{
+    GBA_StateWrite(s, GBA_STATE_TAG('S', 'E', 'S', 'S'),
+                   &state_session, sizeof(state_session));
+
+    for (size_t i = 0; i < STATE_MEM_REGIONS; i++)
+    {
+        GBA_StateWrite(s, state_mem_regions[i].tag, state_mem_region(i),
+                       state_mem_regions[i].size);
+    }
+
+    int32_t vcount = GBA_Context()->vcount;
+    GBA_StateWrite(s, GBA_STATE_TAG('V', 'C', 'N', 'T'),
+                   &vcount, sizeof(vcount));
+
+    GBA_DMAStateSave(s);
+    GBA_TimerStateSave(s);
+    GBA_SoundStateSave(s);
+    GBA_VideoStateSave(s);
+}
+
+static void state_load_sections(gba_state *s)
+{
+    uint64_t session;
+    if (GBA_StateRead(s, GBA_STATE_TAG('S', 'E', 'S', 'S'),
+                      &session, sizeof(session)) == 0)
+    {
+        s->host_valid = (session == state_session);
+    }
+
+    for (size_t i = 0; i < STATE_MEM_REGIONS; i++)
+    {
+        GBA_StateRead(s, state_mem_regions[i].tag, state_mem_region(i),
+                      state_mem_regions[i].size);
+    }
+
+    int32_t vcount;
+    if (GBA_StateReadCopy(s, GBA_STATE_TAG('V', 'C', 'N', 'T'),
+                          &vcount, sizeof(vcount)) == 0)
+    {
+        if ((vcount < 0) || (vcount >= 228))
+        {
+            Debug_Log("%s: Invalid VCOUNT: %d", __func__, (int)vcount);
+            s->error = 1;
+        }
+        else if (!s->validate)
+        {
+            GBA_Context()->vcount = vcount;
+        }
+    }
+
+    GBA_DMAStateLoad(s);
+    GBA_TimerStateLoad(s);
+    GBA_SoundStateLoad(s);
+    GBA_VideoStateLoad(s);
+}
+
+void *UGBA_StateSaveToMemory(size_t *size)
+{
+    gba_state s = { 0 };
+
+    *size = 0;
+
+    state_save_sections(&s);
+
+    if (s.error)
+    {
+        free(s.data);
+        return NULL;
+    }
+
+    uint8_t *buffer = malloc(STATE_HEADER_SIZE + LZ_CompressBound(s.size));
+    if (buffer == NULL)
+    {
+        Debug_Log("%s: Not enough memory", __func__);
+        free(s.data);
+        return NULL;
+    }
+
+    memcpy(buffer, STATE_MAGIC, STATE_MAGIC_SIZE);
+    state_write32(&buffer[STATE_MAGIC_SIZE], STATE_VERSION);
+    state_write32(&buffer[STATE_MAGIC_SIZE + 4], s.size);
+
+    size_t compressed_size = LZ_Compress(&buffer[STATE_HEADER_SIZE],
+                                         s.data, s.size);
+
+    free(s.data);
+
+    if (compressed_size == 0)
+    {
+        Debug_Log("%s: Failed to compress data", __func__);
+        free(buffer);
+        return NULL;
+    }
+
+    *size = STATE_HEADER_SIZE + compressed_size;
+
+    // Save states are normally much smaller than the worst case. This makes it
+    // possible to keep many of them in memory.
+    uint8_t *shrunk = realloc(buffer, *size);
+    if (shrunk != NULL)
+        buffer = shrunk;
+
+    return buffer;
+}
+
+int UGBA_StateLoadFromMemory(const void *state, size_t size)
+{
+    const uint8_t *buffer = state;
+
+    if ((buffer == NULL) || (size < STATE_HEADER_SIZE) ||
+        (memcmp(buffer, STATE_MAGIC, STATE_MAGIC_SIZE) != 0))
+    {
+        Debug_Log("%s: Not a save state", __func__);
+        return -1;
+    }
+
+    uint32_t version = state_read32(&buffer[STATE_MAGIC_SIZE]);
+    if (version != STATE_VERSION)
+    {
+        Debug_Log("%s: Unsupported version: %u", __func__, version);
+        return -1;
+    }
+
+    gba_state s = { 0 };
+
+    s.size = state_read32(&buffer[STATE_MAGIC_SIZE + 4]);
+    if (s.size > STATE_MAX_SIZE)
+    {
+        Debug_Log("%s: Invalid size: %zu", __func__, s.size);
+        return -1;
+    }
+
+    s.data = malloc(s.size);
+    if (s.data == NULL)
+    {
+        Debug_Log("%s: Not enough memory", __func__);
+        return -1;
+    }
+
+    if (LZ_Decompress(s.data, s.size, &buffer[STATE_HEADER_SIZE],
+                      size - STATE_HEADER_SIZE) != 0)
+    {
+        Debug_Log("%s: Corrupted data", __func__);
+        free(s.data);
+        return -1;
+    }
+
+    s.validate = 1;
+    state_load_sections(&s);
+
+    if ((s.error == 0) && (s.offset != s.size))
+    {
+        Debug_Log("%s: Unexpected data at the end", __func__);
+        s.error = 1;
+    }
+
+    if (s.error)
+    {
+        free(s.data);
+        return -1;
+    }
+
+    s.validate = 0;
+    s.offset = 0;
+    state_load_sections(&s);
+
+    free(s.data);
+
+    // The tile cache is derived from VRAM, and VRAM has been replaced
+    GBA_TileCacheInvalidate(MEM_VRAM, MEM_VRAM_SIZE);
+
+    return 0;
+}
+
+void UGBA_StateFree(void *state)
+{
+    free(state);
+}
+
+int UGBA_StateSave(const char *path)
+{
+    size_t size;
+    void *state = UGBA_StateSaveToMemory(&size);
+    if (state == NULL)
+        return -1;
+
+    int ret = 0;
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        Debug_Log("%s: File couldn't be opened: %s", __func__, path);
+        ret = -1;
+    }
+    else
+    {
+        if (fwrite(state, size, 1, f) != 1)
+        {
+            Debug_Log("%s: Error while writing file: %s", __func__, path);
+            ret = -1;
+        }
+
+        if (fclose(f) != 0)
+            ret = -1;
+    }
+
+    free(state);
+
+    return ret;
+}
+
+int UGBA_StateLoad(const char *path)
+{
+    void *state;
+    size_t size;
+
+    File_Load(path, &state, &size);
+    if (state == NULL)
+        return -1;
+
+    int ret = UGBA_StateLoadFromMemory(state, size);
+
+    free(state);
+
+    return ret;
+}
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_CORE_STATE_H__
+#define SDL2_CORE_STATE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Save states
+// ===========
+//
+// The uncompressed data of a save state is a list of sections. Each section is
+// a 32-bit tag, a 32-bit size and the data. All sections have a fixed size, and
+// they are saved and loaded in the same order. Each module saves the sections
+// of its own state.
+//
+// Loading a state is done in two passes. In the first one the tag and size of
+// all sections are checked, but nothing is loaded. Sections with values that
+// are used as indices or sizes are read with GBA_StateReadCopy() and checked in
+// this pass too. The second pass only happens if the first one has found no
+// errors, so a corrupted save state can't leave the emulated hardware in an
+// inconsistent state.
+
+#define GBA_STATE_TAG(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | \
+     ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+typedef struct {
+    uint8_t *data;
+    size_t size; // Size of the data that has been saved or that can be loaded
+    size_t capacity;
+    size_t offset; // Read position
+    int validate; // Only check the sections, don't load them
+    int error;
+    int host_valid; // Set if the state has been created by this process
+} gba_state;
+
+// Must be called once when the library is initialized. It generates the ID that
+// is used to tell if a save state has been created by this process.
+void GBA_StateInit(void);
+
+// Add a section to a save state. On error it sets the "error" field.
+void GBA_StateWrite(gba_state *s, uint32_t tag, const void *data, size_t size);
+
+// Read the next section of a save state. It returns 0 if the section has been
+// copied to "data". If the tag or the size of the section don't match, it sets
+// the "error" field. In the validation pass it never copies the data, and it
+// always returns a non-zero value.
+int GBA_StateRead(gba_state *s, uint32_t tag, void *data, size_t size);
+
+// Like GBA_StateRead(), but the section is also copied in the validation pass
+// so that its values can be checked. If they aren't valid, the caller must set
+// the "error" field. The data must only be loaded if "validate" isn't set.
+int GBA_StateReadCopy(gba_state *s, uint32_t tag, void *data, size_t size);
+
+#endif // SDL2_CORE_STATE_H__
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ugba/ugba.h>
+
+#include "tile_cache.h"
+
+#define NUM_TILES   (MEM_VRAM_SIZE / TILE_CACHE_TILE_SIZE)
+
+gba_tile_cache_state gba_tile_cache_state_default;
+
+#define tile_cache_pixels       (GBA_Context()->tile_cache->pixels)
+#define tile_cache_valid        (GBA_Context()->tile_cache->valid)
+#define tile_cache_vram_copy    (GBA_Context()->tile_cache->vram_copy)
+
+gba_tile_cache_state *GBA_TileCacheStateCreate(void)
+{
+    return calloc(1, sizeof(gba_tile_cache_state));
+}
+
+void GBA_TileCacheStateDestroy(gba_tile_cache_state *state)
+{
+    free(state);
+}
+
+void GBA_TileCacheInvalidate(const void *ptr, size_t size)
+{
+    if (size == 0)
+        return;
+
+    uintptr_t vram_start = (uintptr_t)MEM_VRAM_ADDR;
+    uintptr_t vram_end = vram_start + MEM_VRAM_SIZE;
+
+    uintptr_t start = (uintptr_t)ptr;
+    uintptr_t end = start + size;
+
+    if ((end <= vram_start) || (start >= vram_end))
+        return;
+
+    if (start < vram_start)
+        start = vram_start;
+    if (end > vram_end)
+        end = vram_end;
+
+    uint32_t first = (start - vram_start) / TILE_CACHE_TILE_SIZE;
+    uint32_t last = (end - vram_start - 1) / TILE_CACHE_TILE_SIZE;
+
+    memset(&tile_cache_valid[first], 0, last - first + 1);
+}
+
+void GBA_TileCacheCheckChanges(void)
+{
+    const uint8_t *vram = (const uint8_t *)MEM_VRAM_ADDR;
+
+    for (uint32_t i = 0; i < NUM_TILES; i++)
+    {
+        if (tile_cache_valid[i] == 0)
+            continue;
+
+        uint32_t offset = i * TILE_CACHE_TILE_SIZE;
+
+        if (memcmp(&vram[offset], &tile_cache_vram_copy[offset],
+                   TILE_CACHE_TILE_SIZE) != 0)
+        {
+            tile_cache_valid[i] = 0;
+        }
+    }
+}
+
+static void gba_tile_decode_4bpp(uint8_t *dst, const uint8_t *src)
+{
+    for (int i = 0; i < TILE_CACHE_TILE_SIZE; i++)
+    {
+        dst[i * 2] = src[i] & 0xF;
+        dst[i * 2 + 1] = src[i] >> 4;
+    }
+}
+
+const uint8_t *GBA_TileCacheDecode4bpp(uint32_t offset)
+{
+    const uint8_t *src = &((const uint8_t *)MEM_VRAM_ADDR)[offset];
+
+    memcpy(&tile_cache_vram_copy[offset], src, TILE_CACHE_TILE_SIZE);
+
+    uint8_t *dst = &tile_cache_pixels[offset * 2];
+    gba_tile_decode_4bpp(dst, src);
+
+    tile_cache_valid[offset / TILE_CACHE_TILE_SIZE] = 1;
+
+    return dst;
+}
+
+void GBA_TileCacheUpdate(void)
+{
+    for (uint32_t i = 0; i < NUM_TILES; i++)
+    {
+        if (tile_cache_valid[i] == 0)
+            GBA_TileCacheDecode4bpp(i * TILE_CACHE_TILE_SIZE);
+    }
+}
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_CORE_TILE_CACHE_H__
+#define SDL2_CORE_TILE_CACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ugba/ugba.h>
+
+#include "context.h"
+
+// Decoded copy of the 16-color tiles in VRAM (both BG and OBJ). Each byte of
+// VRAM is expanded to two bytes with one palette index each, so that the
+// renderers don't need to extract nibbles. Tiles are decoded the first time
+// they are used after being modified.
+//
+// The write paths that the library controls (CPU set, DMA, decompression)
+// invalidate the tiles they touch. Any other change to VRAM is detected at the
+// start of each frame by comparing VRAM against the data used to build the
+// cache.
+
+#define TILE_CACHE_TILE_SIZE    32 // Size of a 16-color tile in VRAM
+
+struct gba_tile_cache_state {
+    uint8_t pixels[MEM_VRAM_SIZE * 2];
+    uint8_t valid[MEM_VRAM_SIZE / TILE_CACHE_TILE_SIZE]; // Tiles start invalid
+
+    // Copy of the data of VRAM used to decode the valid tiles
+    uint8_t vram_copy[MEM_VRAM_SIZE];
+};
+
+extern gba_tile_cache_state gba_tile_cache_state_default;
+
+gba_tile_cache_state *GBA_TileCacheStateCreate(void);
+void GBA_TileCacheStateDestroy(gba_tile_cache_state *state);
+
+// Mark as dirty all tiles that overlap the provided range of memory. Ranges
+// outside of VRAM are ignored.
+void GBA_TileCacheInvalidate(const void *ptr, size_t size);
+
+// Mark as dirty all tiles that have been modified without notifying the cache.
+void GBA_TileCacheCheckChanges(void);
+
+// Decode all tiles that aren't valid. After calling this function the cache can
+// be read from multiple threads at the same time.
+void GBA_TileCacheUpdate(void);
+
+// Decode one tile and mark it as valid.
+const uint8_t *GBA_TileCacheDecode4bpp(uint32_t offset);
+
+// Returns the 64 palette indices of the 16-color tile at the provided offset of
+// VRAM, starting from the top left corner. The offset must be a multiple of the
+// size of a tile, and it must be lower than 0x20000.
+static inline const uint8_t *GBA_TileCacheGet4bpp(uint32_t offset)
+{
+    // Like in the GBA, 0x18000-0x1FFFF is a mirror of the OBJ VRAM
+    if (offset >= MEM_VRAM_SIZE)
+        offset -= MEM_VRAM_OBJ_SIZE;
+
+    gba_tile_cache_state *cache = GBA_Context()->tile_cache;
+
+    if (cache->valid[offset / TILE_CACHE_TILE_SIZE])
+        return &cache->pixels[offset * 2];
+
+    return GBA_TileCacheDecode4bpp(offset);
+}
+
+#endif // SDL2_CORE_TILE_CACHE_H__
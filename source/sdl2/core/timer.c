@@ -1,147 +1,245 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 //
-// Copyright (c) 2020 Antonio Niño Díaz
+// Copyright (c) 2020, 2026 Antonio Niño Díaz
 
-#include <SDL2/SDL.h>
+#include <stdlib.h>
 
 #include <ugba/ugba.h>
 
+#include "context.h"
 #include "interrupts.h"
+#include "state.h"
+#include "timer.h"
 
 #include "../debug_utils.h"
+#include "../sound_utils.h"
 
-static uint16_t curr_value[4];
+// Timers are simulated by advancing their counters at the end of each
+// scanline, so interrupts happen at the end of the scanline in which the timer
+// overflows. If a timer overflows several times during the same scanline, its
+// interrupt handler is only called once, but all overflows are passed to the
+// next timer if it is in cascade mode.
+//
+// TMxCNT_L holds the current value of the counter while the timer is running.
+// On the GBA, writing to it sets the reload value. On PC it isn't possible to
+// detect writes to it, so they need to be reported with
+// UGBA_RegisterUpdatedOffset(). While the timer is stopped, TMxCNT_L holds the
+// reload value instead, and it is loaded when the timer is started. This way
+// it is enough to report the write to TMxCNT_H that starts the timer.
+
+#define GBA_CLOCKS_PER_SCANLINE     (GBA_CLOCKS_PER_FRAME / 228)
+
+struct gba_timer_state {
+    uint16_t reload_value[4];
+    uint16_t curr_value[4];
+    uint32_t prescaler_clocks[4]; // Clocks that haven't formed a tick yet
+    int running[4];
+};
+
+gba_timer_state gba_timer_state_default;
 
-static Uint32 Timer_3_Callback(Uint32 interval, UNUSED void *param)
+// This is used to check save states, so it needs to be defined before the
+// macros below.
+static int timer_state_is_valid(const gba_timer_state *state)
 {
-    IRQ_Internal_CallHandler(IRQ_TIMER3);
+    for (int i = 0; i < 4; i++)
+    {
+        if (state->running[i] & ~1)
+            return 0;
+
+        // The clocks left are always smaller than the biggest prescaler
+        if (state->prescaler_clocks[i] >= 1024)
+            return 0;
+    }
 
-    return interval;
+    return 1;
 }
 
-static Uint32 Timer_2_Callback(Uint32 interval, UNUSED void *param)
+#define reload_value        (GBA_Context()->timer->reload_value)
+#define curr_value          (GBA_Context()->timer->curr_value)
+#define prescaler_clocks    (GBA_Context()->timer->prescaler_clocks)
+#define running             (GBA_Context()->timer->running)
+
+gba_timer_state *GBA_TimerStateCreate(void)
 {
-    IRQ_Internal_CallHandler(IRQ_TIMER2);
+    return calloc(1, sizeof(gba_timer_state));
+}
 
-    if (REG_TM3CNT_H & TMCNT_CASCADE)
-    {
-        curr_value[3] += 1;
-        if (curr_value[3] == 0)
-        {
-            curr_value[3] = REG_TM3CNT_L;
-            Timer_3_Callback(0, NULL);
-        }
-    }
+void GBA_TimerStateDestroy(gba_timer_state *state)
+{
+    free(state);
+}
 
-    return interval;
+void GBA_TimerStateSave(gba_state *s)
+{
+    GBA_StateWrite(s, GBA_STATE_TAG('T', 'M', 'R', ' '),
+                   GBA_Context()->timer, sizeof(gba_timer_state));
 }
 
-static Uint32 Timer_1_Callback(Uint32 interval, UNUSED void *param)
+void GBA_TimerStateLoad(gba_state *s)
 {
-    IRQ_Internal_CallHandler(IRQ_TIMER1);
+    gba_timer_state saved;
 
-    if (REG_TM2CNT_H & TMCNT_CASCADE)
+    if (GBA_StateReadCopy(s, GBA_STATE_TAG('T', 'M', 'R', ' '),
+                          &saved, sizeof(saved)) != 0)
     {
-        curr_value[2] += 1;
-        if (curr_value[2] == 0)
-        {
-            curr_value[2] = REG_TM2CNT_L;
-            Timer_2_Callback(0, NULL);
-        }
+        return;
     }
 
-    return interval;
+    if (!timer_state_is_valid(&saved))
+    {
+        Debug_Log("%s: Invalid state", __func__);
+        s->error = 1;
+        return;
+    }
+
+    if (s->validate)
+        return;
+
+    *GBA_Context()->timer = saved;
+}
+
+static const int prescaler_shifts[4] = {
+    // 1, 64, 256, 1024
+    0, 6, 8, 10
+};
+
+static const uint16_t tmcnt_l_offsets[4] = {
+    OFFSET_TM0CNT_L, OFFSET_TM1CNT_L, OFFSET_TM2CNT_L, OFFSET_TM3CNT_L
+};
+
+static const uint16_t tmcnt_h_offsets[4] = {
+    OFFSET_TM0CNT_H, OFFSET_TM1CNT_H, OFFSET_TM2CNT_H, OFFSET_TM3CNT_H
+};
+
+static const irq_index timer_irq[4] = {
+    IRQ_TIMER0, IRQ_TIMER1, IRQ_TIMER2, IRQ_TIMER3
+};
+
+uint16_t GBA_TimerGetReloadValue(int index)
+{
+    if (!running[index])
+        return REG_16(tmcnt_l_offsets[index]);
+
+    return reload_value[index];
 }
 
-static Uint32 Timer_0_Callback(Uint32 interval, UNUSED void *param)
+// Called when the game reports a write to TMxCNT_L
+static void GBA_TimerSetReload(int index)
 {
-    IRQ_Internal_CallHandler(IRQ_TIMER0);
+    // Writing the reload value doesn't modify the counter of a running timer
+    if (!running[index])
+        return;
 
-    if (REG_TM1CNT_H & TMCNT_CASCADE)
+    reload_value[index] = REG_16(tmcnt_l_offsets[index]);
+    REG_16(tmcnt_l_offsets[index]) = curr_value[index];
+}
+
+static void GBA_RefreshTimer(int index)
+{
+    uint16_t flags = REG_16(tmcnt_h_offsets[index]);
+
+    if ((flags & TMCNT_START) == 0)
     {
-        curr_value[1] += 1;
-        if (curr_value[1] == 0)
+        if (running[index])
         {
-            curr_value[1] = REG_TM1CNT_L;
-            Timer_1_Callback(0, NULL);
+            running[index] = 0;
+            REG_16(tmcnt_l_offsets[index]) = reload_value[index];
         }
+        return;
     }
 
-    return interval;
+    // The counter is only reloaded when the timer goes from stopped to started
+    if (running[index])
+        return;
+
+    running[index] = 1;
+    prescaler_clocks[index] = 0;
+
+    reload_value[index] = REG_16(tmcnt_l_offsets[index]);
+    curr_value[index] = reload_value[index];
 }
 
-SDL_TimerCallback timer_callback[4] = {
-    Timer_0_Callback, Timer_1_Callback, Timer_2_Callback, Timer_3_Callback
-};
+// Returns the number of times that the timer has overflowed
+static uint32_t GBA_TimerAddTicks(int index, uint32_t ticks)
+{
+    uint32_t overflows = 0;
 
-SDL_TimerID TimerID[4];
+    uint32_t value = curr_value[index];
+    uint32_t ticks_to_overflow = (UINT16_MAX + 1) - value;
 
-#define PTR_REG_TM0CNT_L        PTR_REG_16(OFFSET_TM0CNT_L)
-#define PTR_REG_TM0CNT_H        PTR_REG_16(OFFSET_TM0CNT_H)
-#define PTR_REG_TM1CNT_L        PTR_REG_16(OFFSET_TM1CNT_L)
-#define PTR_REG_TM1CNT_H        PTR_REG_16(OFFSET_TM1CNT_H)
-#define PTR_REG_TM2CNT_L        PTR_REG_16(OFFSET_TM2CNT_L)
-#define PTR_REG_TM2CNT_H        PTR_REG_16(OFFSET_TM2CNT_H)
-#define PTR_REG_TM3CNT_L        PTR_REG_16(OFFSET_TM3CNT_L)
-#define PTR_REG_TM3CNT_H        PTR_REG_16(OFFSET_TM3CNT_H)
+    if (ticks >= ticks_to_overflow)
+    {
+        uint32_t period = (UINT16_MAX + 1) - reload_value[index];
 
-static void GBA_RefreshTimer(int index)
+        ticks -= ticks_to_overflow;
+        overflows = 1 + (ticks / period);
+        value = reload_value[index] + (ticks % period);
+    }
+    else
+    {
+        value += ticks;
+    }
+
+    curr_value[index] = value;
+    REG_16(tmcnt_l_offsets[index]) = value;
+
+    if (overflows > 0)
+    {
+        if (REG_16(tmcnt_h_offsets[index]) & TMCNT_IRQ_ENABLE)
+            IRQ_Internal_CallHandler(timer_irq[index]);
+    }
+
+    return overflows;
+}
+
+void GBA_TimerHandleScanline(void)
 {
-    volatile uint16_t *tmcnt_l[4] = {
-        PTR_REG_TM0CNT_L, PTR_REG_TM1CNT_L, PTR_REG_TM2CNT_L, PTR_REG_TM3CNT_L
-    };
+    uint32_t overflows = 0;
 
-    volatile uint16_t *tmcnt_h[4] = {
-        PTR_REG_TM0CNT_H, PTR_REG_TM1CNT_H, PTR_REG_TM2CNT_H, PTR_REG_TM3CNT_H
-    };
+    for (int i = 0; i < 4; i++)
+    {
+        uint16_t flags = REG_16(tmcnt_h_offsets[i]);
 
-    uint16_t reload_value = *tmcnt_l[index];
-    curr_value[index] = reload_value;
+        if (!running[i])
+        {
+            overflows = 0;
+            continue;
+        }
 
-    uint16_t flags = *tmcnt_h[index];
+        uint32_t ticks;
 
-    if (TimerID[index])
-        SDL_RemoveTimer(TimerID[index]);
+        // Timer 0 can't be used in cascade mode
+        if ((i > 0) && (flags & TMCNT_CASCADE))
+        {
+            ticks = overflows;
+        }
+        else
+        {
+            int shift = prescaler_shifts[flags & 3];
 
-    if ((flags & TMCNT_START) == 0)
-        return;
+            prescaler_clocks[i] += GBA_CLOCKS_PER_SCANLINE;
+            ticks = prescaler_clocks[i] >> shift;
+            prescaler_clocks[i] &= (1 << shift) - 1;
+        }
 
-    // Clocks per frame = 280_896
-    //
-    // Note:
-    //     Clocks per second = 16_780_000 (Oscillator freq in Hz)
-    //     Note that 16_780_000 / 60 = 279_666.66 = aprox clocks per frame
-    //     However, the frequency is only an aproximation, oscillators aren't
-    //     100% accurate. Just use clocks per frame for the following
-    //     calculations.
-    //
-
-    const int prescaler_values[4] = {
-        1, 64, 256, 1024
-    };
-    uint64_t prescaler = prescaler_values[flags & 3];
-    uint64_t ticks_per_period = UINT16_MAX - reload_value;
-    ticks_per_period += 1;
-    uint64_t clocks_per_period = ticks_per_period * prescaler;
-
-    const uint64_t clocks_per_second = 1 << 24;
-
-    uint64_t delay_ms = (clocks_per_period * 1000) / clocks_per_second;
-
-    if (delay_ms == 0)
-    {
-        Debug_Log("Timer %d: SDL_Timer not accurate enough. "
-                  "This is normal if using it for DMA audio streaming.",
-                  index);
-        return;
+        overflows = 0;
+        if (ticks > 0)
+            overflows = GBA_TimerAddTicks(i, ticks);
     }
-
-    TimerID[index] = SDL_AddTimer(delay_ms, timer_callback[index], NULL);
 }
 
 void GBA_TimerUpdateRegister(uint32_t offset)
 {
-    if (offset == OFFSET_TM0CNT_H)
+    if (offset == OFFSET_TM0CNT_L)
+        GBA_TimerSetReload(0);
+    else if (offset == OFFSET_TM1CNT_L)
+        GBA_TimerSetReload(1);
+    else if (offset == OFFSET_TM2CNT_L)
+        GBA_TimerSetReload(2);
+    else if (offset == OFFSET_TM3CNT_L)
+        GBA_TimerSetReload(3);
+    else if (offset == OFFSET_TM0CNT_H)
         GBA_RefreshTimer(0);
     else if (offset == OFFSET_TM1CNT_H)
         GBA_RefreshTimer(1);
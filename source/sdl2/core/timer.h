@@ -1,10 +1,30 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 //
-// Copyright (c) 2020 Antonio Niño Díaz
+// Copyright (c) 2020, 2026 Antonio Niño Díaz
 
 #ifndef SDL2_CORE_TIMER_H__
 #define SDL2_CORE_TIMER_H__
 
+#include <stdint.h>
+
+#include "context.h"
+#include "state.h"
+
+extern gba_timer_state gba_timer_state_default;
+
+gba_timer_state *GBA_TimerStateCreate(void);
+void GBA_TimerStateDestroy(gba_timer_state *state);
+
+void GBA_TimerStateSave(gba_state *s);
+void GBA_TimerStateLoad(gba_state *s);
+
 void GBA_TimerUpdateRegister(uint32_t offset);
 
+// Advance all timers by the duration of one scanline
+void GBA_TimerHandleScanline(void);
+
+// TMxCNT_L holds the current counter value of running timers, this returns the
+// reload value
+uint16_t GBA_TimerGetReloadValue(int index);
+
 #endif // SDL2_CORE_TIMER_H__
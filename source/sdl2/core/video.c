@@ -2,85 +2,867 @@
 //
 // Copyright (c) 2011-2015, 2019-2021 Antonio Niño Díaz
 
+#include <stdlib.h>
 #include <string.h>
 
+#include <SDL2/SDL.h>
+
 #include <ugba/ugba.h>
 
+#include "color_convert.h"
+#include "context.h"
+#include "state.h"
+#include "tile_cache.h"
 #include "video.h"
+#include "video_simd.h"
 
 #include "../debug_utils.h"
 
-static int curr_screen_buffer = 0;
-static uint16_t screen_buffer_array[2][240 * 160]; // Doble buffer
-static uint16_t *screen_buffer = screen_buffer_array[0];
+// Size of the I/O registers that affect the drawing of a scanline
+#define VIDEO_IO_SIZE       (OFFSET_BLDY + 2)
+
+#if defined(_MSC_VER)
+# define ALWAYS_INLINE      __forceinline
+#else
+# define ALWAYS_INLINE      inline __attribute__((always_inline))
+#endif
+
+// Attributes of a sprite decoded from OAM
+typedef struct {
+    int16_t x, y; // Top left corner
+    uint8_t w, h; // Size of the canvas (bigger than the sprite if double size)
+    uint8_t sx, sy; // Size of the sprite
+    uint8_t affine;
+    uint8_t mode;
+    uint8_t prio;
+    uint8_t mosaic;
+    uint8_t colors_256;
+    uint8_t palno;
+    uint8_t hflip, vflip; // Regular sprites only
+    uint16_t tilebaseno; // Already divided by 2 in 256 color sprites
+    int16_t pa, pb, pc, pd; // Affine sprites only
+} video_sprite;
+
+// State of the hardware that is used to draw a scanline. When the scanline is
+// drawn right away the addresses point to the real registers and memory. When
+// it is drawn later they point to copies taken when the scanline was reached.
+typedef struct {
+    int32_t y;
+    uint16_t *screen; // Screen buffer to draw to
+    const uint16_t *screen_prev; // Screen buffer of the previous frame
+    uint8_t *dirty; // Set to 1 if the scanline changes from the previous frame
+
+    uintptr_t io_addr;
+    uintptr_t palette_addr;
+
+    // Sprites that are displayed in this scanline, sorted by priority
+    const video_sprite *sprite_table;
+    const uint8_t *sprite_list; // Indices in sprite_table
+    int sprite_num;
+
+    // Internal registers of BG2 and BG3 at the start of the scanline. In
+    // affine modes the mosaic effect has already been applied to them.
+    int32_t bg2x, bg2y, bg2pa, bg2pc;
+    int32_t bg3x, bg3y, bg3pa, bg3pc;
+
+    uint16_t io_copy[VIDEO_IO_SIZE / 2];
+    uint16_t palette_copy[MEM_PALETTE_SIZE / 2];
+} video_line;
+
+typedef enum
+{
+    BG0 = 0,
+    BG1,
+    BG2,
+    BG3,
+
+    SPR0,
+    SPR1,
+    SPR2,
+    SPR3,
 
-typedef void (*draw_scanline_fn)(int32_t);
-static draw_scanline_fn DrawScanlineFn;
+    BD
+} _layer_type_;
 
-static void GBA_DrawScanlineMode0(int32_t y);
-static void GBA_DrawScanlineMode1(int32_t y);
-static void GBA_DrawScanlineMode2(int32_t y);
-static void GBA_DrawScanlineMode3(int32_t y);
-static void GBA_DrawScanlineMode4(int32_t y);
-static void GBA_DrawScanlineMode5(int32_t y);
-static void GBA_DrawScanlineMode67(int32_t y);
+// Horizontal run of pixels of a scanline that is affected in the same way by the
+// windows. The enable masks use the format of WININ and WINOUT: bits 0-3 for
+// BG0-BG3, bit 4 for sprites and bit 5 for color effects. Outside of WIN0 and
+// WIN1 the OBJ window can enable a different set of layers, "enable_obj" is
+// used instead of "enable" for the pixels of sprites in OBJ window mode.
+typedef struct {
+    int x1, x2;
+    uint8_t enable;
+    uint8_t enable_obj;
+} window_span;
+
+// Buffers used while drawing a scanline. Each thread that draws scanlines needs
+// its own copy.
+typedef struct {
+    const video_line *line; // Scanline being drawn
+
+    int32_t MosSprX, MosSprY, MosBgX, MosBgY;
+    uint32_t Win0X1, Win0X2, Win0Y1, Win0Y2;
+    uint32_t Win1X1, Win1X2, Win1Y1, Win1Y2;
+
+    // There are at most 5 spans: WIN0 and WIN1 can split the scanline in 5
+    // parts, and the OBJ window is handled per pixel inside the spans.
+    window_span win_span[5];
+    int win_span_num;
+
+    uint16_t bgfb[4][240];
+    uint8_t bgvisible[4][240];
+    uint16_t backdrop[240];
+    uint8_t backdropvisible[240]; // This array is filled in gba_renderer_init()
+
+    uint16_t sprfb[4][240];
+    uint8_t sprvisible[4][240];
+    uint8_t sprwin[240];
+    uint8_t sprblend[4][240]; // This sprite pixel is in blending mode
+
+    // Range of columns of the sprite buffers that may have been modified since
+    // they were last cleared. It is empty if spr_x_min >= spr_x_max.
+    int spr_x_min, spr_x_max;
+
+    // Color effect is enabled / disabled by windows
+    uint8_t win_coloreffect_enable[240];
+
+    // layer_fb[0] goes at the bottom, layer_fb[layer_active_num - 1] at the top
+    uint8_t *layer_vis[9];
+    uint16_t *layer_fb[9];
+    _layer_type_ layer_id[9];
+    int layer_active_num;
+} video_renderer;
+
+// Read a register from the state of the scanline being drawn
+#define LINE_REG_16(ctx, r) *((uint16_t *)((ctx)->line->io_addr + (r)))
+
+static void GBA_DrawScanlineMode0(video_renderer *ctx, int32_t y);
+static void GBA_DrawScanlineMode1(video_renderer *ctx, int32_t y);
+static void GBA_DrawScanlineMode2(video_renderer *ctx, int32_t y);
+static void GBA_DrawScanlineMode3(video_renderer *ctx, int32_t y);
+static void GBA_DrawScanlineMode4(video_renderer *ctx, int32_t y);
+static void GBA_DrawScanlineMode5(video_renderer *ctx, int32_t y);
+static void GBA_DrawScanlineMode67(video_renderer *ctx, int32_t y);
 void GBA_DrawScanlineWhite(int32_t y);
 
-static int32_t BG2lastx, BG2lasty; // For affine transformation
-static int32_t BG3lastx, BG3lasty;
+// State of the video hardware of a context
+struct gba_video_state {
+    int curr_screen_buffer;
+    uint16_t screen_buffer_array[2][240 * 160]; // Doble buffer
+    uint16_t *screen_buffer;
 
-static int32_t MosSprX, MosSprY, MosBgX, MosBgY;
-static uint32_t Win0X1, Win0X2, Win0Y1, Win0Y2;
-static uint32_t Win1X1, Win1X2, Win1Y1, Win1Y2;
+    // 1 if the scanline is different from the same scanline of the previous
+    // frame
+    uint8_t screen_dirty_array[2][160];
 
-//-----------------------------------------------------------
+    int32_t BG2lastx, BG2lasty; // For affine transformation
+    int32_t BG3lastx, BG3lasty;
+
+    int32_t mosBG2lastx, mosBG2lasty, mos2A, mos2C;
+    int32_t mosBG3lastx, mosBG3lasty, mos3A, mos3C;
+
+    video_line video_lines[160];
+    video_renderer video_renderer_main;
+
+    int video_lines_pending; // Lines saved but not drawn yet
+
+    // In multithreaded mode, the scanlines that are waiting to be drawn keep
+    // using the table that was current when they were saved, so every time OAM
+    // changes a new table is used. OAM can change at most once per scanline.
+    video_sprite video_sprite_tables[160][128];
+    int video_sprite_tables_used;
+    const video_sprite *video_sprite_table;
+
+    uint8_t video_sprite_bins[160][128];
+    uint8_t video_sprite_bins_num[160];
+
+    // Copy of OAM used to build the current lists
+    uint16_t video_sprite_oam[MEM_OAM_SIZE / 2];
+};
+
+gba_video_state gba_video_state_default = {
+    .screen_buffer = gba_video_state_default.screen_buffer_array[0],
+};
+
+static void gba_renderer_init(video_renderer *ctx);
+
+gba_video_state *GBA_VideoStateCreate(void)
+{
+    gba_video_state *state = calloc(1, sizeof(gba_video_state));
+    if (state == NULL)
+        return NULL;
+
+    state->screen_buffer = state->screen_buffer_array[0];
+    gba_renderer_init(&state->video_renderer_main);
+
+    return state;
+}
 
-static void mem_clear_32(uint32_t *ptr, uint32_t size)
+void GBA_VideoStateDestroy(gba_video_state *state)
 {
-    size >>= 2;
-    while (size--)
-        *ptr++ = 0;
+    free(state);
 }
 
+// The code below accesses the state of the current context with these names
+
+#define curr_screen_buffer          (GBA_Context()->video->curr_screen_buffer)
+#define screen_buffer_array         (GBA_Context()->video->screen_buffer_array)
+#define screen_buffer               (GBA_Context()->video->screen_buffer)
+#define screen_dirty_array          (GBA_Context()->video->screen_dirty_array)
+
+#define BG2lastx                    (GBA_Context()->video->BG2lastx)
+#define BG2lasty                    (GBA_Context()->video->BG2lasty)
+#define BG3lastx                    (GBA_Context()->video->BG3lastx)
+#define BG3lasty                    (GBA_Context()->video->BG3lasty)
+
+#define mosBG2lastx                 (GBA_Context()->video->mosBG2lastx)
+#define mosBG2lasty                 (GBA_Context()->video->mosBG2lasty)
+#define mos2A                       (GBA_Context()->video->mos2A)
+#define mos2C                       (GBA_Context()->video->mos2C)
+#define mosBG3lastx                 (GBA_Context()->video->mosBG3lastx)
+#define mosBG3lasty                 (GBA_Context()->video->mosBG3lasty)
+#define mos3A                       (GBA_Context()->video->mos3A)
+#define mos3C                       (GBA_Context()->video->mos3C)
+
+#define video_lines                 (GBA_Context()->video->video_lines)
+#define video_renderer_main         (GBA_Context()->video->video_renderer_main)
+#define video_lines_pending         (GBA_Context()->video->video_lines_pending)
+
+#define video_sprite_tables         (GBA_Context()->video->video_sprite_tables)
+#define video_sprite_tables_used    (GBA_Context()->video->video_sprite_tables_used)
+#define video_sprite_table          (GBA_Context()->video->video_sprite_table)
+#define video_sprite_bins           (GBA_Context()->video->video_sprite_bins)
+#define video_sprite_bins_num       (GBA_Context()->video->video_sprite_bins_num)
+#define video_sprite_oam            (GBA_Context()->video->video_sprite_oam)
+
 //-----------------------------------------------------------
 
-void GBA_UpdateDrawScanlineFn(void)
+static void gba_renderer_init(video_renderer *ctx)
+{
+    // Backdrop is always visible
+    for (int i = 0; i < 240; i++)
+    {
+        ctx->backdropvisible[i] = 1;
+        ctx->win_coloreffect_enable[i] = 1;
+    }
+
+    // The buffers haven't been initialized, they need to be cleared before
+    // drawing the first scanline.
+    ctx->spr_x_min = 0;
+    ctx->spr_x_max = 240;
+}
+
+void GBA_FillFadeTables(void)
+{
+    gba_renderer_init(&video_renderer_main);
+}
+
+void GBA_VideoStateSave(gba_state *s)
+{
+    int32_t affine[12] = {
+        BG2lastx, BG2lasty, BG3lastx, BG3lasty,
+        mosBG2lastx, mosBG2lasty, mos2A, mos2C,
+        mosBG3lastx, mosBG3lasty, mos3A, mos3C
+    };
+
+    GBA_StateWrite(s, GBA_STATE_TAG('A', 'F', 'F', 'N'),
+                   affine, sizeof(affine));
+}
+
+void GBA_VideoStateLoad(gba_state *s)
 {
-    uint32_t mode = REG_DISPCNT & 0x7;
+    int32_t affine[12];
+
+    if (GBA_StateRead(s, GBA_STATE_TAG('A', 'F', 'F', 'N'),
+                      affine, sizeof(affine)) != 0)
+    {
+        return;
+    }
+
+    BG2lastx = affine[0];
+    BG2lasty = affine[1];
+    BG3lastx = affine[2];
+    BG3lasty = affine[3];
+
+    mosBG2lastx = affine[4];
+    mosBG2lasty = affine[5];
+    mos2A = affine[6];
+    mos2C = affine[7];
+
+    mosBG3lastx = affine[8];
+    mosBG3lasty = affine[9];
+    mos3A = affine[10];
+    mos3C = affine[11];
+}
+
+static void gba_window_spans_build(video_renderer *ctx, uint32_t y)
+{
+    uint16_t dispcnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
+
+    window_span *span = ctx->win_span;
+
+    if ((dispcnt & (BIT(13) | BIT(14) | BIT(15))) == 0)
+    {
+        // Everything is enabled if there are no windows
+        span[0].x1 = 0;
+        span[0].x2 = 240;
+        span[0].enable = 0x3F;
+        span[0].enable_obj = 0x3F;
+        ctx->win_span_num = 1;
+        return;
+    }
+
+    uint8_t in0 = LINE_REG_16(ctx, OFFSET_WININ) & 0x3F;
+    uint8_t in1 = (LINE_REG_16(ctx, OFFSET_WININ) >> 8) & 0x3F;
+    uint8_t out = LINE_REG_16(ctx, OFFSET_WINOUT) & 0x3F;
+    uint8_t inobj = (LINE_REG_16(ctx, OFFSET_WINOUT) >> 8) & 0x3F;
+
+    // The OBJ window has the lowest priority, it only affects pixels outside of
+    // WIN0 and WIN1.
+    uint8_t out_obj = (dispcnt & BIT(15)) ? inobj : out;
+
+    int win0 = (dispcnt & BIT(13)) && (y >= ctx->Win0Y1) && (y <= ctx->Win0Y2);
+    int win1 = (dispcnt & BIT(14)) && (y >= ctx->Win1Y1) && (y <= ctx->Win1Y2);
+
+    // Split the scanline at the edges of the windows
+
+    int edge[6];
+    int num_edges = 0;
+
+    edge[num_edges++] = 0;
+    edge[num_edges++] = 240;
+    if (win0)
+    {
+        edge[num_edges++] = ctx->Win0X1;
+        edge[num_edges++] = ctx->Win0X2;
+    }
+    if (win1)
+    {
+        edge[num_edges++] = ctx->Win1X1;
+        edge[num_edges++] = ctx->Win1X2;
+    }
+
+    for (int i = 1; i < num_edges; i++)
+    {
+        int value = edge[i];
+        int j = i - 1;
+        for ( ; (j >= 0) && (edge[j] > value); j--)
+            edge[j + 1] = edge[j];
+        edge[j + 1] = value;
+    }
+
+    int num = 0;
+
+    for (int i = 0; i < num_edges - 1; i++)
+    {
+        int x1 = edge[i];
+        int x2 = edge[i + 1];
+
+        if (x1 == x2)
+            continue;
+
+        uint8_t enable, enable_obj;
+
+        // WIN0 has the highest priority
+        if (win0 && (x1 >= (int)ctx->Win0X1) && (x1 < (int)ctx->Win0X2))
+        {
+            enable = in0;
+            enable_obj = in0;
+        }
+        else if (win1 && (x1 >= (int)ctx->Win1X1) && (x1 < (int)ctx->Win1X2))
+        {
+            enable = in1;
+            enable_obj = in1;
+        }
+        else
+        {
+            enable = out;
+            enable_obj = out_obj;
+        }
+
+        if ((num > 0) && (span[num - 1].enable == enable)
+            && (span[num - 1].enable_obj == enable_obj))
+        {
+            span[num - 1].x2 = x2;
+            continue;
+        }
+
+        span[num].x1 = x1;
+        span[num].x2 = x2;
+        span[num].enable = enable;
+        span[num].enable_obj = enable_obj;
+        num++;
+    }
+
+    ctx->win_span_num = num;
+}
+
+static void gba_draw_line(video_renderer *ctx, const video_line *line)
+{
+    ctx->line = line;
+
+    int32_t y = line->y;
+
+    // Fetch values of some registers
+
+    // WIN0H
+    ctx->Win0X1 = (LINE_REG_16(ctx, OFFSET_WIN0H) >> 8) & 0xFF;
+    ctx->Win0X2 = LINE_REG_16(ctx, OFFSET_WIN0H) & 0xFF;
+    if (ctx->Win0X2 > 240)
+        ctx->Win0X2 = 240;
+    if (ctx->Win0X1 > ctx->Win0X2)
+        ctx->Win0X2 = 240; // Real bounds
+    if (ctx->Win0X1 > 240)
+        ctx->Win0X1 = 240;
+
+    // WIN0V
+    ctx->Win0Y1 = (LINE_REG_16(ctx, OFFSET_WIN0V) >> 8) & 0xFF;
+    ctx->Win0Y2 = LINE_REG_16(ctx, OFFSET_WIN0V) & 0xFF;
+    if (ctx->Win0Y2 > 160)
+        ctx->Win0Y2 = 160;
+    if (ctx->Win0Y1 > ctx->Win0Y2)
+        ctx->Win0X2 = 160; // Real bounds
+    if (ctx->Win0Y1 > 160)
+        ctx->Win0Y1 = 160;
+
+    // WIN1H
+    ctx->Win1X1 = (LINE_REG_16(ctx, OFFSET_WIN1H) >> 8) & 0xFF;
+    ctx->Win1X2 = LINE_REG_16(ctx, OFFSET_WIN1H) & 0xFF;
+    if (ctx->Win1X2 > 240)
+        ctx->Win1X2 = 240;
+    if (ctx->Win1X1 > ctx->Win1X2)
+        ctx->Win1X2 = 240; // Real bounds
+    if (ctx->Win1X1 > 240)
+        ctx->Win1X1 = 240;
+
+    // WIN1V
+    ctx->Win1Y1 = (LINE_REG_16(ctx, OFFSET_WIN1V) >> 8) & 0xFF;
+    ctx->Win1Y2 = LINE_REG_16(ctx, OFFSET_WIN1V) & 0xFF;
+    if (ctx->Win1Y2 > 160)
+        ctx->Win1Y2 = 160;
+    if (ctx->Win1Y1 > ctx->Win1Y2)
+        ctx->Win1X2 = 160; // Real bounds
+    if (ctx->Win1Y1 > 160)
+        ctx->Win1Y1 = 160;
+
+    // MOSAIC
+    int mos = LINE_REG_16(ctx, OFFSET_MOSAIC);
+    ctx->MosBgX = (mos & 0xF) + 1;
+    ctx->MosBgY = ((mos >> 4) & 0xF) + 1;
+    ctx->MosSprX = ((mos >> 8) & 0xF) + 1;
+    ctx->MosSprY = ((mos >> 12) & 0xF) + 1;
+
+    gba_window_spans_build(ctx, y);
+
+    // Draw scanline
+    uint32_t mode = LINE_REG_16(ctx, OFFSET_DISPCNT) & 0x7;
 
     switch (mode)
     {
         case 0:
-            DrawScanlineFn = &GBA_DrawScanlineMode0;
+            GBA_DrawScanlineMode0(ctx, y);
             break;
         case 1:
-            DrawScanlineFn = &GBA_DrawScanlineMode1;
+            GBA_DrawScanlineMode1(ctx, y);
             break;
         case 2:
-            DrawScanlineFn = &GBA_DrawScanlineMode2;
+            GBA_DrawScanlineMode2(ctx, y);
             break;
         case 3:
-            DrawScanlineFn = &GBA_DrawScanlineMode3;
+            GBA_DrawScanlineMode3(ctx, y);
             break;
         case 4:
-            DrawScanlineFn = &GBA_DrawScanlineMode4;
+            GBA_DrawScanlineMode4(ctx, y);
             break;
         case 5:
-            DrawScanlineFn = &GBA_DrawScanlineMode5;
+            GBA_DrawScanlineMode5(ctx, y);
             break;
         case 6:
         case 7:
         default:
             // TODO: Check how this works in real hardware
-            DrawScanlineFn = &GBA_DrawScanlineMode67;
+            GBA_DrawScanlineMode67(ctx, y);
             break;
     }
+
+    *line->dirty = memcmp(&line->screen[240 * y], &line->screen_prev[240 * y],
+                          240 * sizeof(uint16_t)) != 0;
 }
 
-void GBA_DrawScanline(int y)
+//-----------------------------------------------------------
+
+// Multithreaded drawing
+// =====================
+//
+// In multithreaded mode the thread of the game only saves the state of each
+// scanline when it is reached. At the start of the VBL period all scanlines are
+// drawn in parallel by the thread of the game and a pool of worker threads.
+// VRAM isn't saved, so all scanlines see the contents of VRAM at the end of the
+// frame.
+
+#define VIDEO_MAX_THREADS   16
+
+static int video_threads_num; // Number of worker threads (0 = disabled)
+static SDL_Thread *video_threads[VIDEO_MAX_THREADS];
+static video_renderer *video_threads_renderer[VIDEO_MAX_THREADS];
+static SDL_sem *video_threads_start;
+static SDL_sem *video_threads_done;
+static SDL_atomic_t video_threads_next_line;
+static int video_threads_exit;
+
+// Only the default context uses the worker threads. The scanlines of other
+// contexts are drawn as soon as they are reached.
+static int gba_video_threads_enabled(void)
 {
-    GBA_UpdateDrawScanlineFn();
+    return (video_threads_num > 0) && GBA_ContextIsDefault();
+}
 
+static void gba_draw_pending_lines(video_renderer *ctx)
+{
+    while (1)
+    {
+        int y = SDL_AtomicAdd(&video_threads_next_line, 1);
+        if (y >= video_lines_pending)
+            break;
+
+        gba_draw_line(ctx, &video_lines[y]);
+    }
+}
+
+static int gba_video_thread(void *data)
+{
+    video_renderer *ctx = data;
+
+    while (1)
+    {
+        SDL_SemWait(video_threads_start);
+
+        if (video_threads_exit)
+            break;
+
+        gba_draw_pending_lines(ctx);
+
+        SDL_SemPost(video_threads_done);
+    }
+
+    return 0;
+}
+
+void GBA_VideoThreadsEnd(void)
+{
+    if (video_threads_num == 0)
+        return;
+
+    video_threads_exit = 1;
+
+    for (int i = 0; i < video_threads_num; i++)
+        SDL_SemPost(video_threads_start);
+
+    for (int i = 0; i < video_threads_num; i++)
+    {
+        SDL_WaitThread(video_threads[i], NULL);
+        free(video_threads_renderer[i]);
+    }
+
+    SDL_DestroySemaphore(video_threads_start);
+    SDL_DestroySemaphore(video_threads_done);
+
+    video_threads_num = 0;
+    video_threads_exit = 0;
+    video_lines_pending = 0;
+}
+
+void GBA_VideoThreadsInit(int num_threads)
+{
+    GBA_VideoThreadsEnd();
+
+    if (num_threads == 0)
+        num_threads = SDL_GetCPUCount();
+
+    // The thread of the game also draws scanlines
+    int num_workers = num_threads - 1;
+    if (num_workers <= 0)
+        return;
+    if (num_workers > VIDEO_MAX_THREADS)
+        num_workers = VIDEO_MAX_THREADS;
+
+    video_threads_start = SDL_CreateSemaphore(0);
+    video_threads_done = SDL_CreateSemaphore(0);
+    if ((video_threads_start == NULL) || (video_threads_done == NULL))
+    {
+        Debug_Log("%s: SDL_CreateSemaphore(): %s", __func__, SDL_GetError());
+        SDL_DestroySemaphore(video_threads_start);
+        SDL_DestroySemaphore(video_threads_done);
+        return;
+    }
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        video_renderer *ctx = malloc(sizeof(video_renderer));
+        if (ctx == NULL)
+        {
+            Debug_Log("%s: Not enough memory", __func__);
+            break;
+        }
+
+        gba_renderer_init(ctx);
+
+        SDL_Thread *thread = SDL_CreateThread(gba_video_thread, "Video", ctx);
+        if (thread == NULL)
+        {
+            Debug_Log("%s: SDL_CreateThread(): %s", __func__, SDL_GetError());
+            free(ctx);
+            break;
+        }
+
+        video_threads[video_threads_num] = thread;
+        video_threads_renderer[video_threads_num] = ctx;
+        video_threads_num++;
+    }
+
+    if (video_threads_num == 0)
+    {
+        SDL_DestroySemaphore(video_threads_start);
+        SDL_DestroySemaphore(video_threads_done);
+    }
+}
+
+void GBA_DrawFrameFinish(void)
+{
+    if (video_lines_pending == 0)
+        return;
+
+    // Make sure that the worker threads only need to read the tile cache
+    GBA_TileCacheCheckChanges();
+    GBA_TileCacheUpdate();
+
+    SDL_AtomicSet(&video_threads_next_line, 0);
+
+    for (int i = 0; i < video_threads_num; i++)
+        SDL_SemPost(video_threads_start);
+
+    gba_draw_pending_lines(&video_renderer_main);
+
+    for (int i = 0; i < video_threads_num; i++)
+        SDL_SemWait(video_threads_done);
+
+    video_lines_pending = 0;
+}
+
+//-----------------------------------------------------------
+
+// Sprite binning
+// ==============
+//
+// Instead of checking all the entries of OAM in each scanline, the attributes
+// of all sprites are decoded once and each sprite is added to the list of the
+// scanlines it covers. This is done at the start of the frame, and again
+// whenever OAM is modified during the frame. The lists are sorted by priority.
+// Sprites with the same priority keep their OAM order.
+
+static const int spr_size[4][4][2] = { // Inputs = [Shape][Size][{x, y}]
+    { { 8, 8 }, { 16, 16 }, { 32, 32 }, { 64, 64 } }, // Square
+    { { 16, 8 }, { 32, 8 }, { 32, 16 }, { 64, 32 } }, // Horizontal
+    { { 8, 16 }, { 8, 32 }, { 16, 32 }, { 32, 64 } }, // Vertical
+    { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } }        // Prohibited
+};
+
+// Returns 1 if the sprite is displayed, 0 if not
+static int gba_sprite_decode(video_sprite *s, const oam_entry *spr,
+                             const oam_matrix_entry *matrices)
+{
+    uint16_t attr0 = spr->attr0;
+    uint16_t attr1 = spr->attr1;
+    uint16_t attr2 = spr->attr2;
+
+    s->affine = (attr0 & BIT(8)) ? 1 : 0;
+
+    if (!s->affine && (attr0 & BIT(9))) // Disabled
+        return 0;
+
+    s->mode = (attr0 >> 10) & 3;
+    if (s->mode == 3) // Prohibited
+        return 0;
+
+    uint16_t shape = attr0 >> 14;
+    uint16_t size = attr1 >> 14;
+    s->sx = spr_size[shape][size][0];
+    s->sy = spr_size[shape][size][1];
+    if (s->sx == 0) // Prohibited shape
+        return 0;
+
+    int y = (attr0 & 0xFF);
+    y |= (y < 160) ? 0 : 0xFFFFFF00;
+    int x = (int)(attr1 & 0x1FF) | ((attr1 & BIT(8)) ? 0xFFFFFE00 : 0);
+
+    s->x = x;
+    s->y = y;
+
+    if (s->affine && (attr0 & BIT(9))) // Double size
+    {
+        s->w = s->sx << 1;
+        s->h = s->sy << 1;
+    }
+    else
+    {
+        s->w = s->sx;
+        s->h = s->sy;
+    }
+
+    s->prio = (attr2 >> 10) & 3;
+    s->mosaic = (attr0 & BIT(12)) ? 1 : 0;
+    s->colors_256 = (attr0 & BIT(13)) ? 1 : 0;
+    s->palno = attr2 >> 12;
+
+    s->tilebaseno = attr2 & 0x3FF;
+    if (s->colors_256)
+        s->tilebaseno >>= 1; // In 256 mode, they need double space
+
+    if (s->affine)
+    {
+        const oam_matrix_entry *mat = &matrices[(attr1 >> 9) & 0x1F];
+
+        s->hflip = 0;
+        s->vflip = 0;
+        s->pa = mat->pa;
+        s->pb = mat->pb;
+        s->pc = mat->pc;
+        s->pd = mat->pd;
+    }
+    else
+    {
+        s->hflip = (attr1 & BIT(12)) ? 1 : 0;
+        s->vflip = (attr1 & BIT(13)) ? 1 : 0;
+    }
+
+    return 1;
+}
+
+// Build the lists of sprites of all scanlines starting from first_line
+static void gba_sprites_bin(int first_line)
+{
+    const void *oam = (const void *)MEM_OAM_ADDR;
+
+    memcpy(video_sprite_oam, oam, sizeof(video_sprite_oam));
+
+    video_sprite *table = video_sprite_tables[0];
+    if (gba_video_threads_enabled())
+        table = video_sprite_tables[video_sprite_tables_used++];
+
+    uint8_t displayed[128];
+    for (int i = 0; i < 128; i++)
+    {
+        displayed[i] = gba_sprite_decode(&table[i], &((const oam_entry *)oam)[i],
+                                         (const oam_matrix_entry *)oam);
+    }
+
+    for (int l = first_line; l < 160; l++)
+        video_sprite_bins_num[l] = 0;
+
+    for (int prio = 0; prio < 4; prio++)
+    {
+        for (int i = 0; i < 128; i++)
+        {
+            const video_sprite *s = &table[i];
+
+            if (!displayed[i] || (s->prio != prio))
+                continue;
+
+            int start = (s->y > first_line) ? s->y : first_line;
+            int end = s->y + s->h;
+            if (end > 160)
+                end = 160;
+
+            for (int l = start; l < end; l++)
+                video_sprite_bins[l][video_sprite_bins_num[l]++] = i;
+        }
+    }
+
+    video_sprite_table = table;
+}
+
+static void gba_line_save_sprites(video_line *line, int y)
+{
+    if (y == 0)
+    {
+        video_sprite_tables_used = 0;
+        gba_sprites_bin(0);
+    }
+    else if (memcmp(video_sprite_oam, (const void *)MEM_OAM_ADDR,
+                    sizeof(video_sprite_oam)) != 0)
+    {
+        gba_sprites_bin(y);
+    }
+
+    // The lists of previous scanlines aren't modified until the next frame, so
+    // it isn't needed to copy them.
+    line->sprite_table = video_sprite_table;
+    line->sprite_list = video_sprite_bins[y];
+    line->sprite_num = video_sprite_bins_num[y];
+}
+
+//-----------------------------------------------------------
+
+// Save the state of the affine backgrounds for this scanline
+static void gba_line_save_affine(video_line *line, int y)
+{
+    uint16_t dispcnt = REG_DISPCNT;
+    uint32_t mode = dispcnt & 0x7;
+    int32_t mos_y = ((REG_MOSAIC >> 4) & 0xF) + 1;
+
+    line->bg2x = BG2lastx;
+    line->bg2y = BG2lasty;
+    line->bg2pa = (int32_t)(int16_t)REG_BG2PA;
+    line->bg2pc = (int32_t)(int16_t)REG_BG2PC;
+
+    line->bg3x = BG3lastx;
+    line->bg3y = BG3lasty;
+    line->bg3pa = (int32_t)(int16_t)REG_BG3PA;
+    line->bg3pc = (int32_t)(int16_t)REG_BG3PC;
+
+    // With vertical mosaic, affine backgrounds repeat the first scanline of
+    // each mosaic block. Bitmap modes ignore the mosaic.
+
+    if (((mode == 1) || (mode == 2)) && (dispcnt & BIT(10))
+        && (REG_BG2CNT & BIT(6)))
+    {
+        if (y % mos_y == 0)
+        {
+            mosBG2lastx = line->bg2x;
+            mosBG2lasty = line->bg2y;
+            mos2A = line->bg2pa;
+            mos2C = line->bg2pc;
+        }
+        else
+        {
+            line->bg2x = mosBG2lastx;
+            line->bg2y = mosBG2lasty;
+            line->bg2pa = mos2A;
+            line->bg2pc = mos2C;
+        }
+    }
+
+    if ((mode == 2) && (dispcnt & BIT(11)) && (REG_BG3CNT & BIT(6)))
+    {
+        if (y % mos_y == 0)
+        {
+            mosBG3lastx = line->bg3x;
+            mosBG3lasty = line->bg3y;
+            mos3A = line->bg3pa;
+            mos3C = line->bg3pc;
+        }
+        else
+        {
+            line->bg3x = mosBG3lastx;
+            line->bg3y = mosBG3lasty;
+            line->bg3pa = mos3A;
+            line->bg3pc = mos3C;
+        }
+    }
+}
+
+void GBA_DrawScanline(int y)
+{
     if (y == 0)
     {
         curr_screen_buffer ^= 1;
@@ -101,59 +883,40 @@ void GBA_DrawScanline(int y)
         BG3lasty = REG_BG3Y;
         if (BG3lasty & BIT(27))
             BG3lasty |= 0xF0000000;
+
+        // Look for tiles modified without using the functions of the library
+        if (!gba_video_threads_enabled())
+            GBA_TileCacheCheckChanges();
     }
 
-    // Fetch values of some registers
+    video_line *line = &video_lines[y];
 
-    // WIN0H
-    Win0X1 = (REG_WIN0H >> 8) & 0xFF;
-    Win0X2 = REG_WIN0H & 0xFF;
-    if (Win0X2 > 240)
-        Win0X2 = 240;
-    if (Win0X1 > Win0X2)
-        Win0X2 = 240; // Real bounds
-    if (Win0X1 > 240)
-        Win0X1 = 240;
+    line->y = y;
+    line->screen = screen_buffer;
+    line->screen_prev = screen_buffer_array[curr_screen_buffer ^ 1];
+    line->dirty = &screen_dirty_array[curr_screen_buffer][y];
 
-    // WIN0V
-    Win0Y1 = (REG_WIN0V >> 8) & 0xFF;
-    Win0Y2 = REG_WIN0V & 0xFF;
-    if (Win0Y2 > 160)
-        Win0Y2 = 160;
-    if (Win0Y1 > Win0Y2)
-        Win0X2 = 160; // Real bounds
-    if (Win0Y1 > 160)
-        Win0Y1 = 160;
+    gba_line_save_affine(line, y);
+    gba_line_save_sprites(line, y);
 
-    // WIN1H
-    Win1X1 = (REG_WIN1H >> 8) & 0xFF;
-    Win1X2 = REG_WIN1H & 0xFF;
-    if (Win1X2 > 240)
-        Win1X2 = 240;
-    if (Win1X1 > Win1X2)
-        Win1X2 = 240; // Real bounds
-    if (Win1X1 > 240)
-        Win1X1 = 240;
+    if (!gba_video_threads_enabled())
+    {
+        line->io_addr = MEM_IO_ADDR;
+        line->palette_addr = MEM_PALETTE_ADDR;
 
-    // WIN1V
-    Win1Y1 = (REG_WIN1V >> 8) & 0xFF;
-    Win1Y2 = REG_WIN1V & 0xFF;
-    if (Win1Y2 > 160)
-        Win1Y2 = 160;
-    if (Win1Y1 > Win1Y2)
-        Win1X2 = 160; // Real bounds
-    if (Win1Y1 > 160)
-        Win1Y1 = 160;
+        gba_draw_line(&video_renderer_main, line);
+    }
+    else
+    {
+        memcpy(line->io_copy, (void *)MEM_IO_ADDR, sizeof(line->io_copy));
+        memcpy(line->palette_copy, (void *)MEM_PALETTE_ADDR,
+               sizeof(line->palette_copy));
 
-    // MOSAIC
-    int mos = REG_MOSAIC;
-    MosBgX = (mos & 0xF) + 1;
-    MosBgY = ((mos >> 4) & 0xF) + 1;
-    MosSprX = ((mos >> 8) & 0xF) + 1;
-    MosSprY = ((mos >> 12) & 0xF) + 1;
+        line->io_addr = (uintptr_t)line->io_copy;
+        line->palette_addr = (uintptr_t)line->palette_copy;
 
-    // Draw scanline
-    DrawScanlineFn(y);
+        video_lines_pending = y + 1;
+    }
 
     // Update values of the affine matrices internal registers
     BG2lastx += (int32_t)(int16_t)REG_BG2PB;
@@ -174,785 +937,186 @@ void GBA_DrawScanlineWhite(int y)
 
     for (int i = 0; i < 240 / 2; i++)
         *destptr++ = 0x7FFF7FFF;
+
+    screen_dirty_array[curr_screen_buffer][y] =
+            memcmp(&screen_buffer[240 * y],
+                   &screen_buffer_array[curr_screen_buffer ^ 1][240 * y],
+                   240 * sizeof(uint16_t)) != 0;
 }
 
 //------------------------------------------------------------------------------
 //
-uint16_t sprfb[4][240];
-int sprvisible[4][240];
-int sprwin[240];
-int sprblend[4][240];   // This sprite pixel is in blending mode
-uint16_t sprblendfb[4][240]; // One line for each sprite priority
-
-static const int spr_size[4][4][2] = { // Inputs = [Shape][Size][{x, y}]
-    { { 8, 8 }, { 16, 16 }, { 32, 32 }, { 64, 64 } }, // Square
-    { { 16, 8 }, { 32, 8 }, { 32, 16 }, { 64, 32 } }, // Horizontal
-    { { 8, 16 }, { 8, 32 }, { 16, 32 }, { 32, 64 } }, // Vertical
-    { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } }        // Prohibited
-};
 
-static void gba_sprites_draw_mode012(int32_t ly)
+static inline void gba_sprite_pixel_put(video_renderer *ctx,
+                                        const video_sprite *s, int j,
+                                        uint16_t color)
 {
-    oam_entry *spr = (oam_entry *)((uint8_t *)MEM_OAM_ADDR);
+    int prio = s->prio;
 
-    for (int i = 0; i < 128; i++)
+    if (s->mode == 0)
     {
-        uint16_t attr0 = spr->attr0;
-
-        if (attr0 & BIT(8)) // Affine sprite -- No H flip or V flip
-        {
-            int mosaic = attr0 & BIT(12);
+        ctx->sprfb[prio][j] = color;
+        ctx->sprvisible[prio][j] = 1;
+    }
+    else if (s->mode == 1) // Transp
+    {
+        ctx->sprblend[prio][j] = 1;
+        ctx->sprfb[prio][j] = color;
+        ctx->sprvisible[prio][j] = 1;
+    }
+    else // if (s->mode == 2) // 3 = prohibited, not added to the lists
+    {
+        ctx->sprwin[j] = 1;
+    }
+}
 
-            uint16_t attr1 = spr->attr1;
-            uint16_t attr2 = spr->attr2;
+// Returns the palette index of a pixel of the sprite, or 0 if it's transparent
+static inline uint8_t gba_sprite_texel(const video_sprite *s,
+                                       uint32_t px, uint32_t py,
+                                       uint32_t tiles_per_row,
+                                       uint32_t min_tile)
+{
+    uint32_t tileindex = s->tilebaseno + (px >> 3) + ((py >> 3) * tiles_per_row);
 
-            oam_matrix_entry *mat =
-                    &(((oam_matrix_entry *)((uint8_t *)MEM_OAM_ADDR))[(attr1 >> 9) & 0x1F]);
+    int _x = px & 7;
+    int _y = py & 7;
 
-            uint16_t shape = attr0 >> 14;
-            uint16_t size = attr1 >> 14;
-            uint32_t hsx = spr_size[shape][size][0] >> 1; // Half size
-            uint32_t hsy = spr_size[shape][size][1] >> 1;
+    if (s->colors_256)
+    {
+        // Each tile needs double space
+        if (tileindex < (min_tile >> 1))
+            return 0;
 
-            int y = (attr0 & 0xFF);
-            y |= (y < 160) ? 0 : 0xFFFFFF00;
-            int x = (int)(attr1 & 0x1FF) | ((attr1 & BIT(8)) ? 0xFFFFFE00 : 0);
+        const uint8_t *tile_ptr =
+                &(((uint8_t *)MEM_VRAM_ADDR)[0x10000 + (tileindex * 64)]);
 
-            // Is double size?
-            int hrealsx = (attr0 & BIT(9)) ? hsx << 1 : hsx; // Half canvas size
-            int hrealsy = (attr0 & BIT(9)) ? hsy << 1 : hsy;
+        return tile_ptr[_x + (_y * 8)];
+    }
+    else
+    {
+        if (tileindex < min_tile)
+            return 0;
 
-            int cx = x + hrealsx; // Center of the sprite
-            int cy = y + hrealsy;
+        const uint8_t *tile_ptr = GBA_TileCacheGet4bpp(0x10000 + (tileindex * 32));
 
-            if ((y <= ly) && ((y + (hrealsy << 1)) > ly)) // If in this line
-            {
-                int mode = (attr0 >> 10) & 3;
-
-                uint16_t prio = (attr2 >> 10) & 3;
-                uint16_t tilebaseno = attr2 & 0x3FF;
-                int ydiff = ly - cy;
-                if (mosaic)
-                    ydiff = ydiff - ydiff % MosSprY;
-
-                if (attr0 & BIT(13)) // 256 colors
-                {
-                    tilebaseno >>= 1; // In 256 mode, they need double space
-
-                    uint16_t *palptr = (uint16_t *)&(((uint8_t *)MEM_PALETTE_ADDR)[256 * 2]);
-
-                    int j = (x < 0) ? 0 : x; // Search start point
-                    while (j < (x + (hrealsx << 1)) && (j < 240))
-                    {
-                        if ((sprvisible[prio][j] == 0) || (mode == 2))
-                        {
-                            int xdiff = j - cx;
-                            if (mosaic)
-                                xdiff = xdiff - xdiff % MosSprX;
-
-                            // Get texture coordinates (relative to center)
-                            uint32_t px = (mat->pa * xdiff + mat->pb * ydiff) >> 8;
-                            uint32_t py = (mat->pc * xdiff + mat->pd * ydiff) >> 8;
-                            // Get texture coordinates (absolute)
-                            px += hsx;
-                            py += hsy;
-
-                            // The variables are unsigned, so this also checks
-                            // for negative numbers
-                            if ((px < (hsx << 1)) && (py < (hsy << 1)))
-                            {
-                                uint32_t tileadd = 0;
-                                if (REG_DISPCNT & BIT(6)) // 1D mapping
-                                {
-                                    int tilex = px >> 3;
-                                    int tiley = py >> 3;
-                                    tileadd = tilex + (tiley * (hsx * 2) / 8);
-                                }
-                                else // 2D mapping
-                                {
-                                    int tilex = px >> 3;
-                                    int tiley = py >> 3;
-                                    tileadd = tilex + (tiley * 16);
-                                }
-
-                                uint8_t *tile_ptr =
-                                    (uint8_t *)&(((uint8_t *)MEM_VRAM_ADDR)
-                                            [0x10000 + ((tilebaseno + tileadd) * 64)]);
-
-                                int _x = px & 7;
-                                int _y = py & 7;
-
-                                uint8_t data = tile_ptr[_x + (_y * 8)];
-
-                                if (data)
-                                {
-                                    if (mode == 0)
-                                    {
-                                        sprfb[prio][j] = palptr[data];
-                                        sprvisible[prio][j] = 1;
-                                    }
-                                    else if (mode == 1) // Transp
-                                    {
-                                        sprblend[prio][j] = 1;
-                                        sprblendfb[prio][j] = palptr[data];
-                                        sprfb[prio][j] = palptr[data];
-                                        sprvisible[prio][j] = 1;
-                                    }
-                                    else if (mode == 2) // 3 = prohibited
-                                    {
-                                        sprwin[j] = 1;
-                                    }
-                                }
-                            }
-                        }
-                        j++;
-                    }
-                }
-                else // 16 colors
-                {
-                    uint16_t palno = attr2 >> 12;
-                    uint16_t *palptr = (uint16_t *)&((uint8_t *)MEM_PALETTE_ADDR)[512 + (palno * 32)];
-
-                    int j = (x < 0) ? 0 : x; // Search start point
-                    while (j < (x + (hrealsx << 1)) && (j < 240))
-                    {
-                        if ((sprvisible[prio][j] == 0) || (mode == 2))
-                        {
-                            int xdiff = j - cx;
-                            if (mosaic)
-                                xdiff = xdiff - xdiff % MosSprX;
-
-                            // Get texture coordinates (relative to center)
-                            uint32_t px = (mat->pa * xdiff + mat->pb * ydiff) >> 8;
-                            uint32_t py = (mat->pc * xdiff + mat->pd * ydiff) >> 8;
-                            // Get texture coordinates (absolute)
-                            px += hsx;
-                            py += hsy;
-
-                            // The variables are unsigned, so this also checks
-                            // for negative numbers
-                            if ((px < (hsx << 1)) && (py < (hsy << 1)))
-                            {
-                                uint32_t tileadd = 0;
-                                if (REG_DISPCNT & BIT(6)) // 1D mapping
-                                {
-                                    int tilex = px >> 3;
-                                    int tiley = py >> 3;
-                                    tileadd = tilex + (tiley * (hsx * 2) / 8);
-                                }
-                                else // 2D mapping
-                                {
-                                    int tilex = px >> 3;
-                                    int tiley = py >> 3;
-                                    tileadd = tilex + (tiley * 32);
-                                }
-
-                                uint8_t *tile_ptr =
-                                    (uint8_t *)&(((uint8_t *)MEM_VRAM_ADDR)[0x10000 + ((tilebaseno + tileadd) * 32)]);
-
-                                int _x = px & 7;
-                                int _y = py & 7;
-
-                                uint8_t data = tile_ptr[(_x / 2) + (_y * 4)];
-
-                                if (_x & 1)
-                                    data = data >> 4;
-                                else
-                                    data = data & 0xF;
-
-                                if (data)
-                                {
-                                    if (mode == 0)
-                                    {
-                                        sprfb[prio][j] = palptr[data];
-                                        sprvisible[prio][j] = 1;
-                                    }
-                                    else if (mode == 1) // Transp
-                                    {
-                                        sprblend[prio][j] = 1;
-                                        sprblendfb[prio][j] = palptr[data];
-                                        sprfb[prio][j] = palptr[data];
-                                        sprvisible[prio][j] = 1;
-                                    }
-                                    else if (mode == 2) // 3 = prohibited
-                                    {
-                                        sprwin[j] = 1;
-                                    }
-                                }
-                            }
-                        }
-                        j++;
-                    }
-                }
-            }
-        }
-        else // Regular sprite
-        {
-            if ((attr0 & BIT(9)) == 0) // Displayed
-            {
-                int mosaic = attr0 & BIT(12);
-
-                uint16_t attr1 = spr->attr1;
-                uint16_t attr2 = spr->attr2;
-
-                uint16_t shape = attr0 >> 14;
-                uint16_t size = attr1 >> 14;
-                int sx = spr_size[shape][size][0];
-                int sy = spr_size[shape][size][1];
-
-                int y = (attr0 & 0xFF);
-                y |= (y < 160) ? 0 : 0xFFFFFF00;
-                int x = (int)(attr1 & 0x1FF)
-                        | ((attr1 & BIT(8)) ? 0xFFFFFE00 : 0);
-
-                if ((y <= ly) && ((y + sy) > ly)) // If in this line
-                {
-                    int mode = (attr0 >> 10) & 3;
-
-                    int ydiff = ly - y;
-
-                    if (attr1 & BIT(13))
-                        ydiff = sy - ydiff - 1; // V flip
-
-                    if (mosaic)
-                        ydiff = ydiff - ydiff % MosSprY;
-
-                    uint16_t prio = (attr2 >> 10) & 3;
-                    uint16_t tilebaseno = attr2 & 0x3FF;
-
-                    if (attr0 & BIT(13)) // 256 colors
-                    {
-                        tilebaseno >>= 1; // In 256 mode, they need double space
-
-                        uint16_t *palptr = (uint16_t *)&(((uint8_t *)MEM_PALETTE_ADDR)[256 * 2]);
-
-                        int j = (x < 0) ? 0 : x; // Search start point
-                        while (j < (x + sx) && (j < 240))
-                        {
-                            if ((sprvisible[prio][j] == 0) || (mode == 2))
-                            {
-                                int xdiff = j - x;
-
-                                if (attr1 & BIT(12))
-                                    xdiff = sx - xdiff - 1; // H flip
-
-                                if (mosaic)
-                                    xdiff = xdiff - xdiff % MosSprX;
-
-                                uint32_t tileadd = 0;
-                                if (REG_DISPCNT & BIT(6)) // 1D mapping
-                                {
-                                    int tilex = xdiff >> 3;
-                                    int tiley = ydiff >> 3;
-                                    tileadd = tilex + (tiley * sx / 8);
-                                }
-                                else // 2D mapping
-                                {
-                                    int tilex = xdiff >> 3;
-                                    int tiley = ydiff >> 3;
-                                    tileadd = tilex + (tiley * 16);
-                                }
-
-                                uint32_t tileindex = tilebaseno + tileadd;
-                                uint8_t *tile_ptr =
-                                    (uint8_t *)&(((uint8_t *)MEM_VRAM_ADDR)[0x10000 + (tileindex * 64)]);
-
-                                int _x = xdiff & 7;
-                                int _y = ydiff & 7;
-
-                                uint8_t data = tile_ptr[_x + (_y * 8)];
-
-                                if (data)
-                                {
-                                    if (mode == 0)
-                                    {
-                                        sprfb[prio][j] = palptr[data];
-                                        sprvisible[prio][j] = 1;
-                                    }
-                                    else if (mode == 1) // Transp
-                                    {
-                                        sprblend[prio][j] = 1;
-                                        sprblendfb[prio][j] = palptr[data];
-                                        sprfb[prio][j] = palptr[data];
-                                        sprvisible[prio][j] = 1;
-                                    }
-                                    else if (mode == 2) // 3 = prohibited
-                                    {
-                                        sprwin[j] = 1;
-                                    }
-                                }
-                            }
-                            j++;
-                        }
-                    }
-                    else // 16 colors
-                    {
-                        uint16_t palno = attr2 >> 12;
-                        uint16_t *palptr = (uint16_t *)&((uint8_t *)MEM_PALETTE_ADDR)[512 + (palno * 32)];
-
-                        int j = (x < 0) ? 0 : x; // Search start point
-                        while (j < (x + sx) && (j < 240))
-                        {
-                            if ((sprvisible[prio][j] == 0) || (mode == 2))
-                            {
-                                int xdiff = j - x;
-
-                                if (attr1 & BIT(12))
-                                    xdiff = sx - xdiff - 1; // H flip
-
-                                if (mosaic)
-                                    xdiff = xdiff - xdiff % MosSprX;
-
-                                uint32_t tileadd = 0;
-                                if (REG_DISPCNT & BIT(6)) // 1D mapping
-                                {
-                                    int tilex = xdiff >> 3;
-                                    int tiley = ydiff >> 3;
-                                    tileadd = tilex + (tiley * sx / 8);
-                                }
-                                else // 2D mapping
-                                {
-                                    int tilex = xdiff >> 3;
-                                    int tiley = ydiff >> 3;
-                                    tileadd = tilex + (tiley * 32);
-                                }
-
-                                uint32_t tileindex = tilebaseno + tileadd;
-                                uint8_t *tile_ptr =
-                                    (uint8_t *)&(((uint8_t *)MEM_VRAM_ADDR)[0x10000 + (tileindex * 32)]);
-
-                                int _x = xdiff & 7;
-                                int _y = ydiff & 7;
-
-                                uint8_t data = tile_ptr[(_x / 2) + (_y * 4)];
-
-                                if (_x & 1)
-                                    data = data >> 4;
-                                else
-                                    data = data & 0xF;
-
-                                if (data)
-                                {
-                                    if (mode == 0)
-                                    {
-                                        sprfb[prio][j] = palptr[data];
-                                        sprvisible[prio][j] = 1;
-                                    }
-                                    else if (mode == 1) // Transp
-                                    {
-                                        sprblend[prio][j] = 1;
-                                        sprblendfb[prio][j] = palptr[data];
-                                        sprfb[prio][j] = palptr[data];
-                                        sprvisible[prio][j] = 1;
-                                    }
-                                    else if (mode == 2) // 3 = prohibited
-                                    {
-                                        sprwin[j] = 1;
-                                    }
-                                }
-                            }
-                            j++;
-                        }
-                    }
-                }
-            }
-        }
-        spr++;
+        return tile_ptr[_x + (_y * 8)];
     }
 }
 
-static void gba_sprites_draw_mode345(int32_t ly)
+static void gba_sprites_draw(video_renderer *ctx, int32_t ly, int bitmap_mode)
 {
-    oam_entry *spr = (oam_entry *)((uint8_t *)MEM_OAM_ADDR);
+    const video_line *line = ctx->line;
 
-    for (int i = 0; i < 128; i++)
+    uint16_t dispcnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
+    uint16_t *palette = (uint16_t *)line->palette_addr;
+
+    // In bitmap modes the first half of the OBJ VRAM is used by the background
+    uint32_t min_tile = bitmap_mode ? 512 : 0;
+
+    for (int i = 0; i < line->sprite_num; i++)
     {
-        uint16_t attr0 = spr->attr0;
+        const video_sprite *s = &line->sprite_table[line->sprite_list[i]];
 
-        if (attr0 & BIT(8)) // Affine sprite -- No H flip or V flip
-        {
-            int mosaic = attr0 & BIT(12);
+        int prio = s->prio;
+        int mode = s->mode;
+
+        uint16_t *palptr = &palette[256];
+        if (!s->colors_256)
+            palptr += s->palno * 16;
 
-            uint16_t attr1 = spr->attr1;
-            uint16_t attr2 = spr->attr2;
+        uint32_t tiles_per_row;
+        if (dispcnt & BIT(6)) // 1D mapping
+            tiles_per_row = s->sx / 8;
+        else // 2D mapping
+            tiles_per_row = s->colors_256 ? 16 : 32;
 
-            oam_matrix_entry *mat =
-                    &(((oam_matrix_entry *)((uint8_t *)MEM_OAM_ADDR))[(attr1 >> 9) & 0x1F]);
+        int x = s->x;
+        int j = (x < 0) ? 0 : x; // Search start point
+        int end = x + s->w;
+        if (end > 240)
+            end = 240;
 
-            uint16_t shape = attr0 >> 14;
-            uint16_t size = attr1 >> 14;
-            uint32_t hsx = spr_size[shape][size][0] >> 1; // Half size
-            uint32_t hsy = spr_size[shape][size][1] >> 1;
+        if (j < end)
+        {
+            if (j < ctx->spr_x_min)
+                ctx->spr_x_min = j;
+            if (end > ctx->spr_x_max)
+                ctx->spr_x_max = end;
+        }
 
-            int y = (attr0 & 0xFF);
-            y |= (y < 160) ? 0 : 0xFFFFFF00;
-            int x = (int)(attr1 & 0x1FF) | ((attr1 & BIT(8)) ? 0xFFFFFE00 : 0);
+        if (s->affine) // No H flip or V flip
+        {
+            uint32_t hsx = s->sx >> 1; // Half size
+            uint32_t hsy = s->sy >> 1;
 
-            // Is double size?
-            int hrealsx = (attr0 & BIT(9)) ? hsx << 1 : hsx; // Half canvas size
-            int hrealsy = (attr0 & BIT(9)) ? hsy << 1 : hsy;
+            int cx = x + (s->w >> 1); // Center of the sprite
+            int cy = s->y + (s->h >> 1);
 
-            int cx = x + hrealsx; // Center of the sprite
-            int cy = y + hrealsy;
+            int ydiff = ly - cy;
+            if (s->mosaic)
+                ydiff = ydiff - ydiff % ctx->MosSprY;
 
-            if ((y <= ly) && ((y + (hrealsy << 1)) > ly)) // If in this line
+            for ( ; j < end; j++)
             {
-                int mode = (attr0 >> 10) & 3;
-
-                uint16_t prio = (attr2 >> 10) & 3;
-                uint16_t tilebaseno = attr2 & 0x3FF;
-                int ydiff = ly - cy;
-                if (mosaic)
-                    ydiff = ydiff - ydiff % MosSprY;
-
-                if (attr0 & BIT(13)) // 256 colors
-                {
-                    tilebaseno >>= 1; // In 256 mode, they need double space
-
-                    uint16_t *palptr = (uint16_t *)&(((uint8_t *)MEM_PALETTE_ADDR)[256 * 2]);
-
-                    int j = (x < 0) ? 0 : x; // Search start point
-                    while (j < (x + (hrealsx << 1)) && (j < 240))
-                    {
-                        if ((sprvisible[prio][j] == 0) || (mode == 2))
-                        {
-                            int xdiff = j - cx;
-                            if (mosaic)
-                                xdiff = xdiff - xdiff % MosSprX;
-
-                            // Get texture coordinates (relative to center)
-                            uint32_t px = (mat->pa * xdiff + mat->pb * ydiff) >> 8;
-                            uint32_t py = (mat->pc * xdiff + mat->pd * ydiff) >> 8;
-                            // Get texture coordinates (absolute)
-                            px += hsx;
-                            py += hsy;
-
-                            // The variables are unsigned, so this also checks
-                            // for negative numbers
-                            if ((px < (hsx << 1)) && (py < (hsy << 1)))
-                            {
-                                uint32_t tileadd = 0;
-                                if (REG_DISPCNT & BIT(6)) // 1D mapping
-                                {
-                                    int tilex = px >> 3;
-                                    int tiley = py >> 3;
-                                    tileadd = tilex + (tiley * (hsx * 2) / 8);
-                                }
-                                else // 2D mapping
-                                {
-                                    int tilex = px >> 3;
-                                    int tiley = py >> 3;
-                                    tileadd = tilex + (tiley * 16);
-                                }
-
-                                // Each tile needs double space
-                                if (tilebaseno + tileadd >= 256)
-                                {
-                                    uint8_t *tile_ptr =
-                                        (uint8_t *)&(((uint8_t *)MEM_VRAM_ADDR)[0x10000 + ((tilebaseno + tileadd) * 64)]);
-
-                                    int _x = px & 7;
-                                    int _y = py & 7;
-
-                                    uint8_t data = tile_ptr[_x + (_y * 8)];
-
-                                    if (data)
-                                    {
-                                        if (mode == 0)
-                                        {
-                                            sprfb[prio][j] = palptr[data];
-                                            sprvisible[prio][j] = 1;
-                                        }
-                                        else if (mode == 1) // Transp
-                                        {
-                                            sprblend[prio][j] = 1;
-                                            sprblendfb[prio][j] = palptr[data];
-                                            sprfb[prio][j] = palptr[data];
-                                            sprvisible[prio][j] = 1;
-                                        }
-                                        else if (mode == 2) // 3 = prohibited
-                                        {
-                                            sprwin[j] = 1;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                        j++;
-                    }
-                }
-                else // 16 colors
-                {
-                    uint16_t palno = attr2 >> 12;
-                    uint16_t *palptr = (uint16_t *)&((uint8_t *)MEM_PALETTE_ADDR)[512 + (palno * 32)];
-
-                    int j = (x < 0) ? 0 : x; // Search start point
-                    while (j < (x + (hrealsx << 1)) && (j < 240))
-                    {
-                        if ((sprvisible[prio][j] == 0) || (mode == 2))
-                        {
-                            int xdiff = j - cx;
-                            if (mosaic)
-                                xdiff = xdiff - xdiff % MosSprX;
-
-                            // Get texture coordinates (relative to center)
-                            uint32_t px = (mat->pa * xdiff + mat->pb * ydiff) >> 8;
-                            uint32_t py = (mat->pc * xdiff + mat->pd * ydiff) >> 8;
-                            // Get texture coordinates (absolute)
-                            px += hsx;
-                            py += hsy;
-
-                            // The variables are unsigned, so this also checks
-                            // for negative numbers
-                            if ((px < (hsx << 1)) && (py < (hsy << 1)))
-                            {
-                                uint32_t tileadd = 0;
-                                if (REG_DISPCNT & BIT(6)) // 1D mapping
-                                {
-                                    int tilex = px >> 3;
-                                    int tiley = py >> 3;
-                                    tileadd = tilex + (tiley * (hsx * 2) / 8);
-                                }
-                                else // 2D mapping
-                                {
-                                    int tilex = px >> 3;
-                                    int tiley = py >> 3;
-                                    tileadd = tilex + (tiley * 32);
-                                }
-
-                                if (tilebaseno + tileadd >= 512)
-                                {
-                                    uint8_t *tile_ptr = (uint8_t *)&(((uint8_t *)MEM_VRAM_ADDR)[0x10000
-                                            + ((tilebaseno + tileadd) * 32)]);
-
-                                    int _x = px & 7;
-                                    int _y = py & 7;
-
-                                    uint8_t data = tile_ptr[(_x / 2) + (_y * 4)];
-
-                                    if (_x & 1)
-                                        data = data >> 4;
-                                    else
-                                        data = data & 0xF;
-
-                                    if (data)
-                                    {
-                                        if (mode == 0)
-                                        {
-                                            sprfb[prio][j] = palptr[data];
-                                            sprvisible[prio][j] = 1;
-                                        }
-                                        else if (mode == 1) // Transp
-                                        {
-                                            sprblend[prio][j] = 1;
-                                            sprblendfb[prio][j] = palptr[data];
-                                            sprfb[prio][j] = palptr[data];
-                                            sprvisible[prio][j] = 1;
-                                        }
-                                        else if (mode == 2) // 3 = prohibited
-                                        {
-                                            sprwin[j] = 1;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                        j++;
-                    }
-                }
+                if ((ctx->sprvisible[prio][j] != 0) && (mode != 2))
+                    continue;
+
+                int xdiff = j - cx;
+                if (s->mosaic)
+                    xdiff = xdiff - xdiff % ctx->MosSprX;
+
+                // Get texture coordinates (relative to center)
+                uint32_t px = (s->pa * xdiff + s->pb * ydiff) >> 8;
+                uint32_t py = (s->pc * xdiff + s->pd * ydiff) >> 8;
+                // Get texture coordinates (absolute)
+                px += hsx;
+                py += hsy;
+
+                // The variables are unsigned, so this also checks for negative
+                // numbers
+                if ((px >= s->sx) || (py >= s->sy))
+                    continue;
+
+                uint8_t data = gba_sprite_texel(s, px, py, tiles_per_row,
+                                                min_tile);
+                if (data)
+                    gba_sprite_pixel_put(ctx, s, j, palptr[data]);
             }
         }
         else // Regular sprite
         {
-            if ((attr0 & BIT(9)) == 0) // Displayed
+            int ydiff = ly - s->y;
+
+            if (s->vflip)
+                ydiff = s->sy - ydiff - 1;
+
+            if (s->mosaic)
+                ydiff = ydiff - ydiff % ctx->MosSprY;
+
+            for ( ; j < end; j++)
             {
-                int mosaic = attr0 & BIT(12);
-
-                uint16_t attr1 = spr->attr1;
-                uint16_t attr2 = spr->attr2;
-
-                uint16_t shape = attr0 >> 14;
-                uint16_t size = attr1 >> 14;
-                int sx = spr_size[shape][size][0];
-                int sy = spr_size[shape][size][1];
-
-                int y = (attr0 & 0xFF);
-                y |= (y < 160) ? 0 : 0xFFFFFF00;
-                int x = (int)(attr1 & 0x1FF)
-                        | ((attr1 & BIT(8)) ? 0xFFFFFE00 : 0);
-
-                if ((y <= ly) && ((y + sy) > ly)) // If in this line
-                {
-                    int mode = (attr0 >> 10) & 3;
-
-                    int ydiff = ly - y;
-
-                    if (attr1 & BIT(13))
-                        ydiff = sy - ydiff - 1; // V flip
-
-                    if (mosaic)
-                        ydiff = ydiff - ydiff % MosSprY;
-
-                    uint16_t prio = (attr2 >> 10) & 3;
-                    uint16_t tilebaseno = attr2 & 0x3FF;
-
-                    if (attr0 & BIT(13)) // 256 colors
-                    {
-                        tilebaseno >>= 1; // in 256 mode, they need double space
-
-                        uint16_t *palptr = (uint16_t *)&(((uint8_t *)MEM_PALETTE_ADDR)[256 * 2]);
-
-                        int j = (x < 0) ? 0 : x; // Search start point
-                        while (j < (x + sx) && (j < 240))
-                        {
-                            if ((sprvisible[prio][j] == 0) || (mode == 2))
-                            {
-                                int xdiff = j - x;
-
-                                if (attr1 & BIT(12))
-                                    xdiff = sx - xdiff - 1; // H flip
-
-                                if (mosaic)
-                                    xdiff = xdiff - xdiff % MosSprX;
-
-                                uint32_t tileadd = 0;
-                                if (REG_DISPCNT & BIT(6)) // 1D mapping
-                                {
-                                    int tilex = xdiff >> 3;
-                                    int tiley = ydiff >> 3;
-                                    tileadd = tilex + (tiley * sx / 8);
-                                }
-                                else // 2D mapping
-                                {
-                                    int tilex = xdiff >> 3;
-                                    int tiley = ydiff >> 3;
-                                    tileadd = tilex + (tiley * 16);
-                                }
-
-                                uint32_t tileindex = tilebaseno + tileadd;
-
-                                // Each tile needs double space
-                                if (tileindex >= 256)
-                                {
-                                    uint8_t *tile_ptr = (uint8_t *)&(((uint8_t *)MEM_VRAM_ADDR)[0x10000
-                                            + (tileindex * 64)]);
-
-                                    int _x = xdiff & 7;
-                                    int _y = ydiff & 7;
-
-                                    uint8_t data = tile_ptr[_x + (_y * 8)];
-
-                                    if (data)
-                                    {
-                                        if (mode == 0)
-                                        {
-                                            sprfb[prio][j] = palptr[data];
-                                            sprvisible[prio][j] = 1;
-                                        }
-                                        else if (mode == 1) // Transp
-                                        {
-                                            sprblend[prio][j] = 1;
-                                            sprblendfb[prio][j] = palptr[data];
-                                            sprfb[prio][j] = palptr[data];
-                                            sprvisible[prio][j] = 1;
-                                        }
-                                        else if (mode == 2) // 3 = prohibited
-                                        {
-                                            sprwin[j] = 1;
-                                        }
-                                    }
-                                }
-                            }
-                            j++;
-                        }
-                    }
-                    else // 16 colors
-                    {
-                        uint16_t palno = attr2 >> 12;
-                        uint16_t *palptr = (uint16_t *)&((uint8_t *)MEM_PALETTE_ADDR)[512 + (palno * 32)];
-
-                        int j = (x < 0) ? 0 : x; // Search start point
-                        while (j < (x + sx) && (j < 240))
-                        {
-                            if ((sprvisible[prio][j] == 0) || (mode == 2))
-                            {
-                                int xdiff = j - x;
-
-                                if (attr1 & BIT(12))
-                                    xdiff = sx - xdiff - 1; // H flip
-
-                                if (mosaic)
-                                    xdiff = xdiff - xdiff % MosSprX;
-
-                                uint32_t tileadd = 0;
-                                if (REG_DISPCNT & BIT(6)) // 1D mapping
-                                {
-                                    int tilex = xdiff >> 3;
-                                    int tiley = ydiff >> 3;
-                                    tileadd = tilex + (tiley * sx / 8);
-                                }
-                                else // 2D mapping
-                                {
-                                    int tilex = xdiff >> 3;
-                                    int tiley = ydiff >> 3;
-                                    tileadd = tilex + (tiley * 32);
-                                }
-
-                                uint32_t tileindex = tilebaseno + tileadd;
-
-                                if (tileindex >= 512)
-                                {
-                                    uint8_t *tile_ptr = (uint8_t *)&(((uint8_t *)MEM_VRAM_ADDR)[0x10000
-                                            + (tileindex * 32)]);
-
-                                    int _x = xdiff & 7;
-                                    int _y = ydiff & 7;
-
-                                    uint8_t data = tile_ptr[(_x / 2) + (_y * 4)];
-
-                                    if (_x & 1)
-                                        data = data >> 4;
-                                    else
-                                        data = data & 0xF;
-
-                                    if (data)
-                                    {
-                                        if (mode == 0)
-                                        {
-                                            sprfb[prio][j] = palptr[data];
-                                            sprvisible[prio][j] = 1;
-                                        }
-                                        else if (mode == 1) // Transp
-                                        {
-                                            sprblend[prio][j] = 1;
-                                            sprblendfb[prio][j] = palptr[data];
-                                            sprfb[prio][j] = palptr[data];
-                                            sprvisible[prio][j] = 1;
-                                        }
-                                        else if (mode == 2) // 3 = prohibited
-                                        {
-                                            sprwin[j] = 1;
-                                        }
-                                    }
-                                }
-                            }
-                            j++;
-                        }
-                    }
-                }
+                if ((ctx->sprvisible[prio][j] != 0) && (mode != 2))
+                    continue;
+
+                int xdiff = j - x;
+
+                if (s->hflip)
+                    xdiff = s->sx - xdiff - 1;
+
+                if (s->mosaic)
+                    xdiff = xdiff - xdiff % ctx->MosSprX;
+
+                uint8_t data = gba_sprite_texel(s, xdiff, ydiff, tiles_per_row,
+                                                min_tile);
+                if (data)
+                    gba_sprite_pixel_put(ctx, s, j, palptr[data]);
             }
         }
-        spr++;
     }
 }
 
 //------------------------------------------------------------------------------
 
-uint16_t bgfb[4][240];
-int bgvisible[4][240];
-uint16_t backdrop[240];
-int backdropvisible[240]; // This array is filled in GBA_FillFadeTables()
-
 static const uint32_t text_bg_size[4][2] = {
     { 256, 256 }, { 512, 256 }, { 256, 512 }, { 512, 512 }
 };
@@ -963,586 +1127,357 @@ static uint32_t se_index(uint32_t tx, uint32_t ty, uint32_t pitch) // From tonc
     return sbb * 1024 + (ty % 32) * 32 + tx % 32;
 }
 
-static void gba_bg0drawtext(int32_t y)
+// Decode the row of pixels of a tile that corresponds to the specified screen
+// entry. The result is a list of palette indices (0 = transparent) ordered from
+// left to right as they are displayed on the screen. The function returns a
+// pointer to the palette used by the tile.
+static uint16_t *gba_bg_text_decode_tile_row(video_renderer *ctx,
+                                             uint8_t *row, uint16_t SE,
+                                             uint32_t charbase,
+                                             int is_256_colors, int _y)
 {
-    int sx = REG_BG0HOFS;
-    int sy = REG_BG0VOFS;
-    uint16_t control = REG_BG0CNT;
-
-    uint8_t *charbaseblockptr = (uint8_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 2) & 3) * (16 * 1024)];
-    uint16_t *scrbaseblockptr = (uint16_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 8) & 0x1F) * (2 * 1024)];
-
-    uint32_t maskx = text_bg_size[control >> 14][0] - 1;
-    uint32_t masky = text_bg_size[control >> 14][1] - 1;
-
-    uint32_t startx = sx & maskx;
-    uint32_t starty = (y + sy) & masky;
+    // Screen entry data:
+    // 0-9 tile id
+    // 10-hflip
+    // 11-vflip
+    // 12-15-pal (16 color mode only)
 
-    uint32_t sizex = text_bg_size[control >> 14][0] / 8;
+    uint16_t *palptr = (uint16_t *)ctx->line->palette_addr;
 
-    int mosaic = (control & BIT(6)); // Mosaic
-    if (mosaic)
-        starty -= starty % MosBgY;
+    if (SE & BIT(11))
+        _y = 7 - _y; // V flip
 
-    uint16_t *fb = bgfb[0];
-    int *visptr = bgvisible[0];
-    if (control & BIT(7)) // 256 colors
+    if (is_256_colors)
     {
-        for (int i = 0; i < 240; i++)
-        {
-            startx = (sx + i) & maskx;
-            if (mosaic)
-                startx -= startx % MosBgX;
-
-            uint32_t index = se_index(startx / 8, starty / 8, sizex);
-            uint16_t SE = scrbaseblockptr[index];
-            // Screen entry data:
-            // 0-9 tile id
-            // 10-hflip
-            // 11-vflip
-            int _x = startx & 7;
-            if (SE & BIT(10))
-                _x = 7 - _x; // H flip
-
-            int _y = starty & 7;
-            if (SE & BIT(11))
-                _y = 7 - _y; // V flip
-
-            int data = charbaseblockptr[((SE & 0x3FF) * 64) + (_x + (_y * 8))];
-
-            *fb++ = ((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR))[data];
-            *visptr++ = data;
+        uint8_t *src = &((uint8_t *)MEM_VRAM_ADDR)[charbase
+                                        + ((SE & 0x3FF) * 64) + (_y * 8)];
 
-            //startx = (startx + 1) & maskx;
-        }
+        memcpy(row, src, 8);
     }
-    else // 16 colors
+    else
     {
-        for (int i = 0; i < 240; i++)
-        {
-            startx = (sx + i) & maskx;
-            if (mosaic)
-                startx -= startx % MosBgX;
-
-            uint32_t index = se_index(startx / 8, starty / 8, sizex);
-            uint16_t SE = scrbaseblockptr[index];
-            // Screen entry data:
-            // 0-9 tile id
-            // 10-hflip
-            // 11-vflip
-            // 12-15-pal
-            uint16_t *palptr = (uint16_t *)&((uint8_t *)MEM_PALETTE_ADDR)[(SE >> 12) * (2 * 16)];
-
-            int _x = startx & 7;
-            if (SE & BIT(10))
-                _x = 7 - _x; // H flip
-
-            int _y = starty & 7;
-            if (SE & BIT(11))
-                _y = 7 - _y; // V flip
-
-            uint32_t data =
-                    charbaseblockptr[((SE & 0x3FF) * 32) + ((_x / 2) + (_y * 4))];
-
-            if (_x & 1)
-                data = data >> 4;
-            else
-                data = data & 0xF;
+        const uint8_t *src = GBA_TileCacheGet4bpp(charbase + (SE & 0x3FF) * 32);
 
-            *fb++ = palptr[data];
-            *visptr++ = data;
+        memcpy(row, &src[_y * 8], 8);
 
-            //startx = (startx + 1) & maskx;
-        }
+        palptr += (SE >> 12) * 16;
     }
-}
-
-static void gba_bg1drawtext(int32_t y)
-{
-    int sx = REG_BG1HOFS;
-    int sy = REG_BG1VOFS;
-    uint16_t control = REG_BG1CNT;
-
-    uint8_t *charbaseblockptr = (uint8_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 2) & 3) * (16 * 1024)];
-    uint16_t *scrbaseblockptr =
-            (uint16_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 8) & 0x1F) * (2 * 1024)];
 
-    uint32_t maskx = text_bg_size[control >> 14][0] - 1;
-    uint32_t masky = text_bg_size[control >> 14][1] - 1;
-
-    uint32_t startx = sx & maskx;
-    uint32_t starty = (y + sy) & masky;
-
-    uint32_t sizex = text_bg_size[control >> 14][0] / 8;
-
-    int mosaic = (control & BIT(6)); // Mosaic
-    if (mosaic)
-        starty -= starty % MosBgY;
-
-    uint16_t *fb = bgfb[1];
-    int *visptr = bgvisible[1];
-    if (control & BIT(7)) // 256 colors
+    if (SE & BIT(10)) // H flip
     {
-        for (int i = 0; i < 240; i++)
+        for (int i = 0; i < 4; i++)
         {
-            startx = (sx + i) & maskx;
-            if (mosaic)
-                startx -= startx % MosBgX;
-
-            uint32_t index = se_index(startx / 8, starty / 8, sizex);
-            uint16_t SE = scrbaseblockptr[index];
-            // Screen entry data:
-            // 0-9 tile id
-            // 10-hflip
-            // 11-vflip
-            int _x = startx & 7;
-            if (SE & BIT(10))
-                _x = 7 - _x; // H flip
-
-            int _y = starty & 7;
-            if (SE & BIT(11))
-                _y = 7 - _y; // V flip
-
-            int data = charbaseblockptr[((SE & 0x3FF) * 64) + (_x + (_y * 8))];
-
-            *fb++ = ((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR))[data];
-            *visptr++ = data;
-
-            //startx = (startx + 1) & maskx;
+            uint8_t tmp = row[i];
+            row[i] = row[7 - i];
+            row[7 - i] = tmp;
         }
     }
-    else // 16 colors
-    {
-        for (int i = 0; i < 240; i++)
-        {
-            startx = (sx + i) & maskx;
-            if (mosaic)
-                startx -= startx % MosBgX;
-
-            uint32_t index = se_index(startx / 8, starty / 8, sizex);
-            uint16_t SE = scrbaseblockptr[index];
-            // Screen entry data:
-            // 0-9 tile id
-            // 10-hflip
-            // 11-vflip
-            // 12-15-pal
-            uint16_t *palptr = (uint16_t *)&((uint8_t *)MEM_PALETTE_ADDR)[(SE >> 12) * (2 * 16)];
-
-            int _x = startx & 7;
-            if (SE & BIT(10))
-                _x = 7 - _x; // H flip
-
-            int _y = starty & 7;
-            if (SE & BIT(11))
-                _y = 7 - _y; // V flip
-
-            uint32_t data =
-                    charbaseblockptr[((SE & 0x3FF) * 32) + ((_x / 2) + (_y * 4))];
-
-            if (_x & 1)
-                data = data >> 4;
-            else
-                data = data & 0xF;
-
-            *fb++ = palptr[data];
-            *visptr++ = data;
 
-            //startx = (startx + 1) & maskx;
-        }
-    }
+    return palptr;
 }
 
-static void gba_bg2drawtext(int32_t y)
+static void gba_bgdrawtext(video_renderer *ctx, int bg, int x1, int x2)
 {
-    int sx = REG_BG2HOFS;
-    int sy = REG_BG2VOFS;
-    uint16_t control = REG_BG2CNT;
+    int32_t y = ctx->line->y;
 
-    uint8_t *charbaseblockptr = (uint8_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 2) & 3) * (16 * 1024)];
+    int sx = LINE_REG_16(ctx, OFFSET_BG0HOFS + bg * 4);
+    int sy = LINE_REG_16(ctx, OFFSET_BG0VOFS + bg * 4);
+    uint16_t control = LINE_REG_16(ctx, OFFSET_BG0CNT + bg * 2);
+
+    uint32_t charbase = ((control >> 2) & 3) * (16 * 1024);
     uint16_t *scrbaseblockptr =
             (uint16_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 8) & 0x1F) * (2 * 1024)];
 
     uint32_t maskx = text_bg_size[control >> 14][0] - 1;
     uint32_t masky = text_bg_size[control >> 14][1] - 1;
 
-    uint32_t startx = sx & maskx;
+    uint32_t startx = (sx + x1) & maskx;
     uint32_t starty = (y + sy) & masky;
 
     uint32_t sizex = text_bg_size[control >> 14][0] / 8;
 
     int mosaic = (control & BIT(6)); // Mosaic
     if (mosaic)
-        starty -= starty % MosBgY;
-
-    uint16_t *fb = bgfb[2];
-    int *visptr = bgvisible[2];
-    if (control & BIT(7)) // 256 colors
-    {
-        for (int i = 0; i < 240; i++)
-        {
-            startx = (sx + i) & maskx;
-            if (mosaic)
-                startx -= startx % MosBgX;
-
-            uint32_t index = se_index(startx / 8, starty / 8, sizex);
-            uint16_t SE = scrbaseblockptr[index];
-            // Screen entry data:
-            // 0-9 tile id
-            // 10-hflip
-            // 11-vflip
-            int _x = startx & 7;
-            if (mosaic)
-                _x = (startx - startx % MosBgX) & 7;
-            if (SE & BIT(10))
-                _x = 7 - _x; // H flip
-
-            int _y = starty & 7;
-            if (SE & BIT(11))
-                _y = 7 - _y; // V flip
-
-            int data = charbaseblockptr[((SE & 0x3FF) * 64) + (_x + (_y * 8))];
-
-            *fb++ = ((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR))[data];
-            *visptr++ = data;
-
-            //startx = (startx + 1) & maskx;
-        }
-    }
-    else // 16 colors
-    {
-        for (int i = 0; i < 240; i++)
-        {
-            startx = (sx + i) & maskx;
-            if (mosaic)
-                startx -= startx % MosBgX;
-
-            uint32_t index = se_index(startx / 8, starty / 8, sizex);
-            uint16_t SE = scrbaseblockptr[index];
-            // Screen entry data
-            // 0-9 tile id
-            // 10-hflip
-            // 11-vflip
-            // 12-15-pal
-            uint16_t *palptr = (uint16_t *)&((uint8_t *)MEM_PALETTE_ADDR)[(SE >> 12) * (2 * 16)];
-
-            int _x = startx & 7;
-            if (SE & BIT(10))
-                _x = 7 - _x; // H flip
-
-            int _y = starty & 7;
-            if (SE & BIT(11))
-                _y = 7 - _y; // V flip
-
-            uint32_t data =
-                    charbaseblockptr[((SE & 0x3FF) * 32) + ((_x / 2) + (_y * 4))];
-
-            if (_x & 1)
-                data = data >> 4;
-            else
-                data = data & 0xF;
-
-            *fb++ = palptr[data];
-            *visptr++ = data;
-
-            //startx = (startx + 1) & maskx;
-        }
-    }
-}
-
-static void gba_bg3drawtext(int32_t y)
-{
-    int sx = REG_BG3HOFS;
-    int sy = REG_BG3VOFS;
-    uint16_t control = REG_BG3CNT;
+        starty -= starty % ctx->MosBgY;
 
-    uint8_t *charbaseblockptr = (uint8_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 2) & 3) * (16 * 1024)];
-    uint16_t *scrbaseblockptr =
-            (uint16_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 8) & 0x1F) * (2 * 1024)];
+    int is_256_colors = control & BIT(7);
 
-    uint32_t maskx = text_bg_size[control >> 14][0] - 1;
-    uint32_t masky = text_bg_size[control >> 14][1] - 1;
+    uint32_t ty = starty / 8;
+    int _y = starty & 7;
 
-    uint32_t startx = sx & maskx;
-    uint32_t starty = (y + sy) & masky;
+    uint16_t *fb = &ctx->bgfb[bg][x1];
+    uint8_t *visptr = &ctx->bgvisible[bg][x1];
 
-    uint32_t sizex = text_bg_size[control >> 14][0] / 8;
+    // All the pixels of a tile share the same screen entry, so tiles are
+    // decoded once and all their visible pixels are drawn afterwards.
+    uint8_t row[8];
+    uint16_t *palptr;
 
-    int mosaic = (control & BIT(6)); // Mosaic
-    if (mosaic)
-        starty -= starty % MosBgY;
-
-    uint16_t *fb = bgfb[3];
-    int *visptr = bgvisible[3];
-    if (control & BIT(7)) // 256 colors
+    if (!mosaic)
     {
-        for (int i = 0; i < 240; i++)
+        int i = x1;
+        while (i < x2)
         {
-            startx = (sx + i) & maskx;
-            if (mosaic)
-                startx -= startx % MosBgX;
-
-            uint32_t index = se_index(startx / 8, starty / 8, sizex);
-            uint16_t SE = scrbaseblockptr[index];
-            // Screen entry data:
-            // 0-9 tile id
-            // 10-hflip
-            // 11-vflip
-            int _x = startx & 7;
-            if (SE & BIT(10))
-                _x = 7 - _x; // H flip
-
-            int _y = starty & 7;
-            if (SE & BIT(11))
-                _y = 7 - _y; // V flip
-
-            int data = charbaseblockptr[((SE & 0x3FF) * 64) + (_x + (_y * 8))];
-
-            *fb++ = ((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR))[data];
-            *visptr++ = data;
+            uint16_t SE = scrbaseblockptr[se_index(startx / 8, ty, sizex)];
+            palptr = gba_bg_text_decode_tile_row(ctx, row, SE, charbase,
+                                                 is_256_colors, _y);
+
+            // Only the first and last tiles may be partially visible
+            int first = startx & 7;
+            int count = 8 - first;
+            if (count > x2 - i)
+                count = x2 - i;
+
+            for (int j = first; j < first + count; j++)
+            {
+                uint8_t data = row[j];
+                *fb++ = palptr[data];
+                *visptr++ = data;
+            }
 
-            //startx = (startx + 1) & maskx;
+            i += count;
+            startx = (startx + count) & maskx;
         }
     }
-    else // 16 colors
+    else
     {
-        for (int i = 0; i < 240; i++)
+        // Keep track of the position inside the current mosaic block instead
+        // of calculating it for each pixel. Mosaic blocks are aligned to the
+        // start of the map, so the position is reset when the map wraps.
+        uint32_t mos_offset = startx % ctx->MosBgX;
+        uint32_t last_tx = UINT32_MAX;
+
+        palptr = NULL;
+
+        for (int i = x1; i < x2; i++)
         {
-            startx = (sx + i) & maskx;
-            if (mosaic)
-                startx -= startx % MosBgX;
-
-            uint32_t index = se_index(startx / 8, starty / 8, sizex);
-            uint16_t SE = scrbaseblockptr[index];
-            // Screen entry data:
-            // 0-9 tile id
-            // 10-hflip
-            // 11-vflip
-            // 12-15-pal
-            uint16_t *palptr = (uint16_t *)&((uint8_t *)MEM_PALETTE_ADDR)[(SE >> 12) * (2 * 16)];
-
-            int _x = startx & 7;
-            if (SE & BIT(10))
-                _x = 7 - _x; // H flip
-
-            int _y = starty & 7;
-            if (SE & BIT(11))
-                _y = 7 - _y; // V flip
-
-            uint32_t data =
-                    charbaseblockptr[((SE & 0x3FF) * 32) + ((_x / 2) + (_y * 4))];
-
-            if (_x & 1)
-                data = data >> 4;
-            else
-                data = data & 0xF;
+            uint32_t mosx = startx - mos_offset;
+            uint32_t tx = mosx / 8;
 
+            if (tx != last_tx)
+            {
+                uint16_t SE = scrbaseblockptr[se_index(tx, ty, sizex)];
+                palptr = gba_bg_text_decode_tile_row(ctx, row, SE, charbase,
+                                                     is_256_colors, _y);
+                last_tx = tx;
+            }
+
+            uint8_t data = row[mosx & 7];
             *fb++ = palptr[data];
             *visptr++ = data;
 
-            //startx = (startx + 1) & maskx;
+            startx = (startx + 1) & maskx;
+            mos_offset++;
+            if ((mos_offset == (uint32_t)ctx->MosBgX) || (startx == 0))
+                mos_offset = 0;
         }
     }
 }
 
 //------------------------------------------------------------------------------
 
-static uint32_t se_index_affine(uint32_t tx, uint32_t ty, uint32_t tpitch)
-{
-    return (ty * tpitch) + tx;
-}
-
 static const uint32_t affine_bg_size[4] = {
     128, 256, 512, 1024
 };
 
-static int32_t mosBG2lastx, mosBG2lasty, mos2A, mos2C;
-
-static void gba_bg2drawaffine(int32_t y)
+// Draw a scanline of an affine background. This function is always inlined
+// with constant values of "wrap" and, in the case of backgrounds without
+// mosaic, "mos_x". That way the compiler generates specialized loops for each
+// combination and nothing needs to be checked per pixel other than the bounds
+// of the map when it doesn't wrap.
+//
+// With mosaic, only the first pixel of each block is read from the map, and it
+// is repeated for the rest of the block. Without mosaic, blocks are 1 pixel
+// wide. Only the pixels between x1 and x2 (not included) are drawn.
+static ALWAYS_INLINE void gba_bgdrawaffine_span(uint16_t *fb, uint8_t *visptr,
+                                                const uint16_t *palette,
+                                                const uint8_t *charbaseblockptr,
+                                                const uint8_t *scrbaseblockptr,
+                                                uint32_t size, int wrap,
+                                                int mos_x, int x1, int x2,
+                                                int32_t currx, int32_t curry,
+                                                int32_t A, int32_t C)
 {
-    uint16_t control = REG_BG2CNT;
-
-    uint8_t *charbaseblockptr = (uint8_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 2) & 3) * (16 * 1024)];
-    uint8_t *scrbaseblockptr = (uint8_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 8) & 0x1F) * (2 * 1024)];
-
-    uint32_t size = affine_bg_size[control >> 14];
     uint32_t sizemask = size - 1;
     uint32_t tilesize = size / 8;
 
-    int32_t currx = BG2lastx;
-    int32_t curry = BG2lasty;
+    // Mosaic blocks are aligned to the left of the screen. Start at the block
+    // that contains the first pixel to draw.
+    int i = x1 - (x1 % mos_x);
 
-    // | PA PB |
-    // | PC PD |
+    currx += A * i;
+    curry += C * i;
 
-    int32_t A = (int32_t)(int16_t)REG_BG2PA;
-    int32_t C = (int32_t)(int16_t)REG_BG2PC;
-
-    uint16_t *fb = bgfb[2];
-    int *visptr = bgvisible[2];
+    if (C == 0)
+    {
+        // The vertical coordinate is the same for the whole scanline (this is
+        // the case for horizontal scaling without rotation), so the row of the
+        // map and the row inside the tiles can be calculated only once.
 
-    int mosaic = (control & BIT(6)); // Mosaic
+        uint32_t _y = curry >> 8;
+        if (wrap)
+            _y &= sizemask;
 
-    if (mosaic)
-    {
-        if (y % MosBgY == 0)
+        if (_y >= size)
         {
-            mosBG2lastx = BG2lastx;
-            mosBG2lasty = BG2lasty;
-            mos2A = A;
-            mos2C = C;
-        }
-        else
-        {
-            currx = mosBG2lastx;
-            curry = mosBG2lasty;
-            A = mos2A;
-            C = mos2C;
+            // The scanline is outside of the map
+            for (int j = x1; j < x2; j++)
+            {
+                fb[j] = palette[0];
+                visptr[j] = 0;
+            }
+            return;
         }
-    }
 
-    uint8_t data = 0;
-    for (int i = 0; i < 240; i++) // Always 256 colors
-    {
-        uint32_t _x = (currx >> 8);
-        uint32_t _y = (curry >> 8);
+        const uint8_t *maprow = &scrbaseblockptr[(_y / 8) * tilesize];
+        const uint8_t *charrow = &charbaseblockptr[(_y & 7) * 8];
 
-        if (!mosaic || ((i % MosBgX) == 0))
+        for ( ; i < x2; i += mos_x)
         {
-            data = 0;
-            if (control & BIT(13)) // Wrap
-            {
+            uint32_t _x = currx >> 8;
+            if (wrap)
                 _x &= sizemask;
-                _y &= sizemask;
 
-                int __x = _x & 7;
-                int __y = _y & 7;
+            uint8_t data = 0;
+            if (wrap || (_x < size))
+                data = charrow[(maprow[_x / 8] * 64) + (_x & 7)];
 
-                uint32_t index = se_index_affine(_x / 8, _y / 8, tilesize);
-                uint8_t SE = scrbaseblockptr[index];
-                data = charbaseblockptr[(SE * 64) + (__x + (__y * 8))];
-            }
-            else if ((_x < size) && (_y < size))
+            int start = (i > x1) ? i : x1;
+            int end = (i + mos_x < x2) ? i + mos_x : x2;
+            uint16_t color = palette[data];
+            for (int j = start; j < end; j++)
             {
-                int __x = _x & 7;
-                int __y = _y & 7;
-
-                uint32_t index = se_index_affine(_x / 8, _y / 8, tilesize);
-                uint8_t SE = scrbaseblockptr[index];
-                data = charbaseblockptr[(SE * 64) + (__x + (__y * 8))];
+                fb[j] = color;
+                visptr[j] = data;
             }
+
+            currx += A * mos_x;
         }
-        *fb++ = ((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR))[data];
-        *visptr++ = data;
 
-        currx += A;
-        curry += C;
+        return;
     }
-}
-
-static int32_t mosBG3lastx, mosBG3lasty, mos3A, mos3C;
-
-static void gba_bg3drawaffine(int32_t y)
-{
-    uint16_t control = REG_BG3CNT;
-
-    uint8_t *charbaseblockptr = (uint8_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 2) & 3) * (16 * 1024)];
-    uint8_t *scrbaseblockptr = (uint8_t *)&((uint8_t *)MEM_VRAM_ADDR)[((control >> 8) & 0x1F) * (2 * 1024)];
-
-    uint32_t size = affine_bg_size[control >> 14];
-    uint32_t sizemask = size - 1;
-    uint32_t tilesize = size / 8;
-
-    int32_t currx = BG3lastx;
-    int32_t curry = BG3lasty;
-
-    // | PA PB |
-    // | PC PD |
-
-    int32_t A = (int32_t)(int16_t)REG_BG3PA;
-    int32_t C = (int32_t)(int16_t)REG_BG3PC;
 
-    uint16_t *fb = bgfb[3];
-    int *visptr = bgvisible[3];
-
-    int mosaic = (control & BIT(6)); // Mosaic
-
-    if (mosaic)
+    for ( ; i < x2; i += mos_x)
     {
-        if (y % MosBgY == 0)
+        uint32_t _x = currx >> 8;
+        uint32_t _y = curry >> 8;
+        if (wrap)
         {
-            mosBG3lastx = BG3lastx;
-            mosBG3lasty = BG3lasty;
-            mos3A = A;
-            mos3C = C;
+            _x &= sizemask;
+            _y &= sizemask;
         }
-        else
+
+        uint8_t data = 0;
+        if (wrap || ((_x < size) && (_y < size)))
+        {
+            uint8_t SE = scrbaseblockptr[((_y / 8) * tilesize) + (_x / 8)];
+            data = charbaseblockptr[(SE * 64) + ((_y & 7) * 8) + (_x & 7)];
+        }
+
+        int start = (i > x1) ? i : x1;
+        int end = (i + mos_x < x2) ? i + mos_x : x2;
+        uint16_t color = palette[data];
+        for (int j = start; j < end; j++)
         {
-            currx = mosBG3lastx;
-            curry = mosBG3lasty;
-            A = mos3A;
-            C = mos3C;
+            fb[j] = color;
+            visptr[j] = data;
         }
+
+        currx += A * mos_x;
+        curry += C * mos_x;
     }
+}
 
-    uint8_t data = 0;
-    for (int i = 0; i < 240; i++) // Always 256 colors
-    {
-        uint32_t _x = (currx >> 8);
-        uint32_t _y = (curry >> 8);
+static void gba_bgdrawaffine(video_renderer *ctx, int bg, int x1, int x2)
+{
+    const video_line *line = ctx->line;
 
-        if (!mosaic || ((i % MosBgX) == 0))
-        {
-            data = 0;
-            if (control & BIT(13)) // Wrap
-            {
-                _x &= sizemask;
-                _y &= sizemask;
+    uint16_t control = LINE_REG_16(ctx, OFFSET_BG0CNT + bg * 2);
+
+    const uint8_t *charbaseblockptr = &((uint8_t *)MEM_VRAM_ADDR)[((control >> 2) & 3) * (16 * 1024)];
+    const uint8_t *scrbaseblockptr = &((uint8_t *)MEM_VRAM_ADDR)[((control >> 8) & 0x1F) * (2 * 1024)];
+
+    const uint16_t *palette = (const uint16_t *)line->palette_addr;
+
+    uint32_t size = affine_bg_size[control >> 14];
 
-                int __x = _x & 7;
-                int __y = _y & 7;
+    // The mosaic effect has already been applied to the starting point and
+    // the increments when the line was prepared.
 
-                uint32_t index = se_index_affine(_x / 8, _y / 8, tilesize);
-                uint8_t SE = scrbaseblockptr[index];
-                data = charbaseblockptr[(SE * 64) + (__x + (__y * 8))];
-            }
-            else if ((_x < size) && (_y < size))
-            {
-                int __x = _x & 7;
-                int __y = _y & 7;
+    // | PA PB |
+    // | PC PD |
 
-                uint32_t index = se_index_affine(_x / 8, _y / 8, tilesize);
-                uint8_t SE = scrbaseblockptr[index];
-                data = charbaseblockptr[(SE * 64) + (__x + (__y * 8))];
-            }
-        }
+    int32_t currx, curry, A, C;
+
+    if (bg == 2)
+    {
+        currx = line->bg2x;
+        curry = line->bg2y;
+        A = line->bg2pa;
+        C = line->bg2pc;
+    }
+    else
+    {
+        currx = line->bg3x;
+        curry = line->bg3y;
+        A = line->bg3pa;
+        C = line->bg3pc;
+    }
 
-        *fb++ = ((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR))[data];
-        *visptr++ = data;
+    uint16_t *fb = ctx->bgfb[bg];
+    uint8_t *visptr = ctx->bgvisible[bg];
 
-        currx += A;
-        curry += C;
+    int wrap = control & BIT(13);
+    int mosaic = control & BIT(6);
+
+    // Always 256 colors
+    if (wrap)
+    {
+        if (mosaic)
+            gba_bgdrawaffine_span(fb, visptr, palette, charbaseblockptr,
+                                  scrbaseblockptr, size, 1, ctx->MosBgX,
+                                  x1, x2, currx, curry, A, C);
+        else
+            gba_bgdrawaffine_span(fb, visptr, palette, charbaseblockptr,
+                                  scrbaseblockptr, size, 1, 1,
+                                  x1, x2, currx, curry, A, C);
+    }
+    else
+    {
+        if (mosaic)
+            gba_bgdrawaffine_span(fb, visptr, palette, charbaseblockptr,
+                                  scrbaseblockptr, size, 0, ctx->MosBgX,
+                                  x1, x2, currx, curry, A, C);
+        else
+            gba_bgdrawaffine_span(fb, visptr, palette, charbaseblockptr,
+                                  scrbaseblockptr, size, 0, 1,
+                                  x1, x2, currx, curry, A, C);
     }
 }
 
 //------------------------------------------------------------------------------
 
-static void gba_bg2drawbitmapmode3(UNUSED int32_t y)
+static void gba_bg2drawbitmapmode3(video_renderer *ctx, UNUSED int bg,
+                                   int x1, int x2)
 {
-    int32_t currx = BG2lastx;
-    int32_t curry = BG2lasty;
+    int32_t currx = ctx->line->bg2x;
+    int32_t curry = ctx->line->bg2y;
 
     uint16_t *srcptr = (uint16_t *)MEM_VRAM_ADDR;
 
     // | PA PB |
     // | PC PD |
 
-    int32_t A = (int32_t)(int16_t)REG_BG2PA;
-    int32_t C = (int32_t)(int16_t)REG_BG2PC;
+    int32_t A = ctx->line->bg2pa;
+    int32_t C = ctx->line->bg2pc;
 
-    uint16_t *fb = bgfb[2];
-    int *visptr = bgvisible[2];
+    uint16_t *fb = &ctx->bgfb[2][x1];
+    uint8_t *visptr = &ctx->bgvisible[2][x1];
 
-    for (int i = 0; i < 240; i++)
+    currx += A * x1;
+    curry += C * x1;
+
+    for (int i = x1; i < x2; i++)
     {
         uint32_t _x = (currx >> 8);
         uint32_t _y = (curry >> 8);
@@ -1551,6 +1486,10 @@ static void gba_bg2drawbitmapmode3(UNUSED int32_t y)
             *fb = srcptr[_x + 240 * _y];
             *visptr = 1;
         }
+        else
+        {
+            *visptr = 0;
+        }
         fb++;
         visptr++;
         currx += A;
@@ -1558,31 +1497,39 @@ static void gba_bg2drawbitmapmode3(UNUSED int32_t y)
     }
 }
 
-static void gba_bg2drawbitmapmode4(UNUSED int32_t y)
+static void gba_bg2drawbitmapmode4(video_renderer *ctx, UNUSED int bg,
+                                   int x1, int x2)
 {
-    int32_t currx = BG2lastx;
-    int32_t curry = BG2lasty;
+    int32_t currx = ctx->line->bg2x;
+    int32_t curry = ctx->line->bg2y;
 
-    uint8_t *srcptr = (uint8_t *)&((uint8_t *)MEM_VRAM_ADDR)[(REG_DISPCNT & BIT(4)) ? 0xA000 : 0];
+    uint8_t *srcptr = (uint8_t *)&((uint8_t *)MEM_VRAM_ADDR)[(LINE_REG_16(ctx, OFFSET_DISPCNT) & BIT(4)) ? 0xA000 : 0];
 
     // | PA PB |
     // | PC PD |
 
-    int32_t A = (int32_t)(int16_t)REG_BG2PA;
-    int32_t C = (int32_t)(int16_t)REG_BG2PC;
+    int32_t A = ctx->line->bg2pa;
+    int32_t C = ctx->line->bg2pc;
 
-    uint16_t *fb = bgfb[2];
-    int *visptr = bgvisible[2];
+    uint16_t *fb = &ctx->bgfb[2][x1];
+    uint8_t *visptr = &ctx->bgvisible[2][x1];
 
-    for (int i = 0; i < 240; i++)
+    currx += A * x1;
+    curry += C * x1;
+
+    for (int i = x1; i < x2; i++)
     {
         uint32_t _x = (currx >> 8);
         uint32_t _y = (curry >> 8);
         if (!((_x > 239) || (_y > 159)))
         {
-            *fb = ((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR))[srcptr[_x + 240 * _y]];
+            *fb = ((uint16_t *)((uint8_t *)ctx->line->palette_addr))[srcptr[_x + 240 * _y]];
             *visptr = 1;
         }
+        else
+        {
+            *visptr = 0;
+        }
         fb++;
         visptr++;
         currx += A;
@@ -1590,23 +1537,27 @@ static void gba_bg2drawbitmapmode4(UNUSED int32_t y)
     }
 }
 
-static void gba_bg2drawbitmapmode5(UNUSED int32_t y)
+static void gba_bg2drawbitmapmode5(video_renderer *ctx, UNUSED int bg,
+                                   int x1, int x2)
 {
-    int32_t currx = BG2lastx;
-    int32_t curry = BG2lasty;
+    int32_t currx = ctx->line->bg2x;
+    int32_t curry = ctx->line->bg2y;
 
-    uint16_t *srcptr = (uint16_t *)&((uint8_t *)MEM_VRAM_ADDR)[((REG_DISPCNT & BIT(4)) ? 0xA000 : 0)];
+    uint16_t *srcptr = (uint16_t *)&((uint8_t *)MEM_VRAM_ADDR)[((LINE_REG_16(ctx, OFFSET_DISPCNT) & BIT(4)) ? 0xA000 : 0)];
 
     // | PA PB |
     // | PC PD |
 
-    int32_t A = (int32_t)(int16_t)REG_BG2PA;
-    int32_t C = (int32_t)(int16_t)REG_BG2PC;
+    int32_t A = ctx->line->bg2pa;
+    int32_t C = ctx->line->bg2pc;
 
-    uint16_t *fb = bgfb[2];
-    int *visptr = bgvisible[2];
+    uint16_t *fb = &ctx->bgfb[2][x1];
+    uint8_t *visptr = &ctx->bgvisible[2][x1];
 
-    for (int i = 0; i < 240; i++)
+    currx += A * x1;
+    curry += C * x1;
+
+    for (int i = x1; i < x2; i++)
     {
         uint32_t _x = (currx >> 8);
         uint32_t _y = (curry >> 8);
@@ -1615,6 +1566,10 @@ static void gba_bg2drawbitmapmode5(UNUSED int32_t y)
             *fb = (uint16_t)srcptr[_x + 160 * _y];
             *visptr = 1;
         }
+        else
+        {
+            *visptr = 0;
+        }
         fb++;
         visptr++;
         currx += A;
@@ -1622,793 +1577,339 @@ static void gba_bg2drawbitmapmode5(UNUSED int32_t y)
     }
 }
 
-//------------------------------------------------------------------------------
-
-static void gba_video_all_buffers_clear(void)
-{
-    mem_clear_32((uint32_t *)bgfb, sizeof(bgfb));
-    mem_clear_32((uint32_t *)bgvisible, sizeof(bgvisible));
-    mem_clear_32((uint32_t *)sprfb, sizeof(sprfb));
-    mem_clear_32((uint32_t *)sprvisible, sizeof(sprvisible));
-    mem_clear_32((uint32_t *)sprblend, sizeof(sprblend));
-    mem_clear_32((uint32_t *)sprblendfb, sizeof(sprblendfb));
-    mem_clear_32((uint32_t *)sprwin, sizeof(sprwin));
-    mem_clear_32((uint32_t *)backdrop, sizeof(backdrop));
-}
-
-//------------------------------------------------------------------------------
-
-typedef enum
-{
-    BG0 = 0,
-    BG1,
-    BG2,
-    BG3,
-
-    SPR0,
-    SPR1,
-    SPR2,
-    SPR3,
-
-    BD
-} _layer_type_;
-
-// layer_fb[0] goes at the bottom, layer_fb[layer_active_num - 1] at the top
-static int *layer_vis[9];
-static uint16_t *layer_fb[9];
-static _layer_type_ layer_id[9];
-static int layer_active_num;
-
-static void gba_sort_layers(int video_mode)
+// Bitmap modes are often used to display full screen images (like videos or
+// software rendered scenes) without any other layer or effect. In that case
+// there is no need to go through the layer buffers, the bitmap can be copied
+// straight to the screen. Returns 1 if the scanline has been drawn this way.
+static int gba_bg2drawbitmap_direct(video_renderer *ctx, int32_t y, int mode)
 {
-    // 1 if the layer is active in a specific screen mode
-    static const int bg0act[6] = { 1, 1, 0, 0, 0, 0 };
-    static const int bg1act[6] = { 1, 1, 0, 0, 0, 0 };
-    static const int bg2act[6] = { 1, 1, 1, 1, 1, 1 };
-    static const int bg3act[6] = { 1, 0, 1, 0, 0, 0 };
+    const video_line *line = ctx->line;
 
-    uint16_t cnt = REG_DISPCNT;
+    uint16_t dispcnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
 
-    int bgprio[4];
-    bgprio[0] = ((cnt & BIT(8)) && bg0act[video_mode]) ? (REG_BG0CNT & 3) : -1;
-    bgprio[1] = ((cnt & BIT(9)) && bg1act[video_mode]) ? (REG_BG1CNT & 3) : -1;
-    bgprio[2] = ((cnt & BIT(10)) && bg2act[video_mode]) ? (REG_BG2CNT & 3) : -1;
-    bgprio[3] = ((cnt & BIT(11)) && bg3act[video_mode]) ? (REG_BG3CNT & 3) : -1;
+    // Only BG2 enabled. BG0, BG1 and BG3 aren't used in bitmap modes.
+    uint16_t layers = BIT(10) | BIT(12) | BIT(13) | BIT(14) | BIT(15);
+    if ((dispcnt & layers) != BIT(10))
+        return 0;
 
-    int spren = cnt & BIT(12);
+    // No color effects
+    if (LINE_REG_16(ctx, OFFSET_BLDCNT) & (3 << 6))
+        return 0;
 
-    int cur_layer = 0;
+    // No rotation or scaling, and the scanline starts at the left of the bitmap
+    if ((line->bg2pa != 0x100) || (line->bg2pc != 0) || ((line->bg2x >> 8) != 0))
+        return 0;
 
-    // Backdrop
+    uint32_t width = (mode == 5) ? 160 : 240;
+    uint32_t height = (mode == 5) ? 128 : 160;
 
-    layer_vis[cur_layer] = backdropvisible;
-    layer_fb[cur_layer] = backdrop;
-    layer_id[cur_layer] = BD;
-    cur_layer++;
+    uint32_t _y = line->bg2y >> 8;
+    if (_y >= height)
+        return 0;
 
-    // Priority 3
+    uint16_t *destptr = &line->screen[240 * y];
+    const uint16_t *palette = (const uint16_t *)line->palette_addr;
 
-    for (int i = 3; i >= 0; i--)
-    {
-        if (bgprio[i] == 3)
-        {
-            bgprio[i] = -1;
-            layer_vis[cur_layer] = bgvisible[i];
-            layer_fb[cur_layer] = bgfb[i];
-            layer_id[cur_layer] = BG0 + i;
-            cur_layer++;
-        }
-    }
+    uint32_t page = (dispcnt & BIT(4)) ? 0xA000 : 0;
 
-    if (spren)
+    if (mode == 3)
     {
-        layer_vis[cur_layer] = sprvisible[3];
-        layer_fb[cur_layer] = sprfb[3];
-        layer_id[cur_layer] = SPR3;
-        cur_layer++;
-    }
-
-    // Priority 2
+        const uint16_t *srcptr = (const uint16_t *)MEM_VRAM_ADDR;
 
-    for (int i = 3; i >= 0; i--)
-    {
-        if (bgprio[i] == 2)
-        {
-            bgprio[i] = -1;
-            layer_vis[cur_layer] = bgvisible[i];
-            layer_fb[cur_layer] = bgfb[i];
-            layer_id[cur_layer] = BG0 + i;
-            cur_layer++;
-        }
+        memcpy(destptr, &srcptr[240 * _y], 240 * sizeof(uint16_t));
     }
-
-    if (spren)
+    else if (mode == 4)
     {
-        layer_vis[cur_layer] = sprvisible[2];
-        layer_fb[cur_layer] = sprfb[2];
-        layer_id[cur_layer] = SPR2;
-        cur_layer++;
-    }
+        const uint8_t *srcptr = &((const uint8_t *)MEM_VRAM_ADDR)[page + 240 * _y];
 
-    // Priority 1
-
-    for (int i = 3; i >= 0; i--)
-    {
-        if (bgprio[i] == 1)
-        {
-            bgprio[i] = -1;
-            layer_vis[cur_layer] = bgvisible[i];
-            layer_fb[cur_layer] = bgfb[i];
-            layer_id[cur_layer] = BG0 + i;
-            cur_layer++;
-        }
+        for (int i = 0; i < 240; i++)
+            destptr[i] = palette[srcptr[i]];
     }
-
-    if (spren)
+    else // if (mode == 5)
     {
-        layer_vis[cur_layer] = sprvisible[1];
-        layer_fb[cur_layer] = sprfb[1];
-        layer_id[cur_layer] = SPR1;
-        cur_layer++;
-    }
-
-    // Priority 0
+        const uint16_t *srcptr =
+                (const uint16_t *)&((const uint8_t *)MEM_VRAM_ADDR)[page];
 
-    for (int i = 3; i >= 0; i--)
-    {
-        if (bgprio[i] == 0)
-        {
-            bgprio[i] = -1;
-            layer_vis[cur_layer] = bgvisible[i];
-            layer_fb[cur_layer] = bgfb[i];
-            layer_id[cur_layer] = BG0 + i;
-            cur_layer++;
-        }
-    }
+        memcpy(destptr, &srcptr[160 * _y], width * sizeof(uint16_t));
 
-    if (spren)
-    {
-        layer_vis[cur_layer] = sprvisible[0];
-        layer_fb[cur_layer] = sprfb[0];
-        layer_id[cur_layer] = SPR0;
-        cur_layer++;
+        // The rest of the scanline shows the backdrop
+        for (int i = width; i < 240; i++)
+            destptr[i] = palette[0];
     }
 
-    // End
-
-    layer_active_num = cur_layer; // Total number of active layers
+    return 1;
 }
 
-static void gba_blit_layers(int y)
+//------------------------------------------------------------------------------
+
+// The background buffers don't need to be cleared. Backgrounds only appear in
+// the list of layers if they are enabled, and they write the visibility of all
+// the pixels of the scanline when they are drawn. The colors of all buffers are
+// only read if the pixel is visible, so only the flags need to be cleared.
+//
+// The sprite flags are read even if the OBJ layer is disabled, so they need to
+// be cleared, but only in the columns that sprites have modified.
+static void gba_video_sprite_buffers_clear(video_renderer *ctx)
 {
-    uint16_t *destptr = (uint16_t *)&screen_buffer[240 * y];
+    int x_min = ctx->spr_x_min;
+    int x_max = ctx->spr_x_max;
 
-    for (int i = 0; i < layer_active_num; i++)
-    {
-        uint16_t *dest = destptr;
+    if (x_min >= x_max)
+        return;
 
-        int *vis = layer_vis[i];
-        uint16_t *fb = layer_fb[i];
+    size_t size = x_max - x_min;
 
-        for (int j = 0; j < 240; j++)
-        {
-            if (*vis++)
-                *dest = *fb;
-            dest++;
-            fb++;
-        }
+    for (int i = 0; i < 4; i++)
+    {
+        memset(&ctx->sprvisible[i][x_min], 0, size);
+        memset(&ctx->sprblend[i][x_min], 0, size);
     }
+    memset(&ctx->sprwin[x_min], 0, size);
+
+    ctx->spr_x_min = 240;
+    ctx->spr_x_max = 0;
 }
 
 //------------------------------------------------------------------------------
 
-// Color effect is enabled / disabled by windows
-int win_coloreffect_enable[240];
-
-// bits 13-15 of DISPCNT
-static void gba_window_apply(uint32_t y, uint32_t win0,
-                             uint32_t win1, uint32_t winobj)
+static void gba_sort_layers(video_renderer *ctx, int video_mode)
 {
-    if (!(winobj || win1 || win0))
-    {
-        if ((REG_BLDCNT >> 6) & 3) // Special effect
-        {
-            for (int i = 0; i < 240; i++)
-                win_coloreffect_enable[i] = 1;
-        }
-        return;
-    }
+    // 1 if the layer is active in a specific screen mode
+    static const int bg0act[6] = { 1, 1, 0, 0, 0, 0 };
+    static const int bg1act[6] = { 1, 1, 0, 0, 0, 0 };
+    static const int bg2act[6] = { 1, 1, 1, 1, 1, 1 };
+    static const int bg3act[6] = { 1, 0, 1, 0, 0, 0 };
 
-    uint32_t in0 = REG_WININ & 0xFF;
-    uint32_t in1 = (REG_WININ >> 8) & 0xFF;
-    uint32_t out = REG_WINOUT & 0xFF;
-    uint32_t inobj = (REG_WINOUT >> 8) & 0xFF;
+    uint16_t cnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
 
-    int win_show[240];
+    int bgprio[4];
+    bgprio[0] = ((cnt & BIT(8)) && bg0act[video_mode]) ? (LINE_REG_16(ctx, OFFSET_BG0CNT) & 3) : -1;
+    bgprio[1] = ((cnt & BIT(9)) && bg1act[video_mode]) ? (LINE_REG_16(ctx, OFFSET_BG1CNT) & 3) : -1;
+    bgprio[2] = ((cnt & BIT(10)) && bg2act[video_mode]) ? (LINE_REG_16(ctx, OFFSET_BG2CNT) & 3) : -1;
+    bgprio[3] = ((cnt & BIT(11)) && bg3act[video_mode]) ? (LINE_REG_16(ctx, OFFSET_BG3CNT) & 3) : -1;
 
-    if (REG_DISPCNT & BIT(8))
-    {
-        if (out & BIT(0))
-        {
-            for (int i = 0; i < 240; i++)
-                win_show[i] = 1;
-        }
-        else
-        {
-            memset(win_show, 0, sizeof(win_show));
-        }
+    int spren = cnt & BIT(12);
 
-        if (winobj) // obj has lowest priority
-        {
-            int *show = win_show;
-            int *ptrsprwin = sprwin;
-            if (inobj & BIT(0))
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 1;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-            else
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 0;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-        }
-        if (win1) // Intermediate priority
-        {
-            if (in1 & BIT(0))
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 0;
-                }
-            }
-        }
-        if (win0) // Highest priority
-        {
-            if (in0 & BIT(0))
-            {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 0;
-                }
-            }
-        }
+    int cur_layer = 0;
 
-        int *vis = bgvisible[0];
-        int *show = win_show;
-        for (int i = 0; i < 240; i++)
-        {
-            *vis = *vis && *show;
-            vis++;
-            show++;
-        }
-    }
+    // Backdrop
 
-    if (REG_DISPCNT & BIT(9))
-    {
-        if (out & BIT(1))
-        {
-            for (int i = 0; i < 240; i++)
-                win_show[i] = 1;
-        }
-        else
-        {
-            memset(win_show, 0, sizeof(win_show));
-        }
-        if (winobj) // obj has lowest priority
-        {
-            int *show = win_show;
-            int *ptrsprwin = sprwin;
-            if (inobj & BIT(1))
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 1;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-            else
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 0;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-        }
-        if (win1) // Intermediate priority
-        {
-            if (in1 & BIT(1))
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 0;
-                }
-            }
-        }
-        if (win0) // Highest priority
-        {
-            if (in0 & BIT(1))
-            {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 0;
-                }
-            }
-        }
+    ctx->layer_vis[cur_layer] = ctx->backdropvisible;
+    ctx->layer_fb[cur_layer] = ctx->backdrop;
+    ctx->layer_id[cur_layer] = BD;
+    cur_layer++;
 
-        int *vis = bgvisible[1];
-        int *show = win_show;
-        for (int i = 0; i < 240; i++)
-        {
-            *vis = *vis && *show;
-            vis++;
-            show++;
-        }
-    }
+    // Priority 3
 
-    if (REG_DISPCNT & BIT(10))
+    for (int i = 3; i >= 0; i--)
     {
-        if (out & BIT(2))
-        {
-            for (int i = 0; i < 240; i++)
-                win_show[i] = 1;
-        }
-        else
-        {
-            memset(win_show, 0, sizeof(win_show));
-        }
-        if (winobj) // obj has lowest priority
-        {
-            int *show = win_show;
-            int *ptrsprwin = sprwin;
-            if (inobj & BIT(2))
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 1;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-            else
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 0;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-        }
-        if (win1) // intermediate priority
-        {
-            if (in1 & BIT(2))
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 0;
-                }
-            }
-        }
-        if (win0) // Highest priority
-        {
-            if (in0 & BIT(2))
-            {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 0;
-                }
-            }
-        }
-
-        int *vis = bgvisible[2];
-        int *show = win_show;
-        for (int i = 0; i < 240; i++)
+        if (bgprio[i] == 3)
         {
-            *vis = *vis && *show;
-            vis++;
-            show++;
+            bgprio[i] = -1;
+            ctx->layer_vis[cur_layer] = ctx->bgvisible[i];
+            ctx->layer_fb[cur_layer] = ctx->bgfb[i];
+            ctx->layer_id[cur_layer] = BG0 + i;
+            cur_layer++;
         }
     }
 
-    if (REG_DISPCNT & BIT(11))
+    if (spren)
     {
-        if (out & BIT(3))
-        {
-            for (int i = 0; i < 240; i++)
-                win_show[i] = 1;
-        }
-        else
-        {
-            memset(win_show, 0, sizeof(win_show));
-        }
-        if (winobj) // obj has lowest priority
-        {
-            int *show = win_show;
-            int *ptrsprwin = sprwin;
-            if (inobj & BIT(3))
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 1;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-            else
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 0;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-        }
-        if (win1) // Intermediate priority
-        {
-            if (in1 & BIT(3))
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 0;
-                }
-            }
-        }
-        if (win0) // Highest priority
-        {
-            if (in0 & BIT(3))
-            {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 0;
-                }
-            }
-        }
+        ctx->layer_vis[cur_layer] = ctx->sprvisible[3];
+        ctx->layer_fb[cur_layer] = ctx->sprfb[3];
+        ctx->layer_id[cur_layer] = SPR3;
+        cur_layer++;
+    }
 
-        int *vis = bgvisible[3];
-        int *show = win_show;
-        for (int i = 0; i < 240; i++)
+    // Priority 2
+
+    for (int i = 3; i >= 0; i--)
+    {
+        if (bgprio[i] == 2)
         {
-            *vis = *vis && *show;
-            vis++;
-            show++;
+            bgprio[i] = -1;
+            ctx->layer_vis[cur_layer] = ctx->bgvisible[i];
+            ctx->layer_fb[cur_layer] = ctx->bgfb[i];
+            ctx->layer_id[cur_layer] = BG0 + i;
+            cur_layer++;
         }
     }
 
-    if (REG_DISPCNT & BIT(12)) // Sprites
+    if (spren)
     {
-        if (out & BIT(4))
-        {
-            for (int i = 0; i < 240; i++)
-                win_show[i] = 1;
-        }
-        else
-        {
-            memset(win_show, 0, sizeof(win_show));
-        }
-        if (winobj) // obj has lowest priority
-        {
-            int *show = win_show;
-            int *ptrsprwin = sprwin;
-            if (inobj & BIT(4))
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 1;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-            else
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 0;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-        }
-        if (win1) // Intermediate priority
-        {
-            if (in1 & BIT(4))
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 0;
-                }
-            }
-        }
-        if (win0) // Highest priority
-        {
-            if (in0 & BIT(4))
-            {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 0;
-                }
-            }
-        }
+        ctx->layer_vis[cur_layer] = ctx->sprvisible[2];
+        ctx->layer_fb[cur_layer] = ctx->sprfb[2];
+        ctx->layer_id[cur_layer] = SPR2;
+        cur_layer++;
+    }
 
-        int *vis = sprvisible[0];
-        int *show = win_show;
-        for (int i = 0; i < 240; i++)
-        {
-            *vis = *vis && *show;
-            vis++;
-            show++;
-        }
-        vis = sprvisible[1];
-        show = win_show;
-        for (int i = 0; i < 240; i++)
-        {
-            *vis = *vis && *show;
-            vis++;
-            show++;
-        }
-        vis = sprvisible[2];
-        show = win_show;
-        for (int i = 0; i < 240; i++)
-        {
-            *vis = *vis && *show;
-            vis++;
-            show++;
-        }
-        vis = sprvisible[3];
-        show = win_show;
-        for (int i = 0; i < 240; i++)
+    // Priority 1
+
+    for (int i = 3; i >= 0; i--)
+    {
+        if (bgprio[i] == 1)
         {
-            *vis = *vis && *show;
-            vis++;
-            show++;
+            bgprio[i] = -1;
+            ctx->layer_vis[cur_layer] = ctx->bgvisible[i];
+            ctx->layer_fb[cur_layer] = ctx->bgfb[i];
+            ctx->layer_id[cur_layer] = BG0 + i;
+            cur_layer++;
         }
     }
 
-    if ((REG_BLDCNT >> 6) & 3) // Special effect
+    if (spren)
     {
-        if (out & BIT(5))
-        {
-            for (int i = 0; i < 240; i++)
-                win_show[i] = 1;
-        }
-        else
-        {
-            memset(win_show, 0, sizeof(win_show));
-        }
-        if (winobj) // obj has lowest priority
+        ctx->layer_vis[cur_layer] = ctx->sprvisible[1];
+        ctx->layer_fb[cur_layer] = ctx->sprfb[1];
+        ctx->layer_id[cur_layer] = SPR1;
+        cur_layer++;
+    }
+
+    // Priority 0
+
+    for (int i = 3; i >= 0; i--)
+    {
+        if (bgprio[i] == 0)
         {
-            int *show = win_show;
-            int *ptrsprwin = sprwin;
-            if (inobj & BIT(5))
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 1;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
-            else
-            {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (*ptrsprwin)
-                        *show = 0;
-                    show++;
-                    ptrsprwin++;
-                }
-            }
+            bgprio[i] = -1;
+            ctx->layer_vis[cur_layer] = ctx->bgvisible[i];
+            ctx->layer_fb[cur_layer] = ctx->bgfb[i];
+            ctx->layer_id[cur_layer] = BG0 + i;
+            cur_layer++;
         }
-        if (win1) // Intermediate priority
+    }
+
+    if (spren)
+    {
+        ctx->layer_vis[cur_layer] = ctx->sprvisible[0];
+        ctx->layer_fb[cur_layer] = ctx->sprfb[0];
+        ctx->layer_id[cur_layer] = SPR0;
+        cur_layer++;
+    }
+
+    // End
+
+    ctx->layer_active_num = cur_layer; // Total number of active layers
+}
+
+//------------------------------------------------------------------------------
+
+typedef void (*bg_draw_fn)(video_renderer *ctx, int bg, int x1, int x2);
+
+// Draw a background only in the parts of the scanline that aren't hidden by the
+// windows. The pixels of the hidden parts are set as transparent.
+static void gba_bg_draw(video_renderer *ctx, int bg, bg_draw_fn draw)
+{
+    uint8_t mask = 1 << bg;
+
+    int x1 = 0; // Start of the pixels that haven't been drawn yet
+
+    for (int i = 0; i < ctx->win_span_num; i++)
+    {
+        const window_span *span = &ctx->win_span[i];
+
+        if ((span->enable | span->enable_obj) & mask)
+            continue;
+
+        if (x1 < span->x1)
+            draw(ctx, bg, x1, span->x1);
+
+        memset(&ctx->bgvisible[bg][span->x1], 0, span->x2 - span->x1);
+
+        x1 = span->x2;
+    }
+
+    if (x1 < 240)
+        draw(ctx, bg, x1, 240);
+}
+
+// Apply the windows to the sprites and calculate where color effects are
+// enabled. The backgrounds have already been clipped when they were drawn
+// apart from the pixels that depend on the OBJ window. "layers" has the same
+// format as bits 8-12 of DISPCNT, and it is used to tell which backgrounds have
+// been drawn.
+static void gba_window_apply(video_renderer *ctx, uint16_t layers)
+{
+    // The enable flags of the color effects are calculated even if there is no
+    // special effect. They are also used by semi-transparent sprites.
+
+    for (int i = 0; i < ctx->win_span_num; i++)
+    {
+        const window_span *span = &ctx->win_span[i];
+
+        int x1 = span->x1;
+        int x2 = span->x2;
+
+        if (span->enable == span->enable_obj)
         {
-            if (in1 & BIT(5))
+            if ((layers & BIT(4)) && ((span->enable & BIT(4)) == 0))
             {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 1;
-                }
-            }
-            else
-            {
-                if (y >= Win1Y1 && y <= Win1Y2)
-                {
-                    for (uint32_t i = Win1X1; i < Win1X2; i++)
-                        win_show[i] = 0;
-                }
+                for (int l = 0; l < 4; l++)
+                    memset(&ctx->sprvisible[l][x1], 0, x2 - x1);
             }
+
+            memset(&ctx->win_coloreffect_enable[x1], (span->enable >> 5) & 1,
+                   x2 - x1);
+
+            continue;
         }
-        if (win0) // Highest priority
+
+        // The OBJ window is enabled, so check each pixel
+        for (int j = x1; j < x2; j++)
         {
-            if (in0 & BIT(5))
+            uint8_t enable = ctx->sprwin[j] ? span->enable_obj : span->enable;
+
+            for (int l = 0; l < 4; l++)
             {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 1;
-                }
+                if ((layers & BIT(l)) && ((enable & BIT(l)) == 0))
+                    ctx->bgvisible[l][j] = 0;
             }
-            else
+
+            if ((layers & BIT(4)) && ((enable & BIT(4)) == 0))
             {
-                if (y >= Win0Y1 && y <= Win0Y2)
-                {
-                    for (uint32_t i = Win0X1; i < Win0X2; i++)
-                        win_show[i] = 0;
-                }
+                for (int l = 0; l < 4; l++)
+                    ctx->sprvisible[l][j] = 0;
             }
-        }
 
-        memcpy(win_coloreffect_enable, win_show,
-               sizeof(win_coloreffect_enable));
+            ctx->win_coloreffect_enable[j] = (enable >> 5) & 1;
+        }
     }
 }
 
-static uint16_t white_table[32][17]; // color, evy
-static uint16_t black_table[32][17]; // color, evy
+//------------------------------------------------------------------------------
 
-void GBA_FillFadeTables(void)
+// Returns 1 if semi-transparent sprites need to be blended when there is no
+// color effect selected in BLDCNT. There must be at least one 2nd target layer,
+// and a pixel with color effects enabled by the windows that belongs to a
+// semi-transparent sprite that isn't hidden by a sprite with higher priority.
+static int gba_sprites_blend_needed(video_renderer *ctx, uint16_t bldcnt)
 {
-    for (int i = 0; i < 32; i++)
-    {
-        for (int y = 0; y < 17; y++)
-        {
-            white_table[i][y] = i + (((31 - i) * y) >> 4);
-            black_table[i][y] = i - ((i * y) >> 4);
-        }
-    }
+    if ((bldcnt >> 8) == 0)
+        return 0;
 
-    // Fill array: Backdrop is always visible
     for (int i = 0; i < 240; i++)
     {
-        backdropvisible[i] = 1;
-        win_coloreffect_enable[i] = 1;
-    }
-}
-
-static uint16_t fade_white(uint16_t col, uint16_t evy)
-{
-    return (white_table[(col >> 10) & 0x1F][evy] << 10)
-           | (white_table[(col >> 5) & 0x1F][evy] << 5)
-           | white_table[col & 0x1F][evy];
-}
-static uint16_t fade_black(uint16_t col, uint16_t evy)
-{
-    return (black_table[(col >> 10) & 0x1F][evy] << 10)
-           | (black_table[(col >> 5) & 0x1F][evy] << 5)
-           | black_table[col & 0x1F][evy];
-}
+        if (ctx->win_coloreffect_enable[i] == 0)
+            continue;
 
-static uint16_t min(uint16_t a, uint16_t b)
-{
-    return (a < b) ? a : b;
-}
+        for (int l = 0; l < 4; l++)
+        {
+            if (ctx->sprblend[l][i])
+                return 1;
+            if (ctx->sprvisible[l][i])
+                break;
+        }
+    }
 
-static uint16_t blend(uint16_t col_1, uint16_t col_2,
-                      uint16_t eva, uint16_t evb)
-{
-    uint16_t r = min(31, (((col_1 & 0x1F) * eva) >> 4)
-                            + (((col_2 & 0x1F) * evb) >> 4));
-    uint16_t g = min(31, ((((col_1 >> 5) & 0x1F) * eva) >> 4)
-                            + ((((col_2 >> 5) & 0x1F) * evb) >> 4));
-    uint16_t b = min(31, ((((col_1 >> 10) & 0x1F) * eva) >> 4)
-                            + ((((col_2 >> 10) & 0x1F) * evb) >> 4));
-    return (b << 10) | (g << 5) | r;
+    return 0;
 }
 
-static void gba_effects_apply(void)
+// Calculate the final color of each pixel of the scanline. Only the top two
+// visible layers of a pixel can affect its color, so the sorted list of layers
+// is searched from the top to the bottom, and the search stops as soon as they
+// are found. The colors that need color effects are modified afterwards for the
+// whole scanline at once.
+static void gba_layers_resolve(video_renderer *ctx, int y)
 {
     // Semi-Transparent OBJs
     //
@@ -2430,321 +1931,150 @@ static void gba_effects_apply(void)
     // special effects. Ie. alpha blending and semi-transparency can be used for
     // OBJ-to-BG or BG-to-OBJ , but not for OBJ-to-OBJ.
 
-    for (int l = 0; l < 3; l++)
-    {
-        // This clears sprite layer pixels that have another layer with higher
-        // priority
-        for (int i = 0; i < 240; i++)
-        {
-            if (sprvisible[l][i])
-            {
-                int k = l + 1;
-                for (; k < 4; k++)
-                {
-                    sprvisible[k][i] = 0;
-                    sprblend[k][i] = 0;
-                }
-            }
-        }
-    }
+    uint16_t *destptr = (uint16_t *)&ctx->line->screen[240 * y];
 
-    uint16_t bldcnt = REG_BLDCNT;
+    uint16_t bldcnt = LINE_REG_16(ctx, OFFSET_BLDCNT);
     int mode = (bldcnt >> 6) & 3;
 
-    if (mode == 0) // Nothing -- only blend transparent sprites
+    int num = ctx->layer_active_num;
+
+    if ((mode == 0) && !gba_sprites_blend_needed(ctx, bldcnt))
     {
-        if (bldcnt >> 8) // At least there must be one 2nd target
-        {
-            // If any sprite is in blending mode, continue, else return
-            int ret = 1;
-            int i = 0;
-            while (i < 240)
-            {
-                if (win_coloreffect_enable[i])
-                {
-                    if (sprblend[0][i] | sprblend[1][i] | sprblend[2][i]
-                        | sprblend[3][i])
-                    {
-                        ret = 0;
-                        break;
-                    }
-                }
-                i++;
-            }
-            if (ret)
-                return;
-        }
-        else
+        // Nothing to do apart from finding the top layer. The backdrop is
+        // always visible, so the search always ends.
+        for (int i = 0; i < 240; i++)
         {
-            return;
+            int top = num - 1;
+            while (ctx->layer_vis[top][i] == 0)
+                top--;
+
+            destptr[i] = ctx->layer_fb[top][i];
         }
+
+        return;
     }
 
     int layer_is_first_target[9];
     int layer_is_second_target[9];
-    int layer_is_sprite[9];
-    memset((void *)layer_is_first_target, 0, sizeof(layer_is_first_target));
-    memset((void *)layer_is_second_target, 0, sizeof(layer_is_second_target));
-    memset((void *)layer_is_sprite, 0, sizeof(layer_is_sprite));
+    int layer_sprite[9]; // Sprite priority, or -1 if it isn't a sprite layer
 
-    for (int l = 0; l < layer_active_num; l++)
+    for (int l = 0; l < num; l++)
     {
-        switch (layer_id[l])
-        {
-            case BG0:
-                layer_is_first_target[l] = bldcnt & BIT(0);
-                layer_is_second_target[l] = bldcnt & BIT(8);
-                break;
-            case BG1:
-                layer_is_first_target[l] = bldcnt & BIT(1);
-                layer_is_second_target[l] = bldcnt & BIT(9);
-                break;
-            case BG2:
-                layer_is_first_target[l] = bldcnt & BIT(2);
-                layer_is_second_target[l] = bldcnt & BIT(10);
-                break;
-            case BG3:
-                layer_is_first_target[l] = bldcnt & BIT(3);
-                layer_is_second_target[l] = bldcnt & BIT(11);
-                break;
-            case SPR0:
-                layer_is_sprite[l] = 1;
-                layer_is_first_target[l] = bldcnt & BIT(4);
-                layer_is_second_target[l] = bldcnt & BIT(12);
-                break;
-            case SPR1:
-                layer_is_sprite[l] = 2;
-                layer_is_first_target[l] = bldcnt & BIT(4);
-                layer_is_second_target[l] = bldcnt & BIT(12);
-                break;
-            case SPR2:
-                layer_is_sprite[l] = 3;
-                layer_is_first_target[l] = bldcnt & BIT(4);
-                layer_is_second_target[l] = bldcnt & BIT(12);
-                break;
-            case SPR3:
-                layer_is_sprite[l] = 4;
-                layer_is_first_target[l] = bldcnt & BIT(4);
-                layer_is_second_target[l] = bldcnt & BIT(12);
-                break;
-            case BD:
-                layer_is_first_target[l] = bldcnt & BIT(5);
-                layer_is_second_target[l] = bldcnt & BIT(13);
-                break;
-            default:
-                break; // ???
-        }
+        _layer_type_ id = ctx->layer_id[l];
+
+        int bit;
+        if (id <= BG3)
+            bit = id;
+        else if (id <= SPR3)
+            bit = 4;
+        else // BD
+            bit = 5;
+
+        layer_is_first_target[l] = (bldcnt >> bit) & 1;
+        layer_is_second_target[l] = (bldcnt >> (bit + 8)) & 1;
+        layer_sprite[l] = ((id >= SPR0) && (id <= SPR3)) ? (int)(id - SPR0) : -1;
     }
 
-    uint32_t eva = REG_BLDALPHA & 0x1F;
-    if (eva > 16)
-        eva = 16;
-    uint32_t evb = (REG_BLDALPHA >> 8) & 0x1F;
-    if (evb > 16)
-        evb = 16;
+    uint8_t blend_mask[240];
+    uint8_t fade_mask[240];
+    uint16_t second_target_fb[240];
 
-    if (mode == 1)
+    for (int i = 0; i < 240; i++)
     {
-        // Disable blending for transparent sprites when a 1st-target visible
-        // pixel of any layer has higher priority
-        int already_first_target[240];
-        mem_clear_32((void *)already_first_target,
-                     sizeof(already_first_target));
+        int top = num - 1;
+        while (ctx->layer_vis[top][i] == 0)
+            top--;
+
+        uint16_t color = ctx->layer_fb[top][i];
 
-        for (int l = (layer_active_num - 1); l >= 0; l--)
+        destptr[i] = color;
+        second_target_fb[i] = color;
+        blend_mask[i] = 0;
+        fade_mask[i] = 0;
+
+        int effect = ctx->win_coloreffect_enable[i]
+                     && layer_is_first_target[top];
+
+        int sprite = layer_sprite[top];
+        int semi_transparent = (sprite >= 0) && ctx->sprblend[sprite][i];
+
+        if (!(effect || semi_transparent))
+            continue;
+
+        // Search the second visible layer. If the top layer is a sprite, all
+        // sprite layers under it are ignored.
+        int second = top - 1;
+        while (second >= 0)
         {
-            if (!((layer_id[l] >= SPR0) && (layer_id[l] <= SPR3)))
+            if (ctx->layer_vis[second][i])
             {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (layer_vis[l][i])
-                        already_first_target[i] = 1;
-                }
-            }
-            else
-            {
-                int sprite_layer = layer_id[l] - SPR0;
-                for (int i = 0; i < 240; i++)
-                {
-                    if (already_first_target[i])
-                        sprblend[sprite_layer][i] = 0;
-                }
+                if ((sprite < 0) || (layer_sprite[second] < 0))
+                    break;
             }
+            second--;
         }
-    }
 
-    // Blend transparent-enabled sprites
-    for (int l = layer_active_num - 1; l >= 0; l--)
-    {
-        if (layer_is_sprite[l])
-        {
-            int sprlayer = layer_is_sprite[l] - 1;
+        int blend = (second >= 0) && layer_is_second_target[second];
 
+        if (semi_transparent)
+        {
             // Transparent sprites are always affected by blending even if
             // window disables special effects!!! Tested on hardware
-            for (int i = 0; i < 240; i++) //if (win_coloreffect_enable[i])
+            if (blend)
             {
-                if (sprblend[sprlayer][i])
-                {
-                    // Search a non-transparent second target pixel
-                    int k = l - 1;
-                    for (; k >= 0; k--)
-                    {
-                        if (layer_vis[k][i])
-                        {
-                            if (layer_is_second_target[k])
-                            {
-                                sprfb[sprlayer][i] = blend(
-                                        sprblendfb[sprlayer][i],
-                                        layer_fb[k][i], eva, evb);
-                            }
-                            else
-                            {
-                                sprblend[sprlayer][i] = 0;
-                            }
-                            break;
-                        }
-                    }
-                }
+                second_target_fb[i] = ctx->layer_fb[second][i];
+                blend_mask[i] = 1;
             }
-        }
-    }
-
-    if (mode == 0) // Nothing
-    {
-
-    }
-    else if (mode == 1) // Blend
-    {
-        for (int l = layer_active_num - 1; l >= 0; l--)
-        {
-            if (layer_is_first_target[l])
+            else if (mode >= 2)
             {
-                for (int i = 0; i < 240; i++)
-                {
-                    if (win_coloreffect_enable[i])
-                    {
-                        // Search a non-transparent second target pixel
-                        int k = l - 1;
-                        for (; k >= 0; k--)
-                        {
-                            if (layer_vis[k][i])
-                            {
-                                // Blending is only applied if the two layers
-                                // are together, not if anything in between
-                                if (layer_is_second_target[k])
-                                {
-                                    if (layer_is_sprite[l])
-                                    {
-                                        int sprlayer = layer_is_sprite[l] - 1;
-
-                                        if (sprblend[sprlayer][i] == 0)
-                                        {
-                                            sprfb[sprlayer][i] = blend(
-                                                    sprfb[sprlayer][i],
-                                                    layer_fb[k][i], eva, evb);
-                                        }
-                                    }
-                                    else
-                                    {
-                                        layer_fb[l][i] = blend(layer_fb[l][i],
-                                                               layer_fb[k][i],
-                                                               eva, evb);
-                                    }
-                                }
-                                break;
-                            }
-                        }
-                    }
-                }
+                fade_mask[i] = effect;
             }
         }
-    }
-    else if (mode == 2) // White
-    {
-        uint32_t evy = REG_BLDY & 0x1F;
-        if (evy > 16)
-            evy = 16;
-
-        for (int l = layer_active_num - 1; l >= 0; l--)
+        else if (mode == 1)
         {
-            if (layer_is_first_target[l])
+            // Blending is only applied if the two layers are together, not if
+            // anything in between
+            if (blend)
             {
-                if (layer_is_sprite[l])
-                {
-                    int sprlayer = layer_is_sprite[l] - 1;
-
-                    for (int i = 0; i < 240; i++)
-                    {
-                        if (win_coloreffect_enable[i])
-                        {
-                            if (sprblend[sprlayer][i] == 0)
-                            {
-                                layer_fb[l][i] = fade_white(layer_fb[l][i], evy);
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    for (int i = 0; i < 240; i++)
-                    {
-                        if (win_coloreffect_enable[i])
-                        {
-                            layer_fb[l][i] = fade_white(layer_fb[l][i], evy);
-                        }
-                    }
-                }
+                second_target_fb[i] = ctx->layer_fb[second][i];
+                blend_mask[i] = 1;
             }
         }
+        else if (mode >= 2)
+        {
+            fade_mask[i] = 1;
+        }
     }
-    if (mode == 3) // Black
+
+    uint32_t eva = LINE_REG_16(ctx, OFFSET_BLDALPHA) & 0x1F;
+    if (eva > 16)
+        eva = 16;
+    uint32_t evb = (LINE_REG_16(ctx, OFFSET_BLDALPHA) >> 8) & 0x1F;
+    if (evb > 16)
+        evb = 16;
+
+    GBA_RowBlend(destptr, destptr, second_target_fb, blend_mask, eva, evb, 240);
+
+    if ((mode == 2) || (mode == 3)) // White, black
     {
-        uint32_t evy = REG_BLDY & 0x1F;
+        uint32_t evy = LINE_REG_16(ctx, OFFSET_BLDY) & 0x1F;
         if (evy > 16)
             evy = 16;
 
-        for (int l = layer_active_num - 1; l >= 0; l--)
-        {
-            if (layer_is_first_target[l])
-            {
-                if (layer_is_sprite[l])
-                {
-                    int sprlayer = layer_is_sprite[l] - 1;
-
-                    for (int i = 0; i < 240; i++)
-                    {
-                        if (win_coloreffect_enable[i])
-                        {
-                            if (sprblend[sprlayer][i] == 0)
-                            {
-                                layer_fb[l][i] = fade_black(layer_fb[l][i], evy);
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    for (int i = 0; i < 240; i++)
-                    {
-                        if (win_coloreffect_enable[i])
-                        {
-                            layer_fb[l][i] = fade_black(layer_fb[l][i], evy);
-                        }
-                    }
-                }
-            }
-        }
+        if (mode == 2)
+            GBA_RowFadeWhite(destptr, fade_mask, evy, 240);
+        else
+            GBA_RowFadeBlack(destptr, fade_mask, evy, 240);
     }
 }
 
 //------------------------------------------------------------------------------
 
-static void gba_greenswap_apply(int y)
+static void gba_greenswap_apply(video_renderer *ctx, int y)
 {
-    if (REG_GREENSWAP & 1)
+    if (LINE_REG_16(ctx, OFFSET_GREENSWAP) & 1)
     {
-        uint16_t *destptr = (uint16_t *)&screen_buffer[240 * y];
+        uint16_t *destptr = (uint16_t *)&ctx->line->screen[240 * y];
         for (int i = 0; i < 240; i += 2)
         {
             uint16_t pix1 = *destptr;
@@ -2757,169 +2087,189 @@ static void gba_greenswap_apply(int y)
 
 //------------------------------------------------------------------------------
 
-static void GBA_DrawScanlineMode0(int32_t y)
+static void GBA_DrawScanlineMode0(video_renderer *ctx, int32_t y)
 {
-    gba_video_all_buffers_clear();
+    uint16_t dispcnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
+
+    gba_video_sprite_buffers_clear(ctx);
 
     // Draw layers
-    uint16_t bd_col = *((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR));
+    uint16_t bd_col = *((uint16_t *)((uint8_t *)ctx->line->palette_addr));
     for (int i = 0; i < 240; i++)
-        backdrop[i] = bd_col;
-    if (REG_DISPCNT & BIT(8))
-        gba_bg0drawtext(y);
-    if (REG_DISPCNT & BIT(9))
-        gba_bg1drawtext(y);
-    if (REG_DISPCNT & BIT(10))
-        gba_bg2drawtext(y);
-    if (REG_DISPCNT & BIT(11))
-        gba_bg3drawtext(y);
-    if (REG_DISPCNT & BIT(12))
-        gba_sprites_draw_mode012(y);
-
-    gba_window_apply(y, REG_DISPCNT & BIT(13), REG_DISPCNT & BIT(14),
-                     REG_DISPCNT & BIT(15));
+        ctx->backdrop[i] = bd_col;
+    if (dispcnt & BIT(8))
+        gba_bg_draw(ctx, 0, gba_bgdrawtext);
+    if (dispcnt & BIT(9))
+        gba_bg_draw(ctx, 1, gba_bgdrawtext);
+    if (dispcnt & BIT(10))
+        gba_bg_draw(ctx, 2, gba_bgdrawtext);
+    if (dispcnt & BIT(11))
+        gba_bg_draw(ctx, 3, gba_bgdrawtext);
+    if (dispcnt & BIT(12))
+        gba_sprites_draw(ctx, y, 0);
+
+    gba_window_apply(ctx, (dispcnt >> 8) & 0x1F);
 
     // Mix
-    gba_sort_layers(0);
-    gba_effects_apply();
-    gba_blit_layers(y);
-    gba_greenswap_apply(y);
+    gba_sort_layers(ctx, 0);
+    gba_layers_resolve(ctx, y);
+    gba_greenswap_apply(ctx, y);
 }
 
-static void GBA_DrawScanlineMode1(int32_t y)
+static void GBA_DrawScanlineMode1(video_renderer *ctx, int32_t y)
 {
-    gba_video_all_buffers_clear();
+    uint16_t dispcnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
+
+    gba_video_sprite_buffers_clear(ctx);
 
     // Draw layers
-    uint16_t bd_col = *((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR));
+    uint16_t bd_col = *((uint16_t *)((uint8_t *)ctx->line->palette_addr));
     for (int i = 0; i < 240; i++)
-        backdrop[i] = bd_col;
-    if (REG_DISPCNT & BIT(8))
-        gba_bg0drawtext(y);
-    if (REG_DISPCNT & BIT(9))
-        gba_bg1drawtext(y);
-    if (REG_DISPCNT & BIT(10))
-        gba_bg2drawaffine(y);
-    if (REG_DISPCNT & BIT(12))
-        gba_sprites_draw_mode012(y);
-    gba_window_apply(y, REG_DISPCNT & BIT(13), REG_DISPCNT & BIT(14),
-                     REG_DISPCNT & BIT(15));
+        ctx->backdrop[i] = bd_col;
+    if (dispcnt & BIT(8))
+        gba_bg_draw(ctx, 0, gba_bgdrawtext);
+    if (dispcnt & BIT(9))
+        gba_bg_draw(ctx, 1, gba_bgdrawtext);
+    if (dispcnt & BIT(10))
+        gba_bg_draw(ctx, 2, gba_bgdrawaffine);
+    if (dispcnt & BIT(12))
+        gba_sprites_draw(ctx, y, 0);
+    gba_window_apply(ctx, (dispcnt >> 8) & 0x17);
 
     // Mix
-    gba_sort_layers(1);
-    gba_effects_apply();
-    gba_blit_layers(y);
-    gba_greenswap_apply(y);
+    gba_sort_layers(ctx, 1);
+    gba_layers_resolve(ctx, y);
+    gba_greenswap_apply(ctx, y);
 }
 
-static void GBA_DrawScanlineMode2(int32_t y)
+static void GBA_DrawScanlineMode2(video_renderer *ctx, int32_t y)
 {
-    gba_video_all_buffers_clear();
+    uint16_t dispcnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
+
+    gba_video_sprite_buffers_clear(ctx);
 
     // Draw layers
-    uint16_t bd_col = *((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR));
+    uint16_t bd_col = *((uint16_t *)((uint8_t *)ctx->line->palette_addr));
     for (int i = 0; i < 240; i++)
-        backdrop[i] = bd_col;
-    if (REG_DISPCNT & BIT(10))
-        gba_bg2drawaffine(y);
-    if (REG_DISPCNT & BIT(11))
-        gba_bg3drawaffine(y);
-    if (REG_DISPCNT & BIT(12))
-        gba_sprites_draw_mode012(y);
-    gba_window_apply(y, REG_DISPCNT & BIT(13), REG_DISPCNT & BIT(14),
-                     REG_DISPCNT & BIT(15));
+        ctx->backdrop[i] = bd_col;
+    if (dispcnt & BIT(10))
+        gba_bg_draw(ctx, 2, gba_bgdrawaffine);
+    if (dispcnt & BIT(11))
+        gba_bg_draw(ctx, 3, gba_bgdrawaffine);
+    if (dispcnt & BIT(12))
+        gba_sprites_draw(ctx, y, 0);
+    gba_window_apply(ctx, (dispcnt >> 8) & 0x1C);
 
     // Mix
-    gba_sort_layers(2);
-    gba_effects_apply();
-    gba_blit_layers(y);
-    gba_greenswap_apply(y);
+    gba_sort_layers(ctx, 2);
+    gba_layers_resolve(ctx, y);
+    gba_greenswap_apply(ctx, y);
 }
 
-static void GBA_DrawScanlineMode3(int32_t y)
+static void GBA_DrawScanlineMode3(video_renderer *ctx, int32_t y)
 {
-    gba_video_all_buffers_clear();
+    uint16_t dispcnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
+
+    if (gba_bg2drawbitmap_direct(ctx, y, 3))
+    {
+        gba_greenswap_apply(ctx, y);
+        return;
+    }
+
+    gba_video_sprite_buffers_clear(ctx);
 
     // Draw layers
-    uint16_t bd_col = *((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR));
+    uint16_t bd_col = *((uint16_t *)((uint8_t *)ctx->line->palette_addr));
     for (int i = 0; i < 240; i++)
-        backdrop[i] = bd_col;
-    if (REG_DISPCNT & BIT(12))
-        gba_sprites_draw_mode345(y);
-    if (REG_DISPCNT & BIT(10)) // BG2 enabled
-        gba_bg2drawbitmapmode3(y);
-    gba_window_apply(y, REG_DISPCNT & BIT(13), REG_DISPCNT & BIT(14),
-                     REG_DISPCNT & BIT(15));
+        ctx->backdrop[i] = bd_col;
+    if (dispcnt & BIT(12))
+        gba_sprites_draw(ctx, y, 1);
+    if (dispcnt & BIT(10)) // BG2 enabled
+        gba_bg_draw(ctx, 2, gba_bg2drawbitmapmode3);
+    gba_window_apply(ctx, (dispcnt >> 8) & 0x14);
 
     // Mix
-    gba_sort_layers(3);
-    gba_effects_apply();
-    gba_blit_layers(y);
-    gba_greenswap_apply(y);
+    gba_sort_layers(ctx, 3);
+    gba_layers_resolve(ctx, y);
+    gba_greenswap_apply(ctx, y);
 }
 
-static void GBA_DrawScanlineMode4(int32_t y)
+static void GBA_DrawScanlineMode4(video_renderer *ctx, int32_t y)
 {
-    gba_video_all_buffers_clear();
+    uint16_t dispcnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
+
+    if (gba_bg2drawbitmap_direct(ctx, y, 4))
+    {
+        gba_greenswap_apply(ctx, y);
+        return;
+    }
+
+    gba_video_sprite_buffers_clear(ctx);
 
     // Draw layers
-    uint16_t bd_col = *((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR));
+    uint16_t bd_col = *((uint16_t *)((uint8_t *)ctx->line->palette_addr));
     for (int i = 0; i < 240; i++)
-        backdrop[i] = bd_col;
-    if (REG_DISPCNT & BIT(12))
-        gba_sprites_draw_mode345(y);
-    if (REG_DISPCNT & BIT(10)) // BG2 enabled
-        gba_bg2drawbitmapmode4(y);
-    gba_window_apply(y, REG_DISPCNT & BIT(13), REG_DISPCNT & BIT(14),
-                     REG_DISPCNT & BIT(15));
+        ctx->backdrop[i] = bd_col;
+    if (dispcnt & BIT(12))
+        gba_sprites_draw(ctx, y, 1);
+    if (dispcnt & BIT(10)) // BG2 enabled
+        gba_bg_draw(ctx, 2, gba_bg2drawbitmapmode4);
+    gba_window_apply(ctx, (dispcnt >> 8) & 0x14);
 
     // Mix
-    gba_sort_layers(4);
-    gba_effects_apply();
-    gba_blit_layers(y);
-    gba_greenswap_apply(y);
+    gba_sort_layers(ctx, 4);
+    gba_layers_resolve(ctx, y);
+    gba_greenswap_apply(ctx, y);
 }
 
-static void GBA_DrawScanlineMode5(int32_t y)
+static void GBA_DrawScanlineMode5(video_renderer *ctx, int32_t y)
 {
-    gba_video_all_buffers_clear();
+    uint16_t dispcnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
+
+    if (gba_bg2drawbitmap_direct(ctx, y, 5))
+    {
+        gba_greenswap_apply(ctx, y);
+        return;
+    }
+
+    gba_video_sprite_buffers_clear(ctx);
 
     // Draw layers
-    uint16_t bd_col = *((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR));
+    uint16_t bd_col = *((uint16_t *)((uint8_t *)ctx->line->palette_addr));
     for (int i = 0; i < 240; i++)
-        backdrop[i] = bd_col;
-    if (REG_DISPCNT & BIT(12))
-        gba_sprites_draw_mode345(y);
-    if (REG_DISPCNT & BIT(10)) // BG2 enabled
-        gba_bg2drawbitmapmode5(y);
-    gba_window_apply(y, REG_DISPCNT & BIT(13), REG_DISPCNT & BIT(14),
-                     REG_DISPCNT & BIT(15));
+        ctx->backdrop[i] = bd_col;
+    if (dispcnt & BIT(12))
+        gba_sprites_draw(ctx, y, 1);
+    if (dispcnt & BIT(10)) // BG2 enabled
+        gba_bg_draw(ctx, 2, gba_bg2drawbitmapmode5);
+    gba_window_apply(ctx, (dispcnt >> 8) & 0x14);
 
     // Mix
-    gba_sort_layers(5);
-    gba_effects_apply();
-    gba_blit_layers(y);
-    gba_greenswap_apply(y);
+    gba_sort_layers(ctx, 5);
+    gba_layers_resolve(ctx, y);
+    gba_greenswap_apply(ctx, y);
 }
 
-static void GBA_DrawScanlineMode67(int32_t y)
+static void GBA_DrawScanlineMode67(video_renderer *ctx, int32_t y)
 {
-    gba_video_all_buffers_clear();
+    uint16_t dispcnt = LINE_REG_16(ctx, OFFSET_DISPCNT);
+
+    gba_video_sprite_buffers_clear(ctx);
 
     // Draw layers
-    uint16_t bd_col = *((uint16_t *)((uint8_t *)MEM_PALETTE_ADDR));
+    uint16_t bd_col = *((uint16_t *)((uint8_t *)ctx->line->palette_addr));
     for (int i = 0; i < 240; i++)
-        backdrop[i] = bd_col;
-    if (REG_DISPCNT & BIT(12))
-        gba_sprites_draw_mode345(y);
-    gba_window_apply(y, REG_DISPCNT & BIT(13), REG_DISPCNT & BIT(14),
-                     REG_DISPCNT & BIT(15));
+        ctx->backdrop[i] = bd_col;
+    if (dispcnt & BIT(10)) // BG2 enabled, but there is no bitmap to draw
+        memset(ctx->bgvisible[2], 0, sizeof(ctx->bgvisible[2]));
+    if (dispcnt & BIT(12))
+        gba_sprites_draw(ctx, y, 1);
+    gba_window_apply(ctx, (dispcnt >> 8) & 0x10);
 
     // Mix
-    gba_sort_layers(5);
-    gba_effects_apply();
-    gba_blit_layers(y);
-    gba_greenswap_apply(y);
+    gba_sort_layers(ctx, 5);
+    gba_layers_resolve(ctx, y);
+    gba_greenswap_apply(ctx, y);
 }
 
 //------------------------------------------------------------------------------
@@ -2961,30 +2311,68 @@ void GBA_VideoUpdateRegister(uint32_t offset)
 
 //------------------------------------------------------------------------------
 
-void GBA_ConvertScreenBufferTo32RGB(void *dst)
+int GBA_ScreenGetDirtyLines(int y, int *y1, int *y2)
 {
-    uint16_t *src = screen_buffer_array[curr_screen_buffer ^ 1];
-    uint32_t *dest = (uint32_t *)dst;
-    for (int i = 0; i < 240 * 160; i++)
-    {
-        uint32_t data = (uint32_t)*src++;
-        *dest++ = ((data & 0x1F) << 3)
-                  | ((data & (0x1F << 5)) << 6)
-                  | ((data & (0x1F << 10)) << 9)
-                  | (0xFF << 24);
-    }
+    const uint8_t *dirty = screen_dirty_array[curr_screen_buffer ^ 1];
+
+    while ((y < 160) && (dirty[y] == 0))
+        y++;
+
+    if (y >= 160)
+        return 0;
+
+    *y1 = y;
+
+    while ((y < 160) && (dirty[y] != 0))
+        y++;
+
+    *y2 = y;
+
+    return 1;
 }
 
-void GBA_ConvertScreenBufferTo24RGB(void *dst)
+void GBA_ConvertScreenLinesTo32RGB(void *dst, int y1, int y2)
+{
+    uint16_t *src = &screen_buffer_array[curr_screen_buffer ^ 1][240 * y1];
+
+    GBA_ColorConvertToRGBA8888(dst, src, 240 * (y2 - y1));
+}
+
+void GBA_ConvertScreenLinesToBGRA8888(void *dst, int pitch, int y1, int y2)
 {
-    uint16_t *src = screen_buffer_array[curr_screen_buffer ^ 1];
-    uint8_t *dest = (void *)dst;
+    uint16_t *src = &screen_buffer_array[curr_screen_buffer ^ 1][240 * y1];
 
-    for (int i = 0; i < 240 * 160; i++)
+    for (int j = 0; j < y2 - y1; j++)
     {
-        uint32_t data = (uint32_t)*src++;
-        *dest++ = (data & 0x1F) << 3;
-        *dest++ = (data & (0x1F << 5)) >> 2;
-        *dest++ = (data & (0x1F << 10)) >> 7;
+        GBA_ColorConvertToBGRA8888((uint8_t *)dst + j * pitch, src, 240);
+        src += 240;
     }
 }
+
+void GBA_ConvertScreenLinesTo24RGB(void *dst, int y1, int y2)
+{
+    uint16_t *src = &screen_buffer_array[curr_screen_buffer ^ 1][240 * y1];
+
+    GBA_ColorConvertToRGB888(dst, src, 240 * (y2 - y1));
+}
+
+void GBA_ScreenCopyDrawnFrame(uint16_t *dst)
+{
+    memcpy(dst, screen_buffer_array[curr_screen_buffer],
+           sizeof(screen_buffer_array[0]));
+}
+
+void GBA_ConvertScreenBufferTo32RGB(void *dst)
+{
+    GBA_ConvertScreenLinesTo32RGB(dst, 0, 160);
+}
+
+void GBA_ConvertScreenBufferToBGRA8888(void *dst, int pitch)
+{
+    GBA_ConvertScreenLinesToBGRA8888(dst, pitch, 0, 160);
+}
+
+void GBA_ConvertScreenBufferTo24RGB(void *dst)
+{
+    GBA_ConvertScreenLinesTo24RGB(dst, 0, 160);
+}
@@ -5,24 +5,70 @@
 #ifndef SDL2_CORE_VIDEO__
 #define SDL2_CORE_VIDEO__
 
+#include <stdint.h>
+
+#include "context.h"
+#include "state.h"
+
+extern gba_video_state gba_video_state_default;
+
+gba_video_state *GBA_VideoStateCreate(void);
+void GBA_VideoStateDestroy(gba_video_state *state);
+
+// Only the internal registers of the affine backgrounds are saved. Everything
+// else is derived from the video memory and the I/O registers.
+void GBA_VideoStateSave(gba_state *s);
+void GBA_VideoStateLoad(gba_state *s);
+
 void GBA_SkipFrame(int skip);
 int GBA_HasToSkipFrame(void);
 
-// Must be called to fill the look up tables used for blending effects.
+// Must be called to initialize the buffers used for blending effects.
 void GBA_FillFadeTables(void);
 
-// Note: The correct way of emulating is drawing a pixel every 4 clocks. This is
-// an optimization that makes pretty much all games show as expected.
-void GBA_UpdateDrawScanlineFn(void);
+// Set the number of threads used to draw the screen, including the thread of
+// the game. If it is 1, each scanline is drawn as soon as it is reached. If it
+// is 0, one thread per CPU core is used. Otherwise, the state of each scanline
+// is saved when it is reached, and all of them are drawn in parallel during
+// GBA_DrawFrameFinish().
+void GBA_VideoThreadsInit(int num_threads);
+void GBA_VideoThreadsEnd(void);
 
 void GBA_VideoUpdateRegister(unsigned int address);
 
+// Note: The correct way of emulating is drawing a pixel every 4 clocks. This is
+// an optimization that makes pretty much all games show as expected.
 void GBA_DrawScanline(int y);
 void GBA_DrawScanlineWhite(int y);
 
+// Must be called at the start of the VBL period. It draws all scanlines that
+// haven't been drawn yet and waits until they are finished.
+void GBA_DrawFrameFinish(void);
+
+// Looks for the next range of scanlines of the last frame that are different
+// from the previous frame, starting at scanline "y". It returns 0 if there are
+// no more changes. If there are, it returns 1 and the first scanline of the
+// range in "y1" and the end of the range (not included) in "y2".
+int GBA_ScreenGetDirtyLines(int y, int *y1, int *y2);
+
+// Convert the scanlines from "y1" to "y2" (not included) of the last frame.
+// "dst" is where the first of them is written.
+void GBA_ConvertScreenLinesTo24RGB(void *dst, int y1, int y2);
+void GBA_ConvertScreenLinesTo32RGB(void *dst, int y1, int y2);
+void GBA_ConvertScreenLinesToBGRA8888(void *dst, int pitch, int y1, int y2);
+
+// Copy the frame that has been drawn last as BGR555 colors. During the VBL
+// period it is one frame ahead of the frame returned by the other functions,
+// which is the one shown on the screen. If frames are being skipped, it is the
+// last frame that was drawn.
+void GBA_ScreenCopyDrawnFrame(uint16_t *dst);
+
 // 24-bit RGB
 void GBA_ConvertScreenBufferTo24RGB(void *dst);
 // 32-bit RGB (with alpha set to 255 in all pixels)
 void GBA_ConvertScreenBufferTo32RGB(void *dst);
+// SDL_PIXELFORMAT_BGRA32 (alpha set to 255). "pitch" is the size of a row of
+// the destination in bytes.
+void GBA_ConvertScreenBufferToBGRA8888(void *dst, int pitch);
 
 #endif // SDL2_CORE_VIDEO__
@@ -0,0 +1,282 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <stdint.h>
+
+#include "video_simd.h"
+
+// Vector helpers
+// ==============
+//
+// All kernels are written using the macros below. Each lane holds one BGR555
+// pixel, so that the color components can be isolated with shifts and masks and
+// processed at the same time. None of the intermediate values can overflow 16
+// bits: the biggest one is 31 * 16 = 496.
+
+#if defined(__AVX2__)
+
+# include <immintrin.h>
+
+# define VEC_PIXELS         16
+
+typedef __m256i vec_t;
+
+# define vec_load(p)        _mm256_loadu_si256((const __m256i *)(p))
+# define vec_store(p, v)    _mm256_storeu_si256((__m256i *)(p), (v))
+# define vec_set1(n)        _mm256_set1_epi16(n)
+# define vec_and(a, b)      _mm256_and_si256((a), (b))
+# define vec_or(a, b)       _mm256_or_si256((a), (b))
+# define vec_add(a, b)      _mm256_add_epi16((a), (b))
+# define vec_sub(a, b)      _mm256_sub_epi16((a), (b))
+# define vec_mul(a, b)      _mm256_mullo_epi16((a), (b))
+# define vec_min(a, b)      _mm256_min_epi16((a), (b))
+# define vec_shr(v, n)      _mm256_srli_epi16((v), (n))
+# define vec_shl(v, n)      _mm256_slli_epi16((v), (n))
+# define vec_select(m, a, b) \
+        _mm256_or_si256(_mm256_and_si256((m), (a)), _mm256_andnot_si256((m), (b)))
+
+static inline vec_t vec_load_mask(const uint8_t *mask)
+{
+    __m256i m = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)mask));
+    __m256i zero = _mm256_cmpeq_epi16(m, _mm256_setzero_si256());
+    return _mm256_xor_si256(zero, _mm256_set1_epi16(-1));
+}
+
+#elif defined(__SSE2__)
+
+# include <emmintrin.h>
+
+# define VEC_PIXELS         8
+
+typedef __m128i vec_t;
+
+# define vec_load(p)        _mm_loadu_si128((const __m128i *)(p))
+# define vec_store(p, v)    _mm_storeu_si128((__m128i *)(p), (v))
+# define vec_set1(n)        _mm_set1_epi16(n)
+# define vec_and(a, b)      _mm_and_si128((a), (b))
+# define vec_or(a, b)       _mm_or_si128((a), (b))
+# define vec_add(a, b)      _mm_add_epi16((a), (b))
+# define vec_sub(a, b)      _mm_sub_epi16((a), (b))
+# define vec_mul(a, b)      _mm_mullo_epi16((a), (b))
+# define vec_min(a, b)      _mm_min_epi16((a), (b))
+# define vec_shr(v, n)      _mm_srli_epi16((v), (n))
+# define vec_shl(v, n)      _mm_slli_epi16((v), (n))
+# define vec_select(m, a, b) \
+        _mm_or_si128(_mm_and_si128((m), (a)), _mm_andnot_si128((m), (b)))
+
+static inline vec_t vec_load_mask(const uint8_t *mask)
+{
+    __m128i m = _mm_loadl_epi64((const __m128i *)mask);
+    m = _mm_unpacklo_epi8(m, m);
+    __m128i zero = _mm_cmpeq_epi16(m, _mm_setzero_si128());
+    return _mm_xor_si128(zero, _mm_set1_epi16(-1));
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+# include <arm_neon.h>
+
+# define VEC_PIXELS         8
+
+typedef uint16x8_t vec_t;
+
+# define vec_load(p)        vld1q_u16(p)
+# define vec_store(p, v)    vst1q_u16((p), (v))
+# define vec_set1(n)        vdupq_n_u16(n)
+# define vec_and(a, b)      vandq_u16((a), (b))
+# define vec_or(a, b)       vorrq_u16((a), (b))
+# define vec_add(a, b)      vaddq_u16((a), (b))
+# define vec_sub(a, b)      vsubq_u16((a), (b))
+# define vec_mul(a, b)      vmulq_u16((a), (b))
+# define vec_min(a, b)      vminq_u16((a), (b))
+# define vec_shr(v, n)      vshrq_n_u16((v), (n))
+# define vec_shl(v, n)      vshlq_n_u16((v), (n))
+# define vec_select(m, a, b) vbslq_u16((m), (a), (b))
+
+static inline vec_t vec_load_mask(const uint8_t *mask)
+{
+    uint16x8_t m = vmovl_u8(vld1_u8(mask));
+    return vtstq_u16(m, m);
+}
+
+#else
+
+# define VEC_PIXELS         0
+
+#endif
+
+#if VEC_PIXELS > 0
+
+static inline vec_t vec_fade_white(vec_t col, vec_t evy)
+{
+    vec_t m31 = vec_set1(0x1F);
+
+    vec_t r = vec_and(col, m31);
+    vec_t g = vec_and(vec_shr(col, 5), m31);
+    vec_t b = vec_and(vec_shr(col, 10), m31);
+
+    r = vec_add(r, vec_shr(vec_mul(vec_sub(m31, r), evy), 4));
+    g = vec_add(g, vec_shr(vec_mul(vec_sub(m31, g), evy), 4));
+    b = vec_add(b, vec_shr(vec_mul(vec_sub(m31, b), evy), 4));
+
+    return vec_or(vec_or(vec_shl(b, 10), vec_shl(g, 5)), r);
+}
+
+static inline vec_t vec_fade_black(vec_t col, vec_t evy)
+{
+    vec_t m31 = vec_set1(0x1F);
+
+    vec_t r = vec_and(col, m31);
+    vec_t g = vec_and(vec_shr(col, 5), m31);
+    vec_t b = vec_and(vec_shr(col, 10), m31);
+
+    r = vec_sub(r, vec_shr(vec_mul(r, evy), 4));
+    g = vec_sub(g, vec_shr(vec_mul(g, evy), 4));
+    b = vec_sub(b, vec_shr(vec_mul(b, evy), 4));
+
+    return vec_or(vec_or(vec_shl(b, 10), vec_shl(g, 5)), r);
+}
+
+static inline vec_t vec_blend(vec_t col_1, vec_t col_2, vec_t eva, vec_t evb)
+{
+    vec_t m31 = vec_set1(0x1F);
+
+    vec_t r1 = vec_and(col_1, m31);
+    vec_t g1 = vec_and(vec_shr(col_1, 5), m31);
+    vec_t b1 = vec_and(vec_shr(col_1, 10), m31);
+
+    vec_t r2 = vec_and(col_2, m31);
+    vec_t g2 = vec_and(vec_shr(col_2, 5), m31);
+    vec_t b2 = vec_and(vec_shr(col_2, 10), m31);
+
+    vec_t r = vec_min(m31, vec_add(vec_shr(vec_mul(r1, eva), 4),
+                                   vec_shr(vec_mul(r2, evb), 4)));
+    vec_t g = vec_min(m31, vec_add(vec_shr(vec_mul(g1, eva), 4),
+                                   vec_shr(vec_mul(g2, evb), 4)));
+    vec_t b = vec_min(m31, vec_add(vec_shr(vec_mul(b1, eva), 4),
+                                   vec_shr(vec_mul(b2, evb), 4)));
+
+    return vec_or(vec_or(vec_shl(b, 10), vec_shl(g, 5)), r);
+}
+
+#endif // VEC_PIXELS > 0
+
+// Scalar helpers
+// ==============
+
+static inline uint16_t fade_white(uint16_t col, uint32_t evy)
+{
+    uint32_t r = col & 0x1F;
+    uint32_t g = (col >> 5) & 0x1F;
+    uint32_t b = (col >> 10) & 0x1F;
+
+    r += ((31 - r) * evy) >> 4;
+    g += ((31 - g) * evy) >> 4;
+    b += ((31 - b) * evy) >> 4;
+
+    return (b << 10) | (g << 5) | r;
+}
+
+static inline uint16_t fade_black(uint16_t col, uint32_t evy)
+{
+    uint32_t r = col & 0x1F;
+    uint32_t g = (col >> 5) & 0x1F;
+    uint32_t b = (col >> 10) & 0x1F;
+
+    r -= (r * evy) >> 4;
+    g -= (g * evy) >> 4;
+    b -= (b * evy) >> 4;
+
+    return (b << 10) | (g << 5) | r;
+}
+
+static inline uint32_t min_u32(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+static inline uint16_t blend(uint16_t col_1, uint16_t col_2,
+                             uint32_t eva, uint32_t evb)
+{
+    uint32_t r = min_u32(31, (((col_1 & 0x1F) * eva) >> 4)
+                             + (((col_2 & 0x1F) * evb) >> 4));
+    uint32_t g = min_u32(31, ((((col_1 >> 5) & 0x1F) * eva) >> 4)
+                             + ((((col_2 >> 5) & 0x1F) * evb) >> 4));
+    uint32_t b = min_u32(31, ((((col_1 >> 10) & 0x1F) * eva) >> 4)
+                             + ((((col_2 >> 10) & 0x1F) * evb) >> 4));
+    return (b << 10) | (g << 5) | r;
+}
+
+// Kernels
+// =======
+
+void GBA_RowFadeWhite(uint16_t *fb, const uint8_t *mask, uint32_t evy,
+                      int count)
+{
+    int i = 0;
+
+#if VEC_PIXELS > 0
+    vec_t vevy = vec_set1(evy);
+
+    for (; i + VEC_PIXELS <= count; i += VEC_PIXELS)
+    {
+        vec_t m = vec_load_mask(&mask[i]);
+        vec_t col = vec_load(&fb[i]);
+        vec_store(&fb[i], vec_select(m, vec_fade_white(col, vevy), col));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        if (mask[i])
+            fb[i] = fade_white(fb[i], evy);
+    }
+}
+
+void GBA_RowFadeBlack(uint16_t *fb, const uint8_t *mask, uint32_t evy,
+                      int count)
+{
+    int i = 0;
+
+#if VEC_PIXELS > 0
+    vec_t vevy = vec_set1(evy);
+
+    for (; i + VEC_PIXELS <= count; i += VEC_PIXELS)
+    {
+        vec_t m = vec_load_mask(&mask[i]);
+        vec_t col = vec_load(&fb[i]);
+        vec_store(&fb[i], vec_select(m, vec_fade_black(col, vevy), col));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        if (mask[i])
+            fb[i] = fade_black(fb[i], evy);
+    }
+}
+
+void GBA_RowBlend(uint16_t *dst, const uint16_t *a, const uint16_t *b,
+                  const uint8_t *mask, uint32_t eva, uint32_t evb, int count)
+{
+    int i = 0;
+
+#if VEC_PIXELS > 0
+    vec_t veva = vec_set1(eva);
+    vec_t vevb = vec_set1(evb);
+
+    for (; i + VEC_PIXELS <= count; i += VEC_PIXELS)
+    {
+        vec_t m = vec_load_mask(&mask[i]);
+        vec_t col = vec_blend(vec_load(&a[i]), vec_load(&b[i]), veva, vevb);
+        vec_store(&dst[i], vec_select(m, col, vec_load(&dst[i])));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        if (mask[i])
+            dst[i] = blend(a[i], b[i], eva, evb);
+    }
+}
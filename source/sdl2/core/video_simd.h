@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_CORE_VIDEO_SIMD_H__
+#define SDL2_CORE_VIDEO_SIMD_H__
+
+#include <stdint.h>
+
+// Row kernels used by the layer compositor. All of them work with BGR555
+// pixels and byte-sized masks (a pixel is affected if its mask isn't 0). They
+// use SSE2, AVX2 or NEON if the compiler targets them, and plain C otherwise.
+// The results are the same in all cases.
+
+// fb[i] = fade_white(fb[i], evy) if mask[i] != 0 (evy = 0..16)
+void GBA_RowFadeWhite(uint16_t *fb, const uint8_t *mask, uint32_t evy,
+                      int count);
+
+// fb[i] = fade_black(fb[i], evy) if mask[i] != 0 (evy = 0..16)
+void GBA_RowFadeBlack(uint16_t *fb, const uint8_t *mask, uint32_t evy,
+                      int count);
+
+// dst[i] = blend(a[i], b[i], eva, evb) if mask[i] != 0 (eva, evb = 0..16)
+void GBA_RowBlend(uint16_t *dst, const uint16_t *a, const uint16_t *b,
+                  const uint8_t *mask, uint32_t eva, uint32_t evb, int count);
+
+#endif // SDL2_CORE_VIDEO_SIMD_H__
@@ -8,17 +8,10 @@
 #include <ugba/ugba.h>
 
 #include "../../debug_utils.h"
+#include "../../core/color_convert.h"
 
 //----------------------------------------------------------------
 
-static uint32_t rgb16to32(uint16_t color)
-{
-    int r = (color & 31) << 3;
-    int g = ((color >> 5) & 31) << 3;
-    int b = ((color >> 10) & 31) << 3;
-    return (b << 16) | (g << 8) | r;
-}
-
 #ifndef min
 static inline int min(int a, int b)
 {
@@ -96,7 +89,7 @@ void GBA_Debug_PrintZoomedSpriteAt(int spritenum, int buf_has_alpha_channel,
 
                 if (data)
                 {
-                    sprbuffer[ydiff * 64 + xdiff] = rgb16to32(palptr[data]);
+                    sprbuffer[ydiff * 64 + xdiff] = GBA_ColorToRGB32(palptr[data]);
                     sprbuffer_vis[ydiff * 64 + xdiff] = 1;
                 }
             }
@@ -141,7 +134,7 @@ void GBA_Debug_PrintZoomedSpriteAt(int spritenum, int buf_has_alpha_channel,
 
                 if (data)
                 {
-                    sprbuffer[ydiff * 64 + xdiff] = rgb16to32(palptr[data]);
+                    sprbuffer[ydiff * 64 + xdiff] = GBA_ColorToRGB32(palptr[data]);
                     sprbuffer_vis[ydiff * 64 + xdiff] = 1;
                 }
             }
@@ -288,7 +281,7 @@ void GBA_Debug_PrintTiles(unsigned char *buffer,
 
                 int data = dataptr[(i & 7) + ((j & 7) * 8)];
 
-                uint32_t color = rgb16to32(((uint16_t *)MEM_PALETTE)[data + pal]);
+                uint32_t color = GBA_ColorToRGB32(((uint16_t *)MEM_PALETTE)[data + pal]);
 
                 int index = (j * bufw + i) * 3;
                 buffer[index + 0] = color & 0xFF;
@@ -332,7 +325,7 @@ void GBA_Debug_PrintTiles(unsigned char *buffer,
                 else
                     data = data & 0xF;
 
-                uint32_t color = rgb16to32(palptr[data]);
+                uint32_t color = GBA_ColorToRGB32(palptr[data]);
 
                 int index = (j * bufw + i) * 3;
                 buffer[index + 0] = color & 0xFF;
@@ -381,7 +374,7 @@ void GBA_Debug_PrintTilesAlpha(unsigned char *buffer,
 
                 int data = dataptr[(i & 7) + ((j & 7) * 8)];
 
-                uint32_t color = rgb16to32(((uint16_t *)MEM_PALETTE)[data + pal]);
+                uint32_t color = GBA_ColorToRGB32(((uint16_t *)MEM_PALETTE)[data + pal]);
 
                 int index = (j * bufw + i) * 4;
                 buffer[index + 0] = color & 0xFF;
@@ -427,7 +420,7 @@ void GBA_Debug_PrintTilesAlpha(unsigned char *buffer,
                 else
                     data = data & 0xF;
 
-                uint32_t color = rgb16to32(palptr[data]);
+                uint32_t color = GBA_ColorToRGB32(palptr[data]);
 
                 int index = (j * bufw + i) * 4;
                 buffer[index + 0] = color & 0xFF;
@@ -478,7 +471,7 @@ void GBA_Debug_TilePrint64x64(unsigned char *buffer, UNUSED int bufw,
                 uint8_t dat_ = data[j * 8 + i];
 
                 tiletempbuffer[j * 8 + i] =
-                        rgb16to32(((uint16_t *)MEM_PALETTE)[dat_ + pal]);
+                        GBA_ColorToRGB32(((uint16_t *)MEM_PALETTE)[dat_ + pal]);
                 tiletempvis[j * 8 + i] = dat_;
             }
         }
@@ -501,7 +494,7 @@ void GBA_Debug_TilePrint64x64(unsigned char *buffer, UNUSED int bufw,
                 else
                     dat_ = dat_ & 0xF;
 
-                tiletempbuffer[j * 8 + i] = rgb16to32(palptr[dat_]);
+                tiletempbuffer[j * 8 + i] = GBA_ColorToRGB32(palptr[dat_]);
                 tiletempvis[j * 8 + i] = dat_;
             }
         }
@@ -594,7 +587,7 @@ void GBA_Debug_PrintBackgroundAlpha(unsigned char *buffer, int bufw, int bufh,
 
                     int data = charbaseblockptr[((SE & 0x3FF) * 64) + (_x + (_y * 8))];
 
-                    uint32_t color = rgb16to32(MEM_PALETTE_BG[data]);
+                    uint32_t color = GBA_ColorToRGB32(MEM_PALETTE_BG[data]);
                     buffer[(j * bufw + i) * 4 + 0] = color & 0xFF;
                     buffer[(j * bufw + i) * 4 + 1] = (color >> 8) & 0xFF;
                     buffer[(j * bufw + i) * 4 + 2] = (color >> 16) & 0xFF;
@@ -633,7 +626,7 @@ void GBA_Debug_PrintBackgroundAlpha(unsigned char *buffer, int bufw, int bufh,
                     else
                         data = data & 0xF;
 
-                    uint32_t color = rgb16to32(palptr[data]);
+                    uint32_t color = GBA_ColorToRGB32(palptr[data]);
                     buffer[(j * bufw + i) * 4 + 0] = color & 0xFF;
                     buffer[(j * bufw + i) * 4 + 1] = (color >> 8) & 0xFF;
                     buffer[(j * bufw + i) * 4 + 2] = (color >> 16) & 0xFF;
@@ -667,7 +660,7 @@ void GBA_Debug_PrintBackgroundAlpha(unsigned char *buffer, int bufw, int bufh,
                 uint8_t SE = scrbaseblockptr[index];
                 uint16_t data = charbaseblockptr[(SE * 64) + (_x + (_y * 8))];
 
-                uint32_t color = rgb16to32(MEM_PALETTE_BG[data]);
+                uint32_t color = GBA_ColorToRGB32(MEM_PALETTE_BG[data]);
                 buffer[(j * bufw + i) * 4 + 0] = color & 0xFF;
                 buffer[(j * bufw + i) * 4 + 1] = (color >> 8) & 0xFF;
                 buffer[(j * bufw + i) * 4 + 2] = (color >> 16) & 0xFF;
@@ -679,17 +672,10 @@ void GBA_Debug_PrintBackgroundAlpha(unsigned char *buffer, int bufw, int bufh,
     {
         uint16_t *srcptr = (uint16_t *)MEM_VRAM;
 
-        for (int i = 0; i < 240; i++)
+        for (int j = 0; j < 160; j++)
         {
-            for (int j = 0; j < 160; j++)
-            {
-                uint16_t data = srcptr[i + 240 * j];
-                uint32_t color = rgb16to32(data);
-                buffer[(j * bufw + i) * 4 + 0] = color & 0xFF;
-                buffer[(j * bufw + i) * 4 + 1] = (color >> 8) & 0xFF;
-                buffer[(j * bufw + i) * 4 + 2] = (color >> 16) & 0xFF;
-                buffer[(j * bufw + i) * 4 + 3] = 0xFF;
-            }
+            GBA_ColorConvertToRGBA8888(&buffer[j * bufw * 4],
+                                       &srcptr[240 * j], 240);
         }
     }
     else if (bgmode == 4) // BG2 mode 4
@@ -701,7 +687,7 @@ void GBA_Debug_PrintBackgroundAlpha(unsigned char *buffer, int bufw, int bufh,
             for (int j = 0; j < 160; j++)
             {
                 uint16_t data = MEM_PALETTE_BG[srcptr[i + 240 * j]];
-                uint32_t color = rgb16to32(data);
+                uint32_t color = GBA_ColorToRGB32(data);
                 buffer[(j * bufw + i) * 4 + 0] = color & 0xFF;
                 buffer[(j * bufw + i) * 4 + 1] = (color >> 8) & 0xFF;
                 buffer[(j * bufw + i) * 4 + 2] = (color >> 16) & 0xFF;
@@ -713,17 +699,10 @@ void GBA_Debug_PrintBackgroundAlpha(unsigned char *buffer, int bufw, int bufh,
     {
         uint16_t *srcptr = (uint16_t *)(((uint8_t *)MEM_VRAM) + (page ? 0xA000 : 0));
 
-        for (int i = 0; i < 160; i++)
+        for (int j = 0; j < 128; j++)
         {
-            for (int j = 0; j < 128; j++)
-            {
-                uint16_t data = srcptr[i + 160 * j];
-                uint32_t color = rgb16to32(data);
-                buffer[(j * bufw + i) * 4 + 0] = color & 0xFF;
-                buffer[(j * bufw + i) * 4 + 1] = (color >> 8) & 0xFF;
-                buffer[(j * bufw + i) * 4 + 2] = (color >> 16) & 0xFF;
-                buffer[(j * bufw + i) * 4 + 3] = 0xFF;
-            }
+            GBA_ColorConvertToRGBA8888(&buffer[j * bufw * 4],
+                                       &srcptr[160 * j], 160);
         }
     }
 }
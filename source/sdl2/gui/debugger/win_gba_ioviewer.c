@@ -10,6 +10,7 @@
 
 #include "../../debug_utils.h"
 #include "../../core/sound.h"
+#include "../../core/timer.h"
 
 #include "../font_utils.h"
 #include "../win_utils.h"
@@ -899,12 +900,12 @@ void Win_GBAIOViewerUpdate(void)
             GUI_ConsoleClear(&gba_ioview_timers_tmr0_con);
 
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr0_con, 0, 0,
-                    "%04X : 100h TM0CNT_L", REG_TM0CNT_L); // TODO: Fix
+                    "%04X : 100h TM0CNT_L", REG_TM0CNT_L);
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr0_con, 0, 1,
                     "%04X : 102h TM0CNT_H", REG_TM0CNT_H);
 
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr0_con, 23, 0,
-                    "[%04X] On reload", REG_TM0CNT_L);
+                    "[%04X] On reload", GBA_TimerGetReloadValue(0));
 
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr0_con, 23, 3,
                     "[%c] Cascade", CHECK(REG_TM0CNT_H & BIT(2)));
@@ -935,12 +936,12 @@ void Win_GBAIOViewerUpdate(void)
             GUI_ConsoleClear(&gba_ioview_timers_tmr1_con);
 
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr1_con, 0, 0,
-                    "%04X : 104h TM1CNT_L", REG_TM1CNT_L); // TODO: Fix
+                    "%04X : 104h TM1CNT_L", REG_TM1CNT_L);
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr1_con, 0, 1,
                     "%04X : 106h TM1CNT_H", REG_TM1CNT_H);
 
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr1_con, 23, 0,
-                    "[%04X] On reload", REG_TM1CNT_L);
+                    "[%04X] On reload", GBA_TimerGetReloadValue(1));
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr1_con, 23, 3,
                     "[%c] Cascade", CHECK(REG_TM1CNT_H & BIT(2)));
 
@@ -970,12 +971,12 @@ void Win_GBAIOViewerUpdate(void)
             GUI_ConsoleClear(&gba_ioview_timers_tmr2_con);
 
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr2_con, 0, 0,
-                    "%04X : 108h TM2CNT_L", REG_TM2CNT_L); // TODO: Fix
+                    "%04X : 108h TM2CNT_L", REG_TM2CNT_L);
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr2_con, 0, 1,
                     "%04X : 10Ah TM2CNT_H", REG_TM2CNT_H);
 
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr2_con, 23, 0,
-                    "[%04X] On reload", REG_TM2CNT_L);
+                    "[%04X] On reload", GBA_TimerGetReloadValue(2));
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr2_con, 23, 3,
                     "[%c] Cascade", CHECK(REG_TM2CNT_H & BIT(2)));
 
@@ -1005,12 +1006,12 @@ void Win_GBAIOViewerUpdate(void)
             GUI_ConsoleClear(&gba_ioview_timers_tmr3_con);
 
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr3_con, 0, 0,
-                    "%04X : 10Ch TM3CNT_L", REG_TM3CNT_L); // TODO: Fix
+                    "%04X : 10Ch TM3CNT_L", REG_TM3CNT_L);
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr3_con, 0, 1,
                     "%04X : 10Eh TM3CNT_H", REG_TM3CNT_H);
 
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr3_con, 23, 0,
-                    "[%04X] On reload", REG_TM3CNT_L);
+                    "[%04X] On reload", GBA_TimerGetReloadValue(3));
             GUI_ConsoleModePrintf(&gba_ioview_timers_tmr3_con, 23, 3,
                     "[%c] Cascade", CHECK(REG_TM3CNT_H & BIT(2)));
 
@@ -10,6 +10,7 @@
 
 #include "../../debug_utils.h"
 #include "../../png_utils.h"
+#include "../../core/color_convert.h"
 
 #include "../font_utils.h"
 #include "../win_utils.h"
@@ -188,14 +189,6 @@ static void _win_gba_mapviewer_update_mapbuffer_from_temp_buffer(void)
     }
 }
 
-static uint32_t rgb16to32(uint16_t color)
-{
-    int r = (color & 31) << 3;
-    int g = ((color >> 5) & 31) << 3;
-    int b = ((color >> 10) & 31) << 3;
-    return (b << 16) | (g << 8) | r;
-}
-
 static uint32_t se_index(uint32_t tx, uint32_t ty, uint32_t pitch) // from tonc
 {
     uint32_t sbb = (ty / 32) * (pitch / 32) + (tx / 32);
@@ -489,7 +482,7 @@ void Win_GBAMapViewerUpdate(void)
                 for (int j = 0; j < 8; j++)
                 {
                     uint8_t dat_ = data[j * 8 + i];
-                    uint32_t color = rgb16to32(MEM_PALETTE_BG[dat_]);
+                    uint32_t color = GBA_ColorToRGB32(MEM_PALETTE_BG[dat_]);
                     tiletempbuffer[j * 8 + i] = color;
                     tiletempvis[j * 8 + i] = dat_;
                 }
@@ -523,7 +516,7 @@ void Win_GBAMapViewerUpdate(void)
                     else
                         dat_ = dat_ & 0xF;
 
-                    tiletempbuffer[j * 8 + i] = rgb16to32(palptr[dat_]);
+                    tiletempbuffer[j * 8 + i] = GBA_ColorToRGB32(palptr[dat_]);
                     tiletempvis[j * 8 + i] = dat_;
                 }
             }
@@ -563,7 +556,7 @@ void Win_GBAMapViewerUpdate(void)
             for (int j = 0; j < 8; j++)
             {
                 uint8_t dat_ = data[j * 8 + i];
-                uint32_t color = rgb16to32(MEM_PALETTE_BG[dat_]);
+                uint32_t color = GBA_ColorToRGB32(MEM_PALETTE_BG[dat_]);
                 tiletempbuffer[j * 8 + i] = color;
                 tiletempvis[j * 8 + i] = dat_;
             }
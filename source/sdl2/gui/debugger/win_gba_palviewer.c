@@ -10,6 +10,7 @@
 
 #include "../../debug_utils.h"
 #include "../../png_utils.h"
+#include "../../core/color_convert.h"
 
 #include "../font_utils.h"
 #include "../win_utils.h"
@@ -73,9 +74,11 @@ static gui_global gba_palviewer_window_gui = {
 
 static void rgb16to32(uint16_t color, uint8_t *r, uint8_t *g, uint8_t *b)
 {
-    *r = (color & 31) << 3;
-    *g = ((color >> 5) & 31) << 3;
-    *b = ((color >> 10) & 31) << 3;
+    uint32_t rgb = GBA_ColorToRGB32(color);
+
+    *r = rgb & 0xFF;
+    *g = (rgb >> 8) & 0xFF;
+    *b = (rgb >> 16) & 0xFF;
 }
 
 //----------------------------------------------------------------
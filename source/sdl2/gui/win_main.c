@@ -2,6 +2,7 @@
 //
 // Copyright (c) 2011-2015, 2019-2021 Antonio Niño Díaz
 
+#include <stdlib.h>
 #include <time.h>
 
 #include <SDL2/SDL.h>
@@ -14,7 +15,8 @@
 
 #include "../config.h"
 #include "../debug_utils.h"
-#include "../png_utils.h"
+#include "../png_writer.h"
+#include "../profiler.h"
 #include "../core/video.h"
 
 #include "debugger/win_gba_debugger.h"
@@ -25,14 +27,18 @@ static int WinIDMain = -1;
 
 //------------------------------------------------------------------
 
-static int current_fps, old_fps;
+static int current_fps;
 static int frames_drawn = 0;
 static SDL_TimerID fps_timer;
 
+// Incremented every time current_fps is updated
+static volatile int fps_updates, old_fps_updates;
+
 static Uint32 fps_callback_function(Uint32 interval, UNUSED void *param)
 {
     current_fps = frames_drawn;
     frames_drawn = 0;
+    fps_updates++;
 
     return interval;
 }
@@ -53,23 +59,25 @@ static void FPS_TimerEnd(void)
 
 //------------------------------------------------------------------
 
+// Only rows "srcy1" to "srcy2" (not included) of the source are scaled
 static void ScaleImage24RGB(int zoom, unsigned char *srcbuf, int srcw, int srch,
-                            unsigned char *dstbuf, int dstw, int dsth)
+                            unsigned char *dstbuf, int dstw, int dsth,
+                            int srcy1, int srcy2)
 {
     int dest_x_offset = (dstw - (srcw * zoom)) / 2;
     int dest_y_offset = (dsth - (srch * zoom)) / 2;
 
     int dest_x_end = dest_x_offset + srcw * zoom;
-    int dest_y_end = dest_y_offset + srch * zoom;
+    int dest_y_end = dest_y_offset + srcy2 * zoom;
 
     int srcx = 0;
-    int srcy = 0;
+    int srcy = srcy1;
 
     int srcx_inc_count = 0;
     int srcy_inc_count = 0;
 
     //int destx = dest_x_offset;
-    int desty = dest_y_offset;
+    int desty = dest_y_offset + srcy1 * zoom;
 
     for (; desty < dest_y_end; desty++)
     {
@@ -102,12 +110,40 @@ static void ScaleImage24RGB(int zoom, unsigned char *srcbuf, int srcw, int srch,
     }
 }
 
+static void Convert24RGBToBGRA8888(const unsigned char *srcbuf, int srcw,
+                                   int srch, void *dstbuf, int pitch)
+{
+    for (int y = 0; y < srch; y++)
+    {
+        const unsigned char *srcline = &(srcbuf[y * srcw * 3]);
+        unsigned char *dstline = (unsigned char *)dstbuf + y * pitch;
+
+        for (int x = 0; x < srcw; x++)
+        {
+            *dstline++ = srcline[2];
+            *dstline++ = srcline[1];
+            *dstline++ = srcline[0];
+            *dstline++ = 0xFF;
+            srcline += 3;
+        }
+    }
+}
+
 //------------------------------------------------------------------
 
 #define ZOOM_MAX 5
 
 static int WIN_MAIN_CONFIG_ZOOM = 2;
 
+// If this is 1, the GBA screen is converted straight into a texture of the same
+// size and SDL scales it to the size of the window. If not, the image is scaled
+// by the CPU and then copied to a texture of the size of the window.
+static int streaming_texture = 0;
+
+// If this is 1, the whole screen is sent to the texture in the next frame. If
+// not, only the scanlines that have changed since the previous frame are sent.
+static int screen_full_update = 1;
+
 static unsigned char GBA_SCREEN[240 * 160 * 3];
 static unsigned char WIN_MAIN_GAME_SCREEN_BUFFER[240 * ZOOM_MAX *
                                                  160 * ZOOM_MAX * 3];
@@ -151,14 +187,46 @@ static void GenerateNewScreenshotTimestampFilename(void)
 
 void Debug_Screenshot(const char *name)
 {
+    // GBA_SCREEN can have the configuration overlay drawn on top of the frame,
+    // and it is used to update the window. This can be called from the thread
+    // of the game and from the thread of the script, so the buffer can't be
+    // shared.
+    unsigned char *screenshot = malloc(240 * 160 * 3);
+    if (screenshot == NULL)
+    {
+        Debug_Log("%s(): Not enough memory", __func__);
+        return;
+    }
+
     if (name == NULL)
         name = "screenshot.png";
 
-    Save_PNG(name, &GBA_SCREEN[0], 240, 160, 0);
+    GBA_ConvertScreenBufferTo24RGB(screenshot);
+
+    PNG_WriterSave(name, screenshot, 240, 160, 0);
+
+    free(screenshot);
 }
 
 #endif // ENABLE_SCREENSHOTS
 
+// Like GBA_ScreenGetDirtyLines(), but it returns the whole screen as one range
+// if it needs to be updated completely.
+static int Win_MainGetUpdatedLines(int y, int *y1, int *y2)
+{
+    if (screen_full_update)
+    {
+        if (y > 0)
+            return 0;
+
+        *y1 = 0;
+        *y2 = 160;
+        return 1;
+    }
+
+    return GBA_ScreenGetDirtyLines(y, y1, y2);
+}
+
 //------------------------------------------------------------------
 
 static int exit_program_requested = 0;
@@ -291,6 +359,15 @@ int Win_MainCreate(void)
         return 1;
     }
 
+    // Let SDL scale the GBA screen if possible. The software scaler is only
+    // used if the texture can't be created.
+    if (WH_SetTextureFormat(WinIDMain, SDL_PIXELFORMAT_BGRA32, 240, 160) == 0)
+        streaming_texture = 1;
+    else
+        Debug_Log("%s(): Using software scaler", __func__);
+
+    screen_full_update = 1;
+
     WH_SetCaption(WinIDMain, "ugba");
 
     WH_SetEventCallback(WinIDMain, Win_MainEventCallback);
@@ -306,7 +383,50 @@ int Win_MainCreate(void)
 
 void Win_MainRender(void)
 {
-    WH_Render(WinIDMain, WIN_MAIN_GAME_SCREEN_BUFFER);
+    int changed = 0;
+    int y = 0;
+    int y1, y2;
+
+    while (Win_MainGetUpdatedLines(y, &y1, &y2))
+    {
+        if (streaming_texture)
+        {
+            int pitch;
+            void *pixels = WH_LockTexture(WinIDMain, y1, y2, &pitch);
+            if (pixels != NULL)
+            {
+                if (config_shown)
+                {
+                    Convert24RGBToBGRA8888(&GBA_SCREEN[y1 * 240 * 3], 240,
+                                           y2 - y1, pixels, pitch);
+                }
+                else
+                {
+                    GBA_ConvertScreenLinesToBGRA8888(pixels, pitch, y1, y2);
+                }
+
+                WH_UnlockTexture(WinIDMain);
+            }
+        }
+        else
+        {
+            WH_UpdateTexture(WinIDMain, WIN_MAIN_GAME_SCREEN_BUFFER,
+                             y1 * WIN_MAIN_CONFIG_ZOOM,
+                             y2 * WIN_MAIN_CONFIG_ZOOM);
+        }
+
+        changed = 1;
+        y = y2;
+    }
+
+    // The overlay of the configuration menu may change in any frame, and the
+    // screen has to be restored when it is hidden.
+    screen_full_update = config_shown;
+
+    // If the frame is the same as the previous one, there is no need to
+    // present it again.
+    if (changed)
+        WH_Present(WinIDMain);
 }
 
 void Win_MainSetZoom(int factor)
@@ -316,40 +436,73 @@ void Win_MainSetZoom(int factor)
     int w = 240 * WIN_MAIN_CONFIG_ZOOM;
     int h = 160 * WIN_MAIN_CONFIG_ZOOM;
 
-    WH_SetSize(WinIDMain, w, h, w, h, 0);
+    if (streaming_texture)
+        WH_SetSize(WinIDMain, w, h, 240, 160, 0);
+    else
+        WH_SetSize(WinIDMain, w, h, w, h, 0);
+
+    screen_full_update = 1;
 }
 
-void Win_MainLoopHandle(void)
+void Win_MainCheckExit(void)
 {
     if (exit_program_requested)
     {
         WH_CloseAll();
         exit(0);
     }
+}
 
-    GBA_ConvertScreenBufferTo24RGB(GBA_SCREEN);
-
+void Win_MainLoopHandle(void)
+{
     if (config_shown)
+    {
+        GBA_ConvertScreenBufferTo24RGB(GBA_SCREEN);
         Win_ConfigDrawOverlay(GBA_SCREEN);
+        screen_full_update = 1;
+    }
+
+    // In streaming mode the screen is converted when it is rendered, unless the
+    // configuration overlay needs to be drawn on top of it.
+    if (streaming_texture == 0)
+    {
+        int y = 0;
+        int y1, y2;
+
+        while (Win_MainGetUpdatedLines(y, &y1, &y2))
+        {
+            if (config_shown == 0)
+            {
+                GBA_ConvertScreenLinesTo24RGB(&GBA_SCREEN[y1 * 240 * 3],
+                                              y1, y2);
+            }
 
-    ScaleImage24RGB(WIN_MAIN_CONFIG_ZOOM, GBA_SCREEN,
-                    240, 160, WIN_MAIN_GAME_SCREEN_BUFFER,
-                    240 * WIN_MAIN_CONFIG_ZOOM,
-                    160 * WIN_MAIN_CONFIG_ZOOM);
+            ScaleImage24RGB(WIN_MAIN_CONFIG_ZOOM, GBA_SCREEN,
+                            240, 160, WIN_MAIN_GAME_SCREEN_BUFFER,
+                            240 * WIN_MAIN_CONFIG_ZOOM,
+                            160 * WIN_MAIN_CONFIG_ZOOM, y1, y2);
+            y = y2;
+        }
+    }
 
     frames_drawn++;
 
     // Update window caption
 
-    if (old_fps != current_fps)
+    if (old_fps_updates != fps_updates)
     {
-        char caption[60];
-        snprintf(caption, sizeof(caption), "ugba: %d fps - %.2f%%",
-                current_fps, (float)current_fps * 10.0f / 6.0f);
+        char caption[160];
+        int len = snprintf(caption, sizeof(caption), "ugba: %d fps - %.2f%%",
+                           current_fps, (float)current_fps * 10.0f / 6.0f);
+
+        // Show the profiler summary of the last second, if enabled
+        char summary[100];
+        if (Profiler_GetSummary(summary, sizeof(summary)))
+            snprintf(caption + len, sizeof(caption) - len, " | %s", summary);
 
         WH_SetCaption(WinIDMain, caption);
 
-        old_fps = current_fps;
+        old_fps_updates = fps_updates;
     }
 
 #ifdef ENABLE_DEBUGGER
@@ -9,6 +9,10 @@ int Win_MainCreate(void); // returns 1 if error
 void Win_MainRender(void);
 void Win_MainSetZoom(int factor);
 int Win_MainIsConfigEnabled(void);
+// Exits the program if it has been requested. It must be called every frame.
+void Win_MainCheckExit(void);
+// Converts the frame that has been drawn last. It isn't needed for frames that
+// aren't shown.
 void Win_MainLoopHandle(void);
 void Win_MainExit(void);
 
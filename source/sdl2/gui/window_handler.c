@@ -27,6 +27,7 @@ typedef struct
     SDL_Renderer *mRenderer;
     SDL_GLContext GLContext;
     SDL_Texture *mTexture;
+    Uint32 mTexFormat;
     int mWindowID;
 
     WH_CallbackFn mEventCallback;
@@ -109,6 +110,7 @@ int WH_Create(int width, int height, int texw, int texh, int scale)
     w->mShown = 0;
     w->mWindowID = -1;
     w->mTexScale = scale;
+    w->mTexFormat = SDL_PIXELFORMAT_RGB24;
 
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
     SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 0);
@@ -169,7 +171,7 @@ int WH_Create(int width, int height, int texw, int texh, int scale)
     w->mWindowID = SDL_GetWindowID(w->mWindow);
     w->mShown = 1; // Flag as opened
 
-    w->mTexture = SDL_CreateTexture(w->mRenderer, SDL_PIXELFORMAT_RGB24,
+    w->mTexture = SDL_CreateTexture(w->mRenderer, w->mTexFormat,
                                     SDL_TEXTUREACCESS_STREAMING, texw, texh);
     if (w->mTexture == NULL)
     {
@@ -209,7 +211,7 @@ void WH_SetSize(int index, int width, int height, int texw, int texh, int scale)
         w->mTexWidth = texw;
         w->mTexHeight = texh;
         SDL_DestroyTexture(w->mTexture);
-        w->mTexture = SDL_CreateTexture(w->mRenderer, SDL_PIXELFORMAT_RGB24,
+        w->mTexture = SDL_CreateTexture(w->mRenderer, w->mTexFormat,
                                         SDL_TEXTUREACCESS_STREAMING,
                                         texw, texh);
         if (w->mTexture == NULL)
@@ -220,6 +222,35 @@ void WH_SetSize(int index, int width, int height, int texw, int texh, int scale)
     }
 }
 
+int WH_SetTextureFormat(int index, Uint32 format, int texw, int texh)
+{
+    window_handle_t *w = wh_get_from_index(index);
+
+    if (w == NULL)
+        return 1;
+    if (w->mWindow == NULL)
+        return 1;
+
+    SDL_Texture *texture = SDL_CreateTexture(w->mRenderer, format,
+                                             SDL_TEXTUREACCESS_STREAMING,
+                                             texw, texh);
+    if (texture == NULL)
+    {
+        Debug_Log("Couldn't create texture! SDL Error: %s\n",
+                  SDL_GetError());
+        return 1;
+    }
+
+    SDL_DestroyTexture(w->mTexture);
+
+    w->mTexture = texture;
+    w->mTexFormat = format;
+    w->mTexWidth = texw;
+    w->mTexHeight = texh;
+
+    return 0;
+}
+
 static void wh_free_from_handle(window_handle_t *w)
 {
     if (w == gMainWindow)
@@ -264,6 +295,8 @@ int WH_SetEventMainWindow(int index)
     return 1;
 }
 
+static void wh_present(window_handle_t *w);
+
 // Returns 1 if handled, 0 if not (it has been sent to main window)
 static int wh_handle_event(SDL_Event *e)
 {
@@ -306,9 +339,10 @@ static int wh_handle_event(SDL_Event *e)
             //    SDL_RenderPresent(w->mRenderer);
             //    break;
 
-            // Repaint on expose
+            // Repaint on expose. The texture holds the last image, which may
+            // not have been presented again if it hasn't changed.
             case SDL_WINDOWEVENT_EXPOSED:
-                SDL_RenderPresent(w->mRenderer);
+                wh_present(w);
                 break;
 
             // Mouse enter
@@ -421,18 +455,8 @@ void WH_SetCaption(int index, const char *caption)
     SDL_SetWindowTitle(w->mWindow, caption);
 }
 
-void WH_Render(int index, const unsigned char *buffer)
+static void wh_present(window_handle_t *w)
 {
-    window_handle_t *w = wh_get_from_index(index);
-
-    if (w == NULL)
-        return;
-    if (w->mWindow == NULL)
-        return;
-
-    SDL_UpdateTexture(w->mTexture, NULL, (const void *)buffer,
-                      w->mTexWidth * 3);
-
 #ifdef OPENGL_BLIT
     glEnable(GL_TEXTURE_2D);
     glDisable(GL_DEPTH_TEST);
@@ -517,6 +541,92 @@ void WH_Render(int index, const unsigned char *buffer)
     SDL_RenderPresent(w->mRenderer);
 }
 
+void WH_Render(int index, const unsigned char *buffer)
+{
+    window_handle_t *w = wh_get_from_index(index);
+
+    if (w == NULL)
+        return;
+    if (w->mWindow == NULL)
+        return;
+
+    SDL_UpdateTexture(w->mTexture, NULL, (const void *)buffer,
+                      w->mTexWidth * SDL_BYTESPERPIXEL(w->mTexFormat));
+
+    wh_present(w);
+}
+
+void WH_UpdateTexture(int index, const unsigned char *buffer, int y1, int y2)
+{
+    window_handle_t *w = wh_get_from_index(index);
+
+    if (w == NULL)
+        return;
+    if (w->mWindow == NULL)
+        return;
+
+    int pitch = w->mTexWidth * SDL_BYTESPERPIXEL(w->mTexFormat);
+
+    SDL_Rect rect;
+    rect.x = 0;
+    rect.y = y1;
+    rect.w = w->mTexWidth;
+    rect.h = y2 - y1;
+
+    SDL_UpdateTexture(w->mTexture, &rect,
+                      (const void *)&buffer[y1 * pitch], pitch);
+}
+
+void *WH_LockTexture(int index, int y1, int y2, int *pitch)
+{
+    window_handle_t *w = wh_get_from_index(index);
+
+    if (w == NULL)
+        return NULL;
+    if (w->mWindow == NULL)
+        return NULL;
+
+    SDL_Rect rect;
+    rect.x = 0;
+    rect.y = y1;
+    rect.w = w->mTexWidth;
+    rect.h = y2 - y1;
+
+    void *pixels;
+
+    if (SDL_LockTexture(w->mTexture, &rect, &pixels, pitch) != 0)
+    {
+        Debug_Log("Couldn't lock texture! SDL Error: %s\n", SDL_GetError());
+        return NULL;
+    }
+
+    return pixels;
+}
+
+void WH_UnlockTexture(int index)
+{
+    window_handle_t *w = wh_get_from_index(index);
+
+    if (w == NULL)
+        return;
+    if (w->mWindow == NULL)
+        return;
+
+    SDL_UnlockTexture(w->mTexture);
+}
+
+void WH_Present(int index)
+{
+    window_handle_t *w = wh_get_from_index(index);
+
+    if (w == NULL)
+        return;
+    if (w->mWindow == NULL)
+        return;
+
+    wh_present(w);
+}
+
 int WH_AreAllWindowsClosed(void)
 {
     for (int i = 0; i < MAX_WINDOWS; i++)
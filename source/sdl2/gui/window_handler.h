@@ -26,8 +26,28 @@ void WH_HandleEvents(void);
 
 void WH_SetCaption(int index, const char *caption);
 
+// Change the pixel format and size of the texture of a window. By default it is
+// SDL_PIXELFORMAT_RGB24. Returns 0 on success.
+int WH_SetTextureFormat(int index, Uint32 format, int texw, int texh);
+
+// Copy the buffer to the texture of the window and show it. The buffer must use
+// the pixel format of the texture.
 void WH_Render(int index, const unsigned char *buffer);
 
+// Copy rows "y1" to "y2" (not included) of the buffer to the texture without
+// showing it. The buffer must hold a whole image in the format of the texture.
+void WH_UpdateTexture(int index, const unsigned char *buffer, int y1, int y2);
+
+// Lock rows "y1" to "y2" (not included) of the texture of a window to write to
+// them directly. All the pixels of the rows must be written before unlocking
+// the texture. WH_LockTexture() returns the address of row "y1", or NULL on
+// error.
+void *WH_LockTexture(int index, int y1, int y2, int *pitch);
+void WH_UnlockTexture(int index);
+
+// Show the current contents of the texture of a window
+void WH_Present(int index);
+
 void WH_Close(int index);
 void WH_CloseAllBut(int index);
 void WH_CloseAllButMain(void);
@@ -2,6 +2,12 @@
 //
 // Copyright (c) 2020-2021 Antonio Niño Díaz
 
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <SDL2/SDL.h>
 
 #ifdef LUA_INTERPRETER_ENABLED
@@ -13,60 +19,280 @@
 #include <ugba/ugba.h>
 
 #include "debug_utils.h"
+#include "lua_handler.h"
+#include "png_writer.h"
+#include "scenario.h"
 #include "sound_utils.h"
+#include "video_capture.h"
 #include "wav_utils.h"
 
+#include "core/context.h"
+#include "core/sound.h"
+#include "core/tile_cache.h"
+#include "core/video.h"
 #include "gui/win_main.h"
 
 static char *script_path = NULL;
 static SDL_Thread *script_thread;
-static int script_running = 0;
 
 static uint16_t lua_keyinput = 0;
 
 // ----------------------------------------------------------------------------
 
-static volatile int remaining_frames = 0;
-static volatile int is_waiting = 0;
+// The script thread and the game thread hand control to each other with a
+// condition variable, which is signaled whenever any of the variables below
+// changes. They are protected by the mutex.
+static SDL_mutex *script_mutex;
+static SDL_cond *script_cond;
+
+static int script_running = 0;
+static int remaining_frames = 0;
+static int is_waiting = 0;
+
+// Scenarios requested by the script. The process can only be forked by the game
+// thread, so the script thread waits until the game thread has handled the
+// request.
+static int scenario_requested = 0;
+static int scenario_num;
+static int scenario_max_parallel;
+static char *scenario_script;
+static int scenario_result; // Value returned by UGBA_ScenarioFork()
+static int scenario_index = -1; // Index of this process if it is a scenario
+
+// Condition checked by the game thread after every frame during run_until(), so
+// that the script thread doesn't need to wake up until it is met.
+typedef enum {
+    UNTIL_EQ,
+    UNTIL_NE,
+    UNTIL_LT,
+    UNTIL_LE,
+    UNTIL_GT,
+    UNTIL_GE,
+} until_op;
+
+static int until_active = 0;
+static const uint8_t *until_ptr;
+static int until_size; // 1, 2 or 4 bytes (little endian)
+static until_op until_operator;
+static uint32_t until_value;
+static int until_met;
+static int until_frames; // Frames run since run_until() was called
+
+// Input sequence set by keys_sequence(). The game thread switches to the next
+// entry when the frames of the current one have been run.
+typedef struct {
+    uint16_t keys;
+    int frames;
+} script_input;
+
+static script_input *sequence = NULL;
+static int sequence_len;
+static int sequence_index;
+static int sequence_frame; // Frames run of the current entry
+
+static int Script_UntilConditionMet(void)
+{
+    uint32_t value = 0;
+
+    for (int i = 0; i < until_size; i++)
+        value |= (uint32_t)until_ptr[i] << (i * 8);
+
+    switch (until_operator)
+    {
+        case UNTIL_EQ:
+            return value == until_value;
+        case UNTIL_NE:
+            return value != until_value;
+        case UNTIL_LT:
+            return value < until_value;
+        case UNTIL_LE:
+            return value <= until_value;
+        case UNTIL_GT:
+            return value > until_value;
+        case UNTIL_GE:
+            return value >= until_value;
+        default:
+            return 1;
+    }
+}
+
+static void Script_SequenceAdvance(void)
+{
+    sequence_frame++;
+
+    if (sequence_frame < sequence[sequence_index].frames)
+        return;
+
+    sequence_frame = 0;
+    sequence_index++;
+
+    if (sequence_index < sequence_len)
+        lua_keyinput = sequence[sequence_index].keys;
+}
+
+// Called with the mutex locked. Returns 1 if this is a new scenario process.
+static int Script_HandleScenarioRequest(void)
+{
+    if (scenario_requested == 0)
+        return 0;
+
+    // Don't keep the mutex locked while the scenarios run
+    SDL_UnlockMutex(script_mutex);
+
+    int index = UGBA_ScenarioFork(scenario_num, scenario_max_parallel);
+    if (index >= 0)
+    {
+        // This is a child process. Only the game thread exists here, and the
+        // script thread of the parent may have had the mutex locked when the
+        // process was forked, so new synchronization objects are needed.
+        script_mutex = SDL_CreateMutex();
+        script_cond = SDL_CreateCond();
+        if ((script_mutex == NULL) || (script_cond == NULL))
+        {
+            Debug_Log("%s: Failed to create sync objects: %s", __func__,
+                      SDL_GetError());
+            Scenario_ChildExit();
+        }
+
+        // Start the script of the scenario. The game is paused until the
+        // script asks to run frames, like when the parent started its own
+        // script.
+        scenario_index = index;
+        scenario_requested = 0;
+        remaining_frames = 0;
+        Script_RunLua(scenario_script);
+
+        SDL_LockMutex(script_mutex);
+        return 1;
+    }
+
+    SDL_LockMutex(script_mutex);
+
+    scenario_result = index;
+    scenario_requested = 0;
+    SDL_CondBroadcast(script_cond);
+
+    return 0;
+}
 
-// Called by the game thread. If the script never calls ``continue()`` this can
-// block
+// Called by the game thread. If the script never calls ``continue()`` this
+// blocks until the script ends.
 void Script_FrameDrawn(void)
 {
+    if (script_mutex == NULL)
+        return;
+
+    SDL_LockMutex(script_mutex);
+
     if (script_running == 0)
+    {
+        SDL_UnlockMutex(script_mutex);
         return;
+    }
+
+    // The frames requested by the script of a new scenario start counting
+    // after this frame.
+    if (Script_HandleScenarioRequest())
+        goto set_input;
 
     if (remaining_frames == 0)
+    {
+        SDL_UnlockMutex(script_mutex);
         return;
+    }
 
     remaining_frames--;
 
+    if (sequence != NULL)
+        Script_SequenceAdvance();
+
+    if (until_active)
+    {
+        until_frames++;
+
+        if (Script_UntilConditionMet())
+        {
+            until_met = 1;
+            remaining_frames = 0;
+        }
+    }
+
     if (remaining_frames == 0)
     {
-        // Wait here until the script thread lets the game thread continue
+        // Let the script thread know that the frames have been run, and wait
+        // here until it lets the game thread continue.
         is_waiting = 1;
+        SDL_CondBroadcast(script_cond);
 
-        int i = 0;
-        while (is_waiting)
+        while (is_waiting && script_running)
         {
-            SDL_Delay(1);
-            i++;
-            if (i == 2000)
+            if (scenario_requested)
             {
-                // Exit after two seconds of inactivity in case the script
-                // forgot to finish the wait period.
-                Debug_Log("%s: Timeout", __func__);
-                break;
+                if (Script_HandleScenarioRequest())
+                    break;
+                continue;
             }
+
+            SDL_CondWait(script_cond, script_mutex);
         }
     }
 
+set_input:
+    SDL_UnlockMutex(script_mutex);
+
     // Set input based on script state
     REG_KEYINPUT = ~lua_keyinput;
 }
 
+int Script_FrameRequested(void)
+{
+    if (script_mutex == NULL)
+        return 0;
+
+    SDL_LockMutex(script_mutex);
+
+    // If the script hasn't asked to run any frame yet, it can do it at any
+    // point, so frames can't be skipped. The condition of run_until() can be
+    // met in any frame. The screen is converted from the frame before the last
+    // one that has been drawn, so the last two frames are needed.
+    int requested = script_running && ((remaining_frames <= 2) || until_active);
+
+    SDL_UnlockMutex(script_mutex);
+
+    return requested;
+}
+
 // ----------------------------------------------------------------------------
 
+// Called with the mutex locked. It lets the game thread run the frames and waits
+// until they have been run.
+static void Script_RunFramesLocked(int frames)
+{
+    remaining_frames = frames;
+    is_waiting = 0;
+    SDL_CondBroadcast(script_cond);
+
+    while (remaining_frames > 0)
+        SDL_CondWait(script_cond, script_mutex);
+}
+
+// The memory and the output of the game, and the files written by the game
+// thread, can only be accessed while the game thread is waiting for the script.
+// If it is, this returns 1 with the mutex locked.
+static int Script_LockPaused(const char *caller)
+{
+    SDL_LockMutex(script_mutex);
+
+    if (is_waiting)
+        return 1;
+
+    SDL_UnlockMutex(script_mutex);
+
+    Debug_Log("%s(): The game isn't paused", caller);
+
+    return 0;
+}
+
 static int lua_run_frames_and_pause(lua_State *L)
 {
     // Number of arguments
@@ -83,11 +309,11 @@ static int lua_run_frames_and_pause(lua_State *L)
 
     Debug_Log("%s(%lld)", __func__, y);
 
-    is_waiting = 0;
-    remaining_frames = y;
-
-    while (remaining_frames > 0)
-        SDL_Delay(0);
+    // Set the number of frames before letting the game thread continue so
+    // that it knows if it has to draw the next frame.
+    SDL_LockMutex(script_mutex);
+    Script_RunFramesLocked(y);
+    SDL_UnlockMutex(script_mutex);
 
     // Number of results
     return 0;
@@ -105,7 +331,10 @@ static int lua_continue(lua_State *L)
 
     Debug_Log("%s()", __func__);
 
+    SDL_LockMutex(script_mutex);
     is_waiting = 0;
+    SDL_CondBroadcast(script_cond);
+    SDL_UnlockMutex(script_mutex);
 
     // Number of results
     return 0;
@@ -221,27 +450,29 @@ static int lua_keys_release(lua_State *L)
 
 static int lua_wav_record_start(lua_State *L)
 {
+    const char *name = NULL;
+
     // Number of arguments
     int narg = lua_gettop(L);
-    if (narg == 0)
+    if (narg > 1)
     {
-        Debug_Log("%s()", __func__);
-        WAV_FileStart(NULL, GBA_SAMPLES_60_FRAMES);
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
     }
-    else if (narg == 1)
-    {
-        const char *name = lua_tostring(L, -1);
 
-        Debug_Log("%s(%s)", __func__, name);
-        WAV_FileStart(name, GBA_SAMPLES_60_FRAMES);
+    if (narg == 1)
+        name = lua_tostring(L, 1);
 
-        lua_pop(L, 1);
-    }
-    else
-    {
-        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+    Debug_Log("%s(%s)", __func__, name ? name : "");
+
+    if (!Script_LockPaused(__func__))
         return 0;
-    }
+
+    WAV_FileStart(name, GBA_SAMPLES_60_FRAMES);
+
+    SDL_UnlockMutex(script_mutex);
+
+    lua_pop(L, narg);
 
     // Number of results
     return 0;
@@ -259,13 +490,77 @@ static int lua_wav_record_end(lua_State *L)
 
     Debug_Log("%s()", __func__);
 
+    if (!Script_LockPaused(__func__))
+        return 0;
+
     WAV_FileEnd();
 
+    SDL_UnlockMutex(script_mutex);
+
     // Number of results
     return 0;
 }
 
-static int lua_exit(lua_State *L)
+static int lua_video_record_start(lua_State *L)
+{
+    vid_format format = VID_FORMAT_Y4M;
+    const char *name = NULL;
+
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg > 2)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    if (narg >= 1)
+        name = lua_tostring(L, 1);
+
+    if (narg == 2)
+    {
+        const char *format_name = lua_tostring(L, 2);
+
+        if (format_name == NULL)
+        {
+            Debug_Log("%s(): Invalid format", __func__);
+            return 0;
+        }
+        else if (strcmp(format_name, "y4m") == 0)
+        {
+            format = VID_FORMAT_Y4M;
+        }
+        else if (strcmp(format_name, "rgb24") == 0)
+        {
+            format = VID_FORMAT_RGB24;
+        }
+        else if (strcmp(format_name, "bgr555") == 0)
+        {
+            format = VID_FORMAT_BGR555;
+        }
+        else
+        {
+            Debug_Log("%s(): Invalid format: %s", __func__, format_name);
+            return 0;
+        }
+    }
+
+    Debug_Log("%s(%s)", __func__, name ? name : "");
+
+    if (!Script_LockPaused(__func__))
+        return 0;
+
+    VID_FileStart(name, format);
+
+    SDL_UnlockMutex(script_mutex);
+
+    lua_pop(L, narg);
+
+    // Number of results
+    return 0;
+}
+
+static int lua_video_record_end(lua_State *L)
 {
     // Number of arguments
     int narg = lua_gettop(L);
@@ -277,108 +572,833 @@ static int lua_exit(lua_State *L)
 
     Debug_Log("%s()", __func__);
 
-    is_waiting = 0;
-    remaining_frames = 0;
+    if (!Script_LockPaused(__func__))
+        return 0;
 
-    Win_MainExit();
+    VID_FileEnd();
+
+    SDL_UnlockMutex(script_mutex);
 
     // Number of results
     return 0;
 }
 
-// ----------------------------------------------------------------------------
-
-static int Script_Runner(UNUSED void *ptr)
+static int lua_state_save(lua_State *L)
 {
-    int ret = 1;
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 1)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
 
-    // Create Lua state
-    lua_State *L = luaL_newstate();
+    const char *name = lua_tostring(L, -1);
+    if (name == NULL)
+    {
+        Debug_Log("%s(): Invalid path", __func__);
+        return 0;
+    }
 
-    // Load Lua libraries
-    luaL_openlibs(L);
+    Debug_Log("%s(%s)", __func__, name);
 
-    // Load script from file
-    int status = luaL_loadfile(L, script_path);
-    if (status) {
-        // On error, the error message is at the top of the stack
-        fprintf(stderr, "Couldn't load file: %s", lua_tostring(L, -1));
-        goto exit;
-    }
+    if (!Script_LockPaused(__func__))
+        return 0;
 
-    // Register C functions
-    lua_register(L, "run_frames_and_pause", lua_run_frames_and_pause);
-    lua_register(L, "continue", lua_continue);
-    lua_register(L, "screenshot", lua_screenshot);
-    lua_register(L, "keys_hold", lua_keys_hold);
-    lua_register(L, "keys_release", lua_keys_release);
-    lua_register(L, "wav_record_start", lua_wav_record_start);
-    lua_register(L, "wav_record_end", lua_wav_record_end);
-    lua_register(L, "exit", lua_exit);
+    UGBA_StateSave(name);
 
-    // Run script with 0 arguments and expect one return value
-    int result = lua_pcall(L, 0, 1, 0);
-    if (result) {
-        fprintf(stderr, "Failed to run script: %s", lua_tostring(L, -1));
-        goto exit;
-    }
+    SDL_UnlockMutex(script_mutex);
 
-    // Get returned value and remove it from the stack (it's at the top)
-    int retval  = lua_tointeger(L, -1);
     lua_pop(L, 1);
 
-    Debug_Log("Script returned: %d", retval);
+    // Number of results
+    return 0;
+}
 
-    // Close Lua
-    lua_close(L);
+static int lua_state_load(lua_State *L)
+{
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 1)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
 
-    ret = 0;
-exit:
-    return ret;
+    const char *name = lua_tostring(L, -1);
+    if (name == NULL)
+    {
+        Debug_Log("%s(): Invalid path", __func__);
+        return 0;
+    }
+
+    Debug_Log("%s(%s)", __func__, name);
+
+    if (!Script_LockPaused(__func__))
+        return 0;
+
+    UGBA_StateLoad(name);
+
+    SDL_UnlockMutex(script_mutex);
+
+    lua_pop(L, 1);
+
+    // Number of results
+    return 0;
 }
 
-int Script_RunLua(const char *path)
+// Lua strings can hold binary data, so they are used to keep states in memory
+static int lua_state_save_to_string(lua_State *L)
 {
-    if (path == NULL)
-        return 1;
-
-    size_t len = strlen(path);
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 0)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
 
-    script_path = malloc(len + 1);
-    if (script_path == NULL)
+    if (!Script_LockPaused(__func__))
+    {
+        lua_pushnil(L);
         return 1;
+    }
 
-    snprintf(script_path, len + 1, "%s", path);
+    size_t size;
+    void *state = UGBA_StateSaveToMemory(&size);
 
-    is_waiting = 1;
+    SDL_UnlockMutex(script_mutex);
 
-    script_thread = SDL_CreateThread(Script_Runner, "Script Runner", NULL);
-    if (script_thread == NULL)
+    if (state == NULL)
     {
-        Debug_Log("SDL_CreateThread failed: %s", SDL_GetError());
+        lua_pushnil(L);
         return 1;
     }
 
-    script_running = 1;
+    lua_pushlstring(L, state, size);
 
-    while (is_waiting == 1)
-        SDL_Delay(0);
+    UGBA_StateFree(state);
 
-    return 0;
+    // Number of results
+    return 1;
 }
 
-void Script_WaitEnd(void)
+static int lua_state_load_from_string(lua_State *L)
 {
-    int return_status;
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 1)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
 
-    SDL_WaitThread(script_thread, &return_status);
+    size_t size;
+    const char *state = lua_tolstring(L, -1, &size);
+    if (state == NULL)
+    {
+        Debug_Log("%s(): Invalid state", __func__);
+        return 0;
+    }
 
-    if (return_status != 0)
-        Debug_Log("%s: Thread returned with: %d", __func__, return_status);
+    if (!Script_LockPaused(__func__))
+        return 0;
 
-    free(script_path);
+    UGBA_StateLoadFromMemory(state, size);
 
-    script_running = 0;
+    SDL_UnlockMutex(script_mutex);
+
+    lua_pop(L, 1);
+
+    // Number of results
+    return 0;
+}
+
+static int lua_scenario_fork(lua_State *L)
+{
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if ((narg != 2) && (narg != 3))
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    lua_Integer num = lua_tointeger(L, 1);
+    const char *path = lua_tostring(L, 2);
+    lua_Integer max_parallel = (narg == 3) ? lua_tointeger(L, 3) : 0;
+
+    if ((num <= 0) || (path == NULL))
+    {
+        Debug_Log("%s(): Invalid arguments", __func__);
+        return 0;
+    }
+
+    Debug_Log("%s(%lld, %s, %lld)", __func__, num, path, max_parallel);
+
+    size_t len = strlen(path);
+
+    free(scenario_script);
+    scenario_script = malloc(len + 1);
+    if (scenario_script == NULL)
+    {
+        Debug_Log("%s(): Not enough memory", __func__);
+        return 0;
+    }
+
+    snprintf(scenario_script, len + 1, "%s", path);
+
+    lua_pop(L, narg);
+
+    SDL_LockMutex(script_mutex);
+
+    scenario_num = num;
+    scenario_max_parallel = max_parallel;
+    scenario_requested = 1;
+    SDL_CondBroadcast(script_cond);
+
+    while (scenario_requested)
+        SDL_CondWait(script_cond, script_mutex);
+
+    int result = scenario_result;
+
+    SDL_UnlockMutex(script_mutex);
+
+    if (result != UGBA_SCENARIO_PARENT)
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    // Table with the results of all scenarios, false if there is no result
+    lua_createtable(L, num, 0);
+
+    for (int i = 0; i < num; i++)
+    {
+        size_t size;
+        const void *data = UGBA_ScenarioGetResult(i, &size);
+
+        if (data != NULL)
+            lua_pushlstring(L, data, size);
+        else
+            lua_pushboolean(L, 0);
+
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    // Number of results
+    return 1;
+}
+
+static int lua_scenario_report(lua_State *L)
+{
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 1)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    size_t size;
+    const char *result = lua_tolstring(L, -1, &size);
+    if (result == NULL)
+    {
+        Debug_Log("%s(): Invalid result", __func__);
+        return 0;
+    }
+
+    Debug_Log("%s()", __func__);
+
+    // This only returns if this process isn't a scenario
+    UGBA_ScenarioReport(result, size);
+
+    // Number of results
+    return 0;
+}
+
+static int lua_keys_sequence(lua_State *L)
+{
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 1)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    if (!lua_istable(L, 1))
+    {
+        Debug_Log("%s(): Invalid sequence", __func__);
+        return 0;
+    }
+
+    size_t len = lua_rawlen(L, 1);
+
+    Debug_Log("%s(%zu entries)", __func__, len);
+
+    script_input *entries = malloc((len + 1) * sizeof(script_input));
+    if (entries == NULL)
+    {
+        Debug_Log("%s(): Not enough memory", __func__);
+        return 0;
+    }
+
+    int num = 0;
+    lua_Integer total = 0;
+
+    // Each entry is a table with the number of frames followed by the names of
+    // the keys that are held during those frames.
+    for (size_t i = 0; i < len; i++)
+    {
+        lua_rawgeti(L, 1, i + 1);
+
+        if (!lua_istable(L, -1))
+        {
+            Debug_Log("%s(): Invalid entry: %zu", __func__, i + 1);
+            free(entries);
+            return 0;
+        }
+
+        size_t entry_len = lua_rawlen(L, -1);
+
+        lua_rawgeti(L, -1, 1);
+        lua_Integer frames = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+
+        uint16_t keys = 0;
+
+        for (size_t j = 2; j <= entry_len; j++)
+        {
+            lua_rawgeti(L, -1, j);
+
+            const char *name = lua_tostring(L, -1);
+            if (name != NULL)
+                keys |= get_bit_from_key_name(name);
+
+            lua_pop(L, 1);
+        }
+
+        lua_pop(L, 1);
+
+        if ((frames < 0) || (frames > (INT_MAX - total)))
+        {
+            Debug_Log("%s(): Invalid number of frames: %lld", __func__, frames);
+            free(entries);
+            return 0;
+        }
+
+        if (frames == 0)
+            continue;
+
+        entries[num].keys = keys;
+        entries[num].frames = frames;
+        num++;
+
+        total += frames;
+    }
+
+    lua_pop(L, 1);
+
+    if (num == 0)
+    {
+        free(entries);
+        return 0;
+    }
+
+    // The keys held with keys_hold() are only held again after the sequence
+    uint16_t keys_held = lua_keyinput;
+
+    SDL_LockMutex(script_mutex);
+
+    sequence = entries;
+    sequence_len = num;
+    sequence_index = 0;
+    sequence_frame = 0;
+
+    lua_keyinput = entries[0].keys;
+
+    Script_RunFramesLocked(total);
+
+    sequence = NULL;
+
+    lua_keyinput = keys_held;
+
+    SDL_UnlockMutex(script_mutex);
+
+    free(entries);
+
+    // Number of results
+    return 0;
+}
+
+static int lua_run_until(lua_State *L)
+{
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if ((narg != 4) && (narg != 5))
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    lua_Integer address = lua_tointeger(L, 1);
+    lua_Integer size = lua_tointeger(L, 2);
+    const char *op_name = lua_tostring(L, 3);
+    lua_Integer value = lua_tointeger(L, 4);
+    lua_Integer max_frames = (narg == 5) ? lua_tointeger(L, 5) : INT_MAX;
+
+    static const struct {
+        const char *name;
+        until_op op;
+    } ops[] = {
+        { "==", UNTIL_EQ },
+        { "~=", UNTIL_NE },
+        { "<", UNTIL_LT },
+        { "<=", UNTIL_LE },
+        { ">", UNTIL_GT },
+        { ">=", UNTIL_GE },
+    };
+
+    int op = -1;
+
+    for (size_t i = 0; (op_name != NULL) && (i < sizeof(ops) / sizeof(ops[0]));
+         i++)
+    {
+        if (strcmp(ops[i].name, op_name) == 0)
+            op = ops[i].op;
+    }
+
+    if ((op == -1) || ((size != 1) && (size != 2) && (size != 4)) ||
+        (address < 0) || (address > UINT32_MAX) ||
+        (max_frames <= 0) || (max_frames > INT_MAX))
+    {
+        Debug_Log("%s(): Invalid arguments", __func__);
+        return 0;
+    }
+
+    const uint8_t *ptr = GBA_ContextMemRange(address, size);
+    if (ptr == NULL)
+    {
+        Debug_Log("%s(): Invalid address: 0x%08llX", __func__, address);
+        return 0;
+    }
+
+    Debug_Log("%s(0x%08llX, %lld, %s, %lld, %lld)", __func__, address, size,
+              op_name, value, max_frames);
+
+    lua_pop(L, narg);
+
+    uint32_t mask = (size == 4) ? UINT32_MAX : ((1U << (size * 8)) - 1);
+
+    SDL_LockMutex(script_mutex);
+
+    until_ptr = ptr;
+    until_size = size;
+    until_operator = op;
+    until_value = (uint32_t)value & mask;
+    until_met = 0;
+    until_frames = 0;
+    until_active = 1;
+
+    Script_RunFramesLocked(max_frames);
+
+    until_active = 0;
+
+    int met = until_met;
+    int frames = until_frames;
+
+    SDL_UnlockMutex(script_mutex);
+
+    // Number of frames that have been run, or nil if the condition hasn't been
+    // met before the limit.
+    if (met)
+        lua_pushinteger(L, frames);
+    else
+        lua_pushnil(L);
+
+    // Number of results
+    return 1;
+}
+
+// The memory regions are accessed as Lua strings, which can hold binary data.
+static int lua_mem_read(lua_State *L)
+{
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 2)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    lua_Integer address = lua_tointeger(L, 1);
+    lua_Integer size = lua_tointeger(L, 2);
+
+    const void *ptr = NULL;
+    if ((address >= 0) && (address <= UINT32_MAX) && (size >= 0))
+        ptr = GBA_ContextMemRange(address, size);
+
+    if (ptr == NULL)
+    {
+        Debug_Log("%s(): Invalid range: 0x%08llX, %lld", __func__, address,
+                  size);
+        lua_pushnil(L);
+        return 1;
+    }
+
+    if (!Script_LockPaused(__func__))
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    Debug_Log("%s(0x%08llX, %lld)", __func__, address, size);
+
+    lua_pop(L, narg);
+
+    lua_pushlstring(L, ptr, size);
+
+    SDL_UnlockMutex(script_mutex);
+
+    // Number of results
+    return 1;
+}
+
+static int lua_mem_write(lua_State *L)
+{
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 2)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    lua_Integer address = lua_tointeger(L, 1);
+
+    size_t size;
+    const char *data = lua_tolstring(L, 2, &size);
+
+    void *ptr = NULL;
+    if ((address >= 0) && (address <= UINT32_MAX) && (data != NULL))
+        ptr = GBA_ContextMemRange(address, size);
+
+    if (ptr == NULL)
+    {
+        Debug_Log("%s(): Invalid range: 0x%08llX, %zu", __func__, address,
+                  size);
+        return 0;
+    }
+
+    if (!Script_LockPaused(__func__))
+        return 0;
+
+    Debug_Log("%s(0x%08llX, %zu)", __func__, address, size);
+
+    // The data is copied as it is. Writes to the I/O registers don't have any of
+    // the side effects that writes done by the game have.
+    memcpy(ptr, data, size);
+
+    GBA_TileCacheInvalidate(ptr, size);
+
+    SDL_UnlockMutex(script_mutex);
+
+    lua_pop(L, narg);
+
+    // Number of results
+    return 0;
+}
+
+// 64-bit FNV-1a. The hashes are returned as strings of 16 hexadecimal digits.
+
+#define SCRIPT_HASH_INIT    0xCBF29CE484222325ULL
+#define SCRIPT_HASH_PRIME   0x00000100000001B3ULL
+
+static uint64_t script_hash(uint64_t hash, const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= SCRIPT_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+static void script_push_hash(lua_State *L, uint64_t hash)
+{
+    char str[17];
+    snprintf(str, sizeof(str), "%016" PRIx64, hash);
+    lua_pushstring(L, str);
+}
+
+// The hash is calculated from the same frame that screenshot() saves
+static int lua_frame_hash(lua_State *L)
+{
+    static uint8_t frame[240 * 160 * 3];
+
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 0)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    if (!Script_LockPaused(__func__))
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    Debug_Log("%s()", __func__);
+
+    GBA_ConvertScreenBufferTo24RGB(frame);
+
+    SDL_UnlockMutex(script_mutex);
+
+    script_push_hash(L, script_hash(SCRIPT_HASH_INIT, frame, sizeof(frame)));
+
+    // Number of results
+    return 1;
+}
+
+// The samples generated during the last frame are hashed before the volume of
+// the configuration is applied to them. They are hashed as little endian values
+// so that the byte order of the host doesn't change the result.
+static int lua_audio_hash(lua_State *L)
+{
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 0)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    if (!Script_LockPaused(__func__))
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    Debug_Log("%s()", __func__);
+
+    int samples;
+    const int16_t *buffer = Sound_GetFrameSamples(&samples);
+
+    uint64_t hash = SCRIPT_HASH_INIT;
+
+    for (int i = 0; i < samples; i++)
+    {
+        uint16_t sample = buffer[i];
+        uint8_t bytes[2] = { sample & 0xFF, sample >> 8 };
+
+        hash = script_hash(hash, bytes, sizeof(bytes));
+    }
+
+    SDL_UnlockMutex(script_mutex);
+
+    script_push_hash(L, hash);
+
+    // Number of results
+    return 1;
+}
+
+static int lua_exit(lua_State *L)
+{
+    // Number of arguments
+    int narg = lua_gettop(L);
+    if (narg != 0)
+    {
+        Debug_Log("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    Debug_Log("%s()", __func__);
+
+    SDL_LockMutex(script_mutex);
+    is_waiting = 0;
+    remaining_frames = 0;
+    SDL_CondBroadcast(script_cond);
+    SDL_UnlockMutex(script_mutex);
+
+    Win_MainExit();
+
+    // Number of results
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+static int Script_Runner(UNUSED void *ptr)
+{
+    int ret = 1;
+
+    // Create Lua state
+    lua_State *L = luaL_newstate();
+
+    // Load Lua libraries
+    luaL_openlibs(L);
+
+    // Load script from file
+    int status = luaL_loadfile(L, script_path);
+    if (status) {
+        // On error, the error message is at the top of the stack
+        fprintf(stderr, "Couldn't load file: %s", lua_tostring(L, -1));
+        goto exit;
+    }
+
+    // Register C functions
+    lua_register(L, "run_frames_and_pause", lua_run_frames_and_pause);
+    lua_register(L, "continue", lua_continue);
+    lua_register(L, "screenshot", lua_screenshot);
+    lua_register(L, "keys_hold", lua_keys_hold);
+    lua_register(L, "keys_release", lua_keys_release);
+    lua_register(L, "keys_sequence", lua_keys_sequence);
+    lua_register(L, "run_until", lua_run_until);
+    lua_register(L, "mem_read", lua_mem_read);
+    lua_register(L, "mem_write", lua_mem_write);
+    lua_register(L, "frame_hash", lua_frame_hash);
+    lua_register(L, "audio_hash", lua_audio_hash);
+    lua_register(L, "wav_record_start", lua_wav_record_start);
+    lua_register(L, "wav_record_end", lua_wav_record_end);
+    lua_register(L, "video_record_start", lua_video_record_start);
+    lua_register(L, "video_record_end", lua_video_record_end);
+    lua_register(L, "state_save", lua_state_save);
+    lua_register(L, "state_load", lua_state_load);
+    lua_register(L, "state_save_to_string", lua_state_save_to_string);
+    lua_register(L, "state_load_from_string", lua_state_load_from_string);
+    lua_register(L, "scenario_fork", lua_scenario_fork);
+    lua_register(L, "scenario_report", lua_scenario_report);
+    lua_register(L, "exit", lua_exit);
+
+    // Scripts of scenarios can check which one they are running
+    if (scenario_index >= 0)
+    {
+        lua_pushinteger(L, scenario_index + 1);
+        lua_setglobal(L, "scenario_index");
+    }
+
+    // Run script with 0 arguments and expect one return value
+    int result = lua_pcall(L, 0, 1, 0);
+    if (result) {
+        fprintf(stderr, "Failed to run script: %s", lua_tostring(L, -1));
+        goto exit;
+    }
+
+    // Get returned value and remove it from the stack (it's at the top)
+    int retval  = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+
+    Debug_Log("Script returned: %d", retval);
+
+    // Close Lua
+    lua_close(L);
+
+    ret = 0;
+exit:
+    // The process of a scenario ends with its script
+    if (Scenario_IsChild())
+        Scenario_ChildExit();
+
+    // Let the game thread continue if it is waiting for the script
+    SDL_LockMutex(script_mutex);
+    script_running = 0;
+    SDL_CondBroadcast(script_cond);
+    SDL_UnlockMutex(script_mutex);
+
+    return ret;
+}
+
+int Script_RunLua(const char *path)
+{
+    if (path == NULL)
+        return 1;
+
+    size_t len = strlen(path);
+
+    free(script_path);
+    script_path = malloc(len + 1);
+    if (script_path == NULL)
+        return 1;
+
+    snprintf(script_path, len + 1, "%s", path);
+
+    if (script_mutex == NULL)
+    {
+        script_mutex = SDL_CreateMutex();
+        script_cond = SDL_CreateCond();
+        if ((script_mutex == NULL) || (script_cond == NULL))
+        {
+            Debug_Log("%s: Failed to create sync objects: %s", __func__,
+                      SDL_GetError());
+            SDL_DestroyMutex(script_mutex);
+            SDL_DestroyCond(script_cond);
+            script_mutex = NULL;
+            script_cond = NULL;
+            return 1;
+        }
+    }
+
+    SDL_LockMutex(script_mutex);
+    is_waiting = 1;
+    script_running = 1;
+    SDL_UnlockMutex(script_mutex);
+
+    script_thread = SDL_CreateThread(Script_Runner, "Script Runner", NULL);
+    if (script_thread == NULL)
+    {
+        Debug_Log("SDL_CreateThread failed: %s", SDL_GetError());
+
+        SDL_LockMutex(script_mutex);
+        is_waiting = 0;
+        script_running = 0;
+        SDL_UnlockMutex(script_mutex);
+
+        return 1;
+    }
+
+    // Wait until the script asks to run frames (or until it ends). The script
+    // can fork scenarios before running any frame.
+    SDL_LockMutex(script_mutex);
+
+    while (is_waiting && script_running)
+    {
+        if (scenario_requested)
+        {
+            if (Script_HandleScenarioRequest())
+                break;
+            continue;
+        }
+
+        SDL_CondWait(script_cond, script_mutex);
+    }
+
+    SDL_UnlockMutex(script_mutex);
+
+    return 0;
+}
+
+void Script_WaitEnd(void)
+{
+    int return_status;
+
+    SDL_WaitThread(script_thread, &return_status);
+
+    if (return_status != 0)
+        Debug_Log("%s: Thread returned with: %d", __func__, return_status);
+
+    free(script_path);
+    script_path = NULL;
+
+    SDL_LockMutex(script_mutex);
+    script_running = 0;
+    SDL_UnlockMutex(script_mutex);
+
+    // Make sure that all screenshots taken by the script have been saved
+    PNG_WriterFlush();
 }
 
 #endif // LUA_INTERPRETER_ENABLED
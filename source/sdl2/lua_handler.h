@@ -10,6 +10,10 @@
 // Called by the game thread whenever a frame is drawn and handled
 void Script_FrameDrawn(void);
 
+// Called by the game thread at the start of a frame. Returns 1 if the script
+// may need the frame to be drawn (because it will be paused after it).
+int Script_FrameRequested(void);
+
 // Run the script in the file pointed by path
 int Script_RunLua(const char *path);
 
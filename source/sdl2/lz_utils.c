@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lz_utils.h"
+
+// The compressed data is a list of sequences. Each sequence starts with a token
+// byte. The top 4 bits are the number of literals, and the bottom 4 bits are the
+// length of the match minus LZ_MIN_MATCH. If any of them is 15, the length
+// continues in the following bytes: each one is added to it until a byte
+// different from 255 is found. The literal bytes come after the token (and the
+// extra bytes of the number of literals), followed by the offset of the match
+// (16 bits, little endian), followed by the extra bytes of the length of the
+// match. The last sequence only has literals, and it ends the data.
+
+#define LZ_MIN_MATCH    4
+#define LZ_MAX_OFFSET   0xFFFF
+
+#define LZ_HASH_BITS    14
+#define LZ_HASH_SIZE    (1 << LZ_HASH_BITS)
+
+static inline uint32_t lz_read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t lz_read64(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t lz_hash(uint32_t value)
+{
+    return (value * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+size_t LZ_CompressBound(size_t size)
+{
+    return size + (size / 255) + 16;
+}
+
+static uint8_t *lz_write_length(uint8_t *dst, size_t length)
+{
+    while (length >= 255)
+    {
+        *dst++ = 255;
+        length -= 255;
+    }
+
+    *dst++ = length;
+
+    return dst;
+}
+
+static uint8_t *lz_write_sequence(uint8_t *dst, const uint8_t *literals,
+                                  size_t num_literals, size_t offset,
+                                  size_t match_length)
+{
+    uint8_t *token = dst++;
+
+    size_t literals_code = (num_literals < 15) ? num_literals : 15;
+    if (num_literals >= 15)
+        dst = lz_write_length(dst, num_literals - 15);
+
+    memcpy(dst, literals, num_literals);
+    dst += num_literals;
+
+    // The last sequence doesn't have a match
+    if (match_length == 0)
+    {
+        *token = literals_code << 4;
+        return dst;
+    }
+
+    *dst++ = offset & 0xFF;
+    *dst++ = offset >> 8;
+
+    size_t length = match_length - LZ_MIN_MATCH;
+    size_t length_code = (length < 15) ? length : 15;
+    if (length >= 15)
+        dst = lz_write_length(dst, length - 15);
+
+    *token = (literals_code << 4) | length_code;
+
+    return dst;
+}
+
+size_t LZ_Compress(void *dst, const void *src, size_t size)
+{
+    const uint8_t *in = src;
+    uint8_t *out = dst;
+
+    uint32_t *table = calloc(LZ_HASH_SIZE, sizeof(uint32_t));
+    if (table == NULL)
+        return 0;
+
+    size_t anchor = 0; // Start of the literals of the current sequence
+    size_t pos = 0;
+
+    if (size >= LZ_MIN_MATCH)
+    {
+        size_t last = size - LZ_MIN_MATCH;
+
+        while (pos <= last)
+        {
+            uint32_t value = lz_read32(&in[pos]);
+            uint32_t hash = lz_hash(value);
+            size_t ref = table[hash];
+            table[hash] = pos;
+
+            if ((ref >= pos) || ((pos - ref) > LZ_MAX_OFFSET) ||
+                (lz_read32(&in[ref]) != value))
+            {
+                // Skip data faster the longer it has been since the last
+                // match, so that data that can't be compressed isn't too slow.
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            size_t length = LZ_MIN_MATCH;
+
+            while ((pos + length + 8 <= size) &&
+                   (lz_read64(&in[ref + length]) == lz_read64(&in[pos + length])))
+            {
+                length += 8;
+            }
+
+            while ((pos + length < size) && (in[ref + length] == in[pos + length]))
+                length++;
+
+            out = lz_write_sequence(out, &in[anchor], pos - anchor, pos - ref,
+                                    length);
+
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    out = lz_write_sequence(out, &in[anchor], size - anchor, 0, 0);
+
+    free(table);
+
+    return out - (uint8_t *)dst;
+}
+
+static int lz_read_length(const uint8_t **src, const uint8_t *src_end,
+                          size_t *length)
+{
+    const uint8_t *p = *src;
+    size_t value = *length;
+
+    while (1)
+    {
+        if (p == src_end)
+            return -1;
+
+        uint8_t byte = *p++;
+        value += byte;
+
+        if (byte != 255)
+            break;
+
+        // Avoid overflows with corrupted data
+        if (value > (SIZE_MAX / 2))
+            return -1;
+    }
+
+    *src = p;
+    *length = value;
+
+    return 0;
+}
+
+int LZ_Decompress(void *dst, size_t dst_size, const void *src, size_t src_size)
+{
+    const uint8_t *in = src;
+    const uint8_t *in_end = in + src_size;
+    uint8_t *out = dst;
+    uint8_t *out_end = out + dst_size;
+
+    while (1)
+    {
+        if (in == in_end)
+            return -1;
+
+        uint8_t token = *in++;
+
+        size_t length = token >> 4;
+        if (length == 15)
+        {
+            if (lz_read_length(&in, in_end, &length) != 0)
+                return -1;
+        }
+
+        if (((size_t)(in_end - in) < length) ||
+            ((size_t)(out_end - out) < length))
+        {
+            return -1;
+        }
+
+        memcpy(out, in, length);
+        in += length;
+        out += length;
+
+        // The last sequence doesn't have a match
+        if (in == in_end)
+            break;
+
+        if ((in_end - in) < 2)
+            return -1;
+
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+
+        if ((offset == 0) || (offset > (size_t)(out - (uint8_t *)dst)))
+            return -1;
+
+        length = token & 0xF;
+        if (length == 15)
+        {
+            if (lz_read_length(&in, in_end, &length) != 0)
+                return -1;
+        }
+        length += LZ_MIN_MATCH;
+
+        if ((size_t)(out_end - out) < length)
+            return -1;
+
+        const uint8_t *ref = out - offset;
+
+        if (offset >= length)
+        {
+            memcpy(out, ref, length);
+        }
+        else if (offset == 1)
+        {
+            memset(out, *ref, length);
+        }
+        else
+        {
+            // The match overlaps the data that is being written. It repeats
+            // the last "offset" bytes, so once they have been copied the rest
+            // can be copied from the start of the match in bigger blocks.
+            memcpy(out, ref, offset);
+
+            size_t done = offset;
+            while (done < length)
+            {
+                size_t size = length - done;
+                if (size > done)
+                    size = done;
+
+                memcpy(out + done, out, size);
+                done += size;
+            }
+        }
+
+        out += length;
+    }
+
+    if (out != out_end)
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_LZ_UTILS_H__
+#define SDL2_LZ_UTILS_H__
+
+#include <stddef.h>
+
+// Fast LZ77 codec with a byte-oriented format similar to the LZ4 block format.
+// It is meant for data that needs to be compressed and decompressed quickly,
+// not for data that needs to be as small as possible.
+
+// Maximum size of the compressed data of a buffer of "size" bytes
+size_t LZ_CompressBound(size_t size);
+
+// Compress "size" bytes from "src" to "dst", which must be at least as big as
+// the value returned by LZ_CompressBound(). It returns the size of the
+// compressed data, or 0 on error.
+size_t LZ_Compress(void *dst, const void *src, size_t size);
+
+// Decompress "src_size" bytes of compressed data from "src" to "dst". It
+// returns 0 on success, or -1 if the data is corrupted or if the size of the
+// decompressed data isn't exactly "dst_size".
+int LZ_Decompress(void *dst, size_t dst_size, const void *src, size_t src_size);
+
+#endif // SDL2_LZ_UTILS_H__
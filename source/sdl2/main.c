@@ -1,6 +1,6 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 //
-// Copyright (c) 2011-2015, 2019-2021 Antonio Niño Díaz
+// Copyright (c) 2011-2015, 2019-2021, 2026 Antonio Niño Díaz
 
 #include <stdlib.h>
 
@@ -12,10 +12,16 @@
 #include "debug_utils.h"
 #include "input_utils.h"
 #include "lua_handler.h"
+#include "png_utils.h"
+#include "png_writer.h"
+#include "profiler.h"
 #include "save_file.h"
 #include "sound_utils.h"
 
+#include "core/color_convert.h"
+#include "core/context.h"
 #include "core/sound.h"
+#include "core/state.h"
 #include "core/video.h"
 #include "gui/win_main.h"
 #include "gui/window_handler.h"
@@ -112,7 +118,7 @@ static void UGBA_ParseArgs(int *argc, char **argv[])
             }
         }
 
-        if (*argc > 2)
+        while (*argc > 2)
         {
             if (strcmp((*argv)[1], "--lua") == 0)
             {
@@ -121,20 +127,50 @@ static void UGBA_ParseArgs(int *argc, char **argv[])
 #else
                 Debug_Log("UGBA compiled without Lua support.");
 #endif
+            }
+            else if (strcmp((*argv)[1], "--fast-forward") == 0)
+            {
+                UGBA_FastForwardSet(1, atoi((*argv)[2]));
+            }
+            else if (strcmp((*argv)[1], "--profile") == 0)
+            {
+                Profiler_Init((*argv)[2]);
+            }
+            else
+            {
+                break;
+            }
 
-                // Remove argv[1] and argv[2]
+            // Remove argv[1] and argv[2]
 
-                for (int i = 1; i < *argc - 2; i++)
-                    (*argv)[i] = (*argv)[i + 2];
+            for (int i = 1; i < *argc - 2; i++)
+                (*argv)[i] = (*argv)[i + 2];
 
-                *argc = *argc - 2;
-            }
+            *argc = *argc - 2;
         }
     }
 }
 
+static void UGBA_ParseEnvironment(void)
+{
+    const char *fast_forward = getenv("UGBA_FAST_FORWARD");
+    if (fast_forward != NULL)
+        UGBA_FastForwardSet(1, atoi(fast_forward));
+
+    const char *profile = getenv("UGBA_PROFILE");
+    if (profile != NULL)
+        Profiler_Init(profile);
+
+    if (GlobalConfig.profiler)
+        Profiler_Init(NULL);
+}
+
 void UGBA_Init(int *argc, char **argv[])
 {
+    // Contexts created with UGBA_ContextCreate() are already initialized
+    if (!GBA_ContextIsDefault())
+        return;
+
     // SDL2 port initialization
 
     Debug_Init();
@@ -148,6 +184,16 @@ void UGBA_Init(int *argc, char **argv[])
     Win_MainCreate();
 
     GBA_FillFadeTables();
+    GBA_ColorConvertInit();
+
+    GBA_VideoThreadsInit(GlobalConfig.render_threads);
+    atexit(GBA_VideoThreadsEnd);
+
+#ifdef ENABLE_LIBPNG
+    PNG_SetCompressionLevel(GlobalConfig.png_compression);
+    PNG_WriterInit();
+    atexit(PNG_WriterEnd);
+#endif
 
     // Initialize hardware status
 
@@ -155,6 +201,7 @@ void UGBA_Init(int *argc, char **argv[])
 
     // Detect arguments
 
+    UGBA_ParseEnvironment();
     UGBA_ParseArgs(argc, argv);
 
     // Update key input state
@@ -164,12 +211,17 @@ void UGBA_Init(int *argc, char **argv[])
     // Library initialization
 
     IRQ_Init();
+    GBA_StateInit();
 
     REG_WAITCNT = WAITCNT_DEFAULT_STARTUP;
 }
 
 void UGBA_InitHeadless(int *argc, char **argv[])
 {
+    // Contexts created with UGBA_ContextCreate() are already initialized
+    if (!GBA_ContextIsDefault())
+        return;
+
     // SDL2 port initialization
 
     Debug_Init();
@@ -181,6 +233,16 @@ void UGBA_InitHeadless(int *argc, char **argv[])
     Config_Load();
 
     GBA_FillFadeTables();
+    GBA_ColorConvertInit();
+
+    GBA_VideoThreadsInit(GlobalConfig.render_threads);
+    atexit(GBA_VideoThreadsEnd);
+
+#ifdef ENABLE_LIBPNG
+    PNG_SetCompressionLevel(GlobalConfig.png_compression);
+    PNG_WriterInit();
+    atexit(PNG_WriterEnd);
+#endif
 
     // Initialize hardware status
 
@@ -188,6 +250,7 @@ void UGBA_InitHeadless(int *argc, char **argv[])
 
     // Detect arguments
 
+    UGBA_ParseEnvironment();
     UGBA_ParseArgs(argc, argv);
 
     Input_Update_GBA();
@@ -195,6 +258,7 @@ void UGBA_InitHeadless(int *argc, char **argv[])
     // Library initialization
 
     IRQ_Init();
+    GBA_StateInit();
 
     REG_WAITCNT = WAITCNT_DEFAULT_STARTUP;
 }
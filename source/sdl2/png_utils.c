@@ -2,6 +2,7 @@
 //
 // Copyright (c) 2011-2015, 2019-2020 Antonio Niño Díaz
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -16,33 +17,76 @@
 # error "This code needs libpng 1.6"
 #endif
 
-// Save a RGBA buffer into a PNG file
+static int png_compression_level = 6;
+
+void PNG_SetCompressionLevel(int level)
+{
+    if (level < 0)
+        level = 0;
+    else if (level > 9)
+        level = 9;
+
+    png_compression_level = level;
+}
+
+// Save a RGBA buffer into a PNG file. The simplified API of libpng doesn't
+// allow the compression level to be changed, so the regular one is used.
 int Save_PNG(const char *filename, unsigned char *buffer,
              int width, int height, int is_rgba)
 {
-    png_image image;
-    memset(&image, 0, sizeof(image));
-
-    image.version = PNG_IMAGE_VERSION;
-    image.width = width;
-    image.height = height;
-    image.flags = 0;
-    image.colormap_entries = 0;
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+    {
+        Debug_Log("%s(): Can't open file: %s", __func__, filename);
+        return 1;
+    }
 
-    if (is_rgba)
-        image.format = PNG_FORMAT_RGBA;
-    else
-        image.format = PNG_FORMAT_RGB;
+    png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+                                                  NULL, NULL, NULL);
+    if (png_ptr == NULL)
+    {
+        Debug_Log("%s(): png_create_write_struct() failed", __func__);
+        fclose(file);
+        return 1;
+    }
 
-    int row_stride = is_rgba ? (width * 4) : (width * 3);
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if (info_ptr == NULL)
+    {
+        Debug_Log("%s(): png_create_info_struct() failed", __func__);
+        png_destroy_write_struct(&png_ptr, NULL);
+        fclose(file);
+        return 1;
+    }
 
-    if (!png_image_write_to_file(&image, filename, 0, buffer, row_stride, NULL))
+    if (setjmp(png_jmpbuf(png_ptr)))
     {
-        Debug_Log("%s(): png_image_write_to_file(): %s",
-                  __func__, image.message);
+        Debug_Log("%s(): Failed to write file: %s", __func__, filename);
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(file);
         return 1;
     }
 
+    png_init_io(png_ptr, file);
+    png_set_compression_level(png_ptr, png_compression_level);
+
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8,
+                 is_rgba ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+
+    png_write_info(png_ptr, info_ptr);
+
+    int row_stride = is_rgba ? (width * 4) : (width * 3);
+
+    for (int y = 0; y < height; y++)
+        png_write_row(png_ptr, &buffer[y * row_stride]);
+
+    png_write_end(png_ptr, NULL);
+
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(file);
+
     return 0;
 }
 
@@ -7,6 +7,9 @@
 
 #ifdef ENABLE_LIBPNG
 
+// zlib compression level used by Save_PNG() (0 - 9)
+void PNG_SetCompressionLevel(int level);
+
 // Buffer is 32 bit (RGBA) / 24 bit (RGB), returns 0 on success
 int Save_PNG(const char *filename, unsigned char *buffer,
              int width, int height, int is_rgba);
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#ifdef ENABLE_LIBPNG
+
+#include <ugba/ugba.h>
+
+#include "debug_utils.h"
+#include "png_utils.h"
+#include "png_writer.h"
+#include "work_queue.h"
+
+// Compressing a PNG file takes several milliseconds. Instead of doing it in the
+// thread of the game, files are added to a queue and a background thread saves
+// them. The thread of the game only needs to wait if the queue is full.
+
+#define PNG_WRITER_QUEUE_SIZE   8
+
+typedef struct {
+    char *filename;
+    unsigned char *buffer;
+    int width;
+    int height;
+    int is_rgba;
+} png_writer_job;
+
+static work_queue *png_writer_queue;
+
+static void png_writer_handle_job(void *entry)
+{
+    png_writer_job *job = entry;
+
+    Save_PNG(job->filename, job->buffer, job->width, job->height,
+             job->is_rgba);
+
+    free(job->filename);
+    free(job->buffer);
+}
+
+void PNG_WriterInit(void)
+{
+    if (png_writer_queue != NULL)
+        return;
+
+    png_writer_queue = WQ_Create("PNG Writer", sizeof(png_writer_job),
+                                 PNG_WRITER_QUEUE_SIZE, png_writer_handle_job);
+}
+
+int PNG_WriterSave(const char *filename, const unsigned char *buffer,
+                   int width, int height, int is_rgba)
+{
+    // If the thread couldn't be created, save the file right away
+    if (png_writer_queue == NULL)
+    {
+        return Save_PNG(filename, (unsigned char *)buffer, width, height,
+                        is_rgba);
+    }
+
+    size_t size = (size_t)width * height * (is_rgba ? 4 : 3);
+    size_t name_size = strlen(filename) + 1;
+
+    unsigned char *buffer_copy = malloc(size);
+    char *filename_copy = malloc(name_size);
+    if ((buffer_copy == NULL) || (filename_copy == NULL))
+    {
+        Debug_Log("%s: Not enough memory", __func__);
+        free(buffer_copy);
+        free(filename_copy);
+        return 1;
+    }
+
+    memcpy(buffer_copy, buffer, size);
+    memcpy(filename_copy, filename, name_size);
+
+    png_writer_job *job = WQ_Reserve(png_writer_queue);
+
+    job->filename = filename_copy;
+    job->buffer = buffer_copy;
+    job->width = width;
+    job->height = height;
+    job->is_rgba = is_rgba;
+
+    WQ_Push(png_writer_queue);
+
+    return 0;
+}
+
+void PNG_WriterFlush(void)
+{
+    if (png_writer_queue == NULL)
+        return;
+
+    WQ_Flush(png_writer_queue);
+}
+
+void PNG_WriterEnd(void)
+{
+    if (png_writer_queue == NULL)
+        return;
+
+    WQ_Destroy(png_writer_queue);
+    png_writer_queue = NULL;
+}
+
+#endif // ENABLE_LIBPNG
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_PNG_WRITER_H__
+#define SDL2_PNG_WRITER_H__
+
+#ifdef ENABLE_LIBPNG
+
+// Start the background thread. If it can't be started, files are saved right
+// away by PNG_WriterSave().
+void PNG_WriterInit(void);
+
+// Queue a PNG file to be saved by a background thread. The buffer is copied, so
+// it can be reused as soon as this function returns. The queue has a limited
+// size; if it is full, this function waits until there is space in it. Buffer
+// is 32 bit (RGBA) / 24 bit (RGB). Returns 0 on success.
+int PNG_WriterSave(const char *filename, const unsigned char *buffer,
+                   int width, int height, int is_rgba);
+
+// Wait until all the files in the queue have been written
+void PNG_WriterFlush(void);
+
+// Write all pending files and stop the background thread
+void PNG_WriterEnd(void);
+
+#endif // ENABLE_LIBPNG
+
+#endif // SDL2_PNG_WRITER_H__
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL2/SDL.h>
+
+#include "debug_utils.h"
+#include "profiler.h"
+
+int profiler_enabled = 0;
+
+static const char *profiler_names[PROF_NUM] = {
+    "game", "video", "sound", "dma", "irq", "gui", "idle"
+};
+
+static FILE *profiler_file = NULL;
+
+static double profiler_us_per_tick;
+
+static uint64_t profiler_frame_ticks[PROF_NUM]; // Time of the current frame
+static uint64_t profiler_frame_start;
+static uint32_t profiler_frame_number;
+
+// Totals since the last call to Profiler_GetSummary()
+static uint64_t profiler_summary_ticks[PROF_NUM];
+static uint32_t profiler_summary_frames;
+
+// Time of each section in every frame, in microseconds. It is used to generate
+// the summary when the program exits.
+static float *profiler_samples = NULL;
+static size_t profiler_samples_frames = 0;
+static size_t profiler_samples_capacity = 0;
+
+void Profiler_AddTime(prof_section section, uint64_t start)
+{
+    // Sections that started before the profiler was enabled are ignored
+    if (start == 0)
+        return;
+
+    profiler_frame_ticks[section] += SDL_GetPerformanceCounter() - start;
+}
+
+static void Profiler_SaveSample(const float *sample)
+{
+    if (profiler_samples_frames == profiler_samples_capacity)
+    {
+        size_t capacity = profiler_samples_capacity * 2;
+        if (capacity == 0)
+            capacity = 60 * 60;
+
+        float *samples = realloc(profiler_samples,
+                                 capacity * PROF_NUM * sizeof(float));
+        if (samples == NULL)
+        {
+            Debug_Log("%s: Not enough memory", __func__);
+            return;
+        }
+
+        profiler_samples = samples;
+        profiler_samples_capacity = capacity;
+    }
+
+    float *dst = &profiler_samples[profiler_samples_frames * PROF_NUM];
+    for (int i = 0; i < PROF_NUM; i++)
+        dst[i] = sample[i];
+
+    profiler_samples_frames++;
+}
+
+void Profiler_FrameEnd(void)
+{
+    if (profiler_enabled == 0)
+        return;
+
+    uint64_t now = SDL_GetPerformanceCounter();
+    double total_us = (now - profiler_frame_start) * profiler_us_per_tick;
+    profiler_frame_start = now;
+
+    if (profiler_file != NULL)
+    {
+        float sample[PROF_NUM];
+
+        fprintf(profiler_file, "{\"frame\":%u,\"total_us\":%.1f",
+                profiler_frame_number, total_us);
+
+        for (int i = 0; i < PROF_NUM; i++)
+        {
+            sample[i] = profiler_frame_ticks[i] * profiler_us_per_tick;
+            fprintf(profiler_file, ",\"%s_us\":%.1f", profiler_names[i],
+                    sample[i]);
+        }
+
+        fprintf(profiler_file, "}\n");
+
+        Profiler_SaveSample(sample);
+    }
+
+    for (int i = 0; i < PROF_NUM; i++)
+    {
+        profiler_summary_ticks[i] += profiler_frame_ticks[i];
+        profiler_frame_ticks[i] = 0;
+    }
+
+    profiler_summary_frames++;
+    profiler_frame_number++;
+}
+
+int Profiler_GetSummary(char *buf, size_t size)
+{
+    if (profiler_enabled == 0)
+        return 0;
+
+    uint32_t frames = profiler_summary_frames;
+    if (frames == 0)
+        frames = 1;
+
+    double ms[PROF_NUM];
+    for (int i = 0; i < PROF_NUM; i++)
+    {
+        ms[i] = profiler_summary_ticks[i] * profiler_us_per_tick
+                / (1000.0 * frames);
+        profiler_summary_ticks[i] = 0;
+    }
+
+    profiler_summary_frames = 0;
+
+    snprintf(buf, size, "game %.2f vid %.2f snd %.2f dma %.2f irq %.2f "
+             "gui %.2f (ms)", ms[PROF_GAME], ms[PROF_VIDEO], ms[PROF_SOUND],
+             ms[PROF_DMA], ms[PROF_IRQ], ms[PROF_GUI]);
+
+    return 1;
+}
+
+static int compare_floats(const void *a, const void *b)
+{
+    float fa = *(const float *)a;
+    float fb = *(const float *)b;
+
+    return (fa > fb) - (fa < fb);
+}
+
+static void Profiler_Close(void)
+{
+    if (profiler_file == NULL)
+        return;
+
+    size_t frames = profiler_samples_frames;
+
+    float *values = NULL;
+    if (frames > 0)
+        values = malloc(frames * sizeof(float));
+
+    fprintf(profiler_file, "{\"summary\":{\"frames\":%zu", frames);
+
+    for (int i = 0; (i < PROF_NUM) && (values != NULL); i++)
+    {
+        double sum = 0;
+
+        for (size_t f = 0; f < frames; f++)
+        {
+            values[f] = profiler_samples[f * PROF_NUM + i];
+            sum += values[f];
+        }
+
+        qsort(values, frames, sizeof(float), compare_floats);
+
+        fprintf(profiler_file,
+                ",\"%s_us\":{\"min\":%.1f,\"avg\":%.1f,\"p99\":%.1f,"
+                "\"max\":%.1f}", profiler_names[i], values[0], sum / frames,
+                values[(frames * 99) / 100], values[frames - 1]);
+    }
+
+    fprintf(profiler_file, "}}\n");
+
+    free(values);
+    free(profiler_samples);
+    profiler_samples = NULL;
+
+    fclose(profiler_file);
+    profiler_file = NULL;
+}
+
+int Profiler_Init(const char *path)
+{
+    if (path != NULL)
+    {
+        if (profiler_file != NULL)
+            return 0;
+
+        profiler_file = fopen(path, "w");
+        if (profiler_file == NULL)
+        {
+            Debug_Log("%s: Can't open %s", __func__, path);
+            return -1;
+        }
+
+        atexit(Profiler_Close);
+    }
+
+    profiler_us_per_tick = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+    profiler_frame_start = SDL_GetPerformanceCounter();
+
+    profiler_enabled = 1;
+
+    return 0;
+}
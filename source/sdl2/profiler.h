@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_PROFILER_H__
+#define SDL2_PROFILER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <SDL2/SDL.h>
+
+#include "core/context.h"
+
+// Frame profiler. It measures how much time of each frame is spent in each
+// subsystem of the library. The sections can overlap: for example, the time
+// spent in DMA copies started by an interrupt handler is counted both as DMA
+// and as IRQ time.
+
+typedef enum {
+    PROF_GAME,  // Game code outside of the library
+    PROF_VIDEO, // Drawing scanlines
+    PROF_SOUND, // Sound_Handle_VBL()
+    PROF_DMA,   // HBL and VBL DMA transfers
+    PROF_IRQ,   // Interrupt handlers
+    PROF_GUI,   // Windows, screen conversion and rendering
+    PROF_IDLE,  // Waiting to keep the frame rate at 60 FPS
+
+    PROF_NUM
+} prof_section;
+
+extern int profiler_enabled;
+
+// Returns the start time of a section, or 0 if the profiler is disabled. Only
+// the default context is profiled.
+static inline uint64_t Profiler_Start(void)
+{
+    if (profiler_enabled == 0)
+        return 0;
+
+    if (!GBA_ContextIsDefault())
+        return 0;
+
+    return SDL_GetPerformanceCounter();
+}
+
+void Profiler_AddTime(prof_section section, uint64_t start);
+
+static inline void Profiler_End(prof_section section, uint64_t start)
+{
+    if (profiler_enabled == 0)
+        return;
+
+    Profiler_AddTime(section, start);
+}
+
+// Called at the end of every frame
+void Profiler_FrameEnd(void);
+
+// Start profiling. If path isn't NULL, one JSON record is saved to that file
+// for each frame, and a summary with the minimum, average and 99th percentile
+// of each section is saved when the program exits.
+int Profiler_Init(const char *path);
+
+// Write the average time spent in each section since the last call to this
+// function. Returns 0 if the profiler is disabled.
+int Profiler_GetSummary(char *buf, size_t size);
+
+#endif // SDL2_PROFILER_H__
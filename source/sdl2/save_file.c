@@ -86,6 +86,9 @@ static Uint32 Autosave_Callback(Uint32 interval, UNUSED void *param)
 
 static void UGBA_ExitSaveFileClose(void)
 {
+    if (sav_path == NULL)
+        return;
+
     SDL_RemoveTimer(AutosaveTimerID);
 
     // Check if there have been changes to SRAM
@@ -160,3 +163,35 @@ void UGBA_SaveFileOpen(const char *path)
     AutosaveTimerID = SDL_AddTimer(AUTOSAVE_INTERVAL_MS, Autosave_Callback,
                                    NULL);
 }
+
+void UGBA_SaveFileAutosavePause(int pause)
+{
+    if (sav_path == NULL)
+        return;
+
+    if (pause)
+    {
+        if (AutosaveTimerID != 0)
+        {
+            SDL_RemoveTimer(AutosaveTimerID);
+            AutosaveTimerID = 0;
+        }
+    }
+    else
+    {
+        if (AutosaveTimerID == 0)
+        {
+            AutosaveTimerID = SDL_AddTimer(AUTOSAVE_INTERVAL_MS,
+                                           Autosave_Callback, NULL);
+        }
+    }
+}
+
+void UGBA_SaveFileDetach(void)
+{
+    // The timer must have been stopped before calling this function
+    AutosaveTimerID = 0;
+
+    free(sav_path);
+    sav_path = NULL;
+}
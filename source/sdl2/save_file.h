@@ -7,4 +7,11 @@
 
 void UGBA_SaveFileOpen(const char *path);
 
+// Stop or restart the timer that autosaves the SRAM
+void UGBA_SaveFileAutosavePause(int pause);
+
+// Stop saving the SRAM to the file. Used by processes that share the save file
+// with their parent process.
+void UGBA_SaveFileDetach(void);
+
 #endif // SDL2_SAVE_FILE_H__
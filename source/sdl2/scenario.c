@@ -0,0 +1,465 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef _WIN32
+// The library is built as C11 without extensions, fork() and friends need this
+# define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+# include <errno.h>
+# include <poll.h>
+# include <signal.h>
+# include <sys/types.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
+#include <SDL2/SDL.h>
+
+#include <ugba/ugba.h>
+
+#include "config.h"
+#include "debug_utils.h"
+#include "png_writer.h"
+#include "profiler.h"
+#include "save_file.h"
+#include "scenario.h"
+#include "video_capture.h"
+#include "wav_utils.h"
+
+#include "core/video.h"
+
+#ifndef _WIN32
+
+// The children are created with fork(), so they get a copy of the whole
+// process: the memory of the emulated hardware and the variables of the game.
+// The memory is only copied when it is modified, so creating a child is cheap.
+//
+// Only the thread that calls fork() exists in the child, so all the threads of
+// the library are stopped before forking, and the ones that are needed are
+// started again in the parent and in the children afterwards. The children
+// don't draw scanlines in other threads, the parallelism comes from running
+// several children at the same time.
+//
+// Each child has a pipe to send its result to the parent. The message is the
+// size of the result (64 bits, native byte order) followed by the data. If the
+// message is incomplete, the child didn't report any result.
+
+typedef struct {
+    pid_t pid;
+    int fd; // Read end of the pipe, or -1 if the child has ended
+    uint8_t *data; // Message received from the child
+    size_t size;
+    size_t capacity;
+} scenario_child;
+
+static scenario_child *scenario_children;
+static int scenario_children_num;
+
+static int scenario_pipe = -1; // Write end of the pipe of a child process
+
+int Scenario_IsChild(void)
+{
+    return scenario_pipe != -1;
+}
+
+void Scenario_ChildExit(void)
+{
+#ifdef ENABLE_LIBPNG
+    // Make sure that all the screenshots of this child have been saved
+    PNG_WriterFlush();
+#endif
+
+    fflush(NULL);
+
+    // exit() would run the handlers registered with atexit(), and they would
+    // try to stop threads that only exist in the parent process.
+    _exit(0);
+}
+
+static void scenario_child_atexit(void)
+{
+    Scenario_ChildExit();
+}
+
+static int scenario_write_all(int fd, const void *data, size_t size)
+{
+    const uint8_t *ptr = data;
+
+    while (size > 0)
+    {
+        ssize_t written = write(fd, ptr, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        ptr += written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+void UGBA_ScenarioReport(const void *data, size_t size)
+{
+    if (scenario_pipe == -1)
+    {
+        Debug_Log("%s: This process isn't a scenario", __func__);
+        return;
+    }
+
+    uint64_t message_size = size;
+
+    if ((scenario_write_all(scenario_pipe, &message_size,
+                            sizeof(message_size)) != 0) ||
+        (scenario_write_all(scenario_pipe, data, size) != 0))
+    {
+        Debug_Log("%s: Failed to send result", __func__);
+    }
+
+    close(scenario_pipe);
+
+    Scenario_ChildExit();
+}
+
+const void *UGBA_ScenarioGetResult(int index, size_t *size)
+{
+    *size = 0;
+
+    if ((index < 0) || (index >= scenario_children_num))
+        return NULL;
+
+    scenario_child *child = &scenario_children[index];
+
+    uint64_t message_size;
+
+    if (child->size < sizeof(message_size))
+        return NULL;
+
+    memcpy(&message_size, child->data, sizeof(message_size));
+
+    if (message_size != (child->size - sizeof(message_size)))
+        return NULL;
+
+    *size = message_size;
+
+    return child->data + sizeof(message_size);
+}
+
+static void scenario_children_free(void)
+{
+    for (int i = 0; i < scenario_children_num; i++)
+        free(scenario_children[i].data);
+
+    free(scenario_children);
+    scenario_children = NULL;
+    scenario_children_num = 0;
+}
+
+// Stop everything that can't be shared between processes or that only works
+// in the thread that created it.
+static void scenario_quiesce(void)
+{
+    if (VID_FileIsOpen())
+    {
+        Debug_Log("%s: Video recording finished before forking", __func__);
+        VID_FileEnd();
+    }
+
+    if (WAV_FileIsOpen())
+    {
+        Debug_Log("%s: WAV recording finished before forking", __func__);
+        WAV_FileEnd();
+    }
+
+#ifdef ENABLE_LIBPNG
+    PNG_WriterEnd();
+#endif
+
+    GBA_VideoThreadsEnd();
+
+    UGBA_SaveFileAutosavePause(1);
+
+    // Buffered output would be written by the parent and by all children
+    fflush(NULL);
+}
+
+static void scenario_resume(void)
+{
+    UGBA_SaveFileAutosavePause(0);
+
+    GBA_VideoThreadsInit(GlobalConfig.render_threads);
+
+#ifdef ENABLE_LIBPNG
+    PNG_WriterInit();
+#endif
+}
+
+static void scenario_child_setup(int fd)
+{
+    // Pipes of other scenarios inherited from the parent
+    for (int i = 0; i < scenario_children_num; i++)
+    {
+        if (scenario_children[i].fd != -1)
+            close(scenario_children[i].fd);
+    }
+
+    if (scenario_pipe != -1)
+        close(scenario_pipe);
+
+    scenario_pipe = fd;
+
+    // Discard the results of previous scenarios of the parent
+    scenario_children_free();
+
+    // The save file and the profiler output belong to the parent
+    UGBA_SaveFileDetach();
+    profiler_enabled = 0;
+
+#ifdef ENABLE_LIBPNG
+    PNG_WriterInit();
+#endif
+
+    // This handler runs before the ones registered by the parent
+    atexit(scenario_child_atexit);
+}
+
+// Read data from a child. Returns 1 when the child has closed the pipe.
+static int scenario_child_read(scenario_child *child)
+{
+    if (child->capacity - child->size < 4096)
+    {
+        size_t capacity = child->capacity ? child->capacity * 2 : 4096;
+
+        uint8_t *data = realloc(child->data, capacity);
+        if (data == NULL)
+        {
+            Debug_Log("%s: Not enough memory", __func__);
+            return 1;
+        }
+
+        child->data = data;
+        child->capacity = capacity;
+    }
+
+    ssize_t size = read(child->fd, child->data + child->size,
+                        child->capacity - child->size);
+    if (size < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        return 1;
+    }
+
+    if (size == 0)
+        return 1;
+
+    child->size += size;
+
+    return 0;
+}
+
+static void scenario_child_end(scenario_child *child)
+{
+    close(child->fd);
+    child->fd = -1;
+
+    int status;
+    while (waitpid(child->pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+            break;
+    }
+}
+
+int UGBA_ScenarioFork(int num, int max_parallel)
+{
+    if (num <= 0)
+    {
+        Debug_Log("%s: Invalid number of scenarios: %d", __func__, num);
+        return UGBA_SCENARIO_ERROR;
+    }
+
+    // Connections to the audio device and the display can't be shared between
+    // processes.
+    if (SDL_WasInit(SDL_INIT_AUDIO | SDL_INIT_VIDEO) != 0)
+    {
+        Debug_Log("%s: Only available in headless mode", __func__);
+        return UGBA_SCENARIO_ERROR;
+    }
+
+    if (max_parallel <= 0)
+        max_parallel = SDL_GetCPUCount();
+
+    scenario_children_free();
+
+    scenario_children = calloc(num, sizeof(scenario_child));
+    if (scenario_children == NULL)
+    {
+        Debug_Log("%s: Not enough memory", __func__);
+        return UGBA_SCENARIO_ERROR;
+    }
+
+    scenario_children_num = num;
+
+    for (int i = 0; i < num; i++)
+        scenario_children[i].fd = -1;
+
+    struct pollfd *fds = malloc(max_parallel * sizeof(struct pollfd));
+    int *fds_child = malloc(max_parallel * sizeof(int));
+    if ((fds == NULL) || (fds_child == NULL))
+    {
+        Debug_Log("%s: Not enough memory", __func__);
+        free(fds);
+        free(fds_child);
+        scenario_children_free();
+        return UGBA_SCENARIO_ERROR;
+    }
+
+    scenario_quiesce();
+
+    int next = 0; // Next child to be started
+    int running = 0;
+    int ended = 0;
+
+    while (ended < num)
+    {
+        while ((running < max_parallel) && (next < num))
+        {
+            scenario_child *child = &scenario_children[next];
+
+            int pipe_fds[2];
+            if (pipe(pipe_fds) != 0)
+            {
+                Debug_Log("%s: pipe() failed: %s", __func__, strerror(errno));
+                next++;
+                ended++;
+                continue;
+            }
+
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                close(pipe_fds[0]);
+                scenario_child_setup(pipe_fds[1]);
+                free(fds);
+                free(fds_child);
+                return next;
+            }
+
+            close(pipe_fds[1]);
+
+            if (pid < 0)
+            {
+                Debug_Log("%s: fork() failed: %s", __func__, strerror(errno));
+                close(pipe_fds[0]);
+                next++;
+                ended++;
+                continue;
+            }
+
+            child->pid = pid;
+            child->fd = pipe_fds[0];
+
+            next++;
+            running++;
+        }
+
+        if (running == 0)
+            continue;
+
+        int n = 0;
+        for (int i = 0; i < next; i++)
+        {
+            if (scenario_children[i].fd == -1)
+                continue;
+
+            fds[n].fd = scenario_children[i].fd;
+            fds[n].events = POLLIN;
+            fds[n].revents = 0;
+            fds_child[n] = i;
+            n++;
+        }
+
+        if (poll(fds, n, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            Debug_Log("%s: poll() failed: %s", __func__, strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (fds[i].revents == 0)
+                continue;
+
+            scenario_child *child = &scenario_children[fds_child[i]];
+
+            if (scenario_child_read(child))
+            {
+                scenario_child_end(child);
+                running--;
+                ended++;
+            }
+        }
+    }
+
+    // Children can only be left running if poll() has failed
+    for (int i = 0; i < next; i++)
+    {
+        if (scenario_children[i].fd != -1)
+        {
+            kill(scenario_children[i].pid, SIGKILL);
+            scenario_child_end(&scenario_children[i]);
+        }
+    }
+
+    free(fds);
+    free(fds_child);
+
+    scenario_resume();
+
+    return UGBA_SCENARIO_PARENT;
+}
+
+#else // _WIN32
+
+int Scenario_IsChild(void)
+{
+    return 0;
+}
+
+void Scenario_ChildExit(void)
+{
+    exit(0);
+}
+
+int UGBA_ScenarioFork(UNUSED int num, UNUSED int max_parallel)
+{
+    Debug_Log("%s: Not supported in this system", __func__);
+    return UGBA_SCENARIO_ERROR;
+}
+
+void UGBA_ScenarioReport(UNUSED const void *data, UNUSED size_t size)
+{
+}
+
+const void *UGBA_ScenarioGetResult(UNUSED int index, size_t *size)
+{
+    *size = 0;
+    return NULL;
+}
+
+#endif // _WIN32
@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_SCENARIO_H__
+#define SDL2_SCENARIO_H__
+
+// Returns 1 if this process is a child created by UGBA_ScenarioFork()
+int Scenario_IsChild(void);
+
+// End a child process without reporting any result. It can be called from any
+// thread.
+void Scenario_ChildExit(void);
+
+#endif // SDL2_SCENARIO_H__
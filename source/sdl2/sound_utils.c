@@ -135,6 +135,10 @@ int Sound_IsBufferOverThreshold(void)
 
 void Sound_SendSamples(int16_t *buffer, int len)
 {
+    // There is no audio device in headless mode
+    if (stream == NULL)
+        return;
+
     int rc = SDL_AudioStreamPut(stream, buffer, len);
     if (rc == -1)
         Debug_Log("Failed to send samples to stream: %s", SDL_GetError());
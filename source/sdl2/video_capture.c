@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ugba/ugba.h>
+
+#include "debug_utils.h"
+#include "video_capture.h"
+#include "wav_utils.h"
+#include "work_queue.h"
+
+#include "core/color_convert.h"
+#include "core/video.h"
+
+// The thread of the game only copies the frame that has just been drawn to a
+// ring buffer. A background thread converts the frames to the format of the
+// file and writes them, so that the game doesn't have to wait for the disk or
+// for the program that reads from the pipe. The game only needs to wait if the
+// ring buffer is full.
+
+#define VID_RING_FRAMES     16
+
+#define VID_WIDTH           240
+#define VID_HEIGHT          160
+#define VID_PIXELS          (VID_WIDTH * VID_HEIGHT)
+
+typedef struct {
+    uint16_t pixels[VID_PIXELS];
+    int64_t audio_samples; // Samples saved to the WAV file (-1 if none)
+} vid_frame;
+
+static work_queue *vid_ring;
+
+static FILE *vid_file;
+static vid_format vid_file_format;
+static uint8_t *vid_out_buffer; // Converted frame, used by the writer thread
+
+static size_t vid_frame_size(vid_format format)
+{
+    switch (format)
+    {
+        case VID_FORMAT_Y4M:
+        case VID_FORMAT_RGB24:
+            return VID_PIXELS * 3;
+        case VID_FORMAT_BGR555:
+            return VID_PIXELS * 2;
+        default:
+            return 0;
+    }
+}
+
+// BT.601 coefficients, limited range
+static void vid_convert_y4m(uint8_t *dst, const uint16_t *src)
+{
+    uint8_t *y_plane = dst;
+    uint8_t *u_plane = dst + VID_PIXELS;
+    uint8_t *v_plane = dst + VID_PIXELS * 2;
+
+    for (int i = 0; i < VID_PIXELS; i++)
+    {
+        uint16_t color = src[i];
+
+        int r = GBA_ColorExpand5(color & 0x1F);
+        int g = GBA_ColorExpand5((color >> 5) & 0x1F);
+        int b = GBA_ColorExpand5((color >> 10) & 0x1F);
+
+        y_plane[i] = 16 + ((66 * r + 129 * g + 25 * b + 128) >> 8);
+        u_plane[i] = 128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8);
+        v_plane[i] = 128 + ((112 * r - 94 * g - 18 * b + 128) >> 8);
+    }
+}
+
+static void vid_convert_bgr555(uint8_t *dst, const uint16_t *src)
+{
+    for (int i = 0; i < VID_PIXELS; i++)
+    {
+        dst[i * 2 + 0] = src[i] & 0xFF;
+        dst[i * 2 + 1] = src[i] >> 8;
+    }
+}
+
+static void vid_write_frame(void *entry)
+{
+    const vid_frame *frame = entry;
+
+    if (vid_file_format == VID_FORMAT_Y4M)
+    {
+        if (frame->audio_samples >= 0)
+        {
+            fprintf(vid_file, "FRAME XAUDIO=%" PRId64 "\n",
+                    frame->audio_samples);
+        }
+        else
+        {
+            fputs("FRAME\n", vid_file);
+        }
+
+        vid_convert_y4m(vid_out_buffer, frame->pixels);
+    }
+    else if (vid_file_format == VID_FORMAT_RGB24)
+    {
+        GBA_ColorConvertToRGB888(vid_out_buffer, frame->pixels, VID_PIXELS);
+    }
+    else // if (vid_file_format == VID_FORMAT_BGR555)
+    {
+        vid_convert_bgr555(vid_out_buffer, frame->pixels);
+    }
+
+    size_t size = vid_frame_size(vid_file_format);
+
+    if (fwrite(vid_out_buffer, size, 1, vid_file) != 1)
+        Debug_Log("%s(): Failed to write data.", __func__);
+}
+
+void VID_FileEnd(void)
+{
+    // Check if there is an open file
+    if (vid_file == NULL)
+        return;
+
+    // Write all pending frames
+    WQ_Destroy(vid_ring);
+    vid_ring = NULL;
+
+    free(vid_out_buffer);
+    vid_out_buffer = NULL;
+
+    fclose(vid_file);
+
+    Debug_Log("%s: File saved.", __func__);
+
+    vid_file = NULL;
+}
+
+void VID_FileStart(const char *path, vid_format format)
+{
+    if (path == NULL)
+        path = "video.y4m";
+
+    if (vid_file)
+        VID_FileEnd();
+
+    if (vid_frame_size(format) == 0)
+    {
+        Debug_Log("%s(): Invalid format: %d", __func__, format);
+        return;
+    }
+
+    vid_out_buffer = malloc(vid_frame_size(format));
+    if (vid_out_buffer == NULL)
+    {
+        Debug_Log("%s(): Failed to allocate resources.", __func__);
+        return;
+    }
+
+    // If the path is a named pipe, this waits until it has a reader
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        Debug_Log("%s(): Can't open file for writing: %s", __func__, path);
+        free(vid_out_buffer);
+        vid_out_buffer = NULL;
+        return;
+    }
+
+    if (format == VID_FORMAT_Y4M)
+    {
+        // The frame rate is 60 FPS instead of the real GBA frame rate so that
+        // it matches the sample rate used in WAV files.
+        fprintf(file, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n",
+                VID_WIDTH, VID_HEIGHT);
+    }
+
+    vid_file_format = format;
+
+    vid_ring = WQ_Create("Video Capture", sizeof(vid_frame), VID_RING_FRAMES,
+                        vid_write_frame);
+    if (vid_ring == NULL)
+    {
+        fclose(file);
+        free(vid_out_buffer);
+        vid_out_buffer = NULL;
+        return;
+    }
+
+    // Set this at the end, the game thread starts streaming when it is set
+    vid_file = file;
+
+    // Close file when the program exits
+    atexit(VID_FileEnd);
+}
+
+int VID_FileIsOpen(void)
+{
+    if (vid_file == NULL)
+        return 0;
+
+    return 1;
+}
+
+void VID_FileStream(void)
+{
+    if (vid_file == NULL)
+        return;
+
+    vid_frame *frame = WQ_Reserve(vid_ring);
+
+    GBA_ScreenCopyDrawnFrame(frame->pixels);
+
+    if (WAV_FileIsOpen())
+        frame->audio_samples = WAV_FileGetSamples();
+    else
+        frame->audio_samples = -1;
+
+    WQ_Push(vid_ring);
+}
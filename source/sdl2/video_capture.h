@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_VIDEO_CAPTURE_H__
+#define SDL2_VIDEO_CAPTURE_H__
+
+typedef enum {
+    VID_FORMAT_Y4M,     // YUV4MPEG2 stream, 4:4:4 YCbCr (BT.601, limited range)
+    VID_FORMAT_RGB24,   // Raw frames, bytes R, G, B in memory
+    VID_FORMAT_BGR555,  // Raw frames, 16-bit GBA colors in little endian
+} vid_format;
+
+// Start recording one frame per VBL period to the specified path, which can be
+// a regular file or a named pipe (in that case this waits until the pipe is
+// opened by the reader). The stream runs at exactly 60 FPS, like the files
+// saved by WAV_FileStart(). If a WAV file is being recorded, each frame header
+// of Y4M streams has a "XAUDIO=<n>" parameter with the number of audio samples
+// that had been saved to the WAV file before the frame started.
+void VID_FileStart(const char *path, vid_format format);
+// Write all pending frames and close the file
+void VID_FileEnd(void);
+
+int VID_FileIsOpen(void);
+
+// Add the frame that has just been drawn to the file. Frames are written to
+// the file by a background thread.
+void VID_FileStream(void);
+
+#endif // SDL2_VIDEO_CAPTURE_H__
@@ -44,6 +44,7 @@ typedef struct {
 
 static FILE *wav_file;
 static uint32_t wav_sample_rate;
+static uint64_t wav_samples; // Number of samples written to the file
 
 // Hardcode format to 16-bit (signed), two channels
 
@@ -114,6 +115,7 @@ void WAV_FileStart(const char *path, uint32_t sample_rate)
     }
 
     wav_sample_rate = sample_rate;
+    wav_samples = 0;
 
     // Close file when the program exits
     atexit(WAV_FileEnd);
@@ -134,4 +136,11 @@ void WAV_FileStream(int16_t *buffer, size_t size)
 
     if (fwrite(buffer, size, 1, wav_file) != 1)
         Debug_Log("%s(): Failed to write data.", __func__);
+
+    wav_samples += size / (WAV_NUMBER_CHANNELS * WAV_BITS_PER_SAMPLE / 8);
+}
+
+uint64_t WAV_FileGetSamples(void)
+{
+    return wav_samples;
 }
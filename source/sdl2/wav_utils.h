@@ -15,4 +15,7 @@ int WAV_FileIsOpen(void);
 
 void WAV_FileStream(int16_t *buffer, size_t size);
 
+// Number of samples written to the file so far (each one has both channels)
+uint64_t WAV_FileGetSamples(void);
+
 #endif // SDL2_WAV_UTILS_H__
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#include <stdlib.h>
+
+#include <SDL2/SDL.h>
+
+#include "debug_utils.h"
+#include "work_queue.h"
+
+struct work_queue {
+    unsigned char *entries;
+    size_t entry_size;
+    int count;
+    int write; // Next entry to be filled
+
+    wq_handler handler;
+
+    SDL_Thread *thread;
+    SDL_mutex *mutex; // Held between WQ_Reserve() and WQ_Push()
+    SDL_sem *free; // Number of free entries
+    SDL_sem *ready; // Number of entries waiting to be handled
+    volatile int exit;
+};
+
+static int wq_thread_main(void *data)
+{
+    work_queue *queue = data;
+    int index = 0;
+
+    while (1)
+    {
+        SDL_SemWait(queue->ready);
+
+        if (queue->exit)
+            break;
+
+        queue->handler(queue->entries + queue->entry_size * index);
+
+        index = (index + 1) % queue->count;
+
+        SDL_SemPost(queue->free);
+    }
+
+    return 0;
+}
+
+static void wq_free_resources(work_queue *queue)
+{
+    SDL_DestroyMutex(queue->mutex);
+    SDL_DestroySemaphore(queue->free);
+    SDL_DestroySemaphore(queue->ready);
+    free(queue->entries);
+    free(queue);
+}
+
+work_queue *WQ_Create(const char *name, size_t entry_size, int count,
+                      wq_handler handler)
+{
+    work_queue *queue = calloc(1, sizeof(work_queue));
+    if (queue == NULL)
+    {
+        Debug_Log("%s(): Not enough memory", __func__);
+        return NULL;
+    }
+
+    queue->entries = malloc(entry_size * count);
+    queue->entry_size = entry_size;
+    queue->count = count;
+    queue->handler = handler;
+
+    queue->mutex = SDL_CreateMutex();
+    queue->free = SDL_CreateSemaphore(count);
+    queue->ready = SDL_CreateSemaphore(0);
+
+    if ((queue->entries == NULL) || (queue->mutex == NULL) ||
+        (queue->free == NULL) || (queue->ready == NULL))
+    {
+        Debug_Log("%s(): Failed to allocate resources: %s", __func__,
+                  SDL_GetError());
+        wq_free_resources(queue);
+        return NULL;
+    }
+
+    queue->thread = SDL_CreateThread(wq_thread_main, name, queue);
+    if (queue->thread == NULL)
+    {
+        Debug_Log("%s(): SDL_CreateThread(): %s", __func__, SDL_GetError());
+        wq_free_resources(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+void *WQ_Reserve(work_queue *queue)
+{
+    SDL_SemWait(queue->free);
+
+    // Entries are handled in order, so the entry must be filled before any
+    // other producer can reserve the next one.
+    SDL_LockMutex(queue->mutex);
+
+    return queue->entries + queue->entry_size * queue->write;
+}
+
+void WQ_Push(work_queue *queue)
+{
+    queue->write = (queue->write + 1) % queue->count;
+
+    SDL_UnlockMutex(queue->mutex);
+
+    SDL_SemPost(queue->ready);
+}
+
+void WQ_Flush(work_queue *queue)
+{
+    // Entries are only freed after they have been handled, so when all of them
+    // are free there is nothing left to do.
+    for (int i = 0; i < queue->count; i++)
+        SDL_SemWait(queue->free);
+
+    for (int i = 0; i < queue->count; i++)
+        SDL_SemPost(queue->free);
+}
+
+void WQ_Destroy(work_queue *queue)
+{
+    WQ_Flush(queue);
+
+    queue->exit = 1;
+    SDL_SemPost(queue->ready);
+
+    SDL_WaitThread(queue->thread, NULL);
+
+    wq_free_resources(queue);
+}
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+//
+// Copyright (c) 2026 Antonio Niño Díaz
+
+#ifndef SDL2_WORK_QUEUE_H__
+#define SDL2_WORK_QUEUE_H__
+
+#include <stddef.h>
+
+// Queue of fixed-size entries that are handled by a background thread in the
+// same order as they are added. Producers only need to wait if the queue is
+// full.
+
+typedef struct work_queue work_queue;
+
+// Called from the background thread for each entry of the queue
+typedef void (*wq_handler)(void *entry);
+
+// Create a queue of "count" entries of "entry_size" bytes each, and start its
+// thread. Returns NULL on error.
+work_queue *WQ_Create(const char *name, size_t entry_size, int count,
+                      wq_handler handler);
+
+// Wait until there is a free entry and return a pointer to it. The queue stays
+// locked until the entry is added with WQ_Push(), so the entry must be filled
+// right away.
+void *WQ_Reserve(work_queue *queue);
+
+// Add the entry returned by WQ_Reserve() to the queue
+void WQ_Push(work_queue *queue);
+
+// Wait until all entries in the queue have been handled
+void WQ_Flush(work_queue *queue);
+
+// Handle all pending entries, stop the thread and free the queue
+void WQ_Destroy(work_queue *queue);
+
+#endif // SDL2_WORK_QUEUE_H__
@@ -26,16 +26,19 @@ static void TM_TimerStartInternal(int index, uint16_t reload_value,
         PTR_REG_TM0CNT_H, PTR_REG_TM1CNT_H, PTR_REG_TM2CNT_H, PTR_REG_TM3CNT_H
     };
 
+    const uint16_t offsets[4] = {
+        OFFSET_TM0CNT_H, OFFSET_TM1CNT_H, OFFSET_TM2CNT_H, OFFSET_TM3CNT_H
+    };
+
+    // The timer needs to be stopped so that the counter is reloaded when it is
+    // started again.
     *tmcnt_h[index] = TMCNT_STOP;
+    UGBA_RegisterUpdatedOffset(offsets[index]);
+
     *tmcnt_l[index] = reload_value;
     *tmcnt_h[index] = prescaler | (cascade ? TMCNT_CASCADE : TMCNT_STANDALONE) |
                       (enable_irq ? TMCNT_IRQ_ENABLE : TMCNT_IRQ_DISABLE) |
                       TMCNT_START;
-
-    const uint16_t offsets[4] = {
-        OFFSET_TM0CNT_H, OFFSET_TM1CNT_H, OFFSET_TM2CNT_H, OFFSET_TM3CNT_H
-    };
-
     UGBA_RegisterUpdatedOffset(offsets[index]);
 }
 